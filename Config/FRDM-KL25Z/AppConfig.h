@@ -32,6 +32,16 @@
 /* Sofware/app testing */
 #define   SMARTMETER_TEST_CALCULATIONS      0
 
+/* Multiple metering reports (NetMultiMeasureSE): with SE_COMPACT_ENCODING
+   a keyframe with all the values is sent every SE_KEYFRAME_PERIOD reports,
+   and the reports in between carry zigzag varint deltas to that keyframe */
+#ifndef SE_COMPACT_ENCODING
+#define   SE_COMPACT_ENCODING               1
+#endif
+#define   SE_KEYFRAME_PERIOD                16
+/* Meters tracked by the decoder of the coordinator (Decode_SmartEnergy_Profile) */
+#define   SE_METER_TABLE_SIZE               16
+
 /*****************************************************************/
 /** RELAY CONTROL APP CONFIG                                    */
 
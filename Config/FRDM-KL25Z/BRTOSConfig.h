@@ -86,7 +86,7 @@
 
 /// Defines the maximum number of semaphores\n
 /// Limits the memory allocation for semaphores
-#define BRTOS_MAX_SEM          10
+#define BRTOS_MAX_SEM          14
 
 /// Defines the maximum number of mutexes\n
 /// Limits the memory allocation for mutex
@@ -127,5 +127,5 @@
 #define HEAP_SIZE 48*128
 
 // Queue heap defines
-// Configurado com 896 bytes p/ filas
-#define QUEUE_HEAP_SIZE 11*512
+// O buffer de recepcao do radio (RFBuffer) nao usa mais filas do BRTOS
+#define QUEUE_HEAP_SIZE 512
@@ -48,9 +48,9 @@
 
 #define INCLUDE_PRINT		1
 #define PRINT_PING_INFO()	UARTPutString(0x4006A000, "Ping recebido do n ");\
-							UARTPutString(0x4006A000, PrintDecimal(mac_packet.SrcAddr_16b, buffer));\
+							UARTPutString(0x4006A000, PrintDecimal(MAC_RX_SRC_ADDR_16B(), buffer));\
 							UARTPutString(0x4006A000, " com RSSI ");\
-							UARTPutString(0x4006A000, PrintDecimal(mac_packet.Frame_RSSI, buffer));\
+							UARTPutString(0x4006A000, PrintDecimal(mac_frame->Frame_RSSI, buffer));\
 							UARTPutString(0x4006A000, "\n\r");
 
 
@@ -158,6 +158,12 @@ typedef struct SysTick_MemMap2 {
 // Defines the tick timer used to compute stocastic address
 #define TIMER_ADDR       SYST_CVR2          ///< Tick Timer register used in stocastic address generation
 
+// Timer of the system tick used to time the transmissions (TX trigger to RF_TXIF):
+// the microsecond clock is the tick count plus the SysTick count down in the current tick
+#define RADIO_TIMER_COUNT()   ((INT32U)SYST_CVR2)                          ///< counts down, reloaded at each tick
+#define RADIO_TIMER_RELOAD    (configCPU_CLOCK_HZ / configTICK_RATE_HZ)    ///< counts per tick
+#define RADIO_TIMER_PER_US    (configCPU_CLOCK_HZ / 1000000)               ///< counts per microsecond
+
 #endif
 
 // Defines activity LED pin
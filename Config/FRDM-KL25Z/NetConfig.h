@@ -52,26 +52,45 @@
 #define Timer_Priority     			(INT8U)28
 #define UNET_Mutex_Priority         (INT8U)27
 #define APP1_Priority               (INT8U)26
-#define APP2_Priority               (INT8U)25
-#define APP3_Priority               (INT8U)24
-#define NWK_HandlerPriority         (INT8U)23
-#define MAC_HandlerPriority         (INT8U)22
+#define UNET_UpRoute_Priority       (INT8U)25
+#define UNET_Neighbor_Priority      (INT8U)24
+#define UNET_TxFifo_Priority        (INT8U)23
+#define APP2_Priority               (INT8U)22
+#define TX_HandlerPriority          (INT8U)21
+#define NWK_HandlerPriority         (INT8U)20
+#define MAC_HandlerPriority         (INT8U)19
+#define APP3_Priority               (INT8U)18
+
+// Network guards (NWK_Lock): UNET_Mutex_Priority is the ceiling of the packet
+// buffer guard, UNET_UpRoute/Neighbor/TxFifo_Priority the ceilings of the up route
+// table, neighbor table and TX FIFO guards. Each ceiling is a free priority above
+// the tasks that take the guard: the application tasks take none (UNET_Send,
+// UNET_AppReceive), so they are not held up by the UNET tasks while they own them.
+// 1 = a single mutex with ceiling UNET_Mutex_Priority for all the guards (the
+// previous global radio lock)
+#ifndef NWK_GLOBAL_LOCK
+#define NWK_GLOBAL_LOCK                     0
+#endif
 
 
-// APPs signals 
+// APPs signals and receive mailboxes (messages copied by UNET_APP, UNET_AppReceive)
 #define SIGNAL_APP1       App1_event
-//#define SIGNAL_APP2       App1_event
+#define APP1_MAILBOX_SIZE 4
+//#define SIGNAL_APP2       App2_event
+//#define APP2_MAILBOX_SIZE 2
 
 // UNET Tasks Stacks
 #if ((DEVICE_TYPE == PAN_COORDINATOR) || (DEVICE_TYPE == INSTALLER))
 #define UNET_RF_Event_StackSize    (384)
 #define UNET_MAC_StackSize         (384)
 #define UNET_NWK_StackSize         (1280)
+#define UNET_TX_StackSize          (256)
 #else
 #define ContikiMAC_StackSize       (384)
 #define UNET_RF_Event_StackSize    (256)
 #define UNET_MAC_StackSize         (384)
 #define UNET_NWK_StackSize         (1088)
+#define UNET_TX_StackSize          (256)
 #endif
 
 // Ping Times
@@ -89,16 +108,106 @@
 #define PING_RETRIES	  3
 #endif
 
+/// TX queue: frames waiting for the UNET_TX task (slots of 138B)
+#define TX_QUEUE_SIZE     (INT8U)4
+
+/// TX retries: binary exponential backoff window after a frame without ACK,
+/// from TX_BACKOFF_MIN ticks doubling up to TX_BACKOFF_MAX, and the number
+/// of destinations whose consecutive failures are remembered
+#ifndef TX_BACKOFF_MIN
+#define TX_BACKOFF_MIN    (INT16U)8
+#define TX_BACKOFF_MAX    (INT16U)128
+#endif
+#define TX_DEST_MEMORY_SIZE (INT8U)4
+
+/// TX classes: forwarded packets first, then route maintenance and MAC
+/// control, then the APP messages of this node. The APP messages hold at
+/// most TX_QUEUE_APP_SLOTS requests of the queue, and a request that waits
+/// TX_CLASS_MAX_WAIT ticks goes ahead of the other classes
+#ifndef TX_QUEUE_APP_SLOTS
+#define TX_QUEUE_APP_SLOTS  (INT8U)(TX_QUEUE_SIZE / 2)
+#endif
+#ifndef TX_CLASS_MAX_WAIT
+#define TX_CLASS_MAX_WAIT   (INT16U)100
+#endif
+
+/// Aggregation of the messages to the coordinator: the APP messages of this
+/// node and the ones forwarded from its children wait up to
+/// NWK_AGGREGATION_HOLD ticks and are sent together in one frame
+#ifndef NWK_AGGREGATION_ENABLE
+#define NWK_AGGREGATION_ENABLE  0
+#endif
+#define NWK_AGGREGATION_HOLD    (INT16U)50
+
+/// Compressed NWK header (NWK_COMPRESSED): the coordinator destiny of the
+/// packets that go down and the source of the first hop are not sent.
+/// Both formats are always received; set to 0 in a network with nodes
+/// that do not decode the compressed header
+#ifndef NWK_HEADER_COMPRESSION
+#define NWK_HEADER_COMPRESSION  1
+#endif
+
 // UpRoute Times
 #define MAX_UPROUTE_MAINTENANCE_TIME	30
 
-/// RF Buffer Size
+/// RF Buffer Size: at most 127 frames, the ring indices run over [0, 2*RFBufferSize) in INT8U
+#if (DEVICE_TYPE == PAN_COORDINATOR)
+#define RFBufferSize      38               // frames (slots of 138B, ~5 KB)
+#else
+#define RFBufferSize      6                // frames (slots of 138B), including the ones held by received packets
+#endif
+
+/// RX flow control: auto-ACK is disabled when the RF buffer reaches the high watermark
+/// and enabled again when it drains to the low watermark. The slots above the high
+/// watermark are left to frames without ACK request (pings, beacons, broadcasts).
+/// RX_ACK_LOW_WATERMARK < RX_ACK_HIGH_WATERMARK <= RFBufferSize
 #if (DEVICE_TYPE == PAN_COORDINATOR)
-#define RFBufferSize      (INT16U)5*1024      // max. 6 packets (128B)
+#define RX_ACK_HIGH_WATERMARK   (RFBufferSize - 2)    // frames
+#define RX_ACK_LOW_WATERMARK    (RFBufferSize - 5)    // frames
 #else
-#define RFBufferSize      (INT16U)768      // max. 6 packets (128B)
+#define RX_ACK_HIGH_WATERMARK   (RFBufferSize - 1)    // frames
+#define RX_ACK_LOW_WATERMARK    (RFBufferSize - 3)    // frames
 #endif
 
+/// Max. frames decoded by UNET_MAC in one acquisition of the radio (1 = one frame per acquisition)
+#if (DEVICE_TYPE == PAN_COORDINATOR)
+#define RX_DRAIN_MAX            (INT8U)8
+#else
+#define RX_DRAIN_MAX            (INT8U)4
+#endif
+
+/// Received packets in use at the same time (RX packet pool): one being decoded by UNET_MAC,
+/// the others waiting for or being routed by the network task and read by the applications.
+/// Each one holds its RF buffer slot. 1 = one packet through the MAC, NWK and APP layers at a time
+#if (DEVICE_TYPE == PAN_COORDINATOR)
+#define RX_PACKET_POOL_SIZE     (INT8U)3
+#else
+#define RX_PACKET_POOL_SIZE     (INT8U)5
+#endif
+
+/// Forwarding queue: received packets waiting for the network task to route them.
+/// A packet to be forwarded waits at the head while the TX queue has no free request.
+/// When the queue is full the new packet (NWK_FWD_DROP_TAIL) or the oldest one
+/// (NWK_FWD_DROP_OLDEST) is dropped. NWK_FWD_QUEUE_SIZE <= RX_PACKET_POOL_SIZE; with
+/// a smaller queue the MAC still has packets to decode pings while it is full
+#define NWK_FWD_QUEUE_SIZE      (INT8U)((RX_PACKET_POOL_SIZE > 1) ? (RX_PACKET_POOL_SIZE - 1) : 1)
+#define NWK_FWD_DROP_POLICY     NWK_FWD_DROP_TAIL
+
+/// Packets for this node (NWK_DEST) behind a packet that waits for a free TX request
+/// are routed before it. 0 = the forwarding queue is routed in order
+#define NWK_FWD_LOCAL_BYPASS    1
+
+/// Application messages being sent (UNET_Send): each entry keeps a copy of the message
+/// until it is routed and its transmission ends (with NWK_AGGREGATION_ENABLE, until the
+/// aggregated frame is sent), and one semaphore for UNET_SendWait. At most 8 entries
+#define UNET_SEND_POOL_SIZE     4
+
+/// Frame CRC: CRC16_BY_TABLE (512B), CRC16_BY_NIBBLE (32B) or CRC16_BY_SLICE4 (2KB of flash)
+#define CRC16_METHOD      CRC16_BY_TABLE
+
+/// Drop frames of other PANs and unicasts to other nodes before they take an RX buffer slot
+#define RX_ADDRESS_FILTER 1
+
 /// Memory locations for network address and configurations
 #if PROCESSOR == COLDFIRE_V1
 #if (DEVICE_TYPE == PAN_COORDINATOR)
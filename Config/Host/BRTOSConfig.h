@@ -0,0 +1,55 @@
+///////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////
+/////                                                     /////
+/////                   OS User Defines                   /////
+/////                                                     /////
+/////             !User configuration defines!            /////
+/////                                                     /////
+///////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////
+
+/// Define if simulation or DEBUG
+#define DEBUG 					1
+
+/// Define if compute cpu load is active
+#define COMPUTES_CPU_LOAD 		0
+
+/// Define Number of Priorities
+#define NUMBER_OF_PRIORITIES 	32
+
+/// Define the maximum number of Tasks to be Installed
+/// must always be equal or higher to NumberOfInstalledTasks
+#define NUMBER_OF_TASKS 		(INT8U)10
+
+#define configMAX_TASK_NAME_LEN 32
+
+/// Define if TimerHook function is active
+#define TIMER_HOOK_EN 1
+
+/// Enable or disable semaphore controls
+#define BRTOS_SEM_EN           1
+
+/// Enable or disable mutex controls
+#define BRTOS_MUTEX_EN         1
+
+/// Enable or disable queue controls
+#define BRTOS_QUEUE_EN         1
+
+/// Defines the maximum number of semaphores\n
+/// Limits the memory allocation for semaphores
+#define BRTOS_MAX_SEM          14
+
+/// Defines the maximum number of mutexes\n
+/// Limits the memory allocation for mutex
+#define BRTOS_MAX_MUTEX        4
+
+/// Defines the maximum number of queues\n
+/// Limits the memory allocation for queues
+#define BRTOS_MAX_QUEUE        3
+
+/// TickTimer Defines
+#define configTICK_RATE_HZ          (INT32U)1000        ///< Tick timer rate in Hertz
+
+// Queue heap defines
+// The radio RX buffer (RFBuffer) no longer uses a BRTOS queue
+#define QUEUE_HEAP_SIZE 512
@@ -0,0 +1,39 @@
+#ifndef BOARD_CONFIG_H
+#define BOARD_CONFIG_H
+
+#include "BRTOS.h"
+
+/*************************************************/
+/** Radio configuration - used by radio driver   */ 
+
+// Power levels
+#define RFTX_0dB    0x00
+#define RFTX_m10dB  0x40
+#define RFTX_m20dB  0x80
+#define RFTX_m30dB  0xC0
+#define RFTX_m36dB  0xF8
+
+#define INCLUDE_PRINT		0
+
+// Transceiver interrupt, emulated by the radio model
+#define RFIF              MRF24J40_InterruptClear()     // Limpa flag da interrupcao externa
+#define RFINT_ENABLE      MRF24J40_InterruptEnable()    // habilita interrupcao externa
+#define RFFLAG			  0
+
+#define TX_POWER_LEVEL   RFTX_0dB        
+
+// No SPI port to initialize: the radio model is accessed directly
+#define SPI_Init()
+
+// Defines the tick timer used to compute stocastic address
+#define TIMER_ADDR       ((INT16U)OSHostCycles())    ///< Tick Timer register used in stocastic address generation
+
+// Free running microsecond clock used to time the transmissions (TX trigger to RF_TXIF)
+#define RADIO_TIMESTAMP_US()  ((INT16U)(OSHostNanoseconds() / 1000))
+
+#define RADIO_DRIVER_WATCHDOG 1
+#define CHANNEL_ERROR     (INT8U)255 
+
+/****************************************************/
+
+#endif
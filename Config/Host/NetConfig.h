@@ -0,0 +1,261 @@
+#ifndef NET_CONFIG_H
+#define NET_CONFIG_H
+
+#include "BRTOS.h"
+
+/// Define network support           
+#define NETWORK_ENABLE                      1
+
+#define CONTIKI_MAC_ENABLE					0
+#define CONTIKI_MAC_WINDOW					125
+
+// Network device types
+#define   PAN_COORDINATOR                   0
+#define   ROUTER                            1
+
+// Network device type: see options above
+// The host makefile builds one program for each type (-DDEVICE_TYPE=...)
+#ifndef DEVICE_TYPE
+#define   DEVICE_TYPE                       PAN_COORDINATOR
+#endif
+
+// Define router type
+#define   ROUTER1                   		0
+#define   ROUTER2                           1
+
+#define   ROUTER_TYPE                       ROUTER1
+
+
+#define ROUTER_AUTO_ASSOCIATION				TRUE
+#if (ROUTER_AUTO_ASSOCIATION == TRUE)
+#if (ROUTER_TYPE == ROUTER1)
+#define ROUTER_AUTO_ASSOCIATION_MAC_ADDR	1
+#endif
+#if (ROUTER_TYPE == ROUTER2)
+#define ROUTER_AUTO_ASSOCIATION_MAC_ADDR	2
+#endif
+#endif
+#ifndef ROUTER_AUTO_ASSOCIATION_MAC_ADDR
+	#error	Defina o endereco MAC do roteador na variavel ROUTER_AUTO_ASSOCIATION_MAC_ADDR
+#endif
+
+// CPU memory alignment
+#define CPU_32_BITS                         1
+#define CPU_16_BITS                         0
+#define CPU_8_BITS                          0
+
+// Reactive up route - 1 = on, 0 = off
+#define USE_REACTIVE_UP_ROUTE               1
+#define REACTIVE_UP_ROUTE_AUTO_MAINTENANCE  1
+
+// UNET Tasks Priorities
+#define ContikiMACPriority			(INT8U)31
+#define SystemTaskPriority     		(INT8U)30
+#define RF_EventHandlerPriority     (INT8U)29
+#define Timer_Priority     			(INT8U)28
+#define UNET_Mutex_Priority         (INT8U)27
+#define APP1_Priority               (INT8U)26
+#define UNET_UpRoute_Priority       (INT8U)25
+#define UNET_Neighbor_Priority      (INT8U)24
+#define UNET_TxFifo_Priority        (INT8U)23
+#define APP2_Priority               (INT8U)22
+#define TX_HandlerPriority          (INT8U)21
+#define NWK_HandlerPriority         (INT8U)20
+#define MAC_HandlerPriority         (INT8U)19
+#define APP3_Priority               (INT8U)18
+
+// Network guards (NWK_Lock): UNET_Mutex_Priority is the ceiling of the packet
+// buffer guard, UNET_UpRoute/Neighbor/TxFifo_Priority the ceilings of the up route
+// table, neighbor table and TX FIFO guards. Each ceiling is a free priority above
+// the tasks that take the guard: the application tasks take none (UNET_Send,
+// UNET_AppReceive), so they are not held up by the UNET tasks while they own them.
+// 1 = a single mutex with ceiling UNET_Mutex_Priority for all the guards (the
+// previous global radio lock)
+#ifndef NWK_GLOBAL_LOCK
+#define NWK_GLOBAL_LOCK                     0
+#endif
+
+
+// APPs signals and receive mailboxes (messages copied by UNET_APP, UNET_AppReceive)
+#define SIGNAL_APP1       App1_event
+#ifndef APP1_MAILBOX_SIZE
+#define APP1_MAILBOX_SIZE                   4
+#endif
+
+// UNET Tasks Stacks (not used by the host port)
+#define ContikiMAC_StackSize       (384)
+#define UNET_RF_Event_StackSize    (384)
+#define UNET_MAC_StackSize         (384)
+#define UNET_NWK_StackSize         (1280)
+#define UNET_TX_StackSize          (384)
+
+// Ping Times
+#if (CONTIKI_MAC_ENABLE == 1)
+#define TX_TIMEOUT       20
+#else
+#define TX_TIMEOUT       50
+#endif
+#define PING_TIME		 10
+#define MAX_PING_TIME	  8
+
+#if (CONTIKI_MAC_ENABLE == 1)
+#define PING_RETRIES	 70	  
+#else
+#define PING_RETRIES	  3
+#endif
+
+/// TX queue: frames waiting for the UNET_TX task (slots of 138B)
+#define TX_QUEUE_SIZE     (INT8U)4
+
+/// TX retries: binary exponential backoff window after a frame without ACK,
+/// from TX_BACKOFF_MIN ticks doubling up to TX_BACKOFF_MAX, and the number
+/// of destinations whose consecutive failures are remembered
+#ifndef TX_BACKOFF_MIN
+#define TX_BACKOFF_MIN    (INT16U)8
+#define TX_BACKOFF_MAX    (INT16U)128
+#endif
+#define TX_DEST_MEMORY_SIZE (INT8U)4
+
+/// TX classes: forwarded packets first, then route maintenance and MAC
+/// control, then the APP messages of this node. The APP messages hold at
+/// most TX_QUEUE_APP_SLOTS requests of the queue, and a request that waits
+/// TX_CLASS_MAX_WAIT ticks goes ahead of the other classes
+#ifndef TX_QUEUE_APP_SLOTS
+#define TX_QUEUE_APP_SLOTS  (INT8U)(TX_QUEUE_SIZE / 2)
+#endif
+#ifndef TX_CLASS_MAX_WAIT
+#define TX_CLASS_MAX_WAIT   (INT16U)100
+#endif
+
+/// Aggregation of the messages to the coordinator: the APP messages of this
+/// node and the ones forwarded from its children wait up to
+/// NWK_AGGREGATION_HOLD ticks and are sent together in one frame
+#ifndef NWK_AGGREGATION_ENABLE
+#define NWK_AGGREGATION_ENABLE  0
+#endif
+#define NWK_AGGREGATION_HOLD    (INT16U)50
+
+/// Compressed NWK header (NWK_COMPRESSED): the coordinator destiny of the
+/// packets that go down and the source of the first hop are not sent.
+/// Both formats are always received; set to 0 in a network with nodes
+/// that do not decode the compressed header
+#ifndef NWK_HEADER_COMPRESSION
+#define NWK_HEADER_COMPRESSION  1
+#endif
+
+// UpRoute Times
+#define MAX_UPROUTE_MAINTENANCE_TIME	30
+
+/// RF Buffer Size: at most 127 frames, the ring indices run over [0, 2*RFBufferSize) in INT8U
+#if (DEVICE_TYPE == PAN_COORDINATOR)
+#define RFBufferSize      38               // frames (slots of 138B, ~5 KB)
+#else
+#define RFBufferSize      6                // frames (slots of 138B), including the ones held by received packets
+#endif
+
+/// RX flow control: auto-ACK is disabled when the RF buffer reaches the high watermark
+/// and enabled again when it drains to the low watermark. The slots above the high
+/// watermark are left to frames without ACK request (pings, beacons, broadcasts).
+/// RX_ACK_LOW_WATERMARK < RX_ACK_HIGH_WATERMARK <= RFBufferSize
+#ifndef RX_ACK_HIGH_WATERMARK
+#if (DEVICE_TYPE == PAN_COORDINATOR)
+#define RX_ACK_HIGH_WATERMARK   (RFBufferSize - 2)    // frames
+#define RX_ACK_LOW_WATERMARK    (RFBufferSize - 5)    // frames
+#else
+#define RX_ACK_HIGH_WATERMARK   (RFBufferSize - 1)    // frames
+#define RX_ACK_LOW_WATERMARK    (RFBufferSize - 3)    // frames
+#endif
+#endif
+
+/// Max. frames decoded by UNET_MAC in one acquisition of the radio (1 = one frame per acquisition)
+#ifndef RX_DRAIN_MAX
+#if (DEVICE_TYPE == PAN_COORDINATOR)
+#define RX_DRAIN_MAX            (INT8U)8
+#else
+#define RX_DRAIN_MAX            (INT8U)4
+#endif
+#endif
+
+/// Received packets in use at the same time (RX packet pool): one being decoded by UNET_MAC,
+/// the others waiting for or being routed by the network task and read by the applications.
+/// Each one holds its RF buffer slot. 1 = one packet through the MAC, NWK and APP layers at a time
+#ifndef RX_PACKET_POOL_SIZE
+#if (DEVICE_TYPE == PAN_COORDINATOR)
+#define RX_PACKET_POOL_SIZE     (INT8U)3
+#else
+#define RX_PACKET_POOL_SIZE     (INT8U)5
+#endif
+#endif
+
+/// Forwarding queue: received packets waiting for the network task to route them.
+/// A packet to be forwarded waits at the head while the TX queue has no free request.
+/// When the queue is full the new packet (NWK_FWD_DROP_TAIL) or the oldest one
+/// (NWK_FWD_DROP_OLDEST) is dropped. NWK_FWD_QUEUE_SIZE <= RX_PACKET_POOL_SIZE; with
+/// a smaller queue the MAC still has packets to decode pings while it is full
+#ifndef NWK_FWD_QUEUE_SIZE
+#define NWK_FWD_QUEUE_SIZE      (INT8U)((RX_PACKET_POOL_SIZE > 1) ? (RX_PACKET_POOL_SIZE - 1) : 1)
+#endif
+#ifndef NWK_FWD_DROP_POLICY
+#define NWK_FWD_DROP_POLICY     NWK_FWD_DROP_TAIL
+#endif
+
+/// Packets for this node (NWK_DEST) behind a packet that waits for a free TX request
+/// are routed before it. 0 = the forwarding queue is routed in order
+#ifndef NWK_FWD_LOCAL_BYPASS
+#define NWK_FWD_LOCAL_BYPASS    1
+#endif
+
+/// Application messages being sent (UNET_Send): each entry keeps a copy of the message
+/// until it is routed and its transmission ends (with NWK_AGGREGATION_ENABLE, until the
+/// aggregated frame is sent), and one semaphore for UNET_SendWait. At most 8 entries
+#ifndef UNET_SEND_POOL_SIZE
+#define UNET_SEND_POOL_SIZE     4
+#endif
+
+/// Frame CRC: CRC16_BY_TABLE (512B), CRC16_BY_NIBBLE (32B) or CRC16_BY_SLICE4 (2KB of flash)
+#ifndef CRC16_METHOD
+#define CRC16_METHOD      CRC16_BY_TABLE
+#endif
+
+/// Drop frames of other PANs and unicasts to other nodes before they take an RX buffer slot
+#define RX_ADDRESS_FILTER 1
+
+/// Memory locations for network address and configurations
+/// The host flash is an array (see FLASH.h), addresses are offsets in it
+#if (DEVICE_TYPE == PAN_COORDINATOR)
+  #define LAT_MEM_ADDRESS    HOST_FLASH_ADDRESS(0x000)
+  #define LON_MEM_ADDRESS    HOST_FLASH_ADDRESS(0x004)
+  #define MAC16_MEM_ADDRESS
+  #define MAC64_MEM_ADDRESS  HOST_FLASH_ADDRESS(0x800)
+  #define PANID_MEM_ADDRESS
+  #define PANID_INIT_VALUE   0x4742
+  #define MAC16_INIT_VALUE   0x0000
+  #define ROUTC_INIT_VALUE   0x01  
+#else 
+  #define LAT_MEM_ADDRESS    HOST_FLASH_ADDRESS(0x000)
+  #define LON_MEM_ADDRESS    HOST_FLASH_ADDRESS(0x004)
+  #define MAC16_MEM_ADDRESS  HOST_FLASH_ADDRESS(0x008)
+  #define PANID_MEM_ADDRESS  HOST_FLASH_ADDRESS(0x00C)
+  #define MAC64_MEM_ADDRESS  HOST_FLASH_ADDRESS(0x800)
+  #define PANID_INIT_VALUE   0xFFFF
+  #define MAC16_INIT_VALUE   0xFFFF
+  #define ROUTC_INIT_VALUE   0x00  
+#endif
+
+#define HOST_FLASH_SIZE           0x1000
+#define HOST_FLASH_ADDRESS(x)     ((uintptr_t)&HostFlash[(x)])
+extern INT8U HostFlash[HOST_FLASH_SIZE];
+
+// IEEE EUI - globally unique number
+#define EUI_7 0xCA
+#define EUI_6 0xBA
+#define EUI_5 0x60                       
+#define EUI_4 0x89
+#define EUI_3 0x50
+#define EUI_2 0x16
+#define EUI_1 0x77
+#define EUI_0 0x84
+
+
+
+#endif
@@ -59,28 +59,14 @@ INT8U    Config_REPORT_JITTER_100MS = 1;
 INT8U NetGeneralONOFF(INT8U state, INT16U destiny)
 {
   INT8U j = 0;
-  INT8U status = 0;
-
-  acquireRadio();
-
-  NWKPayload[j++] = APP_01;
-  NWKPayload[j++] = GENERAL_PROFILE;
-  NWKPayload[j++] = GENERAL_ONOFF;
-  NWKPayload[j++] = state;
-
-  if (destiny == 0){
-	  status = DownRoute(START_ROUTE,(INT8U)(j));
-  }else{
-	  #if (USE_REACTIVE_UP_ROUTE == 1)
-	  status = ReactiveUpRoute(START_ROUTE,(INT8U)(j),destiny);
-	  #else
-	  status = NO_ROUTE_AVAILABLE;
-	  #endif
-  }
+  INT8U message[APP_HEADER_SIZE];
 
-  releaseRadio();
+  message[j++] = APP_01;
+  message[j++] = GENERAL_PROFILE;
+  message[j++] = GENERAL_ONOFF;
+  message[j++] = state;
 
-  return status;
+  return UNET_Send((destiny == 0) ? UNET_SEND_TO_BASE : UNET_SEND_UP, destiny, message, j, NULL);
 }
 
 
@@ -88,19 +74,13 @@ INT8U NetGeneralONOFF(INT8U state, INT16U destiny)
 INT8U NetGeneralCreateUpPath(void)
 {
   INT8U j = 0;
-  INT8U status = 0;
+  INT8U message[APP_HEADER_SIZE];
 
-  acquireRadio();
+  message[j++] = APP_01;
+  message[j++] = GENERAL_PROFILE;
+  message[j++] = CREATE_UP_PATH;
 
-  NWKPayload[j++] = APP_01;
-  NWKPayload[j++] = GENERAL_PROFILE;
-  NWKPayload[j++] = CREATE_UP_PATH;
-
-  status = DownRoute(START_ROUTE,(INT8U)(j));
-
-  releaseRadio();
-
-  return status;
+  return UNET_Send(UNET_SEND_TO_BASE, 0, message, j, NULL);
 }
 
 
@@ -112,19 +92,19 @@ INT8U NetGeneralCreateUpPath(void)
 **/
 #include "UART.h"
 #include "utils.h"
-void Decode_General_Profile(void)
+void Decode_General_Profile(const UNET_APP_MSG *msg)
 {
-    switch(app_packet.APP_Command)
+    switch(APP_RX_COMMAND(msg))
     {
       /* message to turn on/off */
       case GENERAL_ONOFF:
 
-        if (app_packet.APP_Command_Attribute == ON)
+        if (APP_RX_COMMAND_ATTRIBUTE(msg) == ON)
         {              
            //SensorLight_Disable();
         	GPIOPinReset(GPIOB_BASE, GPIO_PIN_18);
         }
-        if(app_packet.APP_Command_Attribute == OFF)
+        if(APP_RX_COMMAND_ATTRIBUTE(msg) == OFF)
         {          
             //SensorLight_Enable();
         	GPIOPinSet(GPIOB_BASE, GPIO_PIN_18);
@@ -155,7 +135,7 @@ void Decode_General_Profile(void)
       
       case RADIO_TXPL:
         /* set TX output power */           
-        SetTxPower(app_packet.APP_Command_Attribute & 0xF8);         
+        SetTxPower(APP_RX_COMMAND_ATTRIBUTE(msg) & 0xF8);         
 
         
 #if (defined TEST_PIN && TEST_PIN == 1)        
@@ -167,24 +147,24 @@ void Decode_General_Profile(void)
       break;
       
       case APP_CONFIG_PARAM:
-        switch (app_packet.APP_Command_Attribute){
+        switch (APP_RX_COMMAND_ATTRIBUTE(msg)){
           case LUX_THRESHOLD_MIN:
-          Config_LUX_THRESHOLD_MIN = app_packet.APP_Payload[0];
+          Config_LUX_THRESHOLD_MIN = APP_RX_PAYLOAD(msg)[0];
           break;
           case LUX_THRESHOLD_MAX:
-          Config_LUX_THRESHOLD_MAX = app_packet.APP_Payload[0];
+          Config_LUX_THRESHOLD_MAX = APP_RX_PAYLOAD(msg)[0];
           break;
           case PARENT_THRESHOLD:
-          Config_PARENT_THRESHOLD = app_packet.APP_Payload[0];
+          Config_PARENT_THRESHOLD = APP_RX_PAYLOAD(msg)[0];
           break;
           case PARENT_THRESHOLD_MIN:
-          Config_PARENT_THRESHOLD_MIN = app_packet.APP_Payload[0];
+          Config_PARENT_THRESHOLD_MIN = APP_RX_PAYLOAD(msg)[0];
           break;
           case REPORT_PERIOD_1000MS:
-          Config_REPORT_PERIOD_1000MS = app_packet.APP_Payload[0];
+          Config_REPORT_PERIOD_1000MS = APP_RX_PAYLOAD(msg)[0];
           break;
           case REPORT_JITTER_100MS:
-          Config_REPORT_JITTER_100MS = app_packet.APP_Payload[0];
+          Config_REPORT_JITTER_100MS = APP_RX_PAYLOAD(msg)[0];
           break;          
           default:
           break;
@@ -206,17 +186,17 @@ void Decode_General_Profile(void)
 * @fn     Decode_Lighting_Profile
 * @brief  function to decode messages for Lighting profile
 **/
-void Decode_Lighting_Profile(void)
+void Decode_Lighting_Profile(const UNET_APP_MSG *msg)
 {
 #ifdef SET_LIGHT_LEVEL
     INT8U level = 0;
 #endif
        
-    switch(app_packet.APP_Command)
+    switch(APP_RX_COMMAND(msg))
     {
       case LIGHTING_DIMMING:
 		#ifdef SET_LIGHT_LEVEL
-        level = app_packet.APP_Command_Attribute;
+        level = APP_RX_COMMAND_ATTRIBUTE(msg);
         SET_LIGHT_LEVEL();
         #endif        
                                 
@@ -233,13 +213,16 @@ void Decode_Lighting_Profile(void)
 * @brief  function to decode messages for Smart Energy profile
 **/
 
-void Decode_SmartEnergy_Profile(void)
+void Decode_SmartEnergy_Profile(const UNET_APP_MSG *msg)
 {   
     INT8U Attribute = 0;
-    switch(app_packet.APP_Command)
+#if (DEVICE_TYPE == PAN_COORDINATOR)
+    SE_STRUCT se;
+#endif
+    switch(APP_RX_COMMAND(msg))
     {
       case SIMPLE_METERING:
-        Attribute = app_packet.APP_Command_Attribute;
+        Attribute = APP_RX_COMMAND_ATTRIBUTE(msg);
         
         switch(Attribute)
         {
@@ -258,6 +241,14 @@ void Decode_SmartEnergy_Profile(void)
         
         break;
       
+#if (DEVICE_TYPE == PAN_COORDINATOR)
+      case MULTIPLE_METERING:
+        // Relatrios keyframe/delta (SE_COMPACT_ENCODING)
+        (void)SE_MultiDecode(APP_RX_SOURCE(msg), APP_RX_COMMAND_ATTRIBUTE(msg), APP_RX_PAYLOAD(msg),
+                             APP_RX_COMMAND_SIZE(msg), &se);
+        break;
+#endif
+      
       default:
         break;
     }
@@ -269,10 +260,11 @@ void SniferRep(INT16U atributte, INT16U destiny)
   INT8U j = 0;
   INT8U status = 0;
   INT8U cnt = 0;
+  INT8U message[APP_HEADER_SIZE + ((NEIGHBOURHOOD_SIZE - 1) * 4) + 4];
                                                                     
-  NWKPayload[j++] = APP_01;
-  NWKPayload[j++] = GENERAL_PROFILE;
-  NWKPayload[j++] = SNIFER_REP; 
+  message[j++] = APP_01;
+  message[j++] = GENERAL_PROFILE;
+  message[j++] = SNIFER_REP; 
   
   //conta quantos vizinhos tem
   cnt = 0; 
@@ -284,141 +276,370 @@ void SniferRep(INT16U atributte, INT16U destiny)
     }
   } 
   
-  NWKPayload[j++] = cnt; 
+  message[j++] = cnt; 
     
   for(i=0;i<(NEIGHBOURHOOD_SIZE-1);i++) 
   {
     if (unet_neighbourhood[i].Addr_16b != 0xFFFE)
     {                      
-      NWKPayload[j++] = (INT8U)(unet_neighbourhood[i].Addr_16b >> 8);
-      NWKPayload[j++] = (INT8U)(unet_neighbourhood[i].Addr_16b & 0xFF);
-      NWKPayload[j++] = unet_neighbourhood[i].NeighborRSSI;
-      NWKPayload[j++] = unet_neighbourhood[i].NeighborStatus.bits.Symmetric;
+      message[j++] = (INT8U)(unet_neighbourhood[i].Addr_16b >> 8);
+      message[j++] = (INT8U)(unet_neighbourhood[i].Addr_16b & 0xFF);
+      message[j++] = unet_neighbourhood[i].NeighborRSSI;
+      message[j++] = unet_neighbourhood[i].NeighborStatus.bits.Symmetric;
     }
   }
   
-  NWKPayload[j++] = (INT8U)(atributte >> 8);
-  NWKPayload[j++] = (INT8U)(atributte & 0xFF);
-  NWKPayload[j++] = (INT8U) CHANNEL_INIT_VALUE;
-  NWKPayload[j++] = (INT8U) GetTxPower();
+  message[j++] = (INT8U)(atributte >> 8);
+  message[j++] = (INT8U)(atributte & 0xFF);
+  message[j++] = (INT8U) CHANNEL_INIT_VALUE;
+  message[j++] = (INT8U) GetTxPower();
   
  
-  if (destiny == 0){
-	  status = DownRoute(START_ROUTE,(INT8U)(j));
-  }else{
-	  #if (USE_REACTIVE_UP_ROUTE == 1)
-	  status = ReactiveUpRoute(START_ROUTE,(INT8U)(j),destiny);
-	  #else
-	  status = NO_ROUTE_AVAILABLE;
-	  #endif
-  }
+  status = UNET_Send((destiny == 0) ? UNET_SEND_TO_BASE : UNET_SEND_UP, destiny, message, j, NULL);
 
   (void)status;
 }
 
 
+/* Medidas de um relatrio multiple metering na ordem de transmisso.
+   Bit i da mscara do relatrio = medida i */
+static INT8U SE_Params(const SE_STRUCT *se, INT32U *value)
+{
+  INT8U mask = 0;
+  
+  value[0] = se->v_rms;
+  value[1] = se->i_rms;
+  value[2] = se->power_factor;
+  value[3] = se->power_S;
+  value[4] = se->power_Q;
+  value[5] = se->power_P;
+  value[6] = se->energy_meter;
+  
+  if (se->params.Bits.Voltage)        mask |= 0x01;
+  if (se->params.Bits.Current)        mask |= 0x02;
+  if (se->params.Bits.Power_Factor)   mask |= 0x04;
+  if (se->params.Bits.Apparent_Power) mask |= 0x08;
+  if (se->params.Bits.Reactive_Power) mask |= 0x10;
+  if (se->params.Bits.Active_Power)   mask |= 0x20;
+  if (se->params.Bits.Energy)         mask |= 0x40;
+  
+  return mask;
+}
+
+/* Varint: 7 bits por byte, do menos significativo ao mais significativo,
+   bit 7 indica que h mais bytes */
+static INT8U SE_PutVarint(INT8U *data, INT32U value)
+{
+  INT8U j = 0;
+  
+  while (value >= 0x80)
+  {
+    data[j++] = (INT8U)(value | 0x80);
+    value >>= 7;
+  }
+  data[j++] = (INT8U)value;
+  
+  return j;
+}
+
+/* Zigzag: diferenas pequenas, positivas ou negativas, em poucos bytes */
+#define SE_ZIGZAG(delta)      ((INT32U)((delta) << 1) ^ (INT32U)(0 - ((delta) >> 31)))
+#define SE_UNZIGZAG(value)    ((INT32U)((value) >> 1) ^ (INT32U)(0 - ((value) & 1)))
+
+/* ltimo keyframe enviado por este n, base dos relatrios delta seguintes */
+static INT32U se_key[SE_MEASURES];
+static INT8U  se_key_mask;
+static INT8U  se_key_seq;
+static INT8U  se_since_key = SE_KEYFRAME_PERIOD;
+/* Handle do ltimo relatrio enviado: o resultado  lido antes do prximo */
+static UNET_SEND_HANDLE se_send = UNET_SEND_NONE;
+
 /**
-* @fn     NetMultiMeasureSE
-* @brief  function to send message for Smart Energy profile
+* @fn     SE_MultiEncode
+* @brief  encodes a multiple metering report from the command attribute on:
+*         [MULTIPLE_KEYFRAME][key seq][mask][varint values] or
+*         [MULTIPLE_DELTA][key seq][mask][zigzag varint deltas to the keyframe].
+*         A delta only depends on its keyframe: a lost report costs itself only
+* @return size of the encoded report
 **/
-#if 0
-INT8U NetMultiMeasureSE(SE_STRUCT *se)
+INT8U SE_MultiEncode(SE_STRUCT *se, INT8U *data)
 {
-
-  INT8U i = 0;
-  INT8U j = 0;  
-  INT8U count = 0; 
-  INT8U status = 0;
+  INT32U value[SE_MEASURES];
+  INT8U  mask;
+  INT8U  i = 0;
+  INT8U  j = 0;
+  INT8U  key;
   
-  acquireRadio();
+  mask = SE_Params(se, value);
+  key  = (INT8U)((se_since_key >= SE_KEYFRAME_PERIOD) || (mask != se_key_mask));
   
-  NWKPayload[j++] = APP_01;
-  NWKPayload[j++] = SMART_ENERGY_PROFILE;
-  NWKPayload[j++] = MULTIPLE_METERING;   
+  if (key)
+  {
+    se_key_seq++;
+    se_key_mask  = mask;
+    se_since_key = 0;
+  }
+  se_since_key++;
   
-  //"se"  um ponteiro que contem o endereo da estrutura SE_ESTRUCTURE          
-  // Descobre o nmero de medidas a serem enviadas
-  for(i=0;i<8;i++)
+  data[j++] = key ? MULTIPLE_KEYFRAME : MULTIPLE_DELTA;
+  data[j++] = se_key_seq;
+  data[j++] = mask;
+  
+  for (i = 0; i < SE_MEASURES; i++)
   {
-    if ((se->params.Byte >> i) && 1)
+    if (mask & (1 << i))
     {
-      count++;
+      if (key)
+      {
+        se_key[i] = value[i];
+        j += SE_PutVarint(&data[j], value[i]);
+      }else
+      {
+        j += SE_PutVarint(&data[j], SE_ZIGZAG(value[i] - se_key[i]));
+      }
     }
   }
   
-  NWKPayload[j++] = count;
+  return j;
+}
+
+
+#if (DEVICE_TYPE == PAN_COORDINATOR)
+static void SE_SetParams(SE_STRUCT *se, INT8U mask, const INT32U *value)
+{
+  se->params.Byte                 = 0;
+  se->params.Bits.Voltage         = (mask & 0x01) ? 1 : 0;
+  se->params.Bits.Current         = (mask & 0x02) ? 1 : 0;
+  se->params.Bits.Power_Factor    = (mask & 0x04) ? 1 : 0;
+  se->params.Bits.Apparent_Power  = (mask & 0x08) ? 1 : 0;
+  se->params.Bits.Reactive_Power  = (mask & 0x10) ? 1 : 0;
+  se->params.Bits.Active_Power    = (mask & 0x20) ? 1 : 0;
+  se->params.Bits.Energy          = (mask & 0x40) ? 1 : 0;
+  
+  se->v_rms        = (INT16U)value[0];
+  se->i_rms        = (INT16U)value[1];
+  se->power_factor = (INT16U)value[2];
+  se->power_S      = value[3];
+  se->power_Q      = value[4];
+  se->power_P      = value[5];
+  se->energy_meter = value[6];
+}
+
+static INT8U SE_GetVarint(const INT8U *data, INT8U size, INT32U *value)
+{
+  INT8U j = 0;
+  INT8U shift = 0;
   
-  //verifica se o bit voltage da variavel params  1. Se for envia.  
-  if(se->params.Bits.Voltage)      
+  *value = 0;
+  while ((j < size) && (shift < 35))
   {
-      //NWKPayload[j++] = VOLTAGE;
-      NWKPayload[j++] = (INT8U)(se->v_rms >> 8);
-      NWKPayload[j++] = (INT8U)(se->v_rms & 0xFF);             
+    *value |= (INT32U)(data[j] & 0x7F) << shift;
+    if ((data[j++] & 0x80) == 0)
+    {
+      return j;
+    }
+    shift += 7;
   }
-  //verifica se o bit current da variavel params  1. Se for envia     
-  if(se->params.Bits.Current)   
+  
+  // varint truncado
+  return 0;
+}
+
+/* ltimo keyframe recebido de cada medidor */
+typedef struct _SE_METER
+{
+  INT16U  Addr;
+  INT8U   Seq;
+  INT8U   Mask;              // 0 = sem keyframe, relatrios delta descartados
+  INT32U  Value[SE_MEASURES];
+} SE_METER;
+
+static SE_METER se_meter[SE_METER_TABLE_SIZE];
+static INT8U    se_meter_used;
+static INT8U    se_meter_next;
+
+static SE_METER *SE_Meter(INT16U source)
+{
+  SE_METER *meter;
+  INT8U     i;
+  
+  for (i = 0; i < se_meter_used; i++)
   {
-      //NWKPayload[j++] = CURRENT;
-      NWKPayload[j++] = (INT8U)(se->i_rms >> 8);
-      NWKPayload[j++] = (INT8U)(se->i_rms & 0xFF);             
+    if (se_meter[i].Addr == source)
+    {
+      return &se_meter[i];
+    }
   }
   
-  
-  if(se->params.Bits.Power_Factor)      
+  // Tabela cheia: substitui os medidores em rodzio
+  if (se_meter_used < SE_METER_TABLE_SIZE)
+  {
+    meter = &se_meter[se_meter_used++];
+  }else
   {
-      //NWKPayload[j++] = POWER_FACTOR;
-      NWKPayload[j++] = (INT8U)(se->power_factor >> 8);
-      NWKPayload[j++] = (INT8U)(se->power_factor & 0xFF);            
+    meter = &se_meter[se_meter_next];
+    if (++se_meter_next == SE_METER_TABLE_SIZE) se_meter_next = 0;
   }
   
+  meter->Addr = source;
+  meter->Mask = 0;
+  return meter;
+}
+
+/**
+* @fn     SE_MultiDecode
+* @brief  rebuilds the values of a multiple metering report of source.
+*         A delta report is only decoded on top of its keyframe: after a
+*         lost keyframe the deltas of the meter wait for the next one
+* @return TRUE if se holds the values of the report
+**/
+INT8U SE_MultiDecode(INT16U source, INT8U attribute, const INT8U *data, INT8U size, SE_STRUCT *se)
+{
+  SE_METER *meter = SE_Meter(source);
+  INT32U    value[SE_MEASURES];
+  INT32U    field;
+  INT8U     seq, mask;
+  INT8U     i = 0;
+  INT8U     j = 2;
+  INT8U     n;
+  
+  if (size < 2)
+  {
+    return FALSE;
+  }
   
-  if(se->params.Bits.Apparent_Power)
+  seq  = data[0];
+  mask = data[1];
+  if ((mask == 0) || (mask & 0x80))
   {
-      //NWKPayload[j++] = APPARENT_POWER;
-      NWKPayload[j++] = (INT8U)(se->power_S >> 24);
-      NWKPayload[j++] = (INT8U)((se->power_S & 0xFFFFFF) >> 16);
-      NWKPayload[j++] = (INT8U)((se->power_S & 0xFFFF) >> 8);
-      NWKPayload[j++] = (INT8U)(se->power_S & 0xFF);            
+    return FALSE;
   }
   
+  if (attribute == MULTIPLE_DELTA)
+  {
+    if ((meter->Mask != mask) || (meter->Seq != seq))
+    {
+      // Keyframe perdido: aguarda o prximo
+      return FALSE;
+    }
+  }else if (attribute != MULTIPLE_KEYFRAME)
+  {
+    return FALSE;
+  }
   
-  if(se->params.Bits.Reactive_Power)      
+  for (i = 0; i < SE_MEASURES; i++)
   {
-      //NWKPayload[j++] = REACTIVE_POWER;
-      NWKPayload[j++] = (INT8U)(se->power_Q >> 24);
-      NWKPayload[j++] = (INT8U)((se->power_Q & 0xFFFFFF) >> 16);
-      NWKPayload[j++] = (INT8U)((se->power_Q & 0xFFFF) >> 8);
-      NWKPayload[j++] = (INT8U)(se->power_Q & 0xFF);        
+    value[i] = meter->Value[i];
+    if (mask & (1 << i))
+    {
+      n = SE_GetVarint(&data[j], (INT8U)(size - j), &field);
+      if (n == 0)
+      {
+        return FALSE;
+      }
+      j += n;
+      value[i] = (attribute == MULTIPLE_DELTA) ? (INT32U)(value[i] + SE_UNZIGZAG(field)) : field;
+    }
   }
-      
   
-  if(se->params.Bits.Active_Power)      
+  if (attribute == MULTIPLE_KEYFRAME)
   {
-      //NWKPayload[j++] = ACTIVE_POWER;
-      NWKPayload[j++] = (INT8U)(se->power_P >> 24);
-      NWKPayload[j++] = (INT8U)((se->power_P & 0xFFFFFF) >> 16);
-      NWKPayload[j++] = (INT8U)((se->power_P & 0xFFFF) >> 8);
-      NWKPayload[j++] = (INT8U)(se->power_P & 0xFF);           
+    for (i = 0; i < SE_MEASURES; i++)
+    {
+      meter->Value[i] = value[i];
+    }
+    meter->Seq  = seq;
+    meter->Mask = mask;
   }
   
+  SE_SetParams(se, mask, value);
+  return TRUE;
+}
+#endif
+
+
+/**
+* @fn     NetMultiMeasureSE
+* @brief  function to send message for Smart Energy profile
+**/
+INT8U NetMultiMeasureSE(SE_STRUCT *se)
+{
+
+  INT8U j = 0;  
+  INT8U status = 0;
+#if (SE_COMPACT_ENCODING == 1)
+  INT8U message[3 + SE_MULTI_MAX_SIZE];
+  INT8U size = 0;
+#else
+  INT8U message[4 + (SE_MEASURES * 4)];
+  INT8U i = 0;
+  INT32U value[SE_MEASURES];
+  INT8U  mask = 0;
+  INT8U  count = 0;
+#endif
+  
+  message[j++] = APP_01;
+  message[j++] = SMART_ENERGY_PROFILE;
+  message[j++] = MULTIPLE_METERING;   
   
-  if(se->params.Bits.Energy)
+#if (SE_COMPACT_ENCODING == 1)
+  // UNET_Send retorna OK quando o relatrio entra no pool de envio: o resultado
+  // do anterior (normalmente j concludo) decide se este  um keyframe
+  if (se_send != UNET_SEND_NONE)
   {
-      //NWKPayload[j++] = ENERGY;
-      NWKPayload[j++] = (INT8U)(se->energy_meter >> 24);
-      NWKPayload[j++] = (INT8U)((se->energy_meter & 0xFFFFFF) >> 16);
-      NWKPayload[j++] = (INT8U)((se->energy_meter & 0xFFFF) >> 8);
-      NWKPayload[j++] = (INT8U)(se->energy_meter & 0xFF);           
-  }  
+    if (UNET_SendWait(se_send, 0) != OK)
+    {
+      se_since_key = SE_KEYFRAME_PERIOD;
+    }
+    se_send = UNET_SEND_NONE;
+  }
   
+  size = SE_MultiEncode(se, &message[j]);
+  j = (INT8U)(j + size);
+#else
+  //"se"  um ponteiro que contem o endereo da estrutura SE_ESTRUCTURE          
+  // Descobre o nmero de medidas a serem enviadas
+  mask = SE_Params(se, value);
+  for(i=0;i<SE_MEASURES;i++)
+  {
+    if (mask & (1 << i))
+    {
+      count++;
+    }
+  }
+  
+  message[j++] = count;
+  
+  // Tenso, corrente e fator de potncia em 16 bits, potncias e energia em 32 bits
+  for(i=0;i<SE_MEASURES;i++)
+  {
+    if (mask & (1 << i))
+    {
+      if (i >= 3)
+      {
+        message[j++] = (INT8U)(value[i] >> 24);
+        message[j++] = (INT8U)((value[i] & 0xFFFFFF) >> 16);
+      }
+      message[j++] = (INT8U)((value[i] & 0xFFFF) >> 8);
+      message[j++] = (INT8U)(value[i] & 0xFF);
+    }
+  }
+#endif
   
-  status = DownRoute(START_ROUTE,(INT8U)(j));  
+#if (SE_COMPACT_ENCODING == 1)
+  status = UNET_Send(UNET_SEND_TO_BASE, 0, message, j, &se_send);
   
-  releaseRadio(); 
+  // Relatrio no enviado: o prximo  um keyframe
+  if (status != OK)
+  {
+    se_since_key = SE_KEYFRAME_PERIOD;
+  }
+#else
+  status = UNET_Send(UNET_SEND_TO_BASE, 0, message, j, NULL);
+#endif
   
   return status;
 }
-#endif
 
 
 /**
@@ -429,70 +650,65 @@ INT8U NetMultiMeasureSE(SE_STRUCT *se)
 INT8U NetSimpleMeasureSE(INT8U MeasureType, INT16U Value16, INT32U Value32)
 {
   INT8U j = 0;
-  INT8U status = 0;  
-  
-  acquireRadio();
+  INT8U message[APP_HEADER_SIZE + 4];
   
           
-  NWKPayload[0] = APP_01;
-  NWKPayload[1] = SMART_ENERGY_PROFILE;
-  NWKPayload[2] = MULTIPLE_METERING;
-  NWKPayload[3] = MeasureType;
+  message[0] = APP_01;
+  message[1] = SMART_ENERGY_PROFILE;
+  message[2] = MULTIPLE_METERING;
+  message[3] = MeasureType;
   
   
   switch(MeasureType)
   {
     case CURRENT:
-      NWKPayload[4] = (INT8U)(Value16 >> 8);
-      NWKPayload[5] = (INT8U)(Value16 & 0xFF);
+      message[4] = (INT8U)(Value16 >> 8);
+      message[5] = (INT8U)(Value16 & 0xFF);
       j = 2;
       break;
     case VOLTAGE:
-      NWKPayload[4] = (INT8U)(Value16 >> 8);
-      NWKPayload[5] = (INT8U)(Value16 & 0xFF);            
+      message[4] = (INT8U)(Value16 >> 8);
+      message[5] = (INT8U)(Value16 & 0xFF);            
       j = 2;
       break;
     case ENERGY:
-      NWKPayload[4] = (INT8U)(Value32 >> 24);
-      NWKPayload[5] = (INT8U)((Value32 & 0xFFFFFF) >> 16);
-      NWKPayload[6] = (INT8U)((Value32 & 0xFFFF) >> 8);
-      NWKPayload[7] = (INT8U)(Value32 & 0xFF);
+      message[4] = (INT8U)(Value32 >> 24);
+      message[5] = (INT8U)((Value32 & 0xFFFFFF) >> 16);
+      message[6] = (INT8U)((Value32 & 0xFFFF) >> 8);
+      message[7] = (INT8U)(Value32 & 0xFF);
       j = 4;
       break;
     case ACTIVE_POWER:
-      NWKPayload[4] = (INT8U)(Value32 >> 24);
-      NWKPayload[5] = (INT8U)((Value32 & 0xFFFFFF) >> 16);
-      NWKPayload[6] = (INT8U)((Value32 & 0xFFFF) >> 8);
-      NWKPayload[7] = (INT8U)(Value32 & 0xFF);
+      message[4] = (INT8U)(Value32 >> 24);
+      message[5] = (INT8U)((Value32 & 0xFFFFFF) >> 16);
+      message[6] = (INT8U)((Value32 & 0xFFFF) >> 8);
+      message[7] = (INT8U)(Value32 & 0xFF);
       j = 4;
       break;
     case REACTIVE_POWER:
-      NWKPayload[4] = (INT8U)(Value32 >> 24);
-      NWKPayload[5] = (INT8U)((Value32 & 0xFFFFFF) >> 16);
-      NWKPayload[6] = (INT8U)((Value32 & 0xFFFF) >> 8);
-      NWKPayload[7] = (INT8U)(Value32 & 0xFF);
+      message[4] = (INT8U)(Value32 >> 24);
+      message[5] = (INT8U)((Value32 & 0xFFFFFF) >> 16);
+      message[6] = (INT8U)((Value32 & 0xFFFF) >> 8);
+      message[7] = (INT8U)(Value32 & 0xFF);
       j = 4;
       break;
     case APPARENT_POWER:
-      NWKPayload[4] = (INT8U)(Value32 >> 24);
-      NWKPayload[5] = (INT8U)((Value32 & 0xFFFFFF) >> 16);
-      NWKPayload[6] = (INT8U)((Value32 & 0xFFFF) >> 8);
-      NWKPayload[7] = (INT8U)(Value32 & 0xFF);
+      message[4] = (INT8U)(Value32 >> 24);
+      message[5] = (INT8U)((Value32 & 0xFFFFFF) >> 16);
+      message[6] = (INT8U)((Value32 & 0xFFFF) >> 8);
+      message[7] = (INT8U)(Value32 & 0xFF);
       j = 4;
       break;
     case POWER_FACTOR:
-      NWKPayload[4] = (INT8U)(Value16 >> 8);
-      NWKPayload[5] = (INT8U)(Value16 & 0xFF);            
+      message[4] = (INT8U)(Value16 >> 8);
+      message[5] = (INT8U)(Value16 & 0xFF);            
       j = 2;
       break;
     
   }
   
   
-  status = DownRoute(START_ROUTE,(INT8U)(4+j));   
-  releaseRadio();
-  
-  return status;
+  return UNET_Send(UNET_SEND_TO_BASE, 0, message, (INT8U)(4+j), NULL);
 }
 
 
@@ -506,45 +722,31 @@ INT8U NetSimpleMeasureSE(INT8U MeasureType, INT16U Value16, INT32U Value32)
 INT8U NetGeneralInfo(INT8U MeasureType, INT8U Value8,INT16U Value16, INT16U destiny)
 {
   INT8U j = 0;
-  INT8U status = 0;
-  
-  acquireRadio();
+  INT8U message[APP_HEADER_SIZE + 2];
 
             
-  NWKPayload[0] = APP_01;
-  NWKPayload[1] = GENERAL_PROFILE;
-  NWKPayload[2] = SIMPLE_METERING;
-  NWKPayload[3] = MeasureType;
+  message[0] = APP_01;
+  message[1] = GENERAL_PROFILE;
+  message[2] = SIMPLE_METERING;
+  message[3] = MeasureType;
   
   
   switch(MeasureType)
   {
     case TEMPERATURE:
     case FAILURE_REPORT:
-      NWKPayload[4] = (INT8U)Value8;
+      message[4] = (INT8U)Value8;
       j = 1;
       break;
     default:
-      NWKPayload[4] = (INT8U)((Value16 & 0xFFFF) >> 8);
-      NWKPayload[5] = (INT8U)(Value16 & 0xFF);
+      message[4] = (INT8U)((Value16 & 0xFFFF) >> 8);
+      message[5] = (INT8U)(Value16 & 0xFF);
       j = 2;
       break;      
   }
   
 
-  if (destiny == 0){
-	  status = DownRoute(START_ROUTE,(INT8U)(j));
-  }else{
-	  #if (USE_REACTIVE_UP_ROUTE == 1)
-	  status = ReactiveUpRoute(START_ROUTE,(INT8U)(j),destiny);
-	  #else
-	  status = NO_ROUTE_AVAILABLE;
-	  #endif
-  }
-  
-  releaseRadio();
-  
-  return status;
+  return UNET_Send((destiny == 0) ? UNET_SEND_TO_BASE : UNET_SEND_UP, destiny, message, (INT8U)(4+j), NULL);
 }
 
 
@@ -556,39 +758,33 @@ INT8U NetGeneralInfo(INT8U MeasureType, INT8U Value8,INT16U Value16, INT16U dest
 INT8U NetLightingProfile(INT8U Command, INT8U Parameter, INT8U Value8, INT16U Value16)
 {
   INT8U j = 0;
-  INT8U status = 0;
+  INT8U message[APP_HEADER_SIZE + 2];
   
-  acquireRadio();
-  
-  NWKPayload[0] = APP_01;
-  NWKPayload[1] = LIGHTING_PROFILE;
-  NWKPayload[2] = Command;
-  NWKPayload[3] = Parameter;
+  message[0] = APP_01;
+  message[1] = LIGHTING_PROFILE;
+  message[2] = Command;
+  message[3] = Parameter;
   
   
   switch(Parameter)
   {
     case LIGHT_LEVEL:
-      NWKPayload[4] = (INT8U)(Value16 >> 8);
-      NWKPayload[5] = (INT8U)(Value16 & 0xFF);
+      message[4] = (INT8U)(Value16 >> 8);
+      message[5] = (INT8U)(Value16 & 0xFF);
       j = 2;
       break;  
     case LAMP_STATE:
-      NWKPayload[4] = (INT8U)Value8;
+      message[4] = (INT8U)Value8;
       j = 1;
       break;    
     case SENSOR_STATE:
-      NWKPayload[4] = (INT8U)Value8;
+      message[4] = (INT8U)Value8;
       j = 1;
       break;                
   }
   
 
-  status = DownRoute(START_ROUTE,(INT8U)(4+j));  
-  
-  releaseRadio();
-  
-  return status;
+  return UNET_Send(UNET_SEND_TO_BASE, 0, message, (INT8U)(4+j), NULL);
 }
 
 
@@ -599,25 +795,19 @@ INT8U NetLightingProfile(INT8U Command, INT8U Parameter, INT8U Value8, INT16U Va
 INT8U NetDebugPacket(INT8U Command, INT8U Parameter, INT8U Value8, INT16U Value16, INT16U destiny)
 {
   INT8U j = 0;
-  INT8U status = 0;
-  
-  acquireRadio();
+  INT8U message[APP_HEADER_SIZE + 2];
   
-  NWKPayload[0] = APP_01;
-  NWKPayload[1] = GENERAL_PROFILE;
-  NWKPayload[2] = Command;
-  NWKPayload[3] = Parameter;
+  message[0] = APP_01;
+  message[1] = GENERAL_PROFILE;
+  message[2] = Command;
+  message[3] = Parameter;
  
 
-  NWKPayload[4] = Value16 >> 8;
-  NWKPayload[5] = Value16 & 0xFF; 
+  message[4] = Value16 >> 8;
+  message[5] = Value16 & 0xFF; 
   j=2;
   
-  status = OneHopRoute((INT8U)(4+j),destiny);
-  
-  releaseRadio();
-  
-  return status;
+  return UNET_Send(UNET_SEND_ONE_HOP, destiny, message, (INT8U)(4+j), NULL);
 }
 
 /**
@@ -628,8 +818,9 @@ INT8U NetDebugPacket(INT8U Command, INT8U Parameter, INT8U Value8, INT16U Value1
 INT8U UNET_TX_ToBaseSation(INT8U Command, INT8U Attribute, UINT_DWORD * ptr_data, INT8U nbr_bytes){
     
     INT8U j = 0; 
+    INT8U message[MAX_APP_PAYLOAD_SIZE];
     
-    if(nbr_bytes > MAX_APP_PAYLOAD_SIZE-2 || ptr_data == NULL) {
+    if(nbr_bytes > (MAX_APP_PAYLOAD_SIZE - APP_HEADER_SIZE - 2) || ptr_data == NULL) {
         return SEND_ERROR;
     }
     
@@ -637,26 +828,20 @@ INT8U UNET_TX_ToBaseSation(INT8U Command, INT8U Attribute, UINT_DWORD * ptr_data
         return SEND_ERROR;
     }
     
-    acquireRadio();
-    
       /* set app header */
-      NWKPayload[0] = APP_01;
-      NWKPayload[1] = GENERAL_PROFILE;
-      NWKPayload[2] = Command;
-      NWKPayload[3] = Attribute;
+      message[0] = APP_01;
+      message[1] = GENERAL_PROFILE;
+      message[2] = Command;
+      message[3] = Attribute;
       
       for(j=0; j<nbr_bytes;j++){        
-        NWKPayload[j+4] = ptr_data->int8u[j];
+        message[j+4] = ptr_data->int8u[j];
       }
       
-      NWKPayload[j+4+0] = (INT8U)(macAddr >> 8);
-      NWKPayload[j+4+1] = (INT8U)(macAddr & 0xFF);
+      message[j+4+0] = (INT8U)(macAddr >> 8);
+      message[j+4+1] = (INT8U)(macAddr & 0xFF);
       
-      j = DownRoute(START_ROUTE,(INT8U)j+4+2);
-    
-      releaseRadio();
-
-      return j;
+      return UNET_Send(UNET_SEND_TO_BASE, 0, message, (INT8U)(j+4+2), NULL);
 }
 
 
@@ -30,10 +30,45 @@ Copyright (c) <2009-2013> <Universidade Federal de Santa Maria>
 #include "unet_api.h"
 #include "AppConfig.h"
 
+/* Smart Energy multiple metering */
+#define SE_MEASURES     (INT8U)7
+/* Compact report: attribute, sequence, mask and up to 5 bytes per varint */
+#define SE_MULTI_MAX_SIZE (INT8U)(3 + (SE_MEASURES * 5))
+
+typedef union _SE_PARAMS
+{
+  INT8U Byte;
+  struct
+  {
+    INT8U Voltage        :1;
+    INT8U Current        :1;
+    INT8U Power_Factor   :1;
+    INT8U Apparent_Power :1;
+    INT8U Reactive_Power :1;
+    INT8U Active_Power   :1;
+    INT8U Energy         :1;
+    INT8U                :1;
+  } Bits;
+} SE_PARAMS;
+
+typedef struct _SE_STRUCT
+{
+  SE_PARAMS params;            // measures sent in the report
+  INT16U    v_rms;
+  INT16U    i_rms;
+  INT16U    power_factor;
+  INT32U    power_S;
+  INT32U    power_Q;
+  INT32U    power_P;
+  INT32U    energy_meter;
+} SE_STRUCT;
+
 #if 0
 INT8U NetSimpleMeasureSE(INT8U MeasureType, INT16U Value16, INT32U Value32);
-INT8U NetMultiMeasureSE(SE_STRUCT *se);
 #endif
+INT8U NetMultiMeasureSE(SE_STRUCT *se);
+INT8U SE_MultiEncode(SE_STRUCT *se, INT8U *data);
+INT8U SE_MultiDecode(INT16U source, INT8U attribute, const INT8U *data, INT8U size, SE_STRUCT *se);
 
 INT8U NetGeneralInfo(INT8U MeasureType, INT8U Value8,INT16U Value16, INT16U destiny);
 INT8U NetLightingProfile(INT8U Command, INT8U Parameter, INT8U Value8, INT16U Value16);
@@ -124,7 +124,7 @@ int main(void)
 #endif
 
 #if 1
-  if(InstallTask(&led_activity,"Blink LED for activity",256,20, NULL, NULL) != OK)
+  if(InstallTask(&led_activity,"Blink LED for activity",256,17, NULL, NULL) != OK)
   {
     // Oh Oh
     // No deveria entrar aqui !!!
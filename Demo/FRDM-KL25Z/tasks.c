@@ -187,6 +187,8 @@ void UNET_App_1_Decode(void *param)
 #if (DEVICE_TYPE == PAN_COORDINATOR)
    char buffer[8];
 #endif
+   // Cpia da mensagem recebida, fora da pilha da tarefa
+   static UNET_APP_MSG msg;
    (void)param;
 
 	// Enables the port clock
@@ -211,40 +213,39 @@ void UNET_App_1_Decode(void *param)
    for (;;)
    {
 
-      /* Wait event from APP layer, with or without timeout */
+      /* Wait message from APP layer, with or without timeout */
 #if (defined BOOTLOADER_ENABLE) && (BOOTLOADER_ENABLE==1)
-	      ret = OSSemPend(SIGNAL_APP1, SIGNAL_TIMEOUT);
+	      ret = UNET_AppReceive(APP_01, &msg, SIGNAL_TIMEOUT);
 #else
-	      (void)OSSemPend(SIGNAL_APP1, 0);
+	      (void)UNET_AppReceive(APP_01, &msg, 0);
 #endif
 
       #if (defined BOOTLOADER_ENABLE) && (BOOTLOADER_ENABLE==1)
       if(ret != TIMEOUT){
       #endif
 
-       acquireRadio();
-
-       switch(app_packet.APP_Profile)
+       // Mensagem recebida (APP_RX_*(&msg))
+       switch(APP_RX_PROFILE(&msg))
        {
         case GENERAL_PROFILE:
 		  #if (DEVICE_TYPE == PAN_COORDINATOR)
           (void)UARTPutString(UART0_BASE, "Pacote do perfil geral recebido do n ");
-          (void)UARTPutString(0x4006A000, PrintDecimal(nwk_packet.NWK_Source, buffer));\
+          (void)UARTPutString(0x4006A000, PrintDecimal(APP_RX_SOURCE(&msg), buffer));\
           (void)UARTPutString(0x4006A000, "\n\r");
 		  #endif
-          Decode_General_Profile();
+          Decode_General_Profile(&msg);
           break;
 
         case LIGHTING_PROFILE:
 		  #if (DEVICE_TYPE == PAN_COORDINATOR)
           (void)UARTPutString(UART0_BASE, "Pacote do perfil lighting recebido!\n\r");
 		  #endif
-          //Decode_Lighting_Profile();
+          //Decode_Lighting_Profile(&msg);
           break;       
 
         #if (defined BOOTLOADER_ENABLE) && (BOOTLOADER_ENABLE==1)
         case BULK_DATA_PROFILE:
-          WBootloader_Handler();
+          WBootloader_Handler(&msg);
           break;
         #endif
 
@@ -254,7 +255,6 @@ void UNET_App_1_Decode(void *param)
 		  #endif
           break;
        }
-       releaseRadio();
 
       #if (defined BOOTLOADER_ENABLE) && (BOOTLOADER_ENABLE==1)
       }else{
@@ -0,0 +1,150 @@
+/**********************************************************************************
+@file   crc16.c
+@brief  Benchmark: frame CRC implementations of uNET/crc.c against the
+        previous per byte bit reversal of mac.c
+*********************************************************************************/
+
+/*
+   uNET/crc.c is built once per CRC16_METHOD, with the functions renamed
+   (see the Makefile), and every variant is checked against a bitwise
+   reference before being timed over frames of several sizes.
+
+   Flash and RAM of each variant are the text and data+bss columns that
+   "make bench" prints with size(1) for build/crc_*.o.
+
+   Cycles are host cycles: they rank the variants, but the previous
+   implementation is favoured here, as a host multiplies in one cycle
+   while a Cortex-M0 without the fast multiplier takes 32 per multiply.
+
+   usage: bench_crc16 [-n iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "BRTOS.h"
+
+INT16U CRC_Compute_table(const INT8U *buf, INT8U len);
+INT16U CRC_Compute_nibble(const INT8U *buf, INT8U len);
+INT16U CRC_Compute_slice4(const INT8U *buf, INT8U len);
+void   CRC_Update_table(INT8U data);
+INT16U CRC_Get_table(void);
+void   CRC_Update_prev(INT8U data);
+INT16U CRC_Get_prev(void);
+
+static volatile INT16U sink;
+
+void BRTOS_TimerHook(void)
+{
+}
+
+/* IEEE 802.15.4 FCS, one bit at a time */
+static INT16U CRC_Bitwise(const INT8U *buf, INT8U len)
+{
+  INT16U crc = 0;
+  INT8U  i;
+
+  while (len--)
+  {
+    crc ^= *buf++;
+    for (i = 0; i < 8; i++)
+    {
+      crc = (INT16U)((crc & 1) ? ((crc >> 1) ^ 0x8408) : (crc >> 1));
+    }
+  }
+  return crc;
+}
+
+/* Previous path of UNET_RF_Event: CRC_Update for each byte, then CRC_Get */
+static INT16U Prev(const INT8U *buf, INT8U len)
+{
+  while (len--)
+  {
+    CRC_Update_prev(*buf++);
+  }
+  return CRC_Get_prev();
+}
+
+/* Byte by byte interface of the new implementation */
+static INT16U TableUpdate(const INT8U *buf, INT8U len)
+{
+  while (len--)
+  {
+    CRC_Update_table(*buf++);
+  }
+  return CRC_Get_table();
+}
+
+typedef struct
+{
+  const char *name;
+  INT16U    (*crc)(const INT8U *buf, INT8U len);
+} CRC_VARIANT;
+
+static const CRC_VARIANT variants[] =
+{
+  {"previous (ReverseByte)", Prev},
+  {"table, CRC_Update",      TableUpdate},
+  {"table",                  CRC_Compute_table},
+  {"nibble",                 CRC_Compute_nibble},
+  {"slice-by-4",             CRC_Compute_slice4},
+};
+
+int main(int argc, char *argv[])
+{
+  static const INT8U sizes[] = {9, 25, 64, 125};
+  INT8U  frame[127];
+  INT32U iterations = 100000;
+  INT32U n, k, v;
+  INT64U t0, cycles;
+  int c;
+
+  while ((c = getopt(argc, argv, "n:")) != -1)
+  {
+    switch (c)
+    {
+      case 'n': iterations = (INT32U)atoi(optarg); break;
+      default:
+        printf("usage: %s [-n iterations]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  srand(1);
+  for (n = 0; n < sizeof(frame); n++) frame[n] = (INT8U)rand();
+
+  for (v = 0; v < sizeof(variants) / sizeof(variants[0]); v++)
+  {
+    for (k = 0; k <= sizeof(frame); k++)
+    {
+      if (variants[v].crc(frame, (INT8U)k) != CRC_Bitwise(frame, (INT8U)k))
+      {
+        printf("%s: wrong CRC for %u bytes\n", variants[v].name, (unsigned)k);
+        return 1;
+      }
+    }
+  }
+
+  printf("frame CRC, cycles/byte, %u iterations\n", (unsigned)iterations);
+  printf("%-24s", "bytes");
+  for (k = 0; k < sizeof(sizes); k++) printf(" %8u", sizes[k]);
+  printf("\n");
+
+  for (v = 0; v < sizeof(variants) / sizeof(variants[0]); v++)
+  {
+    printf("%-24s", variants[v].name);
+    for (k = 0; k < sizeof(sizes); k++)
+    {
+      t0 = OSHostCycles();
+      for (n = 0; n < iterations; n++)
+      {
+        sink = variants[v].crc(frame, sizes[k]);
+      }
+      cycles = OSHostCycles() - t0;
+      printf(" %8.2f", (double)cycles / iterations / sizes[k]);
+    }
+    printf("\n");
+  }
+  return 0;
+}
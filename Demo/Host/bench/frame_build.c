@@ -0,0 +1,248 @@
+/**********************************************************************************
+@file   frame_build.c
+@brief  Benchmark: TX frame build of NWK_Command and NeighborPing from the
+        header templates against the previous field by field header
+*********************************************************************************/
+
+/*
+   The previous builders are kept here as they were before the templates:
+   frame control, PAN id and source address written byte by byte from the
+   volatile macPANId and macAddr on every frame. Both paths must produce
+   the same TX FIFO image. The builders only assemble the frame in
+   mac_tx_fifo (the FIFO load is done by the UNET_TX task), so the cycles
+   are the frame assembly alone. The previous NWK_Command writes the NWK
+   header in the format of the build (NWK_HEADER_COMPRESSION).
+
+   usage: bench_frame_build [-n iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "BRTOS.h"
+#include "unet_api.h"
+#include "mac.h"
+#include "network.h"
+
+static INT8U image[2 + MAX_PHY_PACKETSIZE];
+
+/* Previous NWK_Command (first hop: packet_life == 0) */
+static void PrevNWK_Command(INT16U Address, INT8U r_parameter, INT8U payload_size, INT16U destiny)
+{
+  INT8U i = 0;
+  INT8U FrameIndex = 0;
+  INT8U HeaderSize = 0;
+  INT8U PayloadSize = 0;
+  INT8U tmp = 0;
+
+  mac_tx_fifo[2] = 0x61;
+  HeaderSize++;
+  mac_tx_fifo[3] = 0x88;
+  HeaderSize++;
+
+  UserEnterCritical();
+  tmp = SequenceNumber;
+  UserExitCritical();
+  mac_tx_fifo[4] = tmp;
+  HeaderSize++;
+
+  mac_tx_fifo[5] = (INT8U)(macPANId & 0xFF);
+  mac_tx_fifo[6] = (INT8U)(macPANId >> 8);
+  mac_tx_fifo[7] = (INT8U)(Address & 0xFF);
+  mac_tx_fifo[8] = (INT8U)(Address >> 8);
+  mac_tx_fifo[9] = (INT8U)(macAddr & 0xFF);
+  mac_tx_fifo[10] = (INT8U)(macAddr >> 8);
+  HeaderSize += 6;
+  FrameIndex = 11;
+
+  mac_tx_fifo[FrameIndex] = ROUTE_PACKET;
+  FrameIndex++;
+  PayloadSize++;
+#if (NWK_HEADER_COMPRESSION == 1)
+  // Up packet on its first hop: packet life and destiny
+  mac_tx_fifo[FrameIndex] = (INT8U)(r_parameter | NWK_COMPRESSED);
+  FrameIndex++;
+  PayloadSize++;
+
+  mac_tx_fifo[FrameIndex++] = 0;
+  PayloadSize++;
+
+  mac_tx_fifo[FrameIndex++] = (INT8U)(destiny & 0xFF);
+  mac_tx_fifo[FrameIndex++] = (INT8U)(destiny >> 8);
+  PayloadSize += 2;
+#else
+  mac_tx_fifo[FrameIndex] = r_parameter;
+  FrameIndex++;
+  PayloadSize++;
+
+  mac_tx_fifo[FrameIndex++] = (INT8U)(destiny & 0xFF);
+  mac_tx_fifo[FrameIndex++] = (INT8U)(destiny >> 8);
+  mac_tx_fifo[FrameIndex++] = (INT8U)(macAddr & 0xFF);
+  mac_tx_fifo[FrameIndex++] = (INT8U)(macAddr >> 8);
+  PayloadSize += 4;
+
+  mac_tx_fifo[FrameIndex++] = 0;
+  PayloadSize++;
+#endif
+
+  for (i = 0; i < payload_size; i++)
+  {
+    mac_tx_fifo[FrameIndex++] = NWKPayload[i];
+    PayloadSize++;
+  }
+  IncUNET_NodeStat_apptxed();
+
+  MAC_TxFrame(HeaderSize, (INT8U)(HeaderSize+PayloadSize));
+}
+
+/* Previous NeighborPing */
+static void PrevNeighborPing(void)
+{
+  INT8U i           = 0;
+  INT8U address     = 0;
+  INT8U HeaderSize  = 0;
+  INT8U PayloadSize = 0;
+
+  mac_tx_fifo[2] = 0x41;
+  HeaderSize++;
+  mac_tx_fifo[3] = 0x88;
+  HeaderSize++;
+
+  mac_tx_fifo[4] = SequenceNumber;
+  if (++SequenceNumber == 0) SequenceNumber = 1;
+  HeaderSize++;
+
+  mac_tx_fifo[5] = (INT8U)(macPANId & 0xFF);
+  mac_tx_fifo[6] = (INT8U)(macPANId >> 8);
+  mac_tx_fifo[7] = (INT8U)0xFF;
+  mac_tx_fifo[8] = (INT8U)0xFF;
+  mac_tx_fifo[9] = (INT8U)(macAddr & 0xFF);
+  mac_tx_fifo[10] = (INT8U)(macAddr >> 8);
+  HeaderSize += 6;
+
+  mac_tx_fifo[11] = DATA_PING;
+  PayloadSize++;
+  mac_tx_fifo[12] = thisNodeDepth;
+  PayloadSize++;
+
+  address = 12;
+  for (i = 0; i < NEIGHBOURHOOD_SIZE; i++)
+  {
+    if (unet_neighbourhood[i].Addr_16b != 0xFFFE)
+    {
+      mac_tx_fifo[++address] = (INT8U)(unet_neighbourhood[i].Addr_16b >> 8);
+      mac_tx_fifo[++address] = (INT8U)(unet_neighbourhood[i].Addr_16b & 0xFF);
+      mac_tx_fifo[++address] = (INT8U)(unet_neighbourhood[i].NeighborRSSI & 0xFF);
+      PayloadSize += 3;
+    }
+  }
+
+  MAC_TxFrame(HeaderSize, (INT8U)(HeaderSize+PayloadSize));
+}
+
+static INT8U payload_size;
+
+static void Route(void)
+{
+  NWK_Command(0x0001, DEST_UP | UP_ROUTE, payload_size, 0, 0x0000);
+}
+
+static void PrevRoute(void)
+{
+  PrevNWK_Command(0x0001, DEST_UP | UP_ROUTE, payload_size, 0x0000);
+}
+
+static void Ping(void)
+{
+  SequenceNumber = 0x80;
+  NeighborPing();
+}
+
+static void PrevPing(void)
+{
+  SequenceNumber = 0x80;
+  PrevNeighborPing();
+}
+
+typedef struct
+{
+  const char *name;
+  INT8U       payload;
+  void      (*prev)(void);
+  void      (*build)(void);
+} FRAME_BUILDER;
+
+static const FRAME_BUILDER builders[] =
+{
+  {"NWK_Command",  0,  PrevRoute, Route},
+  {"NWK_Command",  16, PrevRoute, Route},
+  {"NWK_Command",  MAX_APP_PAYLOAD_SIZE, PrevRoute, Route},
+  {"NeighborPing", 0,  PrevPing,  Ping},
+};
+
+int main(int argc, char *argv[])
+{
+  INT32U iterations = 200000;
+  INT32U n, k;
+  INT64U t0, c_old, c_new;
+  int c;
+
+  while ((c = getopt(argc, argv, "n:")) != -1)
+  {
+    switch (c)
+    {
+      case 'n': iterations = (INT32U)atoi(optarg); break;
+      default:
+        printf("usage: %s [-n iterations]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  BRTOS_Init();
+  Radio_port_Init();
+
+  macPANId = 0x4742;
+  macAddr  = 0x0101;
+  NWK_HeaderTemplates();
+  for (n = 0; n < NEIGHBOURHOOD_SIZE; n++)
+  {
+    unet_neighbourhood[n].Addr_16b = (n < 3) ? (INT16U)(0x0200 + n) : 0xFFFE;
+  }
+  for (n = 0; n < MAX_APP_PAYLOAD_SIZE; n++) NWKPayload[n] = (INT8U)n;
+
+  printf("TX frame build, %u iterations\n", (unsigned)iterations);
+  printf("%-14s %8s %6s %12s %12s %8s\n", "frame", "payload", "bytes", "prev cyc", "template cyc", "speedup");
+
+  for (k = 0; k < sizeof(builders) / sizeof(builders[0]); k++)
+  {
+    payload_size = builders[k].payload;
+    builders[k].prev();
+    memcpy(image, mac_tx_fifo, sizeof(image));
+    builders[k].build();
+    if (memcmp(image, mac_tx_fifo, (size_t)(2 + mac_tx_fifo[1])) != 0)
+    {
+      printf("%s: frame differs from the previous builder\n", builders[k].name);
+      return 1;
+    }
+
+    c_old = 0;
+    c_new = 0;
+    for (n = 0; n < iterations; n++)
+    {
+      t0 = OSHostCycles();
+      builders[k].prev();
+      c_old += OSHostCycles() - t0;
+
+      t0 = OSHostCycles();
+      builders[k].build();
+      c_new += OSHostCycles() - t0;
+    }
+
+    printf("%-14s %8u %6u %12.1f %12.1f %7.2fx\n", builders[k].name, builders[k].payload,
+           (unsigned)(2 + mac_tx_fifo[1]), (double)c_old / iterations, (double)c_new / iterations,
+           (double)c_old / c_new);
+  }
+  return 0;
+}
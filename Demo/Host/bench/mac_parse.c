@@ -0,0 +1,207 @@
+/**********************************************************************************
+@file   mac_parse.c
+@brief  Benchmark: MAC header decode of UNET_MAC, field by field copy into
+        the global packet against the in place view (MAC_FrameParse)
+*********************************************************************************/
+
+/*
+   Both paths decode the same frames from an RX buffer slot and read the
+   fields used by the network layer to route a packet (source address,
+   sequence number, NWK destiny/source/life). The copy path is the previous
+   UNET_MAC state machine: every header field, the zero filled 64 bit
+   addresses and the whole payload are copied to the global packet. The
+   view path decodes the NWK header with NWK_HeaderParse, as UNET_MAC does
+   for a ROUTE_PACKET.
+
+   usage: bench_mac_parse [-n iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "BRTOS.h"
+#include "unet_api.h"
+#include "mac.h"
+#include "network.h"
+
+/* Previous global packet (the MAC part of UNET_PACKET) */
+typedef struct _MAC_PACKET_COPY
+{
+    INT8U         Sequence_Number;
+    INT8U         Unused_ByteAlign;
+    INT16U        Dst_PAN_Ident;
+    INT16U        DstAddr_16b;
+    INT8U         DstAddr_64b[8];
+    INT16U        Src_PAN_Ident;
+    INT16U        SrcAddr_16b;
+    INT8U         SrcAddr_64b[8];
+    INT8U         MAC_Payload[MAX_APP_PAYLOAD_SIZE+NWK_APP_HEADER_SIZE];
+    INT8U         Payload_Size;
+    INT16U        Frame_CRC;
+    INT8U         Frame_RSSI;
+    INT8U         Frame_LQI;
+} MAC_PACKET_COPY;
+
+static volatile MAC_PACKET_COPY packet;
+static volatile INT32U sink;
+
+/* Previous path: 16 bit short addresses with PAN id compression, as sent by UNET */
+static INT8U CopyParse(RF_RX_SLOT *slot)
+{
+  INT8U *rx = slot->Frame;
+  INT8U packet_size = slot->Length;
+  INT8U data1, data2, i;
+
+  data1 = *rx++;
+  data2 = *rx++;
+  mac_frame_control.Val = (INT16U)((data1 << 8) | data2);
+  packet.Sequence_Number = *rx++;
+  packet_size -= 3;
+
+  // dest_10
+  packet_size -= 4;
+  data1 = *rx++;
+  data2 = *rx++;
+  packet.Dst_PAN_Ident = (INT16U)((data2 << 8) | data1);
+  data1 = *rx++;
+  data2 = *rx++;
+  packet.DstAddr_16b = (INT16U)((data2 << 8) | data1);
+
+  // source_110
+  packet.Src_PAN_Ident = 0xFFFE;
+  data1 = *rx++;
+  data2 = *rx++;
+  packet.SrcAddr_16b = (INT16U)((data2 << 8) | data1);
+  packet_size -= 2;
+  for (i = 8; i > 0; i--)
+  {
+    packet.SrcAddr_64b[i-1] = 0;
+  }
+
+  // payload
+  packet.Payload_Size = 0;
+  for (i = 0; i < (packet_size - 2); i++)
+  {
+    packet.MAC_Payload[i] = *rx++;
+    packet.Payload_Size++;
+  }
+
+  // CRC
+  data1 = *rx++;
+  data2 = *rx++;
+  packet.Frame_CRC  = (INT16U)((data2 << 8) | data1);
+  packet.Frame_RSSI = slot->RSSI;
+  packet.Frame_LQI  = slot->LQI;
+
+  return (packet.Frame_CRC == slot->CRC) ? TRUE : FALSE;
+}
+
+static void CopyRead(void)
+{
+  INT16U dst = (INT16U)(packet.MAC_Payload[2] | (packet.MAC_Payload[3] << 8));
+  INT16U src = (INT16U)(packet.MAC_Payload[4] | (packet.MAC_Payload[5] << 8));
+
+  sink += packet.SrcAddr_16b + packet.Sequence_Number + dst + src + packet.MAC_Payload[6];
+}
+
+static void ViewRead(void)
+{
+  sink += MAC_RX_SRC_ADDR_16B() + MAC_RX_SEQUENCE_NUMBER() + NWK_RX_DESTINY() +
+          NWK_RX_SOURCE() + NWK_RX_PACKET_LIFE();
+}
+
+static void BuildFrame(RF_RX_SLOT *slot, INT8U payload_size)
+{
+  INT8U *f = slot->Frame;
+  INT8U  n = 0;
+  INT8U  i;
+
+  f[n++] = 0x61; f[n++] = 0x88; f[n++] = 0x42;            // data, ack request, intra PAN
+  f[n++] = 0x42; f[n++] = 0x47;                           // PAN id
+  f[n++] = 0x00; f[n++] = 0x00;                           // destination
+  f[n++] = 0x01; f[n++] = 0x01;                           // source
+  f[n++] = ROUTE_PACKET; f[n++] = 0;                      // NWK header
+  f[n++] = 0x00; f[n++] = 0x00; f[n++] = 0x05; f[n++] = 0x01; f[n++] = 2;
+  for (i = 0; i < (INT8U)(payload_size - NWK_OVERHEAD); i++)
+  {
+    f[n++] = i;
+  }
+
+  slot->Length = (INT8U)(n + 2);
+  for (i = 0; i < n; i++)
+  {
+    CRC_Update(f[i]);
+  }
+  slot->CRC  = CRC_Get();
+  f[n++]     = (INT8U)(slot->CRC & 0xFF);
+  f[n++]     = (INT8U)(slot->CRC >> 8);
+  slot->LQI  = 0xFF;
+  slot->RSSI = 0xC0;
+}
+
+int main(int argc, char *argv[])
+{
+  static const INT8U sizes[] = {NWK_OVERHEAD + APP_HEADER_SIZE + 4,
+                                NWK_OVERHEAD + APP_HEADER_SIZE + 16,
+                                NWK_OVERHEAD + APP_HEADER_SIZE + 48,
+                                MAX_APP_PAYLOAD_SIZE + NWK_APP_HEADER_SIZE};
+  static RF_RX_SLOT slot;
+  static MAC_FRAME_VIEW view;
+  INT32U iterations = 200000;
+  INT32U n, k;
+  INT64U t0, c_copy, c_view;
+  int c;
+
+  while ((c = getopt(argc, argv, "n:")) != -1)
+  {
+    switch (c)
+    {
+      case 'n': iterations = (INT32U)atoi(optarg); break;
+      default:
+        printf("usage: %s [-n iterations]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  mac_frame = &view;
+  nwk_frame = &view;
+
+  printf("MAC header decode, %u iterations\n", (unsigned)iterations);
+  printf("packet state: copy %u B (UNET_PACKET), view %u B (MAC_FRAME_VIEW)\n",
+         (unsigned)sizeof(MAC_PACKET_COPY), (unsigned)sizeof(MAC_FRAME_VIEW));
+  printf("%8s %12s %12s %8s\n", "payload", "copy cyc", "view cyc", "speedup");
+
+  for (k = 0; k < sizeof(sizes); k++)
+  {
+    BuildFrame(&slot, sizes[k]);
+    if ((CopyParse(&slot) != TRUE) || (MAC_FrameParse(&slot) != TRUE) || (NWK_HeaderParse() != OK) ||
+        (packet.SrcAddr_16b != MAC_RX_SRC_ADDR_16B()) || (packet.Payload_Size != mac_frame->Payload_Size) ||
+        (memcmp((const void *)packet.MAC_Payload, mac_frame->MAC_Payload, mac_frame->Payload_Size) != 0))
+    {
+      printf("decode mismatch for a %u byte payload\n", sizes[k]);
+      return 1;
+    }
+
+    c_copy = 0;
+    c_view = 0;
+    for (n = 0; n < iterations; n++)
+    {
+      t0 = OSHostCycles();
+      (void)CopyParse(&slot);
+      CopyRead();
+      c_copy += OSHostCycles() - t0;
+
+      t0 = OSHostCycles();
+      (void)MAC_FrameParse(&slot);
+      (void)NWK_HeaderParse();
+      ViewRead();
+      c_view += OSHostCycles() - t0;
+    }
+
+    printf("%8u %12.1f %12.1f %7.1fx\n", sizes[k], (double)c_copy / iterations,
+           (double)c_view / iterations, (double)c_copy / c_view);
+  }
+  return 0;
+}
@@ -0,0 +1,127 @@
+/**********************************************************************************
+@file   rx_spi.c
+@brief  Benchmark: RX FIFO read of UNET_RF_Event, one SPI access per byte
+        against a single sequential (burst) read
+*********************************************************************************/
+
+/*
+   Both paths read the same frame (length, frame with FCS, LQI and RSSI)
+   from the MRF24J40 model. With -s the model charges the SPI bus time of
+   each transaction at the given clock, as the target would spend it.
+
+   usage: bench_rx_spi [-s spi Hz] [-n iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "BRTOS.h"
+#include "MRF24J40.h"
+
+/* Symbols of the UNET core used by the radio model */
+volatile INT16U macPANId = 0x4742;
+volatile INT16U macAddr  = 0x0000;
+BRTOS_Sem       *RF_Event;
+
+void BRTOS_TimerHook(void)
+{
+}
+
+static INT8U fifo[1 + 127 + 2];
+
+/* Previous path: PHYGetLongRAMAddr for each byte, LQI and RSSI */
+static INT8U ReadPerByte(void)
+{
+  INT8U  i = PHYGetLongRAMAddr(0x300);
+  INT16U j;
+
+  for (j = 0; j <= i; j++)
+  {
+    fifo[j] = PHYGetLongRAMAddr((INT16U)0x300 + j);
+  }
+  fifo[i + 1] = PHYGetLongRAMAddr(0x300 + i + (INT16U)1);
+  fifo[i + 2] = PHYGetLongRAMAddr(0x300 + i + (INT16U)2);
+  return i;
+}
+
+/* New path: length, then the rest in one transaction */
+static INT8U ReadBurst(void)
+{
+  INT8U i = PHYGetLongRAMAddr(0x300);
+
+  fifo[0] = i;
+  PHYGetLongRAMBurst((INT16U)0x301, &fifo[1], (INT8U)(i + 2));
+  return i;
+}
+
+int main(int argc, char *argv[])
+{
+  static const INT8U sizes[] = {16, 48, 96, 125};
+  INT8U  frame[125];
+  INT32U spi_hz = 0;
+  INT32U iterations = 20000;
+  INT32U n, k;
+  INT64U t0, c_old, c_new;
+  MRF24J40_HOST_STAT s_old, s_new;
+  int c;
+
+  while ((c = getopt(argc, argv, "s:n:")) != -1)
+  {
+    switch (c)
+    {
+      case 's': spi_hz     = (INT32U)atoi(optarg); break;
+      case 'n': iterations = (INT32U)atoi(optarg); break;
+      default:
+        printf("usage: %s [-s spi Hz] [-n iterations]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  BRTOS_Init();
+  Radio_port_Init();
+  MRF24J40Init();
+  MRF24J40_HostSetSpiClock(spi_hz);
+
+  for (n = 0; n < sizeof(frame); n++) frame[n] = (INT8U)n;
+  frame[0] = 0x41;
+  frame[1] = 0x88;
+
+  printf("RX FIFO read, SPI clock %s%u Hz, %u iterations\n", spi_hz ? "" : "not charged, ",
+         (unsigned)spi_hz, (unsigned)iterations);
+  printf("%6s %14s %14s %8s %12s %12s\n", "frame", "per byte cyc", "burst cyc", "speedup",
+         "per byte SPI", "burst SPI");
+
+  for (k = 0; k < sizeof(sizes); k++)
+  {
+    // A new frame in the RX FIFO; the model keeps it until RXFLUSH
+    PHYSetShortRAMAddr(WRITE_RXFLUSH, 0x01);
+    (void)MRF24J40_HostReceive(frame, sizes[k], 0xFF, 0xC0);
+
+    c_old = 0;
+    c_new = 0;
+    MRF24J40_HostClearStat();
+    for (n = 0; n < iterations; n++)
+    {
+      t0 = OSHostCycles();
+      (void)ReadPerByte();
+      c_old += OSHostCycles() - t0;
+    }
+    MRF24J40_HostGetStat(&s_old);
+
+    MRF24J40_HostClearStat();
+    for (n = 0; n < iterations; n++)
+    {
+      t0 = OSHostCycles();
+      (void)ReadBurst();
+      c_new += OSHostCycles() - t0;
+    }
+    MRF24J40_HostGetStat(&s_new);
+
+    printf("%6u %14.0f %14.0f %7.1fx %5llu tr/%4llu B %5llu tr/%4llu B\n", sizes[k],
+           (double)c_old / iterations, (double)c_new / iterations, (double)c_old / c_new,
+           (unsigned long long)(s_old.spi_transactions / iterations), (unsigned long long)(s_old.spi_bytes / iterations),
+           (unsigned long long)(s_new.spi_transactions / iterations), (unsigned long long)(s_new.spi_bytes / iterations));
+  }
+  return 0;
+}
@@ -0,0 +1,157 @@
+/**********************************************************************************
+@file   se_codec.c
+@brief  Benchmark: size of the multiple metering reports of NetMultiMeasureSE,
+        full width values against the keyframe/delta encoding, and the
+        reports rebuilt by the decoder of the coordinator
+*********************************************************************************/
+
+/*
+   A meter samples voltage, current, power factor, S/Q/P power and energy
+   once per report, with small variations between reports. Each report is
+   encoded with SE_MultiEncode and decoded with SE_MultiDecode as the
+   coordinator does (Decode_SmartEnergy_Profile); every decoded report must
+   match the one that was sent. With -l the given percentage of the reports
+   is lost on the way: the deltas that follow a lost keyframe are not
+   decoded until the next keyframe.
+
+   The full width report is the one of SE_COMPACT_ENCODING 0: the count of
+   measures, 16 bit voltage, current and power factor and 32 bit powers and
+   energy. "per frame" is the number of reports that fit in one aggregated
+   frame (NWK_AGGREGATE) and "air us" the airtime of a frame with a single
+   report, compressed NWK header, at 250 kbit/s.
+
+   usage: bench_se_codec [-n reports] [-l loss %]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "BRTOS.h"
+#include "unet_api.h"
+#include "mac.h"
+#include "network.h"
+#include "app.h"
+
+#define METER_ADDR            0x0101
+/* APP_01, profile and command before the encoded report */
+#define SE_APP_PREFIX         3
+#define SE_FULL_SIZE          (SE_APP_PREFIX + 1 + (3 * 2) + (4 * 4))
+
+static INT32U Vary(INT32U value, INT32U range)
+{
+  return (INT32U)(value + (INT32U)(rand() % (2 * range + 1)) - range);
+}
+
+static void Sample(SE_STRUCT *se)
+{
+  se->params.Byte                = 0;
+  se->params.Bits.Voltage        = 1;
+  se->params.Bits.Current        = 1;
+  se->params.Bits.Power_Factor   = 1;
+  se->params.Bits.Apparent_Power = 1;
+  se->params.Bits.Reactive_Power = 1;
+  se->params.Bits.Active_Power   = 1;
+  se->params.Bits.Energy         = 1;
+
+  se->v_rms         = (INT16U)Vary(22000, 40);                 // 0.01 V
+  se->i_rms         = (INT16U)Vary(520, 6);                    // 0.01 A
+  se->power_factor  = (INT16U)Vary(950, 3);                    // 0.001
+  se->power_S       = (INT32U)se->v_rms * se->i_rms / 100;     // 0.01 VA
+  se->power_P       = se->power_S * se->power_factor / 1000;
+  se->power_Q       = se->power_S - se->power_P;
+  se->energy_meter += se->power_P / 3600;                      // one report per second
+}
+
+static INT8U Same(const SE_STRUCT *a, const SE_STRUCT *b)
+{
+  return (INT8U)((a->v_rms == b->v_rms) && (a->i_rms == b->i_rms) && (a->power_factor == b->power_factor) &&
+                 (a->power_S == b->power_S) && (a->power_Q == b->power_Q) && (a->power_P == b->power_P) &&
+                 (a->energy_meter == b->energy_meter) && (a->params.Byte == b->params.Byte));
+}
+
+static INT32U AirUs(INT32U message)
+{
+  /* PHY header, MAC header, compressed NWK header of the first hop, FCS */
+  return (6 + NWK_MAC_HEADER_SIZE + NWK_COMPRESSED_OVERHEAD + message + 2) * 32;
+}
+
+int main(int argc, char *argv[])
+{
+  static SE_STRUCT se;
+  SE_STRUCT out;
+  INT8U  report[SE_MULTI_MAX_SIZE];
+  INT32U reports = 100000;
+  INT32U loss = 0;
+  INT32U n, bytes = 0, keys = 0, lost = 0, decoded = 0, missed = 0;
+  INT64U t0, c_enc = 0, c_dec = 0;
+  INT8U  size;
+  double avg;
+  int c;
+
+  while ((c = getopt(argc, argv, "n:l:")) != -1)
+  {
+    switch (c)
+    {
+      case 'n': reports = (INT32U)atoi(optarg); break;
+      case 'l': loss    = (INT32U)atoi(optarg); break;
+      default:
+        printf("usage: %s [-n reports] [-l loss %%]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  srand(1);
+  se.energy_meter = 123456789;
+
+  for (n = 0; n < reports; n++)
+  {
+    Sample(&se);
+
+    t0 = OSHostCycles();
+    size = SE_MultiEncode(&se, report);
+    c_enc += OSHostCycles() - t0;
+
+    bytes += SE_APP_PREFIX + size;
+    if (report[0] == MULTIPLE_KEYFRAME) keys++;
+
+    if (loss && ((INT32U)(rand() % 100) < loss))
+    {
+      lost++;
+      continue;
+    }
+
+    t0 = OSHostCycles();
+    if (SE_MultiDecode(METER_ADDR, report[0], &report[1], (INT8U)(size - 1), &out) == TRUE)
+    {
+      c_dec += OSHostCycles() - t0;
+      if (!Same(&se, &out))
+      {
+        printf("report %u decoded with other values\n", (unsigned)n);
+        return 1;
+      }
+      decoded++;
+    }else
+    {
+      c_dec += OSHostCycles() - t0;
+      missed++;
+    }
+  }
+
+  avg = (double)bytes / reports;
+  printf("Multiple metering reports, %u reports, keyframe every %u, loss %u%%\n",
+         (unsigned)reports, (unsigned)SE_KEYFRAME_PERIOD, (unsigned)loss);
+  printf("%-14s %10s %10s %8s %10s\n", "encoding", "bytes", "per frame", "air us", "cyc");
+  printf("%-14s %10u %10u %8u %10s\n", "full width", (unsigned)SE_FULL_SIZE,
+         (unsigned)(MAX_APP_PAYLOAD_SIZE / (NWK_AGGR_RECORD_HEADER + SE_FULL_SIZE)),
+         (unsigned)AirUs(SE_FULL_SIZE), "-");
+  printf("%-14s %10.1f %10u %8.0f %10.1f\n", "keyframe/delta", avg,
+         (unsigned)(MAX_APP_PAYLOAD_SIZE / (NWK_AGGR_RECORD_HEADER + avg)),
+         (double)AirUs(0) + avg * 32, (double)c_enc / reports);
+  printf("keyframes %u, lost %u, decoded %u (%.1f%% of the received), "
+         "deltas waiting a keyframe %u, decode %.1f cyc\n",
+         (unsigned)keys, (unsigned)lost, (unsigned)decoded,
+         (reports - lost) ? 100.0 * decoded / (reports - lost) : 0.0, (unsigned)missed,
+         (reports - lost) ? (double)c_dec / (reports - lost) : 0.0);
+  return 0;
+}
@@ -0,0 +1,154 @@
+/**********************************************************************************
+@file   tx_spi.c
+@brief  Benchmark: TX normal FIFO load of the frame builders, one SPI access
+        per byte against the frame assembled in RAM and written in one burst
+*********************************************************************************/
+
+/*
+   Each builder (MAC_Beacon, MAC_Command, NeighborPing, NWK_Command) is run
+   once to assemble its frame in mac_tx_fifo. The same image is then loaded
+   into the MRF24J40 model as the previous builders did, with one
+   PHYSetLongRAMAddr per byte, and with the single PHYSetLongRAMBurst of
+   the UNET_TX task. With -s the model charges the SPI bus time of each
+   transaction at the given clock, which is the time the FIFO load holds the
+   radio mutex on the target.
+
+   The "builder" column is a whole builder call (frame assembly in RAM).
+
+   usage: bench_tx_spi [-s spi Hz] [-n iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "BRTOS.h"
+#include "unet_api.h"
+#include "mac.h"
+#include "network.h"
+
+static void Beacon(void)
+{
+  MAC_Beacon();
+}
+
+static void BeaconRequest(void)
+{
+  MAC_Command(BEACON_REQUEST, 0x00, 0xFFFF, 0xFFFF);
+}
+
+static void Ping(void)
+{
+  NeighborPing();
+}
+
+static void Route16(void)
+{
+  NWK_Command(0x0000, 0, 16, 0, 0x0000);
+}
+
+static void RouteMax(void)
+{
+  NWK_Command(0x0000, 0, MAX_APP_PAYLOAD_SIZE, 0, 0x0000);
+}
+
+typedef struct
+{
+  const char *name;
+  void      (*build)(void);
+} TX_BUILDER;
+
+static const TX_BUILDER builders[] =
+{
+  {"MAC_Beacon",             Beacon},
+  {"MAC_Command beacon req", BeaconRequest},
+  {"NeighborPing",           Ping},
+  {"NWK_Command 16 B",       Route16},
+  {"NWK_Command max",        RouteMax},
+};
+
+/* Previous path: one PHYSetLongRAMAddr for each byte of the FIFO image */
+static void LoadPerByte(INT8U size)
+{
+  INT8U i;
+
+  for (i = 0; i < size; i++)
+  {
+    PHYSetLongRAMAddr(i, mac_tx_fifo[i]);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  INT32U spi_hz = 0;
+  INT32U iterations = 20000;
+  INT32U n, k;
+  INT8U  size;
+  INT64U t0, c_old, c_new, c_build;
+  MRF24J40_HOST_STAT s_old, s_new;
+  int c;
+
+  while ((c = getopt(argc, argv, "s:n:")) != -1)
+  {
+    switch (c)
+    {
+      case 's': spi_hz     = (INT32U)atoi(optarg); break;
+      case 'n': iterations = (INT32U)atoi(optarg); break;
+      default:
+        printf("usage: %s [-s spi Hz] [-n iterations]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  // The radio is not started
+  BRTOS_Init();
+  Radio_port_Init();
+  MRF24J40_HostSetSpiClock(spi_hz);
+
+  printf("TX FIFO load, SPI clock %s%u Hz, %u iterations\n", spi_hz ? "" : "not charged, ",
+         (unsigned)spi_hz, (unsigned)iterations);
+  printf("%-24s %6s %14s %14s %8s %12s %12s %12s\n", "frame", "bytes", "per byte cyc", "burst cyc",
+         "speedup", "per byte SPI", "burst SPI", "builder cyc");
+
+  for (k = 0; k < sizeof(builders) / sizeof(builders[0]); k++)
+  {
+    builders[k].build();
+    size = (INT8U)(2 + mac_tx_fifo[1]);
+
+    c_old = 0;
+    c_new = 0;
+    c_build = 0;
+    MRF24J40_HostClearStat();
+    for (n = 0; n < iterations; n++)
+    {
+      t0 = OSHostCycles();
+      LoadPerByte(size);
+      c_old += OSHostCycles() - t0;
+    }
+    MRF24J40_HostGetStat(&s_old);
+
+    MRF24J40_HostClearStat();
+    for (n = 0; n < iterations; n++)
+    {
+      t0 = OSHostCycles();
+      PHYSetLongRAMBurst(0x000, mac_tx_fifo, size);
+      c_new += OSHostCycles() - t0;
+    }
+    MRF24J40_HostGetStat(&s_new);
+
+    for (n = 0; n < iterations; n++)
+    {
+      t0 = OSHostCycles();
+      builders[k].build();
+      c_build += OSHostCycles() - t0;
+    }
+
+    printf("%-24s %6u %14.0f %14.0f %7.1fx %5llu tr/%4llu B %5llu tr/%4llu B %12.0f\n",
+           builders[k].name, size, (double)c_old / iterations, (double)c_new / iterations,
+           (double)c_old / c_new,
+           (unsigned long long)(s_old.spi_transactions / iterations), (unsigned long long)(s_old.spi_bytes / iterations),
+           (unsigned long long)(s_new.spi_transactions / iterations), (unsigned long long)(s_new.spi_bytes / iterations),
+           (double)c_build / iterations);
+  }
+  return 0;
+}
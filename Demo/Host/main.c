@@ -0,0 +1,946 @@
+/**********************************************************************************
+@file   main.c
+@brief  UNET node on a Linux host, with the IEEE 802.15.4 neighbourhood emulated
+@authors: Gustavo Weber Denardin
+          Carlos Henrique Barriquello
+
+Copyright (c) <2009-2013> <Universidade Federal de Santa Maria>
+
+  * Software License Agreement
+  *
+  * The Software is owned by the authors, and is protected under
+  * applicable copyright laws. All rights are reserved.
+  *
+  * The above copyright notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  * THE SOFTWARE.
+*********************************************************************************/
+
+/*
+   The UNET stack runs unmodified over the BRTOS port and the MRF24J40 model
+   (see port/). This file plays the rest of the network:
+
+   - coordinator build: child routers that send application reports to the
+     coordinator, with the MAC retries of the radio and the network retries
+     of UNET, and neighbour pings. With -f, the coordinator also overhears
+     frames that are not for it.
+   - router build: the parent coordinator, which pings the router and
+     acknowledges its frames. The router reports with UNET_App_Traffic and,
+     with -n, forwards the reports of its children at depth 2. With -c, the
+     parent also sends commands to the application of the router (decoded
+     by UNET_App_1_Decode), counted with the reports.
+
+   With -H, each child of the router is the root of a subtree of that many
+   hops to the coordinator: with each report it also relays, back to back,
+   one report of a node at each depth from 3 to the given number of hops
+   (many to one convergecast over a tree of that depth).
+
+   With -a the children aggregate that many reports in each frame
+   (NWK_AGGREGATE), as a router built with NWK_AGGREGATION_ENABLE does.
+   The children use the NWK header format of the build (NWK_COMPRESSED
+   with NWK_HEADER_COMPRESSION).
+
+   At the end the harness prints throughput, latency, losses, the UNET
+   statistics, the radio statistics and the CPU time of each task.
+*/
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* MCU and OS includes */
+#include "BRTOS.h"
+#include "FLASH.h"
+
+/* Config. files */
+#include "AppConfig.h"
+#include "NetConfig.h"
+#include "BoardConfig.h"
+
+#include "tasks.h"        /* for tasks prototypes */
+#include "unet_api.h"     /* for UNET network functions */
+
+BRTOS_TH TH_NET_APP1;
+BRTOS_TH TH_NET_APP2;
+
+#define HOST_PAN_ID             0x4742
+#define HOST_FOREIGN_PAN_ID     0x1234
+#define HOST_PARENT_ADDR        0x0000
+#define HOST_ROUTER_ADDR        0x0001
+#define HOST_CHILD_ADDR(i)      (INT16U)(0x0100 + (i))
+#define HOST_MAX_CHILDREN       32
+#define HOST_RSSI               200
+#define HOST_LQI                255
+#define HOST_PING_PERIOD_MS     1000
+#define HOST_NWK_RETRY_MS       30
+
+/* Options */
+static INT32U opt_seconds  = 5;
+#if (DEVICE_TYPE == PAN_COORDINATOR)
+static INT32U opt_children = 4;
+#else
+static INT32U opt_children = 0;
+#endif
+static INT32U opt_rate     = 20;      // reports per second, per child or of the router
+static INT32U opt_size     = 16;      // application data bytes
+static INT32U opt_spi_hz   = 0;
+static INT32U opt_loss     = 0;       // % of frames not acknowledged by the parent
+static INT32U opt_warmup   = 3;       // seconds to build the neighbourhood
+static INT32U opt_foreign  = 0;       // overheard frames per second, not for the coordinator
+static INT32U opt_work     = 0;       // us of processing for each report received
+static INT32U opt_print    = 0;       // ms blocked printing each report received
+static INT32U opt_aggregate = 1;      // reports in each frame of a child
+static INT32U opt_commands = 0;       // commands per second of the parent to the router
+static INT32U opt_hops     = 2;       // hops to the coordinator of the deepest node of a child subtree
+
+/* Tags: the send time of each outstanding report */
+#define TAG_TABLE_SIZE          65536
+#define LATENCY_SAMPLES         (1 << 20)
+
+static INT64U tag_time[TAG_TABLE_SIZE];
+static INT32U tag_next = 1;
+static INT32U latency_us[LATENCY_SAMPLES];
+static INT32U latency_count = 0;
+static INT64U offered = 0;
+static INT64U delivered = 0;
+static INT64U duplicated = 0;
+static INT64U gave_up = 0;
+static volatile int measuring = 0;
+
+static INT64U Now(void)
+{
+  return OSHostNanoseconds();
+}
+
+static void SleepUntil(INT64U t)
+{
+  struct timespec ts;
+
+  ts.tv_sec  = (time_t)(t / 1000000000ULL);
+  ts.tv_nsec = (long)(t % 1000000000ULL);
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {};
+}
+
+/* Called by tasks and by the radio model: lock free */
+INT32U HostTagNew(void)
+{
+  INT32U tag = __atomic_fetch_add(&tag_next, 1, __ATOMIC_RELAXED);
+
+  __atomic_store_n(&tag_time[tag % TAG_TABLE_SIZE], measuring ? Now() : 0, __ATOMIC_RELAXED);
+  if (measuring) __atomic_fetch_add(&offered, 1, __ATOMIC_RELAXED);
+  return tag;
+}
+
+void HostTagDelivered(INT32U tag)
+{
+  INT64U sent = __atomic_exchange_n(&tag_time[tag % TAG_TABLE_SIZE], 0, __ATOMIC_RELAXED);
+  INT32U n;
+
+  if (!measuring) return;
+  if (sent == 0)
+  {
+    __atomic_fetch_add(&duplicated, 1, __ATOMIC_RELAXED);
+    return;
+  }
+  __atomic_fetch_add(&delivered, 1, __ATOMIC_RELAXED);
+  n = __atomic_fetch_add(&latency_count, 1, __ATOMIC_RELAXED);
+  if (n < LATENCY_SAMPLES)
+  {
+    latency_us[n] = (INT32U)((Now() - sent) / 1000);
+  }
+}
+
+
+/* Frames of the emulated nodes */
+static INT8U PingFrame(INT8U *f, INT16U src, INT8U seq, INT8U depth, INT16U neighbor)
+{
+  INT8U i = 0;
+
+  f[i++] = MAC_INTRA_PAN | DataFrame;
+  f[i++] = 0x88;
+  f[i++] = seq;
+  f[i++] = (INT8U)(HOST_PAN_ID & 0xFF);
+  f[i++] = (INT8U)(HOST_PAN_ID >> 8);
+  f[i++] = 0xFF;
+  f[i++] = 0xFF;
+  f[i++] = (INT8U)(src & 0xFF);
+  f[i++] = (INT8U)(src >> 8);
+  f[i++] = DATA_PING;
+  f[i++] = depth;
+  f[i++] = (INT8U)(neighbor >> 8);
+  f[i++] = (INT8U)(neighbor & 0xFF);
+  f[i++] = HOST_RSSI;
+  return i;
+}
+
+/* APP message of a report: the tag and opt_size - HOST_TAG_SIZE filler bytes */
+static INT8U ReportMessage(INT8U *m, INT32U tag)
+{
+  INT8U i = 0;
+  INT8U j;
+
+  m[i++] = APP_01;
+  m[i++] = GENERAL_PROFILE;
+  m[i++] = DEBUG_PKT;
+  m[i++] = DEBUG_COUNTER;
+  m[i++] = (INT8U)(tag & 0xFF);
+  m[i++] = (INT8U)((tag >> 8) & 0xFF);
+  m[i++] = (INT8U)((tag >> 16) & 0xFF);
+  m[i++] = (INT8U)(tag >> 24);
+  for (j = HOST_TAG_SIZE; j < opt_size; j++)
+  {
+    m[i++] = j;
+  }
+  return i;
+}
+
+/* Report frame of origin to the coordinator, sent by src to dst after life
+   hops (life 0: origin is src). With more than one tag the reports are
+   aggregated (NWK_AGGREGATE), as a router does. The NWK header is compressed
+   as NWK_Command does */
+static INT8U ReportFrame(INT8U *f, INT16U dst, INT8U parameter, INT16U src, INT8U seq,
+                         INT16U origin, INT8U life, const INT32U *tag, INT8U tags)
+{
+  INT8U i = 0;
+  INT8U k;
+
+  f[i++] = MAC_ACK_INTRA_PAN | DataFrame;
+  f[i++] = 0x88;
+  f[i++] = seq;
+  f[i++] = (INT8U)(HOST_PAN_ID & 0xFF);
+  f[i++] = (INT8U)(HOST_PAN_ID >> 8);
+  f[i++] = (INT8U)(dst & 0xFF);
+  f[i++] = (INT8U)(dst >> 8);
+  f[i++] = (INT8U)(src & 0xFF);
+  f[i++] = (INT8U)(src >> 8);
+  f[i++] = ROUTE_PACKET;
+  if (tags > 1) parameter = (INT8U)(parameter | NWK_AGGREGATE);
+#if (NWK_HEADER_COMPRESSION == 1)
+  f[i++] = (INT8U)(parameter | NWK_COMPRESSED);
+  f[i++] = life;                                // packet life
+  if (life != 0)
+  {
+    f[i++] = (INT8U)(origin & 0xFF);
+    f[i++] = (INT8U)(origin >> 8);
+  }
+#else
+  f[i++] = parameter;
+  f[i++] = (INT8U)(HOST_PARENT_ADDR & 0xFF);
+  f[i++] = (INT8U)(HOST_PARENT_ADDR >> 8);
+  f[i++] = (INT8U)(origin & 0xFF);
+  f[i++] = (INT8U)(origin >> 8);
+  f[i++] = life;                                // packet life
+#endif
+  if (tags == 1)
+  {
+    return (INT8U)(i + ReportMessage(&f[i], tag[0]));
+  }
+  for (k = 0; k < tags; k++)
+  {
+    f[i] = ReportMessage(&f[i + NWK_AGGR_RECORD_HEADER], tag[k]);
+    f[i + 1] = (INT8U)(origin & 0xFF);
+    f[i + 2] = (INT8U)(origin >> 8);
+    i = (INT8U)(i + NWK_AGGR_RECORD_HEADER + f[i]);
+  }
+  return i;
+}
+
+
+/* Children: each report is sent with up to aMaxFrameRetries MAC retries
+   and (NWK_TX_RETRIES - 1) network attempts, as HandleRoutePacket does.
+   The children of the coordinator are routers at depth 1; the children of
+   the router are nodes at depth 2 that report through it. With -a a child
+   sends its reports in aggregated frames of that many reports. With -H the
+   reports relayed from the subtree of a child are sent with the MAC retries
+   alone, from the node at HOST_SUBTREE_ADDR(i, life) */
+#if (DEVICE_TYPE == PAN_COORDINATOR)
+#define HOST_CHILD_PARENT       HOST_PARENT_ADDR
+#define HOST_CHILD_DEPTH        1
+#define HOST_CHILD_PARAMETER    DEST_DOWN
+#else
+#define HOST_CHILD_PARENT       HOST_ROUTER_ADDR
+#define HOST_CHILD_DEPTH        2
+#define HOST_CHILD_PARAMETER    NOT_DEST_DOWN
+#endif
+#define HOST_MAX_AGGREGATE      8
+#define HOST_MAX_HOPS           8
+#define HOST_SUBTREE_ADDR(i,life) (INT16U)(HOST_CHILD_ADDR(i) + ((life) << 8))
+
+typedef struct
+{
+  INT16U  addr;
+  INT8U   seq;
+  INT64U  next_report;
+  INT64U  next_ping;
+  INT64U  retry_at;        // 0 = no report pending
+  INT8U   nwk_attempts;
+  INT32U  tag[HOST_MAX_AGGREGATE];
+} HOST_CHILD;
+
+static HOST_CHILD child[HOST_MAX_CHILDREN];
+static INT64U     next_foreign;
+static INT8U      foreign_seq;
+static INT64U     report_period;
+
+static INT64U RandomNs(INT64U max)
+{
+  return (INT64U)(((double)rand() / RAND_MAX) * (double)max);
+}
+
+/* The air is shared: the harness transmits one frame at a time */
+static INT8U ChildTransmit(const INT8U *f, INT8U length, INT8U ack_request)
+{
+  INT8U retries;
+  INT8U ret;
+
+  for (retries = 0; ; retries++)
+  {
+    SleepUntil(Now() + (INT64U)MRF24J40_AIRTIME_US(length) * 1000);
+    ret = MRF24J40_HostReceive(f, length, HOST_LQI, HOST_RSSI);
+    if (!ack_request || (ret & MRF24J40_RX_ACKED)) return TRUE;
+    SleepUntil(Now() + 864000);
+    if (retries == aMaxFrameRetries) return FALSE;
+  }
+}
+
+/* Overheard traffic: reports of a neighbouring PAN and unicasts between
+   two children, alternately. The radio receives them (promiscuous mode),
+   but does not acknowledge them */
+static INT8U ForeignFrame(INT8U *f)
+{
+  INT32U tag    = 0;
+  INT8U  length = ReportFrame(f, HOST_PARENT_ADDR, DEST_DOWN, HOST_CHILD_ADDR(0), foreign_seq,
+                              HOST_CHILD_ADDR(0), 0, &tag, 1);
+  INT16U pan    = HOST_PAN_ID;
+  INT16U dst    = HOST_CHILD_ADDR(1);
+
+  if (foreign_seq & 1)
+  {
+    pan = HOST_FOREIGN_PAN_ID;
+    dst = HOST_PARENT_ADDR;
+  }
+  f[0] = MAC_INTRA_PAN | DataFrame;
+  f[3] = (INT8U)(pan & 0xFF);
+  f[4] = (INT8U)(pan >> 8);
+  f[5] = (INT8U)(dst & 0xFF);
+  f[6] = (INT8U)(dst >> 8);
+  foreign_seq++;
+  return length;
+}
+
+
+#if (DEVICE_TYPE == ROUTER)
+/* Parent coordinator: pings the router, acknowledges its frames and sends
+   commands to its application */
+static INT64U next_ping;
+static INT8U  ping_seq = 1;
+static INT64U next_command;
+
+/* Command of the parent to the router: an APP message to the router (DEST_UP),
+   with the NWK header of a first hop */
+static INT8U CommandFrame(INT8U *f, INT8U seq, INT32U tag)
+{
+  INT8U i = 0;
+
+  f[i++] = MAC_ACK_INTRA_PAN | DataFrame;
+  f[i++] = 0x88;
+  f[i++] = seq;
+  f[i++] = (INT8U)(HOST_PAN_ID & 0xFF);
+  f[i++] = (INT8U)(HOST_PAN_ID >> 8);
+  f[i++] = (INT8U)(HOST_ROUTER_ADDR & 0xFF);
+  f[i++] = (INT8U)(HOST_ROUTER_ADDR >> 8);
+  f[i++] = (INT8U)(HOST_PARENT_ADDR & 0xFF);
+  f[i++] = (INT8U)(HOST_PARENT_ADDR >> 8);
+  f[i++] = ROUTE_PACKET;
+#if (NWK_HEADER_COMPRESSION == 1)
+  f[i++] = (INT8U)(DEST_UP | NWK_COMPRESSED);
+  f[i++] = 0;                                   // packet life
+  f[i++] = (INT8U)(HOST_ROUTER_ADDR & 0xFF);
+  f[i++] = (INT8U)(HOST_ROUTER_ADDR >> 8);
+#else
+  f[i++] = DEST_UP;
+  f[i++] = (INT8U)(HOST_ROUTER_ADDR & 0xFF);
+  f[i++] = (INT8U)(HOST_ROUTER_ADDR >> 8);
+  f[i++] = (INT8U)(HOST_PARENT_ADDR & 0xFF);
+  f[i++] = (INT8U)(HOST_PARENT_ADDR >> 8);
+  f[i++] = 0;                                   // packet life
+#endif
+  return (INT8U)(i + ReportMessage(&f[i], tag));
+}
+
+static void ParentDelivered(const INT8U *m, INT8U size)
+{
+  if ((size >= (APP_HEADER_SIZE + HOST_TAG_SIZE)) && (m[2] == DEBUG_PKT) && (m[3] == DEBUG_COUNTER))
+  {
+    HostTagDelivered((INT32U)(m[4] | (m[5] << 8) | (m[6] << 16) | ((INT32U)m[7] << 24)));
+  }
+}
+
+static INT8U ParentAir(const INT8U *f, INT8U length)
+{
+  INT16U dst;
+  INT8U  i, size;
+
+  if (length < 9) return FALSE;
+  if ((f[0] & 0x07) != DataFrame) return FALSE;
+  if (!(f[0] & MAC_ACK)) return FALSE;
+
+  dst = (INT16U)(f[5] | (f[6] << 8));
+  if (dst != HOST_PARENT_ADDR) return FALSE;
+
+  if (opt_loss && ((INT32U)(rand() % 100) < opt_loss)) return FALSE;
+
+  if ((length < (9 + NWK_COMPRESSED_OVERHEAD)) || (f[9] != ROUTE_PACKET)) return TRUE;
+
+  i = (INT8U)(9 + ((f[10] & NWK_COMPRESSED) ? NWK_COMPRESSED_HEADER_SIZE(f[10], f[11]) : NWK_OVERHEAD));
+  if (i > length) return TRUE;
+  if (!(f[10] & NWK_AGGREGATE))
+  {
+    ParentDelivered(&f[i], (INT8U)(length - i));
+    return TRUE;
+  }
+  while ((INT8U)(i + NWK_AGGR_RECORD_HEADER) <= length)
+  {
+    size = f[i];
+    i = (INT8U)(i + NWK_AGGR_RECORD_HEADER);
+    if ((INT8U)(i + size) > length) break;
+    ParentDelivered(&f[i], size);
+    i = (INT8U)(i + size);
+  }
+  return TRUE;
+}
+#endif
+
+static void WorldInit(INT64U reports_start)
+{
+  INT64U t = Now();
+  INT32U i;
+
+  report_period = 1000000000ULL / (opt_rate ? opt_rate : 1);
+  for (i = 0; i < opt_children; i++)
+  {
+    child[i].addr        = HOST_CHILD_ADDR(i);
+    child[i].seq         = (INT8U)(1 + i * 37);
+    child[i].next_ping   = t + RandomNs(HOST_PING_PERIOD_MS * 1000000ULL);
+    child[i].next_report = reports_start + RandomNs(report_period);
+    child[i].retry_at    = 0;
+  }
+  next_foreign = t;
+#if (DEVICE_TYPE == ROUTER)
+  next_ping = t;
+  next_command = reports_start + RandomNs(1000000000ULL / (opt_commands ? opt_commands : 1));
+#endif
+}
+
+#define HOST_EVENT_FOREIGN      HOST_MAX_CHILDREN
+#define HOST_EVENT_PARENT       (HOST_MAX_CHILDREN + 1)
+#define HOST_EVENT_COMMAND      (HOST_MAX_CHILDREN + 2)
+
+static void WorldRun(INT64U end)
+{
+  INT8U  frame[128];
+  INT8U  length;
+  INT64U t, next;
+  INT32U i, k, n;
+  INT32U tag[HOST_MAX_AGGREGATE];
+
+  for (;;)
+  {
+    // Next event
+    k = 0;
+    next = ~0ULL;
+    for (i = 0; i < opt_children; i++)
+    {
+      t = child[i].next_ping;
+      if (child[i].retry_at)
+      {
+        if (child[i].retry_at < t) t = child[i].retry_at;
+      }else
+      if (opt_rate && (child[i].next_report < t))
+      {
+        t = child[i].next_report;
+      }
+      if (t < next)
+      {
+        next = t;
+        k = i;
+      }
+    }
+    if (opt_foreign && (next_foreign < next))
+    {
+      next = next_foreign;
+      k = HOST_EVENT_FOREIGN;
+    }
+#if (DEVICE_TYPE == ROUTER)
+    if (next_ping < next)
+    {
+      next = next_ping;
+      k = HOST_EVENT_PARENT;
+    }
+    if (opt_commands && (next_command < next))
+    {
+      next = next_command;
+      k = HOST_EVENT_COMMAND;
+    }
+#endif
+    if (next >= end) break;
+    SleepUntil(next);
+
+    if (k == HOST_EVENT_FOREIGN)
+    {
+      length = ForeignFrame(frame);
+      (void)ChildTransmit(frame, length, FALSE);
+      next_foreign += 1000000000ULL / opt_foreign;
+      continue;
+    }
+
+#if (DEVICE_TYPE == ROUTER)
+    if (k == HOST_EVENT_PARENT)
+    {
+      length = PingFrame(frame, HOST_PARENT_ADDR, ping_seq++, 0, HOST_ROUTER_ADDR);
+      (void)ChildTransmit(frame, length, FALSE);
+      next_ping += HOST_PING_PERIOD_MS * 1000000ULL;
+      continue;
+    }
+
+    if (k == HOST_EVENT_COMMAND)
+    {
+      length = CommandFrame(frame, ping_seq++, HostTagNew());
+      (void)ChildTransmit(frame, length, TRUE);
+      next_command += 1000000000ULL / opt_commands;
+      continue;
+    }
+#endif
+
+    if (next == child[k].next_ping)
+    {
+      length = PingFrame(frame, child[k].addr, child[k].seq++, HOST_CHILD_DEPTH, HOST_CHILD_PARENT);
+      (void)ChildTransmit(frame, length, FALSE);
+      child[k].next_ping += HOST_PING_PERIOD_MS * 1000000ULL;
+      continue;
+    }
+
+    if (!child[k].retry_at)
+    {
+      // Reports of the subtree, relayed by the child before its own
+      for (i = opt_hops - 2; i > 0; i--)
+      {
+        for (n = 0; n < opt_aggregate; n++)
+        {
+          tag[n] = HostTagNew();
+        }
+        child[k].seq++;
+        length = ReportFrame(frame, HOST_CHILD_PARENT, HOST_CHILD_PARAMETER, child[k].addr, child[k].seq,
+                             HOST_SUBTREE_ADDR(k, i), (INT8U)i, tag, (INT8U)opt_aggregate);
+        if (!ChildTransmit(frame, length, TRUE) && measuring) gave_up += opt_aggregate;
+      }
+
+      // New reports, with a new sequence number
+      for (i = 0; i < opt_aggregate; i++)
+      {
+        child[k].tag[i] = HostTagNew();
+      }
+      child[k].nwk_attempts = 0;
+      child[k].seq++;
+      child[k].next_report += report_period;
+    }
+
+    length = ReportFrame(frame, HOST_CHILD_PARENT, HOST_CHILD_PARAMETER, child[k].addr, child[k].seq,
+                         child[k].addr, 0, child[k].tag, (INT8U)opt_aggregate);
+    if (ChildTransmit(frame, length, TRUE))
+    {
+      child[k].retry_at = 0;
+    }else
+    if (++child[k].nwk_attempts < (NWK_TX_RETRIES - 1))
+    {
+      child[k].retry_at = Now() + (HOST_NWK_RETRY_MS * 1000000ULL) + RandomNs(34000000ULL);
+    }else
+    {
+      if (measuring) gave_up += opt_aggregate;
+      child[k].retry_at = 0;
+    }
+  }
+  SleepUntil(end);
+}
+
+
+/* Report */
+static int CompareU32(const void *a, const void *b)
+{
+  INT32U x = *(const INT32U *)a;
+  INT32U y = *(const INT32U *)b;
+  return (x > y) - (x < y);
+}
+
+/* UNET_NodeStat fields; the ones marked with '=' are not counters and
+   are printed as they are, the counters as the change since the start */
+static const char *unet_stat_names[] =
+{
+  "rxed", "txed", "txfailed", "routed", "apptxed", "dropped", "overbuf",
+  "routdrop", "=rxedbytes", "=txedbytes", "=rxbps", "=txbps", "radioresets", "hellos",
+  "filtpan", "filtaddr", "bpevents", "bptime",
+  "drain1", "drain2", "drain4", "drain8", "=routdelay"
+};
+
+#define UNET_STAT_MAX   32
+static INT16U unet_start[UNET_STAT_MAX];
+
+static void UnetSnapshot(INT16U *s)
+{
+  INT8U size;
+  INT16U *unet = (INT16U *)GetUNET_Statistics(&size);
+
+  if (size > sizeof(unet_start)) size = sizeof(unet_start);
+  memcpy(s, unet, size);
+}
+
+/* TX retry policies (MAC_TX_SINGLE, MAC_TX_ROUTE, ...) */
+static const char *tx_policy_names[MAC_TX_POLICIES] =
+{
+  "single", "route", "deliver", "one hop", "neighbours"
+};
+
+static MAC_TX_POLICY_STAT tx_policy_start[MAC_TX_POLICIES];
+
+static void TxPolicySnapshot(MAC_TX_POLICY_STAT *s)
+{
+  INT8U i;
+
+  for (i = 0; i < MAC_TX_POLICIES; i++)
+  {
+    s[i] = *MAC_TxPolicyStat(i);
+  }
+}
+
+/* TX classes (MAC_TX_CLASS_ROUTE, ...); the maxima include the warm up */
+static const char *tx_class_names[MAC_TX_CLASSES] =
+{
+  "route", "control", "app"
+};
+
+static MAC_TX_CLASS_STAT tx_class_start[MAC_TX_CLASSES];
+
+static void TxClassSnapshot(MAC_TX_CLASS_STAT *s)
+{
+  INT8U i;
+
+  for (i = 0; i < MAC_TX_CLASSES; i++)
+  {
+    s[i] = *MAC_TxClassStat(i);
+  }
+}
+
+/* Transmission statistics of the RF event task */
+static UNET_TX_STAT tx_stat_start;
+static INT32U       rx_exhausted_start;
+
+/* Forwarding queue drops (NWK_DROP_QUEUE_TAIL, ...) */
+static const char *fwd_drop_names[NWK_DROP_REASONS] =
+{
+  "tail", "oldest", "life", "no route", "tx queue", "tx failed"
+};
+
+static UNET_FWD_STAT fwd_stat_start;
+static UNET_APP_STAT app_stat_start;
+
+static void Report(double seconds)
+{
+  MRF24J40_HOST_STAT radio;
+  OS_HOST_STAT       os;
+  OS_HOST_TASK_STAT  task;
+  const UNET_TX_STAT *tx;
+  const UNET_RX_POOL_STAT *pool;
+  const UNET_FWD_STAT *fwd;
+  const UNET_APP_STAT *app;
+  INT16U *unet;
+  INT8U  size;
+  INT32U n, i;
+  INT64U cpu = 0;
+
+  n = latency_count < LATENCY_SAMPLES ? latency_count : LATENCY_SAMPLES;
+  qsort(latency_us, n, sizeof(INT32U), CompareU32);
+
+  printf("duration         %.2f s\n", seconds);
+  printf("offered          %llu reports (%u data bytes)\n", (unsigned long long)offered, (unsigned)opt_size);
+  printf("delivered        %llu reports, %.1f reports/s, goodput %.0f B/s\n",
+         (unsigned long long)delivered, delivered / seconds, delivered * opt_size / seconds);
+  printf("lost             %llu (gave up %llu), duplicated %llu, delivery ratio %.1f%%\n",
+         (unsigned long long)(offered > delivered ? offered - delivered : 0),
+         (unsigned long long)gave_up, (unsigned long long)duplicated,
+         offered ? 100.0 * delivered / offered : 0.0);
+  if (n)
+  {
+    printf("latency us       p50 %u  p90 %u  p99 %u  max %u\n",
+           latency_us[n / 2], latency_us[(n * 9) / 10], latency_us[(n * 99) / 100], latency_us[n - 1]);
+  }
+
+  if (HostRxDelay.reports)
+  {
+    printf("rx to app ticks  avg %.2f  max %u (APP_RX_TIMESTAMP, %u reports)\n",
+           (double)HostRxDelay.sum / HostRxDelay.reports, (unsigned)HostRxDelay.max,
+           (unsigned)HostRxDelay.reports);
+  }
+
+  unet = (INT16U *)GetUNET_Statistics(&size);
+  printf("unet            ");
+  for (i = 0; (i < (INT32U)(size / 2)) && (i < UNET_STAT_MAX); i++)
+  {
+    if (i < (sizeof(unet_stat_names) / sizeof(unet_stat_names[0])))
+    {
+      if (unet_stat_names[i][0] == '=')
+      {
+        printf(" %s=%u", &unet_stat_names[i][1], unet[i]);
+      }else
+      {
+        printf(" %s=%u", unet_stat_names[i], (INT16U)(unet[i] - unet_start[i]));
+      }
+    }else
+    {
+      printf(" [%u]=%u", i, (INT16U)(unet[i] - unet_start[i]));
+    }
+  }
+  printf("\n");
+
+  MRF24J40_HostGetStat(&radio);
+  printf("radio            rx %llu, lost busy %llu, lost disabled %llu, acks %llu, tx %llu, tx failed %llu, airtime %.1f%%\n",
+         (unsigned long long)radio.rx_frames, (unsigned long long)radio.rx_busy,
+         (unsigned long long)radio.rx_disabled, (unsigned long long)radio.acks_sent,
+         (unsigned long long)radio.tx_frames, (unsigned long long)radio.tx_failed,
+         radio.tx_airtime_us / (seconds * 10000.0));
+  printf("spi              %llu transactions, %llu bytes\n",
+         (unsigned long long)radio.spi_transactions, (unsigned long long)radio.spi_bytes);
+
+  tx = GetUNET_TxStatistics();
+  printf("tx airtime       %.1f%%, %.1f%% per second (8 s average)\n",
+         (tx->AirtimeUs - tx_stat_start.AirtimeUs) / (seconds * 10000.0), tx->AirtimeRate / 10.0);
+  printf("tx latency us   ");
+  for (i = 0; i < UNET_TX_LATENCY_BUCKETS; i++)
+  {
+    printf(" %s%u:%u", (i == (UNET_TX_LATENCY_BUCKETS - 1)) ? ">=" : "<",
+           (unsigned)(UNET_TX_LATENCY_MIN_US << ((i == (UNET_TX_LATENCY_BUCKETS - 1)) ? (i - 1) : i)),
+           (unsigned)(tx->Latency[i] - tx_stat_start.Latency[i]));
+  }
+  printf("\ntx hw retries   ");
+  for (i = 0; i < UNET_TX_RETRY_BUCKETS; i++)
+  {
+    printf(" %u:%u", (unsigned)i, (unsigned)(tx->Retries[i] - tx_stat_start.Retries[i]));
+  }
+  printf("\n");
+
+  pool = GetUNET_RxPoolStatistics();
+  printf("rx packet pool   %u packets, %u in use at most, %u frames waited for a free packet\n",
+         (unsigned)RX_PACKET_POOL_SIZE, (unsigned)pool->InUseMax,
+         (unsigned)(pool->Exhausted - rx_exhausted_start));
+
+  fwd = GetUNET_FwdStatistics();
+  printf("forwarding       queue %u (%s), depth max %u, %u queued, dropped",
+         (unsigned)NWK_FWD_QUEUE_SIZE, (NWK_FWD_DROP_POLICY == NWK_FWD_DROP_OLDEST) ? "drop oldest" : "drop tail",
+         (unsigned)fwd->DepthMax, (unsigned)(fwd->Queued - fwd_stat_start.Queued));
+  for (i = 0; i < NWK_DROP_REASONS; i++)
+  {
+    printf(" %s:%u", fwd_drop_names[i], (unsigned)(fwd->Dropped[i] - fwd_stat_start.Dropped[i]));
+  }
+  printf("\n");
+
+  app = GetUNET_AppStatistics(APP_01);
+  printf("app 1 mailbox    %u messages, depth max %u, %u delivered, %u dropped\n",
+         (unsigned)APP1_MAILBOX_SIZE, (unsigned)app->DepthMax,
+         (unsigned)(app->Delivered - app_stat_start.Delivered),
+         (unsigned)(app->Dropped - app_stat_start.Dropped));
+
+  if (HostSendStat.sent || HostSendStat.pool_full)
+  {
+    printf("send pool        %u entries, %u sent, %u ok, %u failed, %u pool full\n",
+           (unsigned)UNET_SEND_POOL_SIZE, (unsigned)HostSendStat.sent, (unsigned)HostSendStat.ok,
+           (unsigned)HostSendStat.failed, (unsigned)HostSendStat.pool_full);
+  }
+
+  OSHostGetStat(&os);
+  printf("kernel           %llu context switches, %llu critical sections (avg %.0f cycles)\n",
+         (unsigned long long)os.context_switches, (unsigned long long)os.critical_sections,
+         os.critical_sections ? (double)os.critical_cycles / os.critical_sections : 0.0);
+  printf("radio mutex      %llu holds, avg %.1f us, max %.1f us, %.1f us held per transmitted frame\n",
+         (unsigned long long)os.mutex_holds,
+         os.mutex_holds ? os.mutex_hold_ns / 1e3 / os.mutex_holds : 0.0, os.mutex_hold_max_ns / 1e3,
+         radio.tx_frames ? os.mutex_hold_ns / 1e3 / radio.tx_frames : 0.0);
+
+  for (i = 0; i < MAC_TX_POLICIES; i++)
+  {
+    const MAC_TX_POLICY_STAT *p = MAC_TxPolicyStat((INT8U)i);
+    INT32U requests = p->Requests - tx_policy_start[i].Requests;
+
+    if (requests == 0) continue;
+    printf("tx %-13s %u requests, %.1f%% acked, %.2f transmissions each, latency avg %.1f ms\n",
+           tx_policy_names[i], (unsigned)requests,
+           100.0 * (p->Success - tx_policy_start[i].Success) / requests,
+           (double)(p->Transmissions - tx_policy_start[i].Transmissions) / requests,
+           (double)(p->LatencySum - tx_policy_start[i].LatencySum) / requests);
+  }
+
+  for (i = 0; i < MAC_TX_CLASSES; i++)
+  {
+    const MAC_TX_CLASS_STAT *p = MAC_TxClassStat((INT8U)i);
+    INT32U transmissions = p->Transmissions - tx_class_start[i].Transmissions;
+    INT32U rejected = (INT32U)(INT16U)(p->Rejected - tx_class_start[i].Rejected);
+
+    if ((transmissions == 0) && (rejected == 0)) continue;
+    printf("class %-10s %u transmissions, wait avg %.2f ms, max %u ms, %u promoted, depth max %u, %u rejected\n",
+           tx_class_names[i], (unsigned)transmissions,
+           transmissions ? (double)(p->WaitSum - tx_class_start[i].WaitSum) / transmissions : 0.0,
+           (unsigned)p->WaitMax, (unsigned)(INT16U)(p->Promoted - tx_class_start[i].Promoted),
+           (unsigned)p->DepthMax, (unsigned)rejected);
+  }
+
+  for (i = 1; OSHostGetTaskStat((INT8U)i, &task) == OK; i++)
+  {
+    cpu += task.cpu_ns;
+    printf("task %-24s prio %2u  cpu %8.3f ms  dispatches %llu  blocked %8.3f ms\n", task.name, task.priority,
+           task.cpu_ns / 1e6, (unsigned long long)task.dispatches, task.blocked_ns / 1e6);
+    if (task.pends)
+    {
+      printf("     %-24s %.2f critical sections, %.0f cycles with interrupts disabled per pend\n", "",
+             (double)task.critical_sections / task.pends, (double)task.critical_cycles / task.pends);
+    }
+  }
+  printf("cpu              %.3f ms total, %.1f us per delivered report\n",
+         cpu / 1e6, delivered ? (cpu / 1e3) / delivered : 0.0);
+}
+
+
+static void Usage(const char *name)
+{
+  printf("usage: %s [-t seconds] [-w warmup] [-n children] [-r reports/s] [-p data bytes] [-s spi Hz] [-l loss %%] [-f overheard frames/s] [-d us per report received] [-u ms printing each report received] [-a reports per child frame] [-c commands/s to the router] [-H hops of the child subtrees]\n", name);
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  INT64U start, end;
+  int c;
+
+  while ((c = getopt(argc, argv, "t:w:n:r:p:s:l:f:d:u:a:c:H:h")) != -1)
+  {
+    switch (c)
+    {
+      case 't': opt_seconds  = (INT32U)atoi(optarg); break;
+      case 'w': opt_warmup   = (INT32U)atoi(optarg); break;
+      case 'n': opt_children = (INT32U)atoi(optarg); break;
+      case 'r': opt_rate     = (INT32U)atoi(optarg); break;
+      case 'p': opt_size     = (INT32U)atoi(optarg); break;
+      case 's': opt_spi_hz   = (INT32U)atoi(optarg); break;
+      case 'l': opt_loss     = (INT32U)atoi(optarg); break;
+      case 'f': opt_foreign  = (INT32U)atoi(optarg); break;
+      case 'd': opt_work     = (INT32U)atoi(optarg); break;
+      case 'u': opt_print    = (INT32U)atoi(optarg); break;
+      case 'a': opt_aggregate = (INT32U)atoi(optarg); break;
+      case 'c': opt_commands = (INT32U)atoi(optarg); break;
+      case 'H': opt_hops     = (INT32U)atoi(optarg); break;
+      default:  Usage(argv[0]);
+    }
+  }
+  if (opt_children > HOST_MAX_CHILDREN) opt_children = HOST_MAX_CHILDREN;
+  if (opt_size < HOST_TAG_SIZE) opt_size = HOST_TAG_SIZE;
+  if (opt_aggregate < 1) opt_aggregate = 1;
+  if (opt_aggregate > HOST_MAX_AGGREGATE) opt_aggregate = HOST_MAX_AGGREGATE;
+  if (opt_hops < 2) opt_hops = 2;
+  if (opt_hops > HOST_MAX_HOPS) opt_hops = HOST_MAX_HOPS;
+  while ((opt_aggregate > 1) &&
+         ((opt_aggregate * (NWK_AGGR_RECORD_HEADER + APP_HEADER_SIZE + opt_size)) > MAX_APP_PAYLOAD_SIZE))
+  {
+    opt_aggregate--;
+  }
+  if (opt_size > (MAX_APP_PAYLOAD_SIZE - APP_HEADER_SIZE)) opt_size = MAX_APP_PAYLOAD_SIZE - APP_HEADER_SIZE;
+  srand(1);
+
+  // Erased flash; a router is provisioned with its address
+  HostFlashErase();
+#if (DEVICE_TYPE == ROUTER)
+  {
+    INT32U value = HOST_ROUTER_ADDR;
+    (void)WriteToFlash((INT8U *)&value, MAC16_MEM_ADDRESS, 4);
+    value = HOST_PAN_ID;
+    (void)WriteToFlash((INT8U *)&value, PANID_MEM_ADDRESS, 4);
+  }
+  MRF24J40_HostSetAir(ParentAir);
+#endif
+  MRF24J40_HostSetSpiClock(opt_spi_hz);
+
+  // Initialize BRTOS
+  BRTOS_Init();
+
+  UNET_Init();      /* Install 3 task: PHY, MAC and NWK */
+
+  if(InstallTask(&UNET_App_1_Decode,"Decode app 1 profiles",512,APP1_Priority, NULL, &TH_NET_APP1) != OK)
+  {
+    // Oh Oh
+    // Nao deveria entrar aqui !!!
+    while(1){};
+  };
+
+#if (DEVICE_TYPE == ROUTER)
+  if(InstallTask(&UNET_App_Traffic,"Report to coordinator",512,APP2_Priority, NULL, &TH_NET_APP2) != OK)
+  {
+    // Oh Oh
+    // Nao deveria entrar aqui !!!
+    while(1){};
+  };
+#endif
+
+  // Start Task Scheduler
+  if(BRTOSStart() != OK)
+  {
+    // Oh Oh
+    // Nao deveria entrar aqui !!!
+    for(;;){};
+  };
+
+  // Build the neighbourhood, then measure
+  start = Now() + (INT64U)opt_warmup * 1000000000ULL;
+  end   = start + (INT64U)opt_seconds * 1000000000ULL;
+  WorldInit(start);
+  WorldRun(start);
+
+#if (DEVICE_TYPE == ROUTER)
+  HostTraffic.size      = (INT8U)opt_size;
+  HostTraffic.period_ms = (INT16U)(opt_rate ? 1000 / opt_rate : 0);
+#endif
+
+  HostTraffic.work_us = opt_work;
+  HostTraffic.print_ms = (INT16U)opt_print;
+
+  OSHostClearStat();
+  MRF24J40_HostClearStat();
+  UnetSnapshot(unet_start);
+  TxPolicySnapshot(tx_policy_start);
+  TxClassSnapshot(tx_class_start);
+  tx_stat_start = *GetUNET_TxStatistics();
+  rx_exhausted_start = GetUNET_RxPoolStatistics()->Exhausted;
+  fwd_stat_start = *GetUNET_FwdStatistics();
+  app_stat_start = *GetUNET_AppStatistics(APP_01);
+  memset(&HostRxDelay, 0, sizeof(HostRxDelay));
+  memset(&HostSendStat, 0, sizeof(HostSendStat));
+  measuring = 1;
+  WorldRun(end);
+
+  // The emulated nodes fall behind the schedule when the air is busy
+  // (retries): the duration is the time they took to send the traffic
+  if (Now() > end) end = Now();
+
+  // Let the reports in flight arrive
+  SleepUntil(Now() + 200000000ULL);
+  measuring = 0;
+
+  Report((double)(end - start) / 1e9);
+  return 0;
+}
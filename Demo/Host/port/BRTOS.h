@@ -0,0 +1,211 @@
+/**********************************************************************************
+@file   BRTOS.h
+@brief  BRTOS API mapped onto POSIX threads for the host (Linux) build of UNET
+@authors: Gustavo Weber Denardin
+          Carlos Henrique Barriquello
+
+Copyright (c) <2009-2013> <Universidade Federal de Santa Maria>
+
+  * Software License Agreement
+  *
+  * The Software is owned by the authors, and is protected under
+  * applicable copyright laws. All rights are reserved.
+  *
+  * The above copyright notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  * THE SOFTWARE.
+*********************************************************************************/
+
+/*
+   Only the subset of the BRTOS API used by the UNET stack is provided.
+   Every task runs in its own pthread, but only the task that owns the
+   "CPU" executes, as on the target: the highest priority ready task runs
+   until it blocks or a higher priority task becomes ready. The tick thread
+   and the radio emulator behave as interrupts (OSHostIsrEnter/OSHostIsrExit):
+   they hold the kernel lock, as does any critical section, and a task
+   preempted by them is stopped with a signal.
+*/
+
+#ifndef BRTOS_H
+#define BRTOS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "BRTOSConfig.h"
+
+/* Processors, as in the BRTOS HAL */
+#define COLDFIRE_V1         1
+#define ARM_Cortex_M0       2
+
+/* The host build uses the Cortex-M0 definitions: both are little endian
+   and GCC allocates bitfields from the least significant bit */
+#define PROCESSOR           ARM_Cortex_M0
+
+/* Data types */
+typedef unsigned char       INT8U;
+typedef signed char         INT8S;
+typedef unsigned short      INT16U;
+typedef signed short        INT16S;
+typedef unsigned int        INT32U;
+typedef signed int          INT32S;
+typedef unsigned long long  INT64U;
+typedef char                CHAR8;
+typedef INT16U              ostick_t;
+typedef INT16U              TIMER_CNT;
+
+#ifndef TRUE
+#define TRUE                1
+#endif
+#ifndef FALSE
+#define FALSE               0
+#endif
+
+/* Return codes */
+#define OK                          (INT8U)0
+#define NO_MEMORY                   (INT8U)1
+#define END_OF_AVAILABLE_PRIORITIES (INT8U)3
+#define BUSY_PRIORITY               (INT8U)4
+#define TIMEOUT                     (INT8U)6
+#define NO_TASK_DELAY               (INT8U)9
+#define END_OF_AVAILABLE_TCB        (INT8U)10
+#define NOT_VALID_TASK_ERR          (INT8U)11
+#define NO_AVAILABLE_EVENT          (INT8U)14
+#define NO_AVAILABLE_MEMORY         (INT8U)15
+#define ALLOC_EVENT_OK              (INT8U)0
+#define ERR_SEM_OVF                 (INT8U)20
+#define ERR_EVENT_OWNER             (INT8U)21
+#define READ_BUFFER_OK              (INT8U)0
+#define WRITE_BUFFER_OK             (INT8U)0
+#define BUFFER_UNDERRUN             (INT8U)30
+#define NO_ENTRY_AVAILABLE          (INT8U)31
+#define CLEAN_BUFFER_OK             (INT8U)0
+
+#define NO_TIMEOUT                  (ostick_t)0
+
+/* Tick counter wraps at this value, as in BRTOS */
+#define TICK_COUNT_OVERFLOW         (ostick_t)64000
+
+/* Mutex types used by the UNET network layer */
+#define BRTOS_MUTEX                 0
+#define NWK_MUTEX_TYPE              BRTOS_MUTEX
+
+/* Critical sections: only accounted, the CPU lock already serializes tasks
+   and "interrupts" */
+#define OS_SR_SAVE_VAR
+#define OSEnterCritical()           OSHostEnterCritical()
+#define OSExitCritical()            OSHostExitCritical()
+#define UserEnterCritical()         OSHostEnterCritical()
+#define UserExitCritical()          OSHostExitCritical()
+
+typedef INT8U BRTOS_TH;
+
+typedef struct _OS_QUEUE
+{
+    INT8U   *OSQStart;
+    INT8U   *OSQEnd;
+    INT8U   *OSQIn;
+    INT8U   *OSQOut;
+    INT16U  OSQSize;
+    INT16U  OSQEntries;
+} OS_QUEUE;
+
+typedef struct _BRTOS_Sem
+{
+    INT8U   OSEventAllocated;
+    INT8U   OSEventCount;
+    INT8U   OSEventWait;
+} BRTOS_Sem;
+
+typedef struct _BRTOS_Mutex
+{
+    INT8U   OSEventAllocated;
+    INT8U   OSEventState;
+    INT8U   OSEventOwner;
+    INT8U   OSMaxPriority;
+    INT8U   OSOriginalPriority;
+    INT8U   OSEventWait;
+} BRTOS_Mutex;
+
+typedef struct _BRTOS_Queue
+{
+    INT8U     OSEventAllocated;
+    OS_QUEUE  *OSEventPointer;
+    INT8U     OSEventWait;
+} BRTOS_Queue;
+
+/* Kernel */
+void   BRTOS_Init(void);
+INT8U  BRTOSStart(void);
+INT8U  InstallTask(void(*FctPtr)(void*), const CHAR8 *TaskName, INT16U USER_STACKED_BYTES,
+                   INT8U iPriority, void *parameters, BRTOS_TH *TaskHandle);
+INT8U  DelayTask(INT16U time_wait);
+ostick_t OSGetTickCount(void);
+ostick_t OSGetCount(void);
+
+/* Semaphores */
+INT8U  OSSemCreate(INT8U cnt, BRTOS_Sem **event);
+INT8U  OSSemPend(BRTOS_Sem *pont_event, ostick_t time_wait);
+INT8U  OSSemPost(BRTOS_Sem *pont_event);
+
+/* Mutexes (priority ceiling) */
+INT8U  OSMutexCreate(BRTOS_Mutex **event, INT8U HigherPriority);
+INT8U  OSMutexAcquire(BRTOS_Mutex *pont_event);
+INT8U  OSMutexRelease(BRTOS_Mutex *pont_event);
+
+/* Byte queues */
+INT8U  OSQueueCreate(OS_QUEUE *cqueue, INT16U size, BRTOS_Queue **event);
+INT8U  OSWQueue(OS_QUEUE *cqueue, INT8U data);
+INT8U  OSRQueue(OS_QUEUE *cqueue, INT8U *pdata);
+INT8U  OSCleanQueue(BRTOS_Queue *pont_event);
+
+#if (TIMER_HOOK_EN == 1)
+void   BRTOS_TimerHook(void);
+#endif
+
+/* Host port services */
+void   OSHostEnterCritical(void);
+void   OSHostExitCritical(void);
+void   OSHostPreemptDisable(void);
+void   OSHostPreemptEnable(void);
+void   OSHostIsrEnter(void);
+void   OSHostIsrExit(void);
+INT64U OSHostCycles(void);
+INT64U OSHostNanoseconds(void);
+void   OSHostBusy(INT32U us);
+
+typedef struct _OS_HOST_STAT
+{
+    INT64U  critical_sections;   // outermost critical sections entered
+    INT64U  critical_cycles;     // cycles spent inside critical sections
+    INT64U  context_switches;    // task switches performed by the scheduler
+    INT64U  ticks;               // system ticks elapsed
+    INT64U  mutex_holds;         // mutex ownerships released
+    INT64U  mutex_hold_ns;       // time from taking to releasing a mutex
+    INT64U  mutex_hold_max_ns;   // longest single ownership
+} OS_HOST_STAT;
+
+typedef struct _OS_HOST_TASK_STAT
+{
+    const CHAR8 *name;
+    INT8U        priority;
+    INT64U       cpu_ns;         // time the task owned the CPU
+    INT64U       dispatches;     // times the task was given the CPU
+    INT64U       blocked_ns;     // time blocked by other tasks: waiting on a mutex or
+                                 // ready while a lower priority task held the CPU
+    INT64U       pends;          // semaphore pends (one per loop of an event driven task)
+    INT64U       critical_sections;  // critical sections entered by the task
+    INT64U       critical_cycles;    // cycles the task spent inside them
+} OS_HOST_TASK_STAT;
+
+void   OSHostGetStat(OS_HOST_STAT *stat);
+INT8U  OSHostGetTaskStat(INT8U task, OS_HOST_TASK_STAT *stat);
+void   OSHostClearStat(void);
+
+#endif
@@ -0,0 +1,12 @@
+/* Host build: the flash memory is an array, initialized erased (0xFF) */
+#ifndef HOST_FLASH_H
+#define HOST_FLASH_H
+
+#include "BRTOS.h"
+
+#define FLASH_SUPPORTED     1
+
+void   HostFlashErase(void);
+INT8U  WriteToFlash(INT8U *data, uintptr_t address, INT32U size);
+
+#endif
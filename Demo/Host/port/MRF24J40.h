@@ -0,0 +1,169 @@
+/**********************************************************************************
+@file   MRF24J40.h
+@brief  MRF24J40 driver interface for the host build (software radio model)
+@authors: Gustavo Weber Denardin
+          Carlos Henrique Barriquello
+
+Copyright (c) <2009-2013> <Universidade Federal de Santa Maria>
+
+  * Software License Agreement
+  *
+  * The Software is owned by the authors, and is protected under
+  * applicable copyright laws. All rights are reserved.
+  *
+  * The above copyright notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  * THE SOFTWARE.
+*********************************************************************************/
+
+#ifndef MRF24J40_H
+#define MRF24J40_H
+
+#include "BRTOS.h"
+#include "BoardConfig.h"
+
+/* Short address registers: read = (reg << 1), write = (reg << 1) | 1 */
+#define READ_RXMCR          0x00
+#define WRITE_RXMCR         0x01
+#define READ_PANIDL         0x02
+#define WRITE_PANIDL        0x03
+#define READ_PANIDH         0x04
+#define WRITE_PANIDH        0x05
+#define READ_SADRL          0x06
+#define WRITE_SADRL         0x07
+#define READ_SADRH          0x08
+#define WRITE_SADRH         0x09
+#define READ_RXFLUSH        0x1A
+#define WRITE_RXFLUSH       0x1B
+#define READ_TXMCR          0x22
+#define WRITE_TXMCR         0x23
+#define READ_TXNMTRIG       0x36
+#define WRITE_TXNMTRIG      0x37
+#define READ_TXSR           0x48
+#define WRITE_TXSR          0x49
+#define READ_FFOEN          0x5E
+#define WRITE_FFOEN         0x5F
+#define READ_ISRSTS         0x62
+#define WRITE_ISRSTS        0x63
+#define READ_INTMSK         0x64
+#define WRITE_INTMSK        0x65
+#define READ_BBREG1         0x72
+#define WRITE_BBREG1        0x73
+#define READ_BBREG6         0x7C
+#define WRITE_BBREG6        0x7D
+
+/* RXMCR bits */
+#define RXMCR_PROMI         0x01
+#define RXMCR_NOACKRSP      0x20
+
+/* Long address RAM */
+#define TX_NORMAL_FIFO      0x000
+#define RX_FIFO             0x300
+
+typedef union _BYTE
+{
+    INT8U Val;
+    struct
+    {
+        INT8U b0:1;
+        INT8U b1:1;
+        INT8U b2:1;
+        INT8U b3:1;
+        INT8U b4:1;
+        INT8U b5:1;
+        INT8U b6:1;
+        INT8U b7:1;
+    } bits;
+} BYTE;
+
+typedef union _MRF24J40_IFREG
+{
+    INT8U Val;
+    struct
+    {
+        INT8U RF_TXIF       :1;
+        INT8U               :2;
+        INT8U RF_RXIF       :1;
+        INT8U SECIF         :1;
+        INT8U               :4;
+    } bits;
+} MRF24J40_IFREG;
+
+/* Driver interface, as used by the UNET stack */
+INT8U PHYGetShortRAMAddr(INT8U address);
+void  PHYSetShortRAMAddr(INT8U address, INT8U value);
+INT8U PHYGetLongRAMAddr(INT16U address);
+void  PHYSetLongRAMAddr(INT16U address, INT8U value);
+/* Burst access to the long address RAM: without MRF24J40_HAS_BURST the
+   stack falls back to one PHYGet/SetLongRAMAddr per byte */
+#define MRF24J40_HAS_BURST
+/* Sequential read of "size" bytes of the long address RAM in a single
+   SPI transaction (the radio increments the address after each byte) */
+void  PHYGetLongRAMBurst(INT16U address, INT8U *data, INT8U size);
+/* Sequential write of "size" bytes to the long address RAM in a single
+   SPI transaction */
+void  PHYSetLongRAMBurst(INT16U address, const INT8U *data, INT8U size);
+
+void  MRF24J40Init(void);
+void  MRF24J40Reset(void);
+void  PHYSetAutoACK(INT8U enable);
+void  PHYSetDeviceAddress(INT16U PANID, INT16U shortAddress);
+void  SetTxPower(INT8U power);
+INT8U GetTxPower(void);
+void  Radio_port_Init(void);
+
+void  MRF24J40_InterruptEnable(void);
+void  MRF24J40_InterruptClear(void);
+
+extern INT8U mac64Address[8];
+
+#define CHANNEL_INIT_VALUE  (INT8U)0x03
+
+
+/* Host side of the radio model */
+
+/* Called when the radio transmits a frame (MPDU without FCS). For frames
+   that request an acknowledgement, returns TRUE if the frame is acked */
+typedef INT8U (*MRF24J40_AIR_TX)(const INT8U *frame, INT8U length);
+
+void  MRF24J40_HostSetAir(MRF24J40_AIR_TX air);
+
+/* Delivers a frame from the air (MPDU without FCS, which the radio adds).
+   Returns MRF24J40_RX_ACCEPTED if the frame was stored in the RX FIFO, and
+   MRF24J40_RX_ACKED too if the radio answered it with an acknowledgement */
+INT8U MRF24J40_HostReceive(const INT8U *frame, INT8U length, INT8U lqi, INT8U rssi);
+
+#define MRF24J40_RX_LOST        (INT8U)0x00
+#define MRF24J40_RX_ACCEPTED    (INT8U)0x01
+#define MRF24J40_RX_ACKED       (INT8U)0x02
+
+/* SPI clock used to charge the bus time of each access (0 = not charged) */
+void  MRF24J40_HostSetSpiClock(INT32U hz);
+
+/* Air time of a frame in microseconds at 250 kbps, with PHY header */
+#define MRF24J40_AIRTIME_US(length)   ((INT32U)((length) + 2 + 6) * 32)
+
+typedef struct _MRF24J40_HOST_STAT
+{
+    INT64U  spi_transactions;    // register/RAM accesses
+    INT64U  spi_bytes;           // bytes clocked on the SPI bus
+    INT64U  rx_frames;           // frames accepted into the RX FIFO
+    INT64U  rx_busy;             // frames lost: RX FIFO not flushed yet
+    INT64U  rx_disabled;         // frames lost: reception disabled
+    INT64U  acks_sent;           // automatic acknowledgements sent
+    INT64U  tx_frames;           // frames transmitted
+    INT64U  tx_failed;           // frames not acknowledged after retries
+    INT64U  tx_airtime_us;       // air time used by transmissions
+} MRF24J40_HOST_STAT;
+
+void  MRF24J40_HostGetStat(MRF24J40_HOST_STAT *stat);
+void  MRF24J40_HostClearStat(void);
+
+#endif
@@ -0,0 +1,10 @@
+/* Host build: the serial port is the standard output */
+#ifndef HOST_UART_H
+#define HOST_UART_H
+
+#include <stdio.h>
+
+#define UARTPutString(base, str)    ((void)(base), (void)fputs((const char *)(str), stdout))
+#define UARTPutChar(base, c)        ((void)(base), (void)putchar((c)))
+
+#endif
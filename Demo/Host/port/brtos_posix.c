@@ -0,0 +1,846 @@
+/**********************************************************************************
+@file   brtos_posix.c
+@brief  BRTOS kernel services on top of POSIX threads (host build)
+@authors: Gustavo Weber Denardin
+          Carlos Henrique Barriquello
+
+Copyright (c) <2009-2013> <Universidade Federal de Santa Maria>
+
+  * Software License Agreement
+  *
+  * The Software is owned by the authors, and is protected under
+  * applicable copyright laws. All rights are reserved.
+  *
+  * The above copyright notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  * THE SOFTWARE.
+*********************************************************************************/
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "BRTOS.h"
+
+#define TASK_FREE       0
+#define TASK_READY      1
+#define TASK_BLOCKED    2
+
+#define WAIT_NONE       0
+#define WAIT_DELAY      1
+#define WAIT_SEM        2
+#define WAIT_MUTEX      3
+
+/* Signal used to stop a task preempted by an interrupt */
+#define PREEMPT_SIGNAL  SIGUSR1
+
+typedef struct _HOST_TCB
+{
+    pthread_t       thread;
+    pthread_cond_t  turn;
+    void            (*entry)(void *);
+    void            *param;
+    const CHAR8     *name;
+    INT8U           priority;
+    INT8U           base_priority;  // priority without the mutex ceiling
+    INT8U           state;
+    INT8U           wait_type;
+    void            *wait_event;
+    ostick_t        timeout;
+    INT8U           wake_status;
+    volatile sig_atomic_t preempt_pending;
+    INT64U          run_start;
+    INT64U          cpu_ns;
+    INT64U          dispatches;
+    INT64U          blocked_ns;     // waiting on a mutex or behind a lower priority task
+    INT64U          pends;          // semaphore pends
+    INT64U          critical_sections;
+    INT64U          critical_cycles;
+} HOST_TCB;
+
+/* Kernel lock: held by interrupts, critical sections and kernel services */
+static pthread_mutex_t  kernel = PTHREAD_MUTEX_INITIALIZER;
+static HOST_TCB         tcb[NUMBER_OF_TASKS + 1];   // index 0 is not used
+static INT8U            installed = 0;
+static HOST_TCB         *current = NULL;            // task that owns the CPU
+static volatile int     started = 0;
+
+static __thread HOST_TCB              *self = NULL;
+static __thread INT32U                held = 0;
+static __thread volatile sig_atomic_t in_kernel = 0;
+static __thread volatile sig_atomic_t no_preempt = 0;
+static __thread INT32U                critical_nesting = 0;
+static __thread INT64U                critical_start = 0;
+
+static BRTOS_Sem        sem_pool[BRTOS_MAX_SEM];
+static BRTOS_Mutex      mutex_pool[BRTOS_MAX_MUTEX];
+static BRTOS_Queue      queue_pool[BRTOS_MAX_QUEUE];
+static INT8U            queue_heap[QUEUE_HEAP_SIZE];
+static INT16U           queue_heap_index = 0;
+
+static volatile ostick_t OSTickCounter = 0;
+
+static OS_HOST_STAT     host_stat;
+static INT64U           mutex_taken[BRTOS_MAX_MUTEX];
+static INT64U           blocked_since = 0;
+
+static void WaitTurn(HOST_TCB *t);
+
+
+/* Time sources */
+INT64U OSHostNanoseconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (INT64U)ts.tv_sec * 1000000000ULL + (INT64U)ts.tv_nsec;
+}
+
+INT64U OSHostCycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (INT64U)__rdtsc();
+#elif defined(__aarch64__)
+    INT64U v;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#else
+    return OSHostNanoseconds();
+#endif
+}
+
+
+/* Scheduler - called with the kernel lock held */
+
+/* Charges the time since the last scheduler event to the tasks that were
+   blocked by other tasks: waiting on a mutex, or ready while a task of lower
+   base priority (raised by a mutex ceiling) owned the CPU. Called before any
+   change of state or of the running task */
+static void BlockedStat(void)
+{
+    INT64U now = OSHostNanoseconds();
+    INT64U elapsed = blocked_since ? (now - blocked_since) : 0;
+    INT8U i;
+
+    blocked_since = now;
+    if (!started || (elapsed == 0)) return;
+
+    for (i = 1; i <= installed; i++)
+    {
+        if (((tcb[i].state == TASK_BLOCKED) && (tcb[i].wait_type == WAIT_MUTEX)) ||
+            ((tcb[i].state == TASK_READY) && (current != NULL) && (current != &tcb[i]) &&
+             (current->base_priority < tcb[i].base_priority)))
+        {
+            tcb[i].blocked_ns += elapsed;
+        }
+    }
+}
+
+static HOST_TCB *HighestReady(void)
+{
+    HOST_TCB *best = NULL;
+    INT8U i;
+
+    for (i = 1; i <= installed; i++)
+    {
+        if (tcb[i].state == TASK_READY)
+        {
+            if ((best == NULL) || (tcb[i].priority > best->priority))
+            {
+                best = &tcb[i];
+            }
+        }
+    }
+    return best;
+}
+
+/* Gives the CPU to the highest priority ready task. A task that was
+   running and is still ready has been preempted by an interrupt */
+static void Dispatch(void)
+{
+    HOST_TCB *next = HighestReady();
+    HOST_TCB *prev = current;
+
+    if (next == prev) return;
+
+    BlockedStat();
+    host_stat.context_switches++;
+    current = next;
+    if (next != NULL)
+    {
+        next->dispatches++;
+        pthread_cond_signal(&next->turn);
+    }
+
+    if ((prev != NULL) && (prev != self) && (prev->state == TASK_READY))
+    {
+        prev->preempt_pending = 1;
+        pthread_kill(prev->thread, PREEMPT_SIGNAL);
+    }
+}
+
+static void WaitTurn(HOST_TCB *t)
+{
+    if (t->run_start)
+    {
+        t->cpu_ns += OSHostNanoseconds() - t->run_start;
+    }
+    while ((current != t) || !started)
+    {
+        pthread_cond_wait(&t->turn, &kernel);
+    }
+    t->run_start = OSHostNanoseconds();
+}
+
+static void KernelLock(void)
+{
+    if (held++ == 0)
+    {
+        in_kernel = 1;
+        pthread_mutex_lock(&kernel);
+    }
+}
+
+static void KernelUnlock(void)
+{
+    if (--held != 0) return;
+
+    if (self == NULL)
+    {
+        // Interrupt return: switch to a higher priority task made ready
+        if (started) Dispatch();
+    }else
+    {
+        self->preempt_pending = 0;
+        if (started && (current != self)) WaitTurn(self);
+    }
+    pthread_mutex_unlock(&kernel);
+    in_kernel = 0;
+
+    // A preemption signalled while the lock was held was ignored
+    if ((self != NULL) && self->preempt_pending && !no_preempt)
+    {
+        pthread_kill(self->thread, PREEMPT_SIGNAL);
+    }
+}
+
+static void PreemptHandler(int sig)
+{
+    (void)sig;
+
+    if ((self == NULL) || in_kernel || no_preempt) return;
+
+    KernelLock();
+    KernelUnlock();
+}
+
+/* Yields the CPU if a higher priority task became ready */
+static void Preempt(void)
+{
+    if (self == NULL) return;      // interrupts switch at exit
+
+    Dispatch();
+    if (current != self) WaitTurn(self);
+}
+
+static INT8U Block(INT8U wait_type, void *event, ostick_t timeout)
+{
+    BlockedStat();
+    self->state       = TASK_BLOCKED;
+    self->wait_type   = wait_type;
+    self->wait_event  = event;
+    self->timeout     = timeout;
+    self->wake_status = OK;
+    Dispatch();
+    WaitTurn(self);
+    return self->wake_status;
+}
+
+static void Wake(HOST_TCB *t, INT8U status)
+{
+    BlockedStat();
+    t->state       = TASK_READY;
+    t->wait_type   = WAIT_NONE;
+    t->wait_event  = NULL;
+    t->timeout     = 0;
+    t->wake_status = status;
+}
+
+static HOST_TCB *HighestWaiting(INT8U wait_type, void *event)
+{
+    HOST_TCB *best = NULL;
+    INT8U i;
+
+    for (i = 1; i <= installed; i++)
+    {
+        if ((tcb[i].state == TASK_BLOCKED) && (tcb[i].wait_type == wait_type) && (tcb[i].wait_event == event))
+        {
+            if ((best == NULL) || (tcb[i].priority > best->priority))
+            {
+                best = &tcb[i];
+            }
+        }
+    }
+    return best;
+}
+
+
+/* Critical sections hold the kernel lock, so they also exclude interrupts */
+void OSHostEnterCritical(void)
+{
+    KernelLock();
+    if (critical_nesting++ == 0)
+    {
+        host_stat.critical_sections++;
+        critical_start = OSHostCycles();
+    }
+}
+
+void OSHostExitCritical(void)
+{
+    if (critical_nesting == 0) return;
+    if (--critical_nesting == 0)
+    {
+        INT64U cycles = OSHostCycles() - critical_start;
+
+        host_stat.critical_cycles += cycles;
+        if (self != NULL)
+        {
+            self->critical_sections++;
+            self->critical_cycles += cycles;
+        }
+    }
+    KernelUnlock();
+}
+
+
+/* Host locks must not be held by a stopped task: a higher priority task
+   waiting for them would never give the CPU back */
+void OSHostPreemptDisable(void)
+{
+    no_preempt++;
+}
+
+void OSHostPreemptEnable(void)
+{
+    if (--no_preempt != 0) return;
+
+    if ((self != NULL) && self->preempt_pending)
+    {
+        pthread_kill(self->thread, PREEMPT_SIGNAL);
+    }
+}
+
+
+/* Interrupt entry and exit, used by the tick and the radio emulator */
+void OSHostIsrEnter(void)
+{
+    KernelLock();
+}
+
+void OSHostIsrExit(void)
+{
+    KernelUnlock();
+}
+
+
+static void *TaskEntry(void *arg)
+{
+    HOST_TCB *t = (HOST_TCB *)arg;
+
+    self = t;
+    KernelLock();
+    WaitTurn(t);
+    KernelUnlock();
+
+    t->entry(t->param);
+
+    // BRTOS tasks never return
+    KernelLock();
+    t->state = TASK_FREE;
+    Dispatch();
+    pthread_mutex_unlock(&kernel);
+    return NULL;
+}
+
+static void *TickThread(void *arg)
+{
+    struct timespec next;
+    INT8U i;
+
+    (void)arg;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    for (;;)
+    {
+        next.tv_nsec += 1000000000L / configTICK_RATE_HZ;
+        if (next.tv_nsec >= 1000000000L)
+        {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        OSHostIsrEnter();
+
+        host_stat.ticks++;
+        if (++OSTickCounter >= TICK_COUNT_OVERFLOW) OSTickCounter = 0;
+
+        for (i = 1; i <= installed; i++)
+        {
+            if ((tcb[i].state == TASK_BLOCKED) && (tcb[i].timeout != 0))
+            {
+                if (--tcb[i].timeout == 0)
+                {
+                    Wake(&tcb[i], (tcb[i].wait_type == WAIT_DELAY) ? OK : TIMEOUT);
+                }
+            }
+        }
+
+#if (TIMER_HOOK_EN == 1)
+        BRTOS_TimerHook();
+#endif
+
+        OSHostIsrExit();
+    }
+    return NULL;
+}
+
+
+/* Kernel */
+void BRTOS_Init(void)
+{
+    struct sigaction sa;
+
+    memset(tcb, 0, sizeof(tcb));
+    memset(&host_stat, 0, sizeof(host_stat));
+    installed = 0;
+    current = NULL;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = PreemptHandler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(PREEMPT_SIGNAL, &sa, NULL);
+}
+
+INT8U InstallTask(void(*FctPtr)(void*), const CHAR8 *TaskName, INT16U USER_STACKED_BYTES,
+                  INT8U iPriority, void *parameters, BRTOS_TH *TaskHandle)
+{
+    HOST_TCB *t;
+    INT8U i;
+
+    (void)USER_STACKED_BYTES;
+
+    if (iPriority >= NUMBER_OF_PRIORITIES) return END_OF_AVAILABLE_PRIORITIES;
+    if (installed >= NUMBER_OF_TASKS) return END_OF_AVAILABLE_TCB;
+
+    KernelLock();
+    for (i = 1; i <= installed; i++)
+    {
+        if (tcb[i].base_priority == iPriority)
+        {
+            KernelUnlock();
+            return BUSY_PRIORITY;
+        }
+    }
+
+    t = &tcb[++installed];
+    t->entry    = FctPtr;
+    t->param    = parameters;
+    t->name     = TaskName;
+    t->priority = iPriority;
+    t->base_priority = iPriority;
+    t->state    = TASK_READY;
+    pthread_cond_init(&t->turn, NULL);
+    if (TaskHandle != NULL) *TaskHandle = installed;
+
+    if (pthread_create(&t->thread, NULL, TaskEntry, t) != 0)
+    {
+        installed--;
+        KernelUnlock();
+        return NO_MEMORY;
+    }
+
+    // A task installed from a running task may preempt it
+    if (started) Preempt();
+    KernelUnlock();
+
+    return OK;
+}
+
+/* Starts the scheduler and the system tick. Unlike the target, it returns
+   so that the host program can keep driving the emulated world */
+INT8U BRTOSStart(void)
+{
+    pthread_t tick;
+
+    KernelLock();
+    started = 1;
+    KernelUnlock();
+
+    if (pthread_create(&tick, NULL, TickThread, NULL) != 0) return NO_MEMORY;
+    return OK;
+}
+
+INT8U DelayTask(INT16U time_wait)
+{
+    if (time_wait == 0) return NO_TASK_DELAY;
+    if (self == NULL) abort();      // cannot block outside a task
+
+    KernelLock();
+    (void)Block(WAIT_DELAY, NULL, time_wait);
+    KernelUnlock();
+    return OK;
+}
+
+/* Keeps the CPU for us microseconds of task time, as a busy loop of the
+   target would. Interrupts and higher priority tasks still preempt the
+   task, and the host thread sleeps instead of spinning */
+void OSHostBusy(INT32U us)
+{
+    struct timespec ts;
+    INT64U target, owned;
+
+    if (self == NULL) abort();      // only a task owns the CPU
+
+    KernelLock();
+    target = self->cpu_ns + (OSHostNanoseconds() - self->run_start) + (INT64U)us * 1000;
+    KernelUnlock();
+
+    for (;;)
+    {
+        KernelLock();
+        owned = self->cpu_ns + (OSHostNanoseconds() - self->run_start);
+        KernelUnlock();
+        if (owned >= target) break;
+
+        ts.tv_sec  = (time_t)((target - owned) / 1000000000ULL);
+        ts.tv_nsec = (long)((target - owned) % 1000000000ULL);
+        (void)nanosleep(&ts, NULL);
+    }
+}
+
+ostick_t OSGetTickCount(void)
+{
+    return OSTickCounter;
+}
+
+ostick_t OSGetCount(void)
+{
+    return OSTickCounter;
+}
+
+
+/* Semaphores */
+INT8U OSSemCreate(INT8U cnt, BRTOS_Sem **event)
+{
+    INT8U i;
+    INT8U ret = NO_AVAILABLE_EVENT;
+
+    KernelLock();
+    for (i = 0; i < BRTOS_MAX_SEM; i++)
+    {
+        if (!sem_pool[i].OSEventAllocated)
+        {
+            sem_pool[i].OSEventAllocated = TRUE;
+            sem_pool[i].OSEventCount     = cnt;
+            sem_pool[i].OSEventWait      = 0;
+            *event = &sem_pool[i];
+            ret = ALLOC_EVENT_OK;
+            break;
+        }
+    }
+    KernelUnlock();
+    return ret;
+}
+
+INT8U OSSemPend(BRTOS_Sem *pont_event, ostick_t time_wait)
+{
+    INT8U status = OK;
+
+    if (self == NULL) abort();
+
+    KernelLock();
+    self->pends++;
+    if (pont_event->OSEventCount > 0)
+    {
+        pont_event->OSEventCount--;
+    }else
+    {
+        pont_event->OSEventWait++;
+        status = Block(WAIT_SEM, pont_event, time_wait);
+        pont_event->OSEventWait--;
+    }
+    KernelUnlock();
+    return status;
+}
+
+INT8U OSSemPost(BRTOS_Sem *pont_event)
+{
+    HOST_TCB *t;
+    INT8U ret = OK;
+
+    KernelLock();
+    t = HighestWaiting(WAIT_SEM, pont_event);
+    if (t != NULL)
+    {
+        Wake(t, OK);
+        Preempt();
+    }else
+    {
+        if (pont_event->OSEventCount == 255)
+        {
+            ret = ERR_SEM_OVF;
+        }else
+        {
+            pont_event->OSEventCount++;
+        }
+    }
+    KernelUnlock();
+    return ret;
+}
+
+
+/* Mutexes with priority ceiling */
+INT8U OSMutexCreate(BRTOS_Mutex **event, INT8U HigherPriority)
+{
+    INT8U i;
+    INT8U ret = NO_AVAILABLE_EVENT;
+
+    KernelLock();
+    for (i = 0; i < BRTOS_MAX_MUTEX; i++)
+    {
+        if (!mutex_pool[i].OSEventAllocated)
+        {
+            memset(&mutex_pool[i], 0, sizeof(BRTOS_Mutex));
+            mutex_pool[i].OSEventAllocated = TRUE;
+            mutex_pool[i].OSEventState     = TRUE;    // available
+            mutex_pool[i].OSMaxPriority    = HigherPriority;
+            *event = &mutex_pool[i];
+            ret = ALLOC_EVENT_OK;
+            break;
+        }
+    }
+    KernelUnlock();
+    return ret;
+}
+
+static void MutexTake(BRTOS_Mutex *m, HOST_TCB *t)
+{
+    m->OSEventState       = FALSE;
+    m->OSEventOwner       = (INT8U)(t - tcb);
+    m->OSOriginalPriority = t->priority;
+    if (m->OSMaxPriority > t->priority) t->priority = m->OSMaxPriority;
+    mutex_taken[m - mutex_pool] = OSHostNanoseconds();
+}
+
+static void MutexHoldStat(BRTOS_Mutex *m)
+{
+    INT64U held = OSHostNanoseconds() - mutex_taken[m - mutex_pool];
+
+    host_stat.mutex_holds++;
+    host_stat.mutex_hold_ns += held;
+    if (held > host_stat.mutex_hold_max_ns) host_stat.mutex_hold_max_ns = held;
+}
+
+INT8U OSMutexAcquire(BRTOS_Mutex *pont_event)
+{
+    if (self == NULL) abort();
+
+    KernelLock();
+    if (pont_event->OSEventState == TRUE)
+    {
+        MutexTake(pont_event, self);
+    }else
+    if (pont_event->OSEventOwner != (INT8U)(self - tcb))
+    {
+        pont_event->OSEventWait++;
+        (void)Block(WAIT_MUTEX, pont_event, NO_TIMEOUT);
+        pont_event->OSEventWait--;
+    }
+    KernelUnlock();
+    return OK;
+}
+
+INT8U OSMutexRelease(BRTOS_Mutex *pont_event)
+{
+    HOST_TCB *t;
+
+    if (self == NULL) return ERR_EVENT_OWNER;
+
+    KernelLock();
+    if ((pont_event->OSEventState == TRUE) || (pont_event->OSEventOwner != (INT8U)(self - tcb)))
+    {
+        KernelUnlock();
+        return ERR_EVENT_OWNER;
+    }
+
+    self->priority = pont_event->OSOriginalPriority;
+    MutexHoldStat(pont_event);
+
+    t = HighestWaiting(WAIT_MUTEX, pont_event);
+    if (t != NULL)
+    {
+        // Ownership is handed to the highest priority waiting task
+        MutexTake(pont_event, t);
+        Wake(t, OK);
+    }else
+    {
+        pont_event->OSEventState = TRUE;
+        pont_event->OSEventOwner = 0;
+    }
+
+    Preempt();
+    KernelUnlock();
+    return OK;
+}
+
+
+/* Byte queues */
+INT8U OSQueueCreate(OS_QUEUE *cqueue, INT16U size, BRTOS_Queue **event)
+{
+    INT8U i;
+    INT8U ret = NO_AVAILABLE_EVENT;
+
+    KernelLock();
+    if ((INT32U)queue_heap_index + size > QUEUE_HEAP_SIZE)
+    {
+        KernelUnlock();
+        return NO_AVAILABLE_MEMORY;
+    }
+
+    for (i = 0; i < BRTOS_MAX_QUEUE; i++)
+    {
+        if (!queue_pool[i].OSEventAllocated)
+        {
+            cqueue->OSQStart   = &queue_heap[queue_heap_index];
+            cqueue->OSQEnd     = &queue_heap[queue_heap_index + size];
+            cqueue->OSQIn      = cqueue->OSQStart;
+            cqueue->OSQOut     = cqueue->OSQStart;
+            cqueue->OSQSize    = size;
+            cqueue->OSQEntries = 0;
+            queue_heap_index   = (INT16U)(queue_heap_index + size);
+
+            queue_pool[i].OSEventAllocated = TRUE;
+            queue_pool[i].OSEventPointer   = cqueue;
+            queue_pool[i].OSEventWait      = 0;
+            *event = &queue_pool[i];
+            ret = ALLOC_EVENT_OK;
+            break;
+        }
+    }
+    KernelUnlock();
+    return ret;
+}
+
+INT8U OSWQueue(OS_QUEUE *cqueue, INT8U data)
+{
+    INT8U ret = WRITE_BUFFER_OK;
+
+    UserEnterCritical();
+    if (cqueue->OSQEntries >= cqueue->OSQSize)
+    {
+        ret = BUFFER_UNDERRUN;
+    }else
+    {
+        *cqueue->OSQIn++ = data;
+        if (cqueue->OSQIn == cqueue->OSQEnd) cqueue->OSQIn = cqueue->OSQStart;
+        cqueue->OSQEntries++;
+    }
+    UserExitCritical();
+    return ret;
+}
+
+INT8U OSRQueue(OS_QUEUE *cqueue, INT8U *pdata)
+{
+    INT8U ret = READ_BUFFER_OK;
+
+    UserEnterCritical();
+    if (cqueue->OSQEntries == 0)
+    {
+        ret = NO_ENTRY_AVAILABLE;
+    }else
+    {
+        *pdata = *cqueue->OSQOut++;
+        if (cqueue->OSQOut == cqueue->OSQEnd) cqueue->OSQOut = cqueue->OSQStart;
+        cqueue->OSQEntries--;
+    }
+    UserExitCritical();
+    return ret;
+}
+
+INT8U OSCleanQueue(BRTOS_Queue *pont_event)
+{
+    OS_QUEUE *cqueue = pont_event->OSEventPointer;
+
+    UserEnterCritical();
+    cqueue->OSQIn      = cqueue->OSQStart;
+    cqueue->OSQOut     = cqueue->OSQStart;
+    cqueue->OSQEntries = 0;
+    UserExitCritical();
+    return CLEAN_BUFFER_OK;
+}
+
+
+/* Host statistics */
+void OSHostGetStat(OS_HOST_STAT *stat)
+{
+    KernelLock();
+    *stat = host_stat;
+    KernelUnlock();
+}
+
+INT8U OSHostGetTaskStat(INT8U task, OS_HOST_TASK_STAT *stat)
+{
+    if ((task == 0) || (task > installed)) return NOT_VALID_TASK_ERR;
+
+    KernelLock();
+    stat->name       = tcb[task].name;
+    stat->priority   = tcb[task].base_priority;
+    stat->cpu_ns     = tcb[task].cpu_ns;
+    if ((current == &tcb[task]) && tcb[task].run_start)
+    {
+        stat->cpu_ns += OSHostNanoseconds() - tcb[task].run_start;
+    }
+    stat->dispatches = tcb[task].dispatches;
+    BlockedStat();
+    stat->blocked_ns = tcb[task].blocked_ns;
+    stat->pends      = tcb[task].pends;
+    stat->critical_sections = tcb[task].critical_sections;
+    stat->critical_cycles   = tcb[task].critical_cycles;
+    KernelUnlock();
+    return OK;
+}
+
+void OSHostClearStat(void)
+{
+    INT8U i;
+
+    KernelLock();
+    memset(&host_stat, 0, sizeof(host_stat));
+    for (i = 1; i <= installed; i++)
+    {
+        tcb[i].cpu_ns = 0;
+        tcb[i].dispatches = 0;
+        tcb[i].blocked_ns = 0;
+        tcb[i].pends = 0;
+        tcb[i].critical_sections = 0;
+        tcb[i].critical_cycles = 0;
+        if (tcb[i].run_start) tcb[i].run_start = OSHostNanoseconds();
+    }
+    KernelUnlock();
+}
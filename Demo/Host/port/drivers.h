@@ -0,0 +1,4 @@
+/* Host build: the radio model is accessed directly, nothing to declare here */
+#ifndef HOST_DRIVERS_H
+#define HOST_DRIVERS_H
+#endif
@@ -0,0 +1,29 @@
+/**********************************************************************************
+@file   flash.c
+@brief  Flash memory emulation for the host (Linux) build of UNET
+*********************************************************************************/
+
+#include <string.h>
+#include "BRTOS.h"
+#include "NetConfig.h"
+#include "FLASH.h"
+
+INT8U HostFlash[HOST_FLASH_SIZE];
+
+void HostFlashErase(void)
+{
+  memset(HostFlash, 0xFF, sizeof(HostFlash));
+}
+
+INT8U WriteToFlash(INT8U *data, uintptr_t address, INT32U size)
+{
+  uintptr_t start = (uintptr_t)HostFlash;
+
+  if ((address < start) || ((address + size) > (start + sizeof(HostFlash))))
+  {
+    return NO_MEMORY;
+  }
+
+  memcpy((INT8U*)address, data, size);
+  return OK;
+}
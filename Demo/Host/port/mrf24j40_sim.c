@@ -0,0 +1,488 @@
+/**********************************************************************************
+@file   mrf24j40_sim.c
+@brief  Software model of the MRF24J40 radio (host build)
+@authors: Gustavo Weber Denardin
+          Carlos Henrique Barriquello
+
+Copyright (c) <2009-2013> <Universidade Federal de Santa Maria>
+
+  * Software License Agreement
+  *
+  * The Software is owned by the authors, and is protected under
+  * applicable copyright laws. All rights are reserved.
+  *
+  * The above copyright notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  * THE SOFTWARE.
+*********************************************************************************/
+
+/*
+   The model keeps the register file and the long address RAM of the radio.
+   It receives in promiscuous mode, holds one frame in the RX FIFO until
+   RXFLUSH, sends automatic acknowledgements and completes transmissions
+   after the frame air time, with up to three retries when an ack was
+   requested. Interrupts post RF_Event, as the INT pin ISR of the target.
+*/
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "BRTOS.h"
+#include "MRF24J40.h"
+#include "NetConfig.h"
+
+#define MRF_SHORT_REGS      64
+#define MRF_LONG_RAM        0x400
+#define MRF_MAX_RETRIES     3
+#define MRF_ACK_WAIT_US     864     // macAckWaitDuration (54 symbols)
+
+/* Short register addresses */
+#define RXMCR               0x00
+#define PANIDL              0x01
+#define PANIDH              0x02
+#define SADRL               0x03
+#define SADRH               0x04
+#define RXFLUSH             0x0D
+#define TXNMTRIG            0x1B
+#define TXSR                0x24
+#define ISRSTS              0x31
+#define BBREG1              0x39
+
+#define ISRSTS_TXNIF        0x01
+#define ISRSTS_RXIF         0x08
+#define BBREG1_RXDECINV     0x04
+#define TXNMTRIG_TXNTRIG    0x01
+#define TXNMTRIG_TXNACKREQ  0x04
+
+INT8U mac64Address[8] = {EUI_0, EUI_1, EUI_2, EUI_3, EUI_4, EUI_5, EUI_6, EUI_7};
+
+/* MAC layer addresses, programmed by MRF24J40Init */
+extern volatile INT16U macPANId;
+extern volatile INT16U macAddr;
+
+/* Posted by the INT pin interrupt, defined by the UNET core */
+extern BRTOS_Sem *RF_Event;
+
+static pthread_mutex_t  radio = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   tx_start = PTHREAD_COND_INITIALIZER;
+static INT8U            reg[MRF_SHORT_REGS];
+static INT8U            ram[MRF_LONG_RAM];
+static INT8U            int_enabled = 0;
+static INT8U            rx_busy = 0;
+static INT8U            tx_request = 0;
+static INT32U           generation = 0;
+static INT8U            started = 0;
+static INT8U            tx_power = 0;
+static INT32U           spi_ns_per_byte = 0;
+static MRF24J40_AIR_TX  air = NULL;
+static MRF24J40_HOST_STAT stat;
+
+
+/* The radio lock is taken by tasks (SPI accesses), which must not be
+   stopped while holding it */
+static void RadioLock(void)
+{
+    OSHostPreemptDisable();
+    pthread_mutex_lock(&radio);
+}
+
+static void RadioUnlock(void)
+{
+    pthread_mutex_unlock(&radio);
+    OSHostPreemptEnable();
+}
+
+static INT16U FrameCheckSequence(const INT8U *data, INT8U length)
+{
+    INT16U crc = 0;
+    INT8U  i;
+
+    while (length--)
+    {
+        crc ^= *data++;
+        for (i = 0; i < 8; i++)
+        {
+            crc = (INT16U)((crc & 1) ? ((crc >> 1) ^ 0x8408) : (crc >> 1));
+        }
+    }
+    return crc;
+}
+
+static void SpiBusTime(INT32U bytes)
+{
+    INT64U end;
+
+    stat.spi_transactions++;
+    stat.spi_bytes += bytes;
+    if (spi_ns_per_byte == 0) return;
+
+    end = OSHostNanoseconds() + (INT64U)bytes * spi_ns_per_byte;
+    while (OSHostNanoseconds() < end) {};
+}
+
+static void SleepMicroseconds(INT32U us)
+{
+    struct timespec ts;
+
+    ts.tv_sec  = us / 1000000;
+    ts.tv_nsec = (long)(us % 1000000) * 1000;
+    nanosleep(&ts, NULL);
+}
+
+/* Raises the INT pin, with the radio lock held. Returns TRUE if the
+   interrupt must be delivered once the lock is released */
+static INT8U RaiseInterrupt(INT8U flags)
+{
+    reg[ISRSTS] |= flags;
+    if (int_enabled)
+    {
+        int_enabled = 0;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static void DeliverInterrupt(void)
+{
+    OSHostIsrEnter();
+    OSSemPost(RF_Event);
+    OSHostIsrExit();
+}
+
+static void *RadioThread(void *arg)
+{
+    INT8U  frame[128];
+    INT8U  length;
+    INT8U  ack_request;
+    INT8U  acked;
+    INT8U  retries;
+    INT8U  irq;
+    INT32U gen;
+    INT32U airtime;
+
+    (void)arg;
+
+    for (;;)
+    {
+        RadioLock();
+        while (!tx_request)
+        {
+            pthread_cond_wait(&tx_start, &radio);
+        }
+        tx_request  = 0;
+        gen         = generation;
+        ack_request = (INT8U)(reg[TXNMTRIG] & TXNMTRIG_TXNACKREQ);
+        length      = ram[1];
+        if (length > 125) length = 125;
+        memcpy(frame, &ram[2], length);
+        RadioUnlock();
+
+        retries = 0;
+        airtime = 0;
+        for (;;)
+        {
+            SleepMicroseconds(MRF24J40_AIRTIME_US(length));
+            airtime += MRF24J40_AIRTIME_US(length);
+            acked = (air != NULL) ? air(frame, length) : FALSE;
+
+            if (!ack_request || acked) break;
+            SleepMicroseconds(MRF_ACK_WAIT_US);
+            if (retries == MRF_MAX_RETRIES) break;
+            retries++;
+        }
+
+        RadioLock();
+        if (gen != generation)
+        {
+            // The radio was reset during the transmission
+            RadioUnlock();
+            continue;
+        }
+        stat.tx_frames++;
+        stat.tx_airtime_us += airtime;
+        reg[TXSR] = (INT8U)(retries << 6);
+        if (ack_request && !acked)
+        {
+            reg[TXSR] |= 0x01;
+            stat.tx_failed++;
+        }
+        irq = RaiseInterrupt(ISRSTS_TXNIF);
+        RadioUnlock();
+
+        if (irq) DeliverInterrupt();
+    }
+    return NULL;
+}
+
+
+/* SPI accesses */
+INT8U PHYGetShortRAMAddr(INT8U address)
+{
+    INT8U r = (INT8U)(address >> 1);
+    INT8U value;
+
+    RadioLock();
+    SpiBusTime(2);
+    value = reg[r & (MRF_SHORT_REGS - 1)];
+    if (r == ISRSTS) reg[ISRSTS] = 0;        // cleared on read
+    RadioUnlock();
+    return value;
+}
+
+void PHYSetShortRAMAddr(INT8U address, INT8U value)
+{
+    INT8U r = (INT8U)((address >> 1) & (MRF_SHORT_REGS - 1));
+
+    RadioLock();
+    SpiBusTime(2);
+    switch (r)
+    {
+        case RXFLUSH:
+            if (value & 0x01) rx_busy = 0;
+            reg[r] = (INT8U)(value & ~0x01);
+            break;
+        case TXNMTRIG:
+            reg[r] = value;
+            if (value & TXNMTRIG_TXNTRIG)
+            {
+                tx_request = 1;
+                pthread_cond_signal(&tx_start);
+            }
+            break;
+        case ISRSTS:
+            break;
+        default:
+            reg[r] = value;
+            break;
+    }
+    RadioUnlock();
+}
+
+INT8U PHYGetLongRAMAddr(INT16U address)
+{
+    INT8U value;
+
+    RadioLock();
+    SpiBusTime(3);
+    value = ram[address & (MRF_LONG_RAM - 1)];
+    RadioUnlock();
+    return value;
+}
+
+void PHYGetLongRAMBurst(INT16U address, INT8U *data, INT8U size)
+{
+    INT8U i;
+
+    RadioLock();
+    SpiBusTime(2 + (INT32U)size);
+    for (i = 0; i < size; i++)
+    {
+        data[i] = ram[(address + i) & (MRF_LONG_RAM - 1)];
+    }
+    RadioUnlock();
+}
+
+void PHYSetLongRAMAddr(INT16U address, INT8U value)
+{
+    RadioLock();
+    SpiBusTime(3);
+    ram[address & (MRF_LONG_RAM - 1)] = value;
+    RadioUnlock();
+}
+
+void PHYSetLongRAMBurst(INT16U address, const INT8U *data, INT8U size)
+{
+    INT8U i;
+
+    RadioLock();
+    SpiBusTime(2 + (INT32U)size);
+    for (i = 0; i < size; i++)
+    {
+        ram[(address + i) & (MRF_LONG_RAM - 1)] = data[i];
+    }
+    RadioUnlock();
+}
+
+
+/* Driver functions */
+void Radio_port_Init(void)
+{
+    if (OSSemCreate(0, &RF_Event) != ALLOC_EVENT_OK)
+    {
+        while(1){};
+    }
+}
+
+void MRF24J40Reset(void)
+{
+    RadioLock();
+    generation++;
+    tx_request   = 0;
+    rx_busy      = 0;
+    reg[ISRSTS]  = 0;
+    reg[TXSR]    = 0;
+    RadioUnlock();
+}
+
+void MRF24J40Init(void)
+{
+    pthread_t thread;
+
+    RadioLock();
+    memset(reg, 0, sizeof(reg));
+    memset(ram, 0, sizeof(ram));
+    reg[RXMCR]  = RXMCR_PROMI;
+    // As the target driver, start with the addresses of the MAC layer
+    reg[PANIDL] = (INT8U)(macPANId & 0xFF);
+    reg[PANIDH] = (INT8U)(macPANId >> 8);
+    reg[SADRL]  = (INT8U)(macAddr & 0xFF);
+    reg[SADRH]  = (INT8U)(macAddr >> 8);
+    rx_busy     = 0;
+    int_enabled = 1;
+    if (!started)
+    {
+        started = 1;
+        pthread_create(&thread, NULL, RadioThread, NULL);
+    }
+    tx_power    = 0;
+    RadioUnlock();
+}
+
+void PHYSetAutoACK(INT8U enable)
+{
+    INT8U value = PHYGetShortRAMAddr(READ_RXMCR);
+
+    if (enable)
+    {
+        value = (INT8U)(value & ~RXMCR_NOACKRSP);
+    }else
+    {
+        value = (INT8U)(value | RXMCR_NOACKRSP);
+    }
+    PHYSetShortRAMAddr(WRITE_RXMCR, value);
+}
+
+void PHYSetDeviceAddress(INT16U PANID, INT16U shortAddress)
+{
+    PHYSetShortRAMAddr(WRITE_PANIDL, (INT8U)(PANID & 0xFF));
+    PHYSetShortRAMAddr(WRITE_PANIDH, (INT8U)(PANID >> 8));
+    PHYSetShortRAMAddr(WRITE_SADRL, (INT8U)(shortAddress & 0xFF));
+    PHYSetShortRAMAddr(WRITE_SADRH, (INT8U)(shortAddress >> 8));
+}
+
+void SetTxPower(INT8U power)
+{
+    tx_power = power;
+}
+
+INT8U GetTxPower(void)
+{
+    return tx_power;
+}
+
+void MRF24J40_InterruptEnable(void)
+{
+    INT8U irq = FALSE;
+
+    RadioLock();
+    int_enabled = 1;
+    if (reg[ISRSTS] != 0)
+    {
+        // Edge left pending while the interrupt was disabled
+        irq = RaiseInterrupt(0);
+    }
+    RadioUnlock();
+
+    if (irq) OSSemPost(RF_Event);
+}
+
+void MRF24J40_InterruptClear(void)
+{
+}
+
+
+/* Host side */
+void MRF24J40_HostSetAir(MRF24J40_AIR_TX tx)
+{
+    air = tx;
+}
+
+void MRF24J40_HostSetSpiClock(INT32U hz)
+{
+    spi_ns_per_byte = (hz != 0) ? (INT32U)((8ULL * 1000000000ULL) / hz) : 0;
+}
+
+INT8U MRF24J40_HostReceive(const INT8U *frame, INT8U length, INT8U lqi, INT8U rssi)
+{
+    INT8U  ret = MRF24J40_RX_LOST;
+    INT8U  irq = FALSE;
+    INT16U fcs;
+    INT16U pan, dst;
+
+    if ((length < 3) || (length > 125)) return MRF24J40_RX_LOST;
+
+    RadioLock();
+    if (reg[BBREG1] & BBREG1_RXDECINV)
+    {
+        stat.rx_disabled++;
+    }else
+    if (rx_busy)
+    {
+        stat.rx_busy++;
+    }else
+    {
+        fcs = FrameCheckSequence(frame, length);
+        ram[RX_FIFO] = (INT8U)(length + 2);
+        memcpy(&ram[RX_FIFO + 1], frame, length);
+        ram[RX_FIFO + 1 + length] = (INT8U)(fcs & 0xFF);
+        ram[RX_FIFO + 2 + length] = (INT8U)(fcs >> 8);
+        ram[RX_FIFO + 3 + length] = lqi;
+        ram[RX_FIFO + 4 + length] = rssi;
+        rx_busy = 1;
+        stat.rx_frames++;
+        ret = MRF24J40_RX_ACCEPTED;
+
+        // Automatic acknowledgement of frames to this short address
+        if ((frame[0] & 0x20) && ((frame[1] & 0x0C) == 0x08) && (length >= 7) &&
+            ((reg[RXMCR] & RXMCR_NOACKRSP) == 0))
+        {
+            pan = (INT16U)(frame[3] | (frame[4] << 8));
+            dst = (INT16U)(frame[5] | (frame[6] << 8));
+            if ((pan == (INT16U)(reg[PANIDL] | (reg[PANIDH] << 8))) &&
+                (dst == (INT16U)(reg[SADRL] | (reg[SADRH] << 8))))
+            {
+                stat.acks_sent++;
+                ret |= MRF24J40_RX_ACKED;
+            }
+        }
+
+        irq = RaiseInterrupt(ISRSTS_RXIF);
+    }
+    RadioUnlock();
+
+    if (irq) DeliverInterrupt();
+    return ret;
+}
+
+void MRF24J40_HostGetStat(MRF24J40_HOST_STAT *s)
+{
+    RadioLock();
+    *s = stat;
+    RadioUnlock();
+}
+
+void MRF24J40_HostClearStat(void)
+{
+    RadioLock();
+    memset(&stat, 0, sizeof(stat));
+    RadioUnlock();
+}
@@ -0,0 +1,4 @@
+/* Host build: the radio model is accessed directly, nothing to declare here */
+#ifndef HOST_SPI_H
+#define HOST_SPI_H
+#endif
@@ -0,0 +1,4 @@
+/* Host build: the radio model is accessed directly, nothing to declare here */
+#ifndef HOST_TIMERS_H
+#define HOST_TIMERS_H
+#endif
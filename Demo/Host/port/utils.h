@@ -0,0 +1,4 @@
+/* Host build: formatting helpers of the target are not used */
+#ifndef HOST_UTILS_H
+#define HOST_UTILS_H
+#endif
@@ -0,0 +1,11 @@
+/* Host build: there are no LEDs, GPIO writes are discarded */
+#ifndef HOST_XGPIO_H
+#define HOST_XGPIO_H
+
+#define GPIOB_BASE                  0
+#define GPIO_PIN_18                 (1UL << 18)
+
+#define GPIOPinSet(base, pin)       ((void)(base), (void)(pin))
+#define GPIOPinReset(base, pin)     ((void)(base), (void)(pin))
+
+#endif
@@ -0,0 +1,4 @@
+/* Host build: driverlib types used by the demo application */
+#ifndef HOST_XHW_TYPES_H
+#define HOST_XHW_TYPES_H
+#endif
@@ -0,0 +1,183 @@
+/*********************************************************************************************************
+*                                               BRTOS
+*                                Brazilian Real-Time Operating System
+*                            Acronymous of Basic Real-Time Operating System
+*
+*                              
+*                                  Open Source RTOS under MIT License
+*
+*
+*
+*                                       OS Tasks - host (Linux) demo
+*
+*
+*   Author:   Gustavo Weber Denardin
+*   Revision: 1.0
+*   Date:     20/03/2009
+*
+*********************************************************************************************************/
+
+
+/* MCU and OS includes */
+#include "BRTOS.h"
+
+/* Config. files */
+#include "BRTOSConfig.h"
+#include "AppConfig.h"
+#include "NetConfig.h"
+#include "BoardConfig.h"
+
+/* Function prototypes */
+#include "unet_api.h"
+#include "app.h"
+#include "tasks.h"
+
+
+HOST_TRAFFIC HostTraffic = {0, HOST_TAG_SIZE, 0, 0};
+HOST_RX_DELAY HostRxDelay = {0, 0, 0};
+HOST_SEND_STAT HostSendStat = {0, 0, 0, 0};
+
+
+/*************************************************/
+/* Task: decode the application profiles         */
+/*************************************************/
+void UNET_App_1_Decode(void *param)
+{
+   INT32U tag;
+   INT32U delay;
+   UNET_APP_MSG msg;
+
+   (void)param;
+
+   /* task main loop */
+   for (;;)
+   {
+      /* Wait message from APP layer: a copy, read with APP_RX_*(&msg) */
+      (void)UNET_AppReceive(APP_01, &msg, 0);
+
+      switch(APP_RX_PROFILE(&msg))
+      {
+        case GENERAL_PROFILE:
+          /* traffic of the harness */
+          if ((APP_RX_COMMAND(&msg) == DEBUG_PKT) && (APP_RX_COMMAND_ATTRIBUTE(&msg) == DEBUG_COUNTER))
+          {
+            tag = (INT32U)(APP_RX_PAYLOAD(&msg)[0] | (APP_RX_PAYLOAD(&msg)[1] << 8) |
+                          (APP_RX_PAYLOAD(&msg)[2] << 16) | ((INT32U)APP_RX_PAYLOAD(&msg)[3] << 24));
+            HostTagDelivered(tag);
+
+            delay = UNET_TicksSince(APP_RX_TIMESTAMP(&msg));
+            HostRxDelay.reports++;
+            HostRxDelay.sum += delay;
+            if (delay > HostRxDelay.max) HostRxDelay.max = delay;
+
+            /* a slow sink: the task keeps the CPU (the radio interrupt still
+               preempts it) without loading the host */
+            if (HostTraffic.work_us)
+            {
+              OSHostBusy(HostTraffic.work_us);
+            }
+
+            /* a report printed on a serial port, as the FRDM-KL25Z demo
+               does: the next messages wait in the mailbox */
+            if (HostTraffic.print_ms)
+            {
+              DelayTask(HostTraffic.print_ms);
+            }
+          }
+          Decode_General_Profile(&msg);
+          break;
+
+        case LIGHTING_PROFILE:
+          Decode_Lighting_Profile(&msg);
+          break;
+
+        case SMART_ENERGY_PROFILE:
+          Decode_SmartEnergy_Profile(&msg);
+          break;
+
+        default:
+          break;
+      }
+   }
+}
+
+
+/*************************************************/
+/* Task: report to the coordinator periodically  */
+/*************************************************/
+void UNET_App_Traffic(void *param)
+{
+   INT8U  j, k;
+   INT8U  status;
+   INT32U tag;
+   INT8U  report[MAX_APP_PAYLOAD_SIZE];
+   UNET_SEND_HANDLE sending[UNET_SEND_POOL_SIZE];
+
+   (void)param;
+
+   for (j = 0; j < UNET_SEND_POOL_SIZE; j++)
+   {
+     sending[j] = UNET_SEND_NONE;
+   }
+
+   for (;;)
+   {
+      if (HostTraffic.period_ms == 0)
+      {
+        DelayTask(100);
+        continue;
+      }
+
+      DelayTask(HostTraffic.period_ms);
+
+      /* results of the reports sent before */
+      for (j = 0; j < UNET_SEND_POOL_SIZE; j++)
+      {
+        if (sending[j] != UNET_SEND_NONE)
+        {
+          status = UNET_SendStatus(sending[j]);
+          if (status != SEND_PENDING)
+          {
+            if (status == OK) HostSendStat.ok++;
+            else HostSendStat.failed++;
+            sending[j] = UNET_SEND_NONE;
+          }
+        }
+      }
+
+      /* wait for a route to the coordinator */
+      if (thisNodeDepth >= ROUTE_TO_BASESTATION_LOST) continue;
+
+      /* the report is built in this task's buffer, without the network guards */
+      tag = HostTagNew();
+
+      j = 0;
+      report[j++] = APP_01;
+      report[j++] = GENERAL_PROFILE;
+      report[j++] = DEBUG_PKT;
+      report[j++] = DEBUG_COUNTER;
+      report[j++] = (INT8U)(tag & 0xFF);
+      report[j++] = (INT8U)((tag >> 8) & 0xFF);
+      report[j++] = (INT8U)((tag >> 16) & 0xFF);
+      report[j++] = (INT8U)(tag >> 24);
+      while ((j < (HostTraffic.size + 4)) && (j < MAX_APP_PAYLOAD_SIZE))
+      {
+        report[j] = j;
+        j++;
+      }
+
+      /* each report in flight holds an entry of the send pool */
+      for (k = 0; k < UNET_SEND_POOL_SIZE; k++)
+      {
+        if (sending[k] == UNET_SEND_NONE) break;
+      }
+
+      if ((k < UNET_SEND_POOL_SIZE) && (UNET_Send(UNET_SEND_TO_BASE, 0, report, j, &sending[k]) == OK))
+      {
+        HostSendStat.sent++;
+      }else
+      {
+        HostSendStat.pool_full++;
+      }
+   }
+}
@@ -0,0 +1,68 @@
+/*********************************************************************************************************
+*                                               BRTOS
+*                                Brazilian Real-Time Operating System
+*                            Acronymous of Basic Real-Time Operating System
+*
+*                              
+*                                  Open Source RTOS under MIT License
+*
+*
+*
+*                                       OS Tasks - host (Linux) demo
+*
+*
+*   Author:   Gustavo Weber Denardin
+*   Revision: 1.0
+*   Date:     20/03/2009
+*
+*********************************************************************************************************/
+
+#ifndef TASKS_H
+#define TASKS_H
+
+#include "BRTOS.h"
+
+void UNET_App_1_Decode(void *param);
+void UNET_App_Traffic(void *param);
+
+/* Application traffic generated by UNET_App_Traffic (router) */
+typedef struct _HOST_TRAFFIC
+{
+  INT16U  period_ms;        // time between reports, 0 = no traffic
+  INT8U   size;             // application data bytes, including the tag
+  INT32U  work_us;          // processing time of each report received (UNET_App_1_Decode)
+  INT16U  print_ms;         // time blocked on output (a UART print) for each report received
+} HOST_TRAFFIC;
+
+extern HOST_TRAFFIC HostTraffic;
+
+/* Ticks from the RX interrupt to the application, for the reports
+   received by UNET_App_1_Decode (APP_RX_TIMESTAMP) */
+typedef struct _HOST_RX_DELAY
+{
+  INT32U  reports;
+  INT32U  sum;
+  INT32U  max;
+} HOST_RX_DELAY;
+
+extern HOST_RX_DELAY HostRxDelay;
+
+/* Results of the reports sent by UNET_App_Traffic, polled with UNET_SendStatus */
+typedef struct _HOST_SEND_STAT
+{
+  INT32U  sent;             // accepted by UNET_Send
+  INT32U  ok;               // acknowledged by the next hop
+  INT32U  failed;           // no route or transmission error
+  INT32U  pool_full;        // no free entry in the send pool
+} HOST_SEND_STAT;
+
+extern HOST_SEND_STAT HostSendStat;
+
+/* Application frames carry a tag in the first bytes of its data,
+   which the harness (main.c) uses to measure latency and losses */
+#define HOST_TAG_SIZE       4
+
+INT32U HostTagNew(void);
+void   HostTagDelivered(INT32U tag);
+
+#endif
@@ -0,0 +1,53 @@
+/**********************************************************************************
+@file   crc.h
+@brief  UNET frame check sequence (CRC-16)
+@authors: Gustavo Weber Denardin
+          Carlos Henrique Barriquello
+
+Copyright (c) <2009-2013> <Universidade Federal de Santa Maria>
+
+  * Software License Agreement
+  *
+  * The Software is owned by the authors, and is protected under 
+  * applicable copyright laws. All rights are reserved.
+  *
+  * The above copyright notice shall be included in
+  * all copies or substantial portions of the Software.
+  *  
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  * THE SOFTWARE. 
+*********************************************************************************/
+
+
+#ifndef UNET_CRC_H
+#define UNET_CRC_H
+
+#include "BRTOS.h"
+#include "NetConfig.h"
+
+/* IEEE 802.15.4 FCS: ITU-T CRC-16, x^16 + x^12 + x^5 + 1, initial value 0.
+   Bits are sent LSB first, so the CRC is computed reflected (poly 0x8408)
+   and no byte needs to be bit reversed. */
+
+/* Implementations, selected by CRC16_METHOD (NetConfig.h) */
+#define CRC16_BY_TABLE    0     // 256 entries table (512 B of flash), one lookup per byte
+#define CRC16_BY_NIBBLE   1     // 16 entries table (32 B of flash), two lookups per byte
+#define CRC16_BY_SLICE4   2     // 4 x 256 entries tables (2 KB of flash), four bytes per step
+
+#ifndef CRC16_METHOD
+#define CRC16_METHOD      CRC16_BY_TABLE
+#endif
+
+/* CRC of a whole buffer */
+INT16U CRC_Compute(const INT8U *buf, INT8U len);
+
+/* CRC computed byte by byte: CRC_Get returns the result and restarts it */
+void   CRC_Update(INT8U data);
+INT16U CRC_Get(void);
+
+#endif
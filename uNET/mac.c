@@ -30,9 +30,7 @@ Copyright (c) <2009-2013> <Universidade Federal de Santa Maria>
 #include "NetConfig.h"
 #include <stdlib.h>
 
-extern BRTOS_Sem   *RF_TX_Event;
 extern BRTOS_Sem   *MAC_Event;
-extern BRTOS_Queue *RF;
 
 #if (!defined MAC16_MEM_ADDRESS) || (!defined PANID_MEM_ADDRESS)
 #error "Please define 'MAC16_MEM_ADDRESS' and 'PANID_MEM_ADDRESS'"
@@ -72,9 +70,9 @@ volatile INT8U          AssociateAddress[8];
 volatile INT8U          SequenceNumber = 0x80; 
 
 /* Um pacote  composto por um mac frame control 
-em conjunto com o unet packet */
+em conjunto com a viso do frame recebido */
 volatile MAC_FRAME_CONTROL mac_frame_control;
-volatile UNET_PACKET       unet_packet;
+MAC_FRAME_VIEW             *mac_frame;         // pacote do frame sendo decodificado pela tarefa UNET_MAC
 
 /* O vetor unet_beacon guarda uma quantidade "BeaconLimit"
 de beacons durante o active scan de um canal  */
@@ -84,86 +82,594 @@ volatile INT8U             BeaconCnt = 0;
 // Flags de indicao de tarefas pendentes pela camada MAC
 volatile MAC_TASKS_PENDING mac_tasks_pending;
 
-/* Frame CRC check */
-static INT16U FrameCRC = 0;    
-
-const INT16U ccitt_crc16_table[256] = {
-    0x0000,  0x1021,  0x2042,  0x3063,  0x4084,  0x50a5,  0x60c6,  0x70e7,
-    0x8108,  0x9129,  0xa14a,  0xb16b,  0xc18c,  0xd1ad,  0xe1ce,  0xf1ef,
-    0x1231,  0x0210,  0x3273,  0x2252,  0x52b5,  0x4294,  0x72f7,  0x62d6,
-    0x9339,  0x8318,  0xb37b,  0xa35a,  0xd3bd,  0xc39c,  0xf3ff,  0xe3de,
-    0x2462,  0x3443,  0x0420,  0x1401,  0x64e6,  0x74c7,  0x44a4,  0x5485,
-    0xa56a,  0xb54b,  0x8528,  0x9509,  0xe5ee,  0xf5cf,  0xc5ac,  0xd58d,
-    0x3653,  0x2672,  0x1611,  0x0630,  0x76d7,  0x66f6,  0x5695,  0x46b4,
-    0xb75b,  0xa77a,  0x9719,  0x8738,  0xf7df,  0xe7fe,  0xd79d,  0xc7bc,
-    0x48c4,  0x58e5,  0x6886,  0x78a7,  0x0840,  0x1861,  0x2802,  0x3823,
-    0xc9cc,  0xd9ed,  0xe98e,  0xf9af,  0x8948,  0x9969,  0xa90a,  0xb92b,
-    0x5af5,  0x4ad4,  0x7ab7,  0x6a96,  0x1a71,  0x0a50,  0x3a33,  0x2a12,
-    0xdbfd,  0xcbdc,  0xfbbf,  0xeb9e,  0x9b79,  0x8b58,  0xbb3b,  0xab1a,
-    0x6ca6,  0x7c87,  0x4ce4,  0x5cc5,  0x2c22,  0x3c03,  0x0c60,  0x1c41,
-    0xedae,  0xfd8f,  0xcdec,  0xddcd,  0xad2a,  0xbd0b,  0x8d68,  0x9d49,
-    0x7e97,  0x6eb6,  0x5ed5,  0x4ef4,  0x3e13,  0x2e32,  0x1e51,  0x0e70,
-    0xff9f,  0xefbe,  0xdfdd,  0xcffc,  0xbf1b,  0xaf3a,  0x9f59,  0x8f78,
-    0x9188,  0x81a9,  0xb1ca,  0xa1eb,  0xd10c,  0xc12d,  0xf14e,  0xe16f,
-    0x1080,  0x00a1,  0x30c2,  0x20e3,  0x5004,  0x4025,  0x7046,  0x6067,
-    0x83b9,  0x9398,  0xa3fb,  0xb3da,  0xc33d,  0xd31c,  0xe37f,  0xf35e,
-    0x02b1,  0x1290,  0x22f3,  0x32d2,  0x4235,  0x5214,  0x6277,  0x7256,
-    0xb5ea,  0xa5cb,  0x95a8,  0x8589,  0xf56e,  0xe54f,  0xd52c,  0xc50d,
-    0x34e2,  0x24c3,  0x14a0,  0x0481,  0x7466,  0x6447,  0x5424,  0x4405,
-    0xa7db,  0xb7fa,  0x8799,  0x97b8,  0xe75f,  0xf77e,  0xc71d,  0xd73c,
-    0x26d3,  0x36f2,  0x0691,  0x16b0,  0x6657,  0x7676,  0x4615,  0x5634,
-    0xd94c,  0xc96d,  0xf90e,  0xe92f,  0x99c8,  0x89e9,  0xb98a,  0xa9ab,
-    0x5844,  0x4865,  0x7806,  0x6827,  0x18c0,  0x08e1,  0x3882,  0x28a3,
-    0xcb7d,  0xdb5c,  0xeb3f,  0xfb1e,  0x8bf9,  0x9bd8,  0xabbb,  0xbb9a,
-    0x4a75,  0x5a54,  0x6a37,  0x7a16,  0x0af1,  0x1ad0,  0x2ab3,  0x3a92,
-    0xfd2e,  0xed0f,  0xdd6c,  0xcd4d,  0xbdaa,  0xad8b,  0x9de8,  0x8dc9,
-    0x7c26,  0x6c07,  0x5c64,  0x4c45,  0x3ca2,  0x2c83,  0x1ce0,  0x0cc1,
-    0xef1f,  0xff3e,  0xcf5d,  0xdf7c,  0xaf9b,  0xbfba,  0x8fd9,  0x9ff8,
-    0x6e17,  0x7e36,  0x4e55,  0x5e74,  0x2e93,  0x3eb2,  0x0ed1,  0x1ef0
-};
+/* Imagem da TX normal FIFO do rdio, indexada pelo endereo da long RAM
+(0x000 = tamanho do header, 0x001 = tamanho do frame, 0x002.. = frame).
+Os frames so montados aqui com a guarda NWK_LOCK_TX e copiados para uma
+requisio da fila de transmisso por MAC_TxRequest */
+INT8U                      mac_tx_fifo[2 + MAX_PHY_PACKETSIZE];
+
+void MAC_TxFrame(INT8U HeaderSize, INT8U FrameSize)
+{
+    mac_tx_fifo[0] = HeaderSize;
+    mac_tx_fifo[1] = FrameSize;
+}
 
-#define BY_LUT 0
-#define BY_FUN 1
-  
-#define  REVERSE_BYTE   BY_FUN
 
-#ifndef REVERSE_BYTE
-  #error "REVERSE_BYTE method must be defined!"
+/* Fila de transmisso da tarefa UNET_TX */
+#define MAC_TX_FREE          (INT8U)0
+#define MAC_TX_ALLOCATED     (INT8U)1
+#define MAC_TX_QUEUED        (INT8U)2
+#define MAC_TX_ACTIVE        (INT8U)3
+
+static MAC_TX_REQUEST      mac_tx_queue[TX_QUEUE_SIZE];
+static INT16U              mac_tx_ticket = 0;
+static BRTOS_Sem          *TX_Queue_Event;
+static BRTOS_Sem          *TX_Wait_Event;
+static volatile INT8U      mac_tx_wait_status;
+
+/* Polticas de retransmisso, indexadas por MAC_TX_SINGLE, MAC_TX_ROUTE, ...
+   Com o ContikiMAC as rotas repetem a transmisso durante uma janela, sem backoff */
+#if (CONTIKI_MAC_ENABLE == 1)
+#define MAC_TX_WINDOW(w)     (INT16U)(w)
+#else
+#define MAC_TX_WINDOW(w)     (INT16U)0
 #endif
 
-#if (REVERSE_BYTE == BY_LUT)
-const INT8U rev_bitorder_table[256] = 
+static const MAC_TX_POLICY mac_tx_policy[MAC_TX_POLICIES] =
 {
-    0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0, 0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0,
-    0x08, 0x88, 0x48, 0xc8, 0x28, 0xa8, 0x68, 0xe8, 0x18, 0x98, 0x58, 0xd8, 0x38, 0xb8, 0x78, 0xf8,
-    0x04, 0x84, 0x44, 0xc4, 0x24, 0xa4, 0x64, 0xe4, 0x14, 0x94, 0x54, 0xd4, 0x34, 0xb4, 0x74, 0xf4,
-    0x0c, 0x8c, 0x4c, 0xcc, 0x2c, 0xac, 0x6c, 0xec, 0x1c, 0x9c, 0x5c, 0xdc, 0x3c, 0xbc, 0x7c, 0xfc,
-    0x02, 0x82, 0x42, 0xc2, 0x22, 0xa2, 0x62, 0xe2, 0x12, 0x92, 0x52, 0xd2, 0x32, 0xb2, 0x72, 0xf2,
-    0x0a, 0x8a, 0x4a, 0xca, 0x2a, 0xaa, 0x6a, 0xea, 0x1a, 0x9a, 0x5a, 0xda, 0x3a, 0xba, 0x7a, 0xfa,
-    0x06, 0x86, 0x46, 0xc6, 0x26, 0xa6, 0x66, 0xe6, 0x16, 0x96, 0x56, 0xd6, 0x36, 0xb6, 0x76, 0xf6,
-    0x0e, 0x8e, 0x4e, 0xce, 0x2e, 0xae, 0x6e, 0xee, 0x1e, 0x9e, 0x5e, 0xde, 0x3e, 0xbe, 0x7e, 0xfe,
-    0x01, 0x81, 0x41, 0xc1, 0x21, 0xa1, 0x61, 0xe1, 0x11, 0x91, 0x51, 0xd1, 0x31, 0xb1, 0x71, 0xf1,
-    0x09, 0x89, 0x49, 0xc9, 0x29, 0xa9, 0x69, 0xe9, 0x19, 0x99, 0x59, 0xd9, 0x39, 0xb9, 0x79, 0xf9,
-    0x05, 0x85, 0x45, 0xc5, 0x25, 0xa5, 0x65, 0xe5, 0x15, 0x95, 0x55, 0xd5, 0x35, 0xb5, 0x75, 0xf5,
-    0x0d, 0x8d, 0x4d, 0xcd, 0x2d, 0xad, 0x6d, 0xed, 0x1d, 0x9d, 0x5d, 0xdd, 0x3d, 0xbd, 0x7d, 0xfd,
-    0x03, 0x83, 0x43, 0xc3, 0x23, 0xa3, 0x63, 0xe3, 0x13, 0x93, 0x53, 0xd3, 0x33, 0xb3, 0x73, 0xf3,
-    0x0b, 0x8b, 0x4b, 0xcb, 0x2b, 0xab, 0x6b, 0xeb, 0x1b, 0x9b, 0x5b, 0xdb, 0x3b, 0xbb, 0x7b, 0xfb,
-    0x07, 0x87, 0x47, 0xc7, 0x27, 0xa7, 0x67, 0xe7, 0x17, 0x97, 0x57, 0xd7, 0x37, 0xb7, 0x77, 0xf7,
-    0x0f, 0x8f, 0x4f, 0xcf, 0x2f, 0xaf, 0x6f, 0xef, 0x1f, 0x9f, 0x5f, 0xdf, 0x3f, 0xbf, 0x7f, 0xff,
+  {1,                            0,                                        TX_BACKOFF_MIN, TX_BACKOFF_MAX},
+  {(INT8U)(NWK_TX_RETRIES-1),    MAC_TX_WINDOW(CONTIKI_MAC_WINDOW+5),      TX_BACKOFF_MIN, TX_BACKOFF_MAX},
+  {(INT8U)(NWK_TX_RETRIES-1),    MAC_TX_WINDOW((CONTIKI_MAC_WINDOW*2)+10), TX_BACKOFF_MIN, TX_BACKOFF_MAX},
+  {(INT8U)(NWK_TX_RETRIES-1),    0,                                        TX_BACKOFF_MIN, TX_BACKOFF_MAX},
+  {(INT8U)(NWK_TX_RETRIES+1),    0,                                        TX_BACKOFF_MIN, TX_BACKOFF_MAX},
 };
-#endif
 
-#if (REVERSE_BYTE == BY_FUN)
+static MAC_TX_POLICY_STAT  mac_tx_policy_stat[MAC_TX_POLICIES];
+static MAC_TX_CLASS_STAT   mac_tx_class_stat[MAC_TX_CLASSES];
 
-/* Reverse order byte */
-INT8U ReverseByte(INT8U);
+/* Falhas consecutivas das ltimas transmisses com ACK para cada destino.
+   Acessada somente pela tarefa UNET_TX */
+typedef struct
+{
+  INT16U Addr;
+  INT8U  Failures;
+} MAC_TX_DEST;
+
+static MAC_TX_DEST         mac_tx_dest[TX_DEST_MEMORY_SIZE];
 
-INT8U ReverseByte(INT8U b){
+void MAC_TxInit(void)
+{
+  INT8U i;
+  
+  for(i=0;i<TX_QUEUE_SIZE;i++)
+  {
+    mac_tx_queue[i].State = MAC_TX_FREE;
+  }
+  
+  for(i=0;i<TX_DEST_MEMORY_SIZE;i++)
+  {
+    mac_tx_dest[i].Addr     = 0xFFFF;
+    mac_tx_dest[i].Failures = 0;
+  }
+  
+  if ((INT8U)OSSemCreate(0,&TX_Queue_Event) != ALLOC_EVENT_OK)
+  {
+    while(1){};
+  }
+  
+  if ((INT8U)OSSemCreate(0,&TX_Wait_Event) != ALLOC_EVENT_OK)
+  {
+    while(1){};
+  }
+}
+
+// Verifica se MAC_TxRequest encontraria uma requisio livre para a classe.
+// No reserva a requisio: outra tarefa pode ocup-la antes do MAC_TxRequest
+INT8U MAC_TxFree(INT8U Class)
+{
+  INT8U i;
+  INT8U free = FALSE;
+  
+  UserEnterCritical();
+  if ((Class != MAC_TX_CLASS_APP) || (mac_tx_class_stat[Class].Depth < TX_QUEUE_APP_SLOTS))
+  {
+    for(i=0;i<TX_QUEUE_SIZE;i++)
+    {
+      if (mac_tx_queue[i].State == MAC_TX_FREE)
+      {
+        free = TRUE;
+        break;
+      }
+    }
+  }
+  UserExitCritical();
+  
+  return free;
+}
 
-    return   b = (INT8U)(((b * 0x0802LU & 0x22110LU) | (b * 0x8020LU & 0x88440LU)) * 0x10101LU >> 16); 
+// Copia o frame montado em mac_tx_fifo para uma requisio livre.
+// Chamada com NWK_LOCK_TX: no espera por uma requisio livre, pois a
+// tarefa UNET_TX precisa da guarda para esvaziar a fila. Retorna NULL se a fila estiver
+// cheia, ou se a classe MAC_TX_CLASS_APP j ocupa TX_QUEUE_APP_SLOTS requisies
+MAC_TX_REQUEST *MAC_TxRequest(INT8U Trigger, INT8U Policy, INT8U Class, MAC_TX_CALLBACK Callback)
+{
+  INT8U i;
+  INT8U size;
+  MAC_TX_REQUEST *request = NULL;
+  MAC_TX_CLASS_STAT *stat = &mac_tx_class_stat[Class];
+  
+  UserEnterCritical();
+  if ((Class != MAC_TX_CLASS_APP) || (stat->Depth < TX_QUEUE_APP_SLOTS))
+  {
+    for(i=0;i<TX_QUEUE_SIZE;i++)
+    {
+      if (mac_tx_queue[i].State == MAC_TX_FREE)
+      {
+        mac_tx_queue[i].State = MAC_TX_ALLOCATED;
+        request = &mac_tx_queue[i];
+        if (++stat->Depth > stat->DepthMax)
+        {
+          stat->DepthMax = stat->Depth;
+        }
+        break;
+      }
+    }
+  }
+  if (request == NULL)
+  {
+    stat->Rejected++;
+  }
+  UserExitCritical();
+  
+  if (request == NULL)
+  {
+    return NULL;
+  }
+  
+  size = (INT8U)(2 + mac_tx_fifo[1]);
+  for(i=0;i<size;i++)
+  {
+    request->Fifo[i] = mac_tx_fifo[i];
+  }
+  
+  request->Trigger  = Trigger;
+  request->Policy   = Policy;
+  request->Class    = Class;
+  request->Node     = 0;
+  request->Wake     = FALSE;
+  request->Send     = 0;
+  request->Arg      = 0;
+  request->Backoff  = 0;
+  request->Start    = OSGetTickCount();
+  request->Callback = Callback;
+  MAC_TxRetry(request);
+  
+  return request;
+}
 
+// Atribui  requisio as tentativas da sua poltica
+// (usada tambm pelos callbacks para reenviar o frame, ex.: para outro vizinho)
+void MAC_TxRetry(MAC_TX_REQUEST *request)
+{
+  request->Attempts = mac_tx_policy[request->Policy].Attempts;
+  request->Failures = 0;
 }
+
+// Coloca a requisio na fila. A ordem de transmisso  a das classes e, em cada
+// classe, a de submisso, exceto pelas requisies em backoff, que deixam as seguintes passarem
+void MAC_TxSubmit(MAC_TX_REQUEST *request)
+{
+  ostick_t now = OSGetTickCount();
+  
+  UserEnterCritical();
+  request->Submitted    = now;
+  request->BackoffStart = now;
+  request->Ticket       = mac_tx_ticket++;
+  request->State        = MAC_TX_QUEUED;
+  UserExitCritical();
+  
+  OSSemPost(TX_Queue_Event);
+}
+
+// Ticks entre start e now, com o tick count dando a volta em TICK_COUNT_OVERFLOW
+static ostick_t MAC_TxElapsed(ostick_t now, ostick_t start)
+{
+  if (now >= start)
+  {
+    return (ostick_t)(now - start);
+  }
+  return (ostick_t)(now + (TICK_COUNT_OVERFLOW - start));
+}
+
+// Usada somente pela tarefa UNET_TX: espera pela requisio que no esteja em backoff
+// da classe de maior prioridade, a mais antiga da classe. Uma requisio que espera h
+// TX_CLASS_MAX_WAIT ticks ou mais passa  frente das demais classes
+MAC_TX_REQUEST *MAC_TxNext(void)
+{
+  INT8U i;
+  INT8U rank;
+  INT8U best;
+  INT16U age;
+  INT16U oldest;
+  ostick_t now;
+  ostick_t elapsed;
+  ostick_t wait;
+  ostick_t queued;
+  ostick_t request_queued;
+  MAC_TX_REQUEST *request;
+  MAC_TX_CLASS_STAT *stat;
+  
+  for(;;)
+  {
+    now     = OSGetTickCount();
+    request = NULL;
+    oldest  = 0;
+    best    = 0;
+    wait    = 0;               // 0: sem timeout
+    request_queued = 0;
+    
+    UserEnterCritical();
+    for(i=0;i<TX_QUEUE_SIZE;i++)
+    {
+      if (mac_tx_queue[i].State == MAC_TX_QUEUED)
+      {
+        elapsed = MAC_TxElapsed(now, mac_tx_queue[i].BackoffStart);
+        if (elapsed >= mac_tx_queue[i].Backoff)
+        {
+          // Espera na fila, fora do backoff
+          queued = (ostick_t)(elapsed - mac_tx_queue[i].Backoff);
+          rank   = (queued >= TX_CLASS_MAX_WAIT) ? (INT8U)0 : (INT8U)(mac_tx_queue[i].Class + 1);
+          age    = (INT16U)(mac_tx_ticket - mac_tx_queue[i].Ticket);
+          if ((request == NULL) || (rank < best) || ((rank == best) && (age > oldest)))
+          {
+            request = &mac_tx_queue[i];
+            best    = rank;
+            oldest  = age;
+            request_queued = queued;
+          }
+        }else
+        {
+          // Tempo restante do menor backoff
+          if ((wait == 0) || ((ostick_t)(mac_tx_queue[i].Backoff - elapsed) < wait))
+          {
+            wait = (ostick_t)(mac_tx_queue[i].Backoff - elapsed);
+          }
+        }
+      }
+    }
+    if (request != NULL)
+    {
+      request->State = MAC_TX_ACTIVE;
+    }
+    UserExitCritical();
+    
+    if (request != NULL)
+    {
+      stat = &mac_tx_class_stat[request->Class];
+      stat->Transmissions++;
+      stat->WaitSum += request_queued;
+      if (request_queued > stat->WaitMax)
+      {
+        stat->WaitMax = (INT16U)request_queued;
+      }
+      if ((best == 0) && (request->Class != MAC_TX_CLASS_ROUTE))
+      {
+        stat->Promoted++;
+      }
+    }
+    
+    if (request != NULL)
+    {
+      return request;
+    }
+    
+    // Acorda com uma nova submisso ou com o fim do menor backoff
+    (void)OSSemPend(TX_Queue_Event,wait);
+  }
+}
+
+// Memria de falhas do destino de um frame com pedido de ACK e endereo curto.
+// Retorna NULL para os demais frames. Com alloc, um destino desconhecido
+// ocupa a entrada com menos falhas
+static MAC_TX_DEST *MAC_TxDest(MAC_TX_REQUEST *request, INT8U alloc)
+{
+  INT8U i;
+  INT16U addr;
+  MAC_TX_DEST *dest = NULL;
+  
+  if ((request->Trigger != MAC_TX_ACK) || (((request->Fifo[3] >> 2) & 0x03) != 0x02))
+  {
+    return NULL;
+  }
+  
+  addr = (INT16U)(request->Fifo[7] | (request->Fifo[8] << 8));
+  if (addr == 0xFFFF)
+  {
+    return NULL;
+  }
+  
+  for(i=0;i<TX_DEST_MEMORY_SIZE;i++)
+  {
+    if (mac_tx_dest[i].Addr == addr)
+    {
+      return &mac_tx_dest[i];
+    }
+    if ((dest == NULL) || (mac_tx_dest[i].Failures < dest->Failures))
+    {
+      dest = &mac_tx_dest[i];
+    }
+  }
+  
+  if ((alloc == FALSE) || (dest == NULL))
+  {
+    return NULL;
+  }
+  
+  dest->Addr     = addr;
+  dest->Failures = 0;
+  return dest;
+}
+
+// Backoff exponencial binrio: janela de BackoffMin << (falhas-1) ticks, limitada a
+// BackoffMax, sorteado entre a metade e o total da janela (RadioRand: 0 a 34)
+static INT16U MAC_TxBackoff(const MAC_TX_POLICY *policy, INT8U failures)
+{
+  INT16U window = policy->BackoffMin;
+  
+  while ((failures > 1) && (window < policy->BackoffMax))
+  {
+    window = (INT16U)(window << 1);
+    failures--;
+  }
+  
+  if (window > policy->BackoffMax)
+  {
+    window = policy->BackoffMax;
+  }
+  
+  return (INT16U)((window / 2) + (((INT32U)(window / 2) * RadioRand()) / 34));
+}
+
+// Resultado de uma transmisso da requisio ativa (tarefa UNET_TX, com NWK_LOCK_NEIGHBOR e NWK_LOCK_TX).
+// Repete a transmisso conforme a poltica da requisio e depois chama o callback,
+// que pode chamar MAC_TxRetry para reenviar o frame
+void MAC_TxDone(MAC_TX_REQUEST *request, INT8U status)
+{
+  INT8U retry = FALSE;
+  INT8U failures;
+  ostick_t now = OSGetTickCount();
+  ostick_t latency;
+  const MAC_TX_POLICY *policy = &mac_tx_policy[request->Policy];
+  MAC_TX_POLICY_STAT *stat = &mac_tx_policy_stat[request->Policy];
+  MAC_TX_DEST *dest;
+  
+  stat->Transmissions++;
+  
+  if (status == OK)
+  {
+    dest = MAC_TxDest(request, FALSE);
+    if (dest != NULL)
+    {
+      dest->Failures = 0;
+    }
+  }else
+  {
+    if (policy->Window != 0)
+    {
+      if (MAC_TxElapsed(now, request->Submitted) < policy->Window)
+      {
+        retry = TRUE;
+      }
+    }else
+    {
+      if (request->Attempts > 1)
+      {
+        retry = TRUE;
+      }
+    }
+    
+    // Espera o backoff antes de nova transmisso. Se o rdio travou (sem RF_TXIF)
+    // ele j foi reiniciado, repete sem esperar
+    request->Backoff = 0;
+    if (status == TX_NO_ACK_ERROR)
+    {
+      if (request->Failures < 0xFF)
+      {
+        request->Failures++;
+      }
+      failures = request->Failures;
+      
+      dest = MAC_TxDest(request, TRUE);
+      if (dest != NULL)
+      {
+        if (dest->Failures < 0xFF)
+        {
+          dest->Failures++;
+        }
+        if (dest->Failures > failures)
+        {
+          failures = dest->Failures;
+        }
+      }
+#if (CONTIKI_MAC_ENABLE != 1)
+      request->Backoff = MAC_TxBackoff(policy, failures);
 #endif
+    }
+  }
+  
+  if (retry == TRUE)
+  {
+    UserEnterCritical();
+    if (policy->Window == 0)
+    {
+      request->Attempts--;
+    }
+    request->BackoffStart = now;
+    request->State        = MAC_TX_QUEUED;
+    UserExitCritical();
+    return;
+  }
+  
+  request->Attempts = 0;
+  if (request->Callback != NULL)
+  {
+    request->Callback(request, status);
+  }
+  
+  if (request->Attempts != 0)
+  {
+    // O callback pediu o reenvio (ex.: outro vizinho)
+    MAC_TxSubmit(request);
+  }else
+  {
+    latency = MAC_TxElapsed(now, request->Start);
+    stat->Requests++;
+    if (status == OK)
+    {
+      stat->Success++;
+    }
+    stat->LatencySum += latency;
+    if (latency > stat->LatencyMax)
+    {
+      stat->LatencyMax = (INT16U)latency;
+    }
+    
+    UserEnterCritical();
+    request->State = MAC_TX_FREE;
+    mac_tx_class_stat[request->Class].Depth--;
+    UserExitCritical();
+  }
+}
+
+// Contadores da poltica, para ajuste de TX_BACKOFF_MIN/MAX e das tentativas
+const MAC_TX_POLICY_STAT *MAC_TxPolicyStat(INT8U Policy)
+{
+  return &mac_tx_policy_stat[Policy];
+}
+
+// Ocupao da fila e espera de cada classe, para ajuste de TX_QUEUE_APP_SLOTS e TX_CLASS_MAX_WAIT
+const MAC_TX_CLASS_STAT *MAC_TxClassStat(INT8U Class)
+{
+  return &mac_tx_class_stat[Class];
+}
+
+static void MAC_TxWaitDone(MAC_TX_REQUEST *request, INT8U status)
+{
+  (void)request;
+  mac_tx_wait_status = status;
+  OSSemPost(TX_Wait_Event);
+}
+
+// Transmite o frame montado em mac_tx_fifo e espera o resultado.
+// Chamada com NWK_LOCK_TX, que  liberada durante a espera
+// (somente pela associao, que no tem outra transmisso pendente)
+INT8U MAC_TxSendWait(INT8U Trigger)
+{
+  MAC_TX_REQUEST *request;
+  
+  request = MAC_TxRequest(Trigger, MAC_TX_SINGLE, MAC_TX_CLASS_CONTROL, MAC_TxWaitDone);
+  if (request == NULL)
+  {
+    return TX_QUEUE_FULL;
+  }
+  MAC_TxSubmit(request);
+  
+  NWK_Unlock(NWK_LOCK_TX);
+  (void)OSSemPend(TX_Wait_Event,0);
+  NWK_Lock(NWK_LOCK_TX);
+  
+  return mac_tx_wait_status;
+}
+
+// Decodifica o cabealho IEEE 802.15.4 diretamente sobre o slot do buffer de recepo.
+// Somente os offsets dos campos e o ponteiro para o payload so guardados no pacote mac_frame.
+// Retorna TRUE se o frame  valido e o CRC confere
+INT8U MAC_FrameParse(RF_RX_SLOT *slot)
+{
+    INT8U *frame  = slot->Frame;
+    INT8U length  = slot->Length;
+    INT8U offset  = 3;             // frame control (2b) + sequence number (1b)
+
+    mac_frame->Frame              = frame;
+    mac_frame->MAC_Payload        = &frame[offset];
+    mac_frame->Payload_Size       = 0;
+    mac_frame->Dst_PAN_Offset     = 0;
+    mac_frame->DstAddr_16b_Offset = 0;
+    mac_frame->DstAddr_64b_Offset = 0;
+    mac_frame->Src_PAN_Offset     = 0;
+    mac_frame->SrcAddr_16b_Offset = 0;
+    mac_frame->SrcAddr_64b_Offset = 0;
+    mac_frame->Frame_RSSI         = slot->RSSI;
+    mac_frame->Frame_LQI          = slot->LQI;
+    mac_frame->Frame_CRC          = 0;
+    mac_frame->Frame_Timestamp    = slot->Timestamp;
+
+    // Frame control + sequence number + FCS
+    if ((length < 5) || (length > MAX_PHY_PACKETSIZE))
+      return FALSE;
+
+    mac_frame_control.Val = (INT16U)((frame[0] << 8) | frame[1]);
+
+    switch(mac_frame_control.bits.DstAddrMode)
+    {
+      case 0:
+        break;
+      case 2:
+        mac_frame->Dst_PAN_Offset     = offset;
+        mac_frame->DstAddr_16b_Offset = (INT8U)(offset + 2);
+        offset += 4;
+        break;
+      case 3:
+        mac_frame->Dst_PAN_Offset     = offset;
+        mac_frame->DstAddr_64b_Offset = (INT8U)(offset + 2);
+        offset += 10;
+        break;
+      default:
+        return FALSE;
+    }
+
+    switch(mac_frame_control.bits.SrcAddrMode)
+    {
+      case 0:
+        break;
+      case 2:
+        if (!mac_frame_control.bits.IntraPAN)
+        {
+          mac_frame->Src_PAN_Offset = offset;
+          offset += 2;
+        }
+        mac_frame->SrcAddr_16b_Offset = offset;
+        offset += 2;
+        break;
+      case 3:
+        if (!mac_frame_control.bits.IntraPAN)
+        {
+          mac_frame->Src_PAN_Offset = offset;
+          offset += 2;
+        }
+        mac_frame->SrcAddr_64b_Offset = offset;
+        offset += 8;
+        break;
+      default:
+        return FALSE;
+    }
+
+    // O cabealho e o FCS devem caber no frame
+    if ((INT8U)(offset + 2) > length)
+      return FALSE;
+
+    mac_frame->MAC_Payload  = &frame[offset];
+    mac_frame->Payload_Size = (INT8U)(length - offset - 2);
+    mac_frame->Frame_CRC    = (INT16U)((frame[length-1] << 8) | frame[length-2]);
+
+    if (mac_frame->Payload_Size > (MAX_APP_PAYLOAD_SIZE + NWK_APP_HEADER_SIZE))
+      return FALSE;
+
+    if (mac_frame->Frame_CRC != slot->CRC)
+      return FALSE;
+
+    return TRUE;
+}
 
 
 // Analiza se o beacon  valido na rede UNET
@@ -171,14 +677,14 @@ INT8U ReverseByte(INT8U b){
 INT8U MAC_BeaconVerify(void)
 {
     // Se for de tamanho diferente, descarta beacon por estar fora de padro
-    if (mac_packet.Payload_Size != macBeaconPayloadLength)
+    if (mac_frame->Payload_Size != macBeaconPayloadLength)
       return FALSE;
     
-    if ((mac_packet.MAC_Payload[0] == 0xFF) & (mac_packet.MAC_Payload[1] == 0xCF))
+    if ((mac_frame->MAC_Payload[0] == 0xFF) & (mac_frame->MAC_Payload[1] == 0xCF))
     {
-      if (mac_packet.MAC_Payload[4] == 0xAA)
+      if (mac_frame->MAC_Payload[4] == 0xAA)
       {
-        if (mac_packet.MAC_Payload[7] > 0)
+        if (mac_frame->MAC_Payload[7] > 0)
           return TRUE;
         else
           return FALSE;
@@ -203,7 +709,7 @@ void MAC_Command(INT8U command, INT8U Parameters, INT16U PANId, INT16U ShortAddr
   // Inicia montagem do pacote MAC Command
   
   // Indicao de MAC Command no Frame Control
-  PHYSetLongRAMAddr(2, (INT8U)(0x03+Parameters));
+  mac_tx_fifo[2] = (INT8U)(0x03+Parameters);
   HeaderSize++;
   
   if(mac_tasks_pending.bits.isAssociated == 1)
@@ -213,7 +719,7 @@ void MAC_Command(INT8U command, INT8U Parameters, INT16U PANId, INT16U ShortAddr
           // Association Response
           if (command == ASSOCIATION_RESPONSE)
           {
-            PHYSetLongRAMAddr(3, 0xCC);
+            mac_tx_fifo[3] = 0xCC;
             HeaderSize++;          
           }
       } 
@@ -222,19 +728,19 @@ void MAC_Command(INT8U command, INT8U Parameters, INT16U PANId, INT16U ShortAddr
       // Indicao de Dest Address de 16b, sem Source Address, no Frame Control
       if (mac_tasks_pending.bits.ScanInProgress == 1)
       {      
-          PHYSetLongRAMAddr(3, 0x08);
+          mac_tx_fifo[3] = 0x08;
           HeaderSize++;
       }
       
       if (mac_tasks_pending.bits.AssociationPending == 1)
       {
-          PHYSetLongRAMAddr(3, 0xC8);
+          mac_tx_fifo[3] = 0xC8;
           HeaderSize++;      
       }      
   }
   
   // Sequence Number
-  PHYSetLongRAMAddr(4, SequenceNumber);
+  mac_tx_fifo[4] = SequenceNumber;
   if (++SequenceNumber == 0) SequenceNumber = 1;
   HeaderSize++;
   
@@ -246,15 +752,15 @@ void MAC_Command(INT8U command, INT8U Parameters, INT16U PANId, INT16U ShortAddr
           if (command == ASSOCIATION_RESPONSE)
           {
             j = (INT8U)(macPANId & 0xFF);
-            PHYSetLongRAMAddr(5, j);
+            mac_tx_fifo[5] = j;
             j = (INT8U)(macPANId >> 8);
-            PHYSetLongRAMAddr(6, j);
+            mac_tx_fifo[6] = j;
             
             // Copia endereo 64b do n pedindo associao
             j = 7;
             for(i=8;i>0;i--)
             {
-              PHYSetLongRAMAddr(j, AssociateAddress[i-1]);
+              mac_tx_fifo[j] = AssociateAddress[i-1];
               j++;
             }
             
@@ -262,7 +768,7 @@ void MAC_Command(INT8U command, INT8U Parameters, INT16U PANId, INT16U ShortAddr
             j = 15;
             for(i=8;i>0;i--)
             {
-              PHYSetLongRAMAddr(j, mac64Address[i-1]);
+              mac_tx_fifo[j] = mac64Address[i-1];
               j++;
             }            
             HeaderSize += 18;
@@ -275,10 +781,10 @@ void MAC_Command(INT8U command, INT8U Parameters, INT16U PANId, INT16U ShortAddr
       {
           /* Indicao de Dest Address de 16b, 
           sem Source Address, no Frame Control */
-          PHYSetLongRAMAddr(5, 0xFF);
-          PHYSetLongRAMAddr(6, 0xFF);
-          PHYSetLongRAMAddr(7, 0xFF);
-          PHYSetLongRAMAddr(8, 0xFF);
+          mac_tx_fifo[5] = 0xFF;
+          mac_tx_fifo[6] = 0xFF;
+          mac_tx_fifo[7] = 0xFF;
+          mac_tx_fifo[8] = 0xFF;
           HeaderSize += 4;
           FrameIndex = 9;
       }
@@ -288,14 +794,14 @@ void MAC_Command(INT8U command, INT8U Parameters, INT16U PANId, INT16U ShortAddr
           /* Indicao de Dest Address de 16b, 
           com Source Address em 64b, no Frame Control */
           j = (INT8U)(PANId & 0xFF);
-          PHYSetLongRAMAddr(5, j);
+          mac_tx_fifo[5] = j;
           j = (INT8U)(PANId >> 8);
-          PHYSetLongRAMAddr(6, j);
+          mac_tx_fifo[6] = j;
           
           j = (INT8U)(ShortAddr & 0xFF);
-          PHYSetLongRAMAddr(7, j);
+          mac_tx_fifo[7] = j;
           j = (INT8U)(ShortAddr >> 8);
-          PHYSetLongRAMAddr(8, j);
+          mac_tx_fifo[8] = j;
                               
           // No precisa PANId da fonte pq
           // a associao  intrapan
@@ -304,7 +810,7 @@ void MAC_Command(INT8U command, INT8U Parameters, INT16U PANId, INT16U ShortAddr
           j = 9;
           for(i=8;i>0;i--)
           {
-             PHYSetLongRAMAddr(j, mac64Address[i-1]);
+             mac_tx_fifo[j] = mac64Address[i-1];
              j++;
           }
           HeaderSize += 12;
@@ -314,7 +820,7 @@ void MAC_Command(INT8U command, INT8U Parameters, INT16U PANId, INT16U ShortAddr
   }
   
   // Adiciona o comando
-  PHYSetLongRAMAddr(FrameIndex, command);
+  mac_tx_fifo[FrameIndex] = command;
   FrameIndex++;
   PayloadSize++;
   
@@ -327,18 +833,18 @@ void MAC_Command(INT8U command, INT8U Parameters, INT16U PANId, INT16U ShortAddr
       // no desliga o receptor para conservar energia
       // sem segurana
       // Solicitando endereo de 16 bits
-      PHYSetLongRAMAddr(FrameIndex, 0x8E);
+      mac_tx_fifo[FrameIndex] = 0x8E;
       FrameIndex++;
       PayloadSize++;
       break;
     case ASSOCIATION_RESPONSE:
       // Associa o n sem enviar endereo de 16 bits
       // sem segurana
-      PHYSetLongRAMAddr(FrameIndex, 0xFE);
+      mac_tx_fifo[FrameIndex] = 0xFE;
       FrameIndex++;
-      PHYSetLongRAMAddr(FrameIndex, 0xFF);
+      mac_tx_fifo[FrameIndex] = 0xFF;
       FrameIndex++;
-      PHYSetLongRAMAddr(FrameIndex, 0x00);
+      mac_tx_fifo[FrameIndex] = 0x00;
       FrameIndex++;
       PayloadSize += 3;
       break;
@@ -346,28 +852,9 @@ void MAC_Command(INT8U command, INT8U Parameters, INT16U PANId, INT16U ShortAddr
       break;
   }
 
-  // Informao do tamanho do MAC header em bytes
-  // No modo no seguro  ignorado
-  PHYSetLongRAMAddr(0x000,HeaderSize);
-  // Informao do tamanho em bytes do MAC header + Payload
-  PHYSetLongRAMAddr(0x001,(INT8U)(HeaderSize+PayloadSize));
-
-  // transmit packet without ACK requested
-  // Para solicitar ACK, bit2 = 1
-  if ((Parameters&0x20) == 0x20)
-  {
-    UserEnterCritical();
-  	mac_tasks_pending.bits.PacketPendingAck = 1;
-  	UserExitCritical();
-    PHYSetShortRAMAddr(WRITE_TXNMTRIG,0b00000101);
-  }
-  else
-  {
-    UserEnterCritical();
-  	mac_tasks_pending.bits.PacketPendingAck = 0;
-  	UserExitCritical();
-    PHYSetShortRAMAddr(WRITE_TXNMTRIG,0b00000001);
-  }
+  // Tamanho do MAC header (ignorado no modo no seguro) e do MAC header + Payload.
+  // O frame  transmitido pela tarefa UNET_TX: MAC_TX_ACK se Parameters pede ACK (0x20)
+  MAC_TxFrame(HeaderSize, (INT8U)(HeaderSize+PayloadSize));
 }
 
 
@@ -379,63 +866,67 @@ void MAC_Beacon(void){
   // Inicia montagem do pacote Beacon
   
   // Indicao de Beacon no Frame Control
-  PHYSetLongRAMAddr(2, 0x00);
+  mac_tx_fifo[2] = 0x00;
   HeaderSize++;
   
   /* Indicao de Dest Address de 16b, 
   sem Source Address, no Frame Control */    
-  PHYSetLongRAMAddr(3, 0x80);
+  mac_tx_fifo[3] = 0x80;
   HeaderSize++;
  
   
   // Sequence Number
-  PHYSetLongRAMAddr(4, SequenceNumber);
+  mac_tx_fifo[4] = SequenceNumber;
   if (++SequenceNumber == 0) SequenceNumber = 1;
   HeaderSize++;
   
   // PanId do coordenador que gera o Beacon
-  PHYSetLongRAMAddr(5, (INT8U)(macPANId & 0xFF));
-  PHYSetLongRAMAddr(6, (INT8U)(macPANId >> 8));
+  mac_tx_fifo[5] = (INT8U)(macPANId & 0xFF);
+  mac_tx_fifo[6] = (INT8U)(macPANId >> 8);
   
   // Endereo do coordenador que gera o Beacon
-  PHYSetLongRAMAddr(7, (INT8U)(macAddr & 0xFF));
-  PHYSetLongRAMAddr(8, (INT8U)(macAddr >> 8));
+  mac_tx_fifo[7] = (INT8U)(macAddr & 0xFF);
+  mac_tx_fifo[8] = (INT8U)(macAddr >> 8);
   HeaderSize += 4;
   
   // Padro IEEE 802.15.4 p/ Beaconless networks
-  PHYSetLongRAMAddr(9, 0xFF);
-  PHYSetLongRAMAddr(10, 0xCF);
-  PHYSetLongRAMAddr(11, 0x00);
-  PHYSetLongRAMAddr(12, 0x00);
+  mac_tx_fifo[9] = 0xFF;
+  mac_tx_fifo[10] = 0xCF;
+  mac_tx_fifo[11] = 0x00;
+  mac_tx_fifo[12] = 0x00;
   PayloadSize += 4;
   
   // Protocol Id
-  PHYSetLongRAMAddr(13, 0xAA);
+  mac_tx_fifo[13] = 0xAA;
   PayloadSize++;
   
   // Profile
-  PHYSetLongRAMAddr(14, 0x00);
+  mac_tx_fifo[14] = 0x00;
   PayloadSize++;
   
   // Distancia do PAN coordinator
-  PHYSetLongRAMAddr(15, thisNodeDepth);
+  mac_tx_fifo[15] = thisNodeDepth;
   PayloadSize++;
   
   // Capacidade de enderear Roteadores
-  PHYSetLongRAMAddr(16, RouterCapacity);
+  mac_tx_fifo[16] = RouterCapacity;
   PayloadSize++;    
 
-  // Informao do tamanho do MAC header em bytes
-  // No modo no seguro  ignorado
-  PHYSetLongRAMAddr(0x000,HeaderSize);
-  // Informao do tamanho em bytes do MAC header + Payload
-  PHYSetLongRAMAddr(0x001,(INT8U)(HeaderSize+PayloadSize));
+  // Tamanho do MAC header (ignorado no modo no seguro) e do MAC header + Payload.
+  // Transmitido sem pedido de ACK (MAC_TX_NO_ACK) pela tarefa UNET_TX
+  MAC_TxFrame(HeaderSize, (INT8U)(HeaderSize+PayloadSize));
+}
 
-  //transmit packet without ACK requested
+// Fim do envio do Association Response
+static void MAC_AssociationResponseDone(MAC_TX_REQUEST *request, INT8U status)
+{
+  (void)request;
+  (void)status;
+  
+  // Com ou sem ACK, termina o processo de associao
   UserEnterCritical();
-  mac_tasks_pending.bits.PacketPendingAck = 1;
+  mac_tasks_pending.bits.AssociationInProgress = 0;
   UserExitCritical();
-  PHYSetShortRAMAddr(WRITE_TXNMTRIG,0b00000001);
 }
 
 
@@ -445,22 +936,23 @@ void MAC_Beacon(void){
  {
     INT8U k = 0;
     INT8U AssociateCapabilityInfo;
+    MAC_TX_REQUEST *request;
     
     // Responde comandos MAC somente depois da associao do n
-    switch(mac_packet.MAC_Payload[0])
+    switch(mac_frame->MAC_Payload[0])
     {
       case ASSOCIATION_REQUEST:
         // No associa outros ns enquanto no terminar
         // um processo de associao pendente
         if(mac_tasks_pending.bits.AssociationInProgress != 1)
         {
-            AssociateCapabilityInfo = mac_packet.MAC_Payload[1];
+            AssociateCapabilityInfo = mac_frame->MAC_Payload[1];
             if (AssociateCapabilityInfo == 0x8E)
             {
               // Copia endereo 64b do requisitante
               for(k=0;k<8;k++)
               {
-                 AssociateAddress[k] = mac_packet.SrcAddr_64b[k];
+                 AssociateAddress[k] = MAC_RX_SRC_ADDR_64B(k);
               }
               UserEnterCritical();
               mac_tasks_pending.bits.AssociationInProgress = 1;
@@ -476,24 +968,16 @@ void MAC_Beacon(void){
         if(mac_tasks_pending.bits.AssociationInProgress == 1)
         {
           // Enviar Association Response
-          //acquireRadio();
-          macACK = FALSE;
+          // O processo termina no callback, depois do ACK ou do erro de transmisso
           MAC_Command(ASSOCIATION_RESPONSE,MAC_ACK_INTRA_PAN,0xFFFF,0xFFFF);
-          
-          // Espera Ack
-          // Colocar para dormir com semaforo com timeout
-          // e acordar na rotina de interrupo pelo mesmo semaforo
-          OSSemPend(RF_TX_Event,TX_TIMEOUT);
-          if (macACK == TRUE)
+          request = MAC_TxRequest(MAC_TX_ACK,MAC_TX_SINGLE,MAC_TX_CLASS_CONTROL,MAC_AssociationResponseDone);
+          if (request != NULL)
           {
-            // Associao completada com sucesso
-            UserEnterCritical();
-            mac_tasks_pending.bits.AssociationInProgress = 0;
-            UserExitCritical();
+            MAC_TxSubmit(request);
           }else
           {
             // Erro no processo de Associao
-        	UserEnterCritical();
+            UserEnterCritical();
             mac_tasks_pending.bits.AssociationInProgress = 0;
             UserExitCritical();
           }
@@ -504,11 +988,15 @@ void MAC_Beacon(void){
       case ORPHAN_NOTIFICATION:
         break;
       case BEACON_REQUEST:
-        // Envia Beacon
-        DelayTask(RadioRand());
+        // Envia Beacon depois de um tempo aleatrio,
+        // sem esperar o resultado do envio
         MAC_Beacon();
-        // Espera resultado do envio do Beacon
-        OSSemPend(RF_TX_Event,TX_TIMEOUT);
+        request = MAC_TxRequest(MAC_TX_NO_ACK,MAC_TX_SINGLE,MAC_TX_CLASS_CONTROL,NULL);
+        if (request != NULL)
+        {
+          request->Backoff = RadioRand();
+          MAC_TxSubmit(request);
+        }
         break;
       default:
         break;
@@ -528,7 +1016,7 @@ INT16U RadioRand(void)
   
   j = OSGetCount(); 
   j = (INT16U)(j ^ macAddr);
-  j = (INT16U)(j ^ mac_packet.Frame_RSSI);
+  j = (INT16U)(j ^ mac_frame->Frame_RSSI);
   
   OSExitCritical();
   
@@ -545,6 +1033,21 @@ INT16U RadioRand(void)
                                        
 
 // Funo que controla a associao do n
+// Pedido de beacon do active scan, sem ACK e sem esperar o resultado
+static void MAC_BeaconRequest(void)
+{
+   MAC_TX_REQUEST *request;
+   
+   NWK_Lock(NWK_LOCK_TX);
+   MAC_Command(BEACON_REQUEST,MAC_NACK,0xFFFF,0xFFFF);
+   request = MAC_TxRequest(MAC_TX_NO_ACK,MAC_TX_SINGLE,MAC_TX_CLASS_CONTROL,NULL);
+   if (request != NULL)
+   {
+     MAC_TxSubmit(request);
+   }
+   NWK_Unlock(NWK_LOCK_TX);
+}
+
 INT8U UNET_Associate(void)
 {
    //INT8U AssociateTimeout = 0;
@@ -552,6 +1055,7 @@ INT8U UNET_Associate(void)
    INT8U j   = 0;
    INT8U z  = 0;
    INT8U aux = 0;
+   INT8U status = 0;
    
    // mquina de estados que ir coordenar entrada na rede
    // O processo deve demorar no mximo 2 segundos = 4 * 500ms
@@ -575,11 +1079,11 @@ INT8U UNET_Associate(void)
       {
         // Envia pedido de beacon
         // Sem ACK e com broadcast de PANId       
-        MAC_Command(BEACON_REQUEST,MAC_NACK,0xFFFF,0xFFFF);
+        MAC_BeaconRequest();
         DelayTask((INT16U)(53+RadioRand()));
         
         
-        MAC_Command(BEACON_REQUEST,MAC_NACK,0xFFFF,0xFFFF);
+        MAC_BeaconRequest();
         DelayTask((INT16U)(53+RadioRand()));
         
                         
@@ -595,21 +1099,23 @@ INT8U UNET_Associate(void)
       {
                         
         // Reset de Radio se ficou mais de 50 segundos sem receber pacotes
-        if (nwk_tasks_pending.bits.RadioReset == 1)
+        if (nwk_tasks_pending & NWK_EVENT_RADIO_RESET)
         {
             
             //  Disable receiving packets off air
             PHYSetShortRAMAddr(WRITE_BBREG1,0x04);
             
             // Limpa o buffer de recepo
-            (void)OSCleanQueue(RF);
+            RFBufferClean();
             
             MRF24J40Reset();
             
             //  Enable receiving packets off air
             PHYSetShortRAMAddr(WRITE_BBREG1,0x00);
                       
-            nwk_tasks_pending.bits.RadioReset = 0;
+            UserEnterCritical();
+            nwk_tasks_pending &= (INT16U)~NWK_EVENT_RADIO_RESET;
+            UserExitCritical();
         }
                 
         // Tempo para nova tentativa
@@ -671,14 +1177,13 @@ INT8U UNET_Associate(void)
   while(z<3) 
   {
    // Associate Request com Acknowledgement
-   macACK = FALSE;
+   // Espera o resultado da transmisso (ACK) pela tarefa UNET_TX
+   NWK_Lock(NWK_LOCK_TX);
    MAC_Command(ASSOCIATION_REQUEST,MAC_ACK_INTRA_PAN,unet_beacon[j].PAN_Ident,unet_beacon[j].Addr_16b);
-   
-   // Colocar para dormir com semaforo com timeout
-   // e acordar na rotina de interrupo pelo mesmo semaforo
-   OSSemPend(RF_TX_Event,TX_TIMEOUT);
+   status = MAC_TxSendWait(MAC_TX_ACK);
+   NWK_Unlock(NWK_LOCK_TX);
      
-   if (macACK == TRUE)
+   if (status == OK)
    {
       // Espera o tempo aResponseWaitTime
       // = 32 * BaseSuperframeDuration
@@ -692,38 +1197,36 @@ INT8U UNET_Associate(void)
       macPANId = unet_beacon[j].PAN_Ident;
       
       // Data Request
-      macACK = FALSE;
+      NWK_Lock(NWK_LOCK_TX);
       MAC_Command(DATA_REQUEST,MAC_ACK_INTRA_PAN,unet_beacon[j].PAN_Ident,unet_beacon[j].Addr_16b);
-   
-      // Colocar para dormir com semaforo com timeout
-      // e acordar na rotina de interrupo pelo mesmo semaforo
-      OSSemPend(RF_TX_Event,TX_TIMEOUT);
+      status = MAC_TxSendWait(MAC_TX_ACK);
+      NWK_Unlock(NWK_LOCK_TX);
       
-      if (macACK == TRUE)
+      if (status == OK)
       {
-         mac_packet.MAC_Payload[0] = 0;
+         mac_frame->Payload_Size = 0;
          OSSemPend(MAC_Event,50);
    
          // Verifica se  Association Response
-         if (mac_packet.MAC_Payload[0] == 0x02)
+         if ((mac_frame->Payload_Size >= 4) && (mac_frame->MAC_Payload[0] == 0x02))
          {
             // Analisar "Association status field"
             // Se diferente de 0, alocar motivo em unet_beacon[j].AssociationStatus
-            if (mac_packet.MAC_Payload[3] == 0)
+            if (mac_frame->MAC_Payload[3] == 0)
             {
                 // Dispositivo Associado
                 // Ao terminar associao, deixa o estado de associao pendente
                 // para o estado de associado
                 macPANId   = unet_beacon[j].PAN_Ident;
                 // Copia o endereo recebido pelo n ao qual foi associado
-                macAddr = (INT16U)((mac_packet.MAC_Payload[2]<<8) | mac_packet.MAC_Payload[1]);
+                macAddr = (INT16U)((mac_frame->MAC_Payload[2]<<8) | mac_frame->MAC_Payload[1]);
                 
                 // Gera endereo estocstico
                 if (macAddress == 0xFFFFFFFF)
                 {
                   if(macAddr == 0xFFFE)
                   {
-                    macAddr = (INT16U)(mac_packet.Frame_CRC ^ TIMER_ADDR);
+                    macAddr = (INT16U)(mac_frame->Frame_CRC ^ TIMER_ADDR);
                   }
                 }
                 else
@@ -746,7 +1249,7 @@ INT8U UNET_Associate(void)
             {
                 // Falha na associao
                 // O motivo estar disponvel no Association Status do beacon solicitado
-                unet_beacon[j].AssociationStatus = mac_packet.MAC_Payload[3];
+                unet_beacon[j].AssociationStatus = mac_frame->MAC_Payload[3];
                 goto AssociationFail;
             }
          }else
@@ -780,41 +1283,6 @@ INT8U UNET_Associate(void)
    
 }
 
-/* Functions for CRC calculation and checking */
-void CRC_Update(INT8U data)
-{
-    INT8U tmp = 0;
-    INT8U short_data = 0;
-    INT16U fcs_tmp = 0;
-
-#if (REVERSE_BYTE == BY_LUT)    
-    short_data = (INT8U)(rev_bitorder_table[data] & 0xff);
-#else // (REVERSE_BYTE == BY_FUN) 
-    short_data = (INT8U)ReverseByte(data);
-#endif
- 
-    tmp = (INT8U)((INT8U)(FrameCRC >> 8) ^ short_data);
-    fcs_tmp = (INT16U)ccitt_crc16_table[tmp];
-    FrameCRC = (INT16U)((INT16U)(FrameCRC << 8) ^ fcs_tmp);
-}
-
-
-INT16U CRC_Get(void)
-{
-    INT8U tmp = 0;
-    INT8U tmp2 = 0;
-#if (REVERSE_BYTE == BY_LUT)     
-    tmp = rev_bitorder_table[(INT8U)(FrameCRC >> 8)];
-    tmp2 = rev_bitorder_table[(INT8U)(FrameCRC & 0xFF)];
-#else // (REVERSE_BYTE == BY_FUN) 
-   tmp = ReverseByte((INT8U)(FrameCRC >> 8));
-   tmp2 = ReverseByte((INT8U)(FrameCRC & 0xFF));
-#endif     
-    
-    FrameCRC = 0; /* reset frame CRC for next packet */
-    
-    return ((INT16U)((tmp2 << 8) | tmp));
-}
 
 
 
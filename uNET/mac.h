@@ -29,12 +29,9 @@ Copyright (c) <2009-2013> <Universidade Federal de Santa Maria>
 
 #include "BRTOS.h"
 #include "NetConfig.h"
+#include "crc.h"
 #include <stddef.h>
 
-#define   mac_packet          unet_packet.mac_packet_u
-#define   nwk_packet          unet_packet.nwk_packet_u
-#define   app_packet          unet_packet.app_packet_u
-
                                                           
 // Function Prototypes
 INT8U MAC_BeaconVerify(void);
@@ -44,8 +41,6 @@ void MAC_Command(INT8U command, INT8U Parameters,INT16U PANId, INT16U ShortAddr)
 
 INT8U UNET_Associate(void);
 INT16U RadioRand(void);
-INT16U CRC_Get(void); 
-void CRC_Update(INT8U data);
       
     
 #define aMaxFrameResponseTime  1220
@@ -89,7 +84,34 @@ que retira os dados extras da camada app (payload da app)
 #define nwkMaxDepth           (INT8U)200
 
 /* removed from here and included in NetConfig.h */
-// #define RFBufferSize                (INT16U)768
+// #define RFBufferSize                (INT8U)5
+
+/* RX buffer slot: one received frame as read from the radio RX FIFO */
+typedef struct _RF_RX_SLOT
+{
+    INT8U         Length;                       // frame length, FCS included
+    INT8U         RSSI;
+    INT8U         LQI;
+    volatile INT8U Held;                        // the frame is in a received packet (RX packet pool)
+    INT16U        CRC;                          // CRC computed on reception
+    ostick_t      Timestamp;                    // tick count at the RX interrupt
+    INT8U         Frame[MAX_PHY_PACKETSIZE+2];  // frame + FCS, followed by LQI and RSSI
+} RF_RX_SLOT;
+
+/* RX buffer: single producer (UNET_RF_Event), single consumer (UNET_MAC).
+   UNET_MAC takes the frames in order at Next; a frame stays in its slot while
+   a received packet refers to it, and the packets are released in any order
+   by the layers: Out advances over the slots already released.
+   In, Next and Out run over [0, 2*RFBufferSize) */
+typedef struct _RF_RX_RING
+{
+    volatile INT8U In;
+    volatile INT8U Next;
+    volatile INT8U Out;
+    RF_RX_SLOT     Slot[RFBufferSize];
+} RF_RX_RING;
+
+void RFBufferClean(void);
 
 /* mac frame control struct */
 typedef union _MAC_FRAME_CONTROL
@@ -129,80 +151,200 @@ typedef union _MAC_FRAME_CONTROL
     } bits;
 } MAC_FRAME_CONTROL;
 
-/* mac packet struct */
-typedef struct _MAC_PACKET
+/* Received packet: in-place view of a received frame (zero copy).
+   The header is decoded into offsets over the RX buffer slot, which stays
+   reserved while a layer holds a reference to the packet (Refs).
+   The packets come from a pool of RX_PACKET_POOL_SIZE entries and go from
+   the MAC task to the network task and to the application, so frames in
+   different stages are processed at the same time.
+   An offset of 0 means that the field is not present in the frame. */
+typedef struct _MAC_FRAME_VIEW
 {
-    INT8U         Sequence_Number;
-    INT8U         Unused_ByteAlign;
-    INT16U        Dst_PAN_Ident;
-    INT16U        DstAddr_16b;
-    INT8U         DstAddr_64b[8];
-    INT16U        Src_PAN_Ident;
-    INT16U        SrcAddr_16b;
-    INT8U         SrcAddr_64b[8];
-    INT8U         MAC_Payload[MAX_APP_PAYLOAD_SIZE+NWK_APP_HEADER_SIZE]; // app header (4bytes) + nwk header (28 bytes)
+    INT8U        *Frame;             // frame in the RX buffer slot
+    INT8U        *MAC_Payload;       // MAC payload (NWK header), inside Frame
     INT8U         Payload_Size;
-    INT16U        Frame_CRC;
+    INT8U         Dst_PAN_Offset;
+    INT8U         DstAddr_16b_Offset;
+    INT8U         DstAddr_64b_Offset;
+    INT8U         Src_PAN_Offset;
+    INT8U         SrcAddr_16b_Offset;
+    INT8U         SrcAddr_64b_Offset;
     INT8U         Frame_RSSI;
-    INT8U         Frame_LQI;      
-} MAC_PACKET;
-
-/* nwk packet struct */
-typedef struct _NWK_PACKET 
+    INT8U         Frame_LQI;
+    INT8U         Unused_ByteAlign;
+    INT16U        Frame_CRC;         // received FCS
+    ostick_t      Frame_Timestamp;   // tick count at the RX interrupt
+    INT16U        Nwk_Destiny;       // NWK header decoded by NWK_HeaderParse
+    INT16U        Nwk_Source;
+    INT8U         Nwk_Life;
+    INT8U         Nwk_Header_Size;
+    INT8U         Slot;              // RX buffer index of the frame
+    INT8U         Refs;              // references held by the layers, 0: free packet
+} MAC_FRAME_VIEW;
+
+/* Campos de 16 bits so little endian e podem estar desalinhados no frame */
+#define MAC_FRAME_U16(frame,offset)       ((INT16U)((frame)->Frame[(offset)] | ((frame)->Frame[(offset)+1] << 8)))
+#define MAC_FRAME_FIELD16(frame,offset)   (((offset) != 0) ? MAC_FRAME_U16(frame,offset) : (INT16U)0xFFFE)
+/* Endereos de 64 bits so transmitidos do byte menos significativo para o mais significativo */
+#define MAC_FRAME_FIELD64(frame,offset,i) (((offset) != 0) ? (frame)->Frame[(offset)+7-(i)] : (INT8U)0)
+
+/* Cada camada l o seu pacote: mac_frame  o frame sendo decodificado pela
+   tarefa UNET_MAC e nwk_frame o pacote sendo roteado pela tarefa de rede.
+   A aplicao l a sua cpia da mensagem (UNET_APP_MSG, UNET_AppReceive) */
+
+/* MAC header */
+#define MAC_RX_SEQUENCE_NUMBER()    (mac_frame->Frame[2])
+#define MAC_RX_DST_PAN_IDENT()      MAC_FRAME_FIELD16(mac_frame,mac_frame->Dst_PAN_Offset)
+#define MAC_RX_DST_ADDR_16B()       MAC_FRAME_FIELD16(mac_frame,mac_frame->DstAddr_16b_Offset)
+#define MAC_RX_DST_ADDR_64B(i)      MAC_FRAME_FIELD64(mac_frame,mac_frame->DstAddr_64b_Offset,(i))
+#define MAC_RX_SRC_PAN_IDENT()      MAC_FRAME_FIELD16(mac_frame,mac_frame->Src_PAN_Offset)
+#define MAC_RX_SRC_ADDR_16B()       MAC_FRAME_FIELD16(mac_frame,mac_frame->SrcAddr_16b_Offset)
+#define MAC_RX_SRC_ADDR_64B(i)      MAC_FRAME_FIELD64(mac_frame,mac_frame->SrcAddr_64b_Offset,(i))
+#define MAC_RX_TIMESTAMP()          (mac_frame->Frame_Timestamp)
+
+/* NWK header: packet type, parameter, destiny, source and packet life.
+   O cabealho completo ou comprimido (NWK_COMPRESSED)  decodificado por NWK_HeaderParse */
+#define NWK_RX_PACKET_TYPE()        (nwk_frame->MAC_Payload[0])
+#define NWK_RX_PARAMETER()          (nwk_frame->MAC_Payload[1])
+#define NWK_RX_DESTINY()            (nwk_frame->Nwk_Destiny)
+#define NWK_RX_SOURCE()             (nwk_frame->Nwk_Source)
+#define NWK_RX_PACKET_LIFE()        (nwk_frame->Nwk_Life)
+#define NWK_RX_HEADER_SIZE          (nwk_frame->Nwk_Header_Size)
+#define NWK_RX_PAYLOAD              (&nwk_frame->MAC_Payload[NWK_RX_HEADER_SIZE])
+#define NWK_RX_PAYLOAD_SIZE()       ((INT8U)(nwk_frame->Payload_Size - NWK_RX_HEADER_SIZE))
+/* Vizinho que transmitiu o pacote e instante de recepo */
+#define NWK_RX_MAC_SOURCE()         MAC_FRAME_FIELD16(nwk_frame,nwk_frame->SrcAddr_16b_Offset)
+#define NWK_RX_TIMESTAMP()          (nwk_frame->Frame_Timestamp)
+
+/* Mensagem APP copiada por UNET_APP para a caixa de mensagens da aplicao.
+   Um frame agregado (NWK_AGGREGATE) gera uma mensagem por registro */
+typedef struct _UNET_APP_MSG
 {
-    // MAC Header    
-    INT8U         MAC_Header[offsetof(MAC_PACKET,MAC_Payload)];     
-    // NWK Packet
-    INT8U         NWK_Packet_Type;
-    INT8U         NWK_Parameter;
-    INT16U		  NWK_Destiny;
-    INT16U		  NWK_Source;
-    INT8U         NWK_Packet_Life;    
-    INT8U         NWK_Payload[MAX_APP_PAYLOAD_SIZE+APP_HEADER_SIZE];     // app header (4bytes)
-    INT8U         NWK_Payload_Size;
-    INT8U         Frame_CRC_RSSI_LQI[4];
-} NWK_PACKET;
-
-/* app packet struct */      
-typedef struct _APP_PACKET    
-{    
-    // MAC Header    
-    INT8U         MAC_Header[offsetof(MAC_PACKET,MAC_Payload)];    
-    // NWK Header    
-    INT8U         NWK_Header[offsetof(NWK_PACKET,NWK_Payload) - offsetof(MAC_PACKET,MAC_Payload)];
-    
-    // APP Packet
-    INT8U         APP_Identify;      /* Id da tarefa a ser acordada */
-    INT8U         APP_Profile;       /*  Perfil de Aplicao
-                                     ex: perfil p/ iluminao 
-                                     = LIGHTING_PROFILE */
-    INT8U         APP_Command;       /* Comando do perfil a ser executado */
-    INT8U         APP_Command_Attribute;      
-                                     /* Atributo do comando do perfil a ser executado
-                                      ex: comando = ON/OFF, atributo = ON */
-    INT8U         APP_Payload[MAX_APP_PAYLOAD_SIZE];
-    INT8U         APP_Command_Size;  /* Atributos da mensagem em bytes */
-    INT8U         Frame_CRC_RSSI_LQI[4];
-} APP_PACKET;
-
-// APP Packet Header
-typedef union {
-    
-    INT8U         APP_Identify;      /* Id da tarefa a ser acordada */
-    INT8U         APP_Profile;       /*  Perfil de Aplicao
-                                     ex: perfil p/ iluminao 
-                                     = LIGHTING_PROFILE */
-    INT8U         APP_Command;       /* Comando do perfil a ser executado */
-    INT8U         APP_Command_Attribute;
-}APP_PACKET_HEADER;
-
+    INT8U         Payload[MAX_APP_PAYLOAD_SIZE];   // APP header e atributos
+    INT8U         Size;
+    INT16U        Source;            // n de origem (NWK)
+    ostick_t      Timestamp;         // instante de recepo do pacote neste n
+} UNET_APP_MSG;
+
+/* APP header: id da tarefa a ser acordada, perfil, comando e atributo do comando */
+#define APP_RX_IDENTIFY(msg)          ((msg)->Payload[0])
+#define APP_RX_PROFILE(msg)           ((msg)->Payload[1])
+#define APP_RX_COMMAND(msg)           ((msg)->Payload[2])
+#define APP_RX_COMMAND_ATTRIBUTE(msg) ((msg)->Payload[3])
+#define APP_RX_PAYLOAD(msg)           (&(msg)->Payload[APP_HEADER_SIZE])
+/* N de origem da mensagem */
+#define APP_RX_SOURCE(msg)            ((msg)->Source)
+/* Instante de recepo do pacote neste n (tick do sistema, ver UNET_TicksSince) */
+#define APP_RX_TIMESTAMP(msg)         ((msg)->Timestamp)
+/* Atributos da mensagem em bytes */
+#define APP_RX_COMMAND_SIZE(msg)      (((msg)->Size < APP_HEADER_SIZE) ? (INT8U)0 : \
+                                       (INT8U)((msg)->Size - APP_HEADER_SIZE))
+
+INT8U MAC_FrameParse(RF_RX_SLOT *slot);
+
+
+/* Escalonador de transmisso (tarefa UNET_TX).
+   Os frames so montados em mac_tx_fifo e copiados para uma requisio da fila
+   de transmisso. A tarefa UNET_TX carrega a TX normal FIFO, espera o RF_TXIF,
+   repete a transmisso conforme a poltica de retransmisso da requisio e
+   chama o callback ao final, sem que o chamador fique bloqueado com a guarda NWK_LOCK_TX */
+
+// Valores de WRITE_TXNMTRIG
+#define MAC_TX_ACK           (INT8U)0b00000101     // transmite com pedido de ACK
+#define MAC_TX_NO_ACK        (INT8U)0b00000001     // transmite sem pedido de ACK
+
+// Resultado de uma requisio de transmisso (alm de OK)
+#define TX_NO_ACK_ERROR      (INT8U)0x11           // sem ACK em todas as tentativas
+#define TX_RADIO_ERROR       (INT8U)0x12           // sem RF_TXIF, rdio reiniciado
+#define TX_QUEUE_FULL        (INT8U)0x13           // nenhuma requisio livre
+
+// Polticas de retransmisso
+#define MAC_TX_SINGLE        (INT8U)0              // uma transmisso (comandos MAC, beacon, ping)
+#define MAC_TX_ROUTE         (INT8U)1              // prximo salto (ContikiMAC: uma janela)
+#define MAC_TX_DELIVER       (INT8U)2              // ltimo salto e rota up (ContikiMAC: duas janelas)
+#define MAC_TX_ONE_HOP       (INT8U)3              // destino vizinho (OneHopRoute)
+#define MAC_TX_NEIGHBOURS    (INT8U)4              // vizinhos a um salto (UpSimpleRoute, UpBroadcastRoute)
+#define MAC_TX_POLICIES      (INT8U)5
+
+/* Classes de trfego, em ordem de prioridade. A tarefa UNET_TX transmite primeiro a
+   requisio da classe de maior prioridade; uma requisio que espera h mais de
+   TX_CLASS_MAX_WAIT ticks passa  frente de todas. A classe MAC_TX_CLASS_APP ocupa no
+   mximo TX_QUEUE_APP_SLOTS requisies, as demais ficam para o roteamento e o controle */
+#define MAC_TX_CLASS_ROUTE   (INT8U)0              // pacotes repassados
+#define MAC_TX_CLASS_CONTROL (INT8U)1              // comandos MAC, beacon, ping, manuteno de rotas
+#define MAC_TX_CLASS_APP     (INT8U)2              // mensagens da aplicao deste n
+#define MAC_TX_CLASSES       (INT8U)3
+
+/* Depois de uma transmisso sem ACK a requisio espera um backoff exponencial binrio:
+   sorteado entre a metade e o total de uma janela que comea em BackoffMin e dobra a
+   cada falha at BackoffMax. O nmero de falhas  o maior entre o da requisio e o das
+   ltimas transmisses consecutivas para o mesmo destino (memria de TX_DEST_MEMORY_SIZE destinos) */
+typedef struct _MAC_TX_POLICY
+{
+    INT8U            Attempts;                      // transmisses por requisio
+    INT16U           Window;                        // != 0: tenta enquanto no passar Window ticks (ContikiMAC)
+    INT16U           BackoffMin;                    // janela de backoff da primeira falha, em ticks
+    INT16U           BackoffMax;                    // limite da janela de backoff
+} MAC_TX_POLICY;
 
-typedef union _UNET_PACKET
+typedef struct _MAC_TX_POLICY_STAT
+{
+    INT32U           Requests;                      // requisies terminadas
+    INT32U           Success;                       // requisies terminadas com ACK
+    INT32U           Transmissions;                 // transmisses, incluindo as repeties
+    INT32U           LatencySum;                    // ticks da requisio at o seu fim
+    INT16U           LatencyMax;
+} MAC_TX_POLICY_STAT;
+
+typedef struct _MAC_TX_CLASS_STAT
 {
-  MAC_PACKET  mac_packet_u;
-  NWK_PACKET  nwk_packet_u;
-  APP_PACKET  app_packet_u;  
-} UNET_PACKET;
+    INT32U           Transmissions;                 // transmisses iniciadas, incluindo as repeties
+    INT32U           WaitSum;                       // ticks na fila, fora do backoff, at a transmisso
+    INT16U           WaitMax;
+    INT16U           Promoted;                      // transmisses adiantadas por TX_CLASS_MAX_WAIT
+    INT16U           Rejected;                      // requisies recusadas (TX_QUEUE_FULL)
+    INT8U            Depth;                         // requisies alocadas
+    INT8U            DepthMax;
+} MAC_TX_CLASS_STAT;
+
+typedef struct _MAC_TX_REQUEST MAC_TX_REQUEST;
+
+// Chamado pela tarefa UNET_TX com NWK_LOCK_NEIGHBOR e NWK_LOCK_TX, depois da ltima tentativa.
+// Pode alterar o frame e chamar MAC_TxRetry para reenvi-lo
+typedef void (*MAC_TX_CALLBACK)(MAC_TX_REQUEST *request, INT8U status);
+
+struct _MAC_TX_REQUEST
+{
+    INT8U            Fifo[2 + MAX_PHY_PACKETSIZE];  // imagem da TX normal FIFO, como mac_tx_fifo
+    INT8U            Trigger;                       // MAC_TX_ACK ou MAC_TX_NO_ACK
+    INT8U            Policy;                        // MAC_TX_SINGLE, MAC_TX_ROUTE, ...
+    INT8U            Class;                         // MAC_TX_CLASS_ROUTE, MAC_TX_CLASS_CONTROL, ...
+    INT8U            Attempts;                      // transmisses restantes
+    INT8U            Failures;                      // transmisses sem ACK da requisio
+    INT8U            State;
+    INT8U            Node;                          // uso do chamador (ndice do vizinho)
+    INT8U            Wake;                          // TRUE: UNET_TX liga o rdio antes de transmitir (ContikiMAC)
+    INT8U            Send;                          // mensagens do pool de envio no frame (NWK_SEND_MASK)
+    INT16U           Arg;                           // uso do chamador
+    ostick_t         Start;                         // instante da requisio
+    ostick_t         Submitted;                     // instante da submisso
+    ostick_t         BackoffStart;
+    INT16U           Backoff;                       // ticks a esperar antes da prxima transmisso
+    INT16U           Ticket;                        // ordem de chegada
+    MAC_TX_CALLBACK  Callback;
+};
+
+void             MAC_TxInit(void);
+void             MAC_TxFrame(INT8U HeaderSize, INT8U FrameSize);
+MAC_TX_REQUEST  *MAC_TxRequest(INT8U Trigger, INT8U Policy, INT8U Class, MAC_TX_CALLBACK Callback);
+INT8U            MAC_TxFree(INT8U Class);
+void             MAC_TxSubmit(MAC_TX_REQUEST *request);
+void             MAC_TxRetry(MAC_TX_REQUEST *request);
+INT8U            MAC_TxSendWait(INT8U Trigger);
+MAC_TX_REQUEST  *MAC_TxNext(void);
+void             MAC_TxDone(MAC_TX_REQUEST *request, INT8U status);
+const MAC_TX_POLICY_STAT *MAC_TxPolicyStat(INT8U Policy);
+const MAC_TX_CLASS_STAT  *MAC_TxClassStat(INT8U Class);
 
 
 typedef struct _UNET_BEACON
@@ -215,28 +357,6 @@ typedef struct _UNET_BEACON
 } UNET_BEACON;
 
 
-
-enum packet_states
-{
-    start_packet,
-    dest_00,
-    dest_01,
-    dest_10,
-    dest_11,
-    intra_pan,
-    source_000,
-    source_001,
-    source_010,
-    source_011,    
-    source_100,
-    source_101,
-    source_110,
-    source_111,
-    payload,
-    CRC,
-    end_packet
-};
-
 typedef union _MAC_TASKS_PENDING
 {
     INT8U Val;
@@ -318,7 +438,9 @@ extern  volatile INT8U              SequenceNumber;
 extern  volatile INT8U              AssociateAddress[8];
 extern  volatile MAC_FRAME_CONTROL  mac_frame_control;
 extern  volatile MAC_TASKS_PENDING  mac_tasks_pending;
-extern  volatile UNET_PACKET      unet_packet;
+extern  MAC_FRAME_VIEW            *mac_frame;
+extern  MAC_FRAME_VIEW            *nwk_frame;
+extern  INT8U                     mac_tx_fifo[2 + MAX_PHY_PACKETSIZE];
 extern  volatile UNET_BEACON      unet_beacon[BeaconLimit];
 extern  volatile INT8U              BeaconCnt;
 
@@ -67,10 +67,19 @@ volatile UNET_ROUTING_UP_TABLE           unet_routing_up_table[ROUTING_UP_TABLE_
 
 // Payload das mensagens roteadas
 volatile INT8U                 			NWKPayload[MAX_APP_PAYLOAD_SIZE];
+INT8U                                   NWKPayloadSend = 0;
+
+// Mensagens do pool de envio do frame em mac_tx_fifo, para a prxima requisio (NWK_TxSubmit)
+static INT8U                            nwk_tx_send = 0;
+
+// Pacote em roteamento na tarefa de rede
+MAC_FRAME_VIEW                          *nwk_frame;
 
 #if (NWK_MUTEX_TYPE == BRTOS_MUTEX)
-/* Mutex for Radio IEEE 802.15.4 */
-BRTOS_Mutex                  *Radio_IEEE802;
+/* Mutexes das guardas da rede, na ordem de aquisio (NWK_LOCK_PACKET ... NWK_LOCK_TX).
+   Com NWK_GLOBAL_LOCK somente o primeiro  criado e guarda todo o rdio */
+#define NWK_LOCKS                 4
+static BRTOS_Mutex           *NWK_Guard[NWK_LOCKS];
 #endif
 
 static   INT16U              DepthWatchdog        = 0;
@@ -82,32 +91,121 @@ volatile INT8U				 ReactiveUpTimeCnt    = 1;
 volatile INT16U 			 ReactiveUpCnt        = 0;
 #endif
 
-volatile NWK_TASKS_PENDING   nwk_tasks_pending;
+volatile INT16U              nwk_tasks_pending;
+
+/* Cabealhos MAC pr-montados dos pacotes de rede (frame control, PAN ID e
+endereo fonte), atualizados por NWK_HeaderTemplates. Na transmisso somente
+o sequence number e o destino so completados */
+static INT8U                 nwk_data_header[NWK_MAC_HEADER_SIZE];
+static INT8U                 nwk_ping_header[NWK_MAC_HEADER_SIZE];
+
+
+// Monta os cabealhos MAC dos pacotes de rede a partir do PAN ID e do endereo do n.
+// Deve ser chamada sempre que macPANId ou macAddr forem alterados
+void NWK_HeaderTemplates(void)
+{
+  INT16U panid;
+  INT16U addr;
+  INT8U  i;
+
+  UserEnterCritical();
+  panid = macPANId;
+  addr  = macAddr;
+
+  // Data frame com pedido de ACK, intrapan; destino e fonte de 16b
+  nwk_data_header[0] = 0x61;
+  nwk_data_header[1] = 0x88;
+  nwk_data_header[2] = 0x00;                   // sequence number
+  nwk_data_header[3] = (INT8U)(panid & 0xFF);
+  nwk_data_header[4] = (INT8U)(panid >> 8);
+  nwk_data_header[5] = 0xFF;                   // destino
+  nwk_data_header[6] = 0xFF;
+  nwk_data_header[7] = (INT8U)(addr & 0xFF);
+  nwk_data_header[8] = (INT8U)(addr >> 8);
+
+  // Ping de vizinhana: data frame sem ACK para o endereo de broadcast
+  nwk_ping_header[0] = 0x41;
+  for (i = 1; i < NWK_MAC_HEADER_SIZE; i++)
+  {
+    nwk_ping_header[i] = nwk_data_header[i];
+  }
+  UserExitCritical();
+}
+
+
+// Adquire as guardas de locks (NWK_LOCK_*) na ordem PACKET, NEIGHBOR, UP_ROUTE, TX
+void NWK_Lock(INT8U locks)
+{
+#if (NWK_GLOBAL_LOCK == 1)
+    (void)locks;
+    OSMutexAcquire(NWK_Guard[0]);
+#else
+    INT8U i;
+    
+    for (i = 0; i < NWK_LOCKS; i++)
+    {
+      if (locks & (1 << i))
+      {
+        OSMutexAcquire(NWK_Guard[i]);
+      }
+    }
+#endif
+}
 
+// Libera as guardas de locks na ordem inversa da aquisio
+void NWK_Unlock(INT8U locks)
+{
+#if (NWK_GLOBAL_LOCK == 1)
+    (void)locks;
+    OSMutexRelease(NWK_Guard[0]);
+#else
+    INT8U i = NWK_LOCKS;
+    
+    while (i > 0)
+    {
+      i--;
+      if (locks & (1 << i))
+      {
+        OSMutexRelease(NWK_Guard[i]);
+      }
+    }
+#endif
+}
 
 //Funo para adquirir direito exclusivo ao radio
 void acquireRadio(void)
 {  
-    OSMutexAcquire(Radio_IEEE802);
+    NWK_Lock(NWK_LOCK_ALL);
 }
 
 //Funo para liberar o radio
 void releaseRadio(void)
 {
-    OSMutexRelease(Radio_IEEE802);
+    NWK_Unlock(NWK_LOCK_ALL);
 }
 
 
 /* 
-   Cria um mutex informando que o recurso est disponvel
-   aps a inicializao da prioridade mxima a acessar o recurso = priority
+   Cria os mutexes das guardas informando que os recursos esto disponveis.
+   O teto de cada mutex  a prioridade livre acima das tarefas que usam a guarda
+   (UNET_Mutex_Priority, UNET_Neighbor_Priority, UNET_UpRoute_Priority, UNET_TxFifo_Priority)
 */
-void init_radio_resource(INT8U priority)
+void init_radio_resource(void)
 {
-  if (OSMutexCreate(&Radio_IEEE802,priority) != ALLOC_EVENT_OK)
+#if (NWK_GLOBAL_LOCK == 1)
+  if (OSMutexCreate(&NWK_Guard[0],UNET_Mutex_Priority) != ALLOC_EVENT_OK)
   {
     while(1){};
   };
+#else
+  if ((OSMutexCreate(&NWK_Guard[0],UNET_Mutex_Priority) != ALLOC_EVENT_OK) ||
+      (OSMutexCreate(&NWK_Guard[1],UNET_Neighbor_Priority) != ALLOC_EVENT_OK) ||
+      (OSMutexCreate(&NWK_Guard[2],UNET_UpRoute_Priority) != ALLOC_EVENT_OK) ||
+      (OSMutexCreate(&NWK_Guard[3],UNET_TxFifo_Priority) != ALLOC_EVENT_OK))
+  {
+    while(1){};
+  };
+#endif
 }
 
 // Monta pacote de comando Neighbor Ping
@@ -126,39 +224,24 @@ void NeighborPing(void)
                             
   // Inicia montagem do pacote Data
   
-  // Indicao de Beacon no Frame Control
-  PHYSetLongRAMAddr(2, 0x41);
-  HeaderSize++;
-  
-  // Indicao de Dest e Source Address de 16b, no Frame Control    
-  PHYSetLongRAMAddr(3, 0x88);
-  HeaderSize++;  
+  // Cabealho pr-montado: frame control, PAN ID, destino broadcast e endereo fonte
+  for (i = 0; i < NWK_MAC_HEADER_SIZE; i++)
+  {
+    mac_tx_fifo[2 + i] = nwk_ping_header[i];
+  }
+  HeaderSize = NWK_MAC_HEADER_SIZE;
   
   // Sequence Number
-  PHYSetLongRAMAddr(4, SequenceNumber);
+  mac_tx_fifo[4] = SequenceNumber;
   if (++SequenceNumber == 0) SequenceNumber = 1;
-  HeaderSize++;
-  
-  // PanId do coordenador que gera o data packet
-  PHYSetLongRAMAddr(5, (INT8U)(macPANId & 0xFF));
-  PHYSetLongRAMAddr(6, (INT8U)(macPANId >> 8));
-  
-  // Endereo de destino broadcast do data packet
-  PHYSetLongRAMAddr(7, (INT8U)0xFF);
-  PHYSetLongRAMAddr(8, (INT8U)0xFF);
-  
-  // Endereo fonte do data packet
-  PHYSetLongRAMAddr(9, (INT8U)(macAddr & 0xFF));
-  PHYSetLongRAMAddr(10, (INT8U)(macAddr >> 8));
-  HeaderSize += 6;  
   
   
   // Enviar dados do pacote de vizinhana padro da rede
   // Tipo de pacote de dados
-  PHYSetLongRAMAddr(11, DATA_PING);
+  mac_tx_fifo[11] = DATA_PING;
   PayloadSize++;
 
-  PHYSetLongRAMAddr(12, thisNodeDepth);
+  mac_tx_fifo[12] = thisNodeDepth;
   PayloadSize++;
 
   address = 12;
@@ -168,22 +251,16 @@ void NeighborPing(void)
   {
     if (unet_neighbourhood[i].Addr_16b != 0xFFFE)
     {
-      PHYSetLongRAMAddr((INT16U)(++address), (INT8U)(unet_neighbourhood[i].Addr_16b >> 8));
-      PHYSetLongRAMAddr((INT16U)(++address), (INT8U)(unet_neighbourhood[i].Addr_16b & 0xFF));
-      PHYSetLongRAMAddr((INT16U)(++address), (INT8U)(unet_neighbourhood[i].NeighborRSSI & 0xFF));
+      mac_tx_fifo[++address] = (INT8U)(unet_neighbourhood[i].Addr_16b >> 8);
+      mac_tx_fifo[++address] = (INT8U)(unet_neighbourhood[i].Addr_16b & 0xFF);
+      mac_tx_fifo[++address] = (INT8U)(unet_neighbourhood[i].NeighborRSSI & 0xFF);
       PayloadSize += 3;
     }
   }
 
-  // Informao do tamanho do MAC header em bytes
-  // No modo no seguro  ignorado
-  PHYSetLongRAMAddr(0x000,HeaderSize);
-  // Informao do tamanho em bytes do MAC header + Payload
-  PHYSetLongRAMAddr(0x001,(INT8U)(HeaderSize+PayloadSize));
-
-  //transmit packet without ACK requested
-  mac_tasks_pending.bits.PacketPendingAck = 1;
-  PHYSetShortRAMAddr(WRITE_TXNMTRIG,0b00000001);
+  // Tamanho do MAC header (ignorado no modo no seguro) e do MAC header + Payload.
+  // Transmitido sem pedido de ACK (MAC_TX_NO_ACK) pela tarefa UNET_TX
+  MAC_TxFrame(HeaderSize, (INT8U)(HeaderSize+PayloadSize));
 }
 
 
@@ -233,6 +310,9 @@ void VerifyNewAddress(void)
 #endif
 #endif
   }
+
+  // Cabealhos dos pacotes de rede com o novo endereo
+  NWK_HeaderTemplates();
 }
 
 
@@ -243,14 +323,14 @@ INT8U VerifyPacketReplicated(void)
     
     for(i=0;i<NEIGHBOURHOOD_SIZE;i++)
     {
-        if (unet_neighbourhood[i].Addr_16b == mac_packet.SrcAddr_16b)
+        if (unet_neighbourhood[i].Addr_16b == MAC_RX_SRC_ADDR_16B())
         {
-          if (unet_neighbourhood[i].NeighborLastID == mac_packet.Sequence_Number)
+          if (unet_neighbourhood[i].NeighborLastID == MAC_RX_SEQUENCE_NUMBER())
           {
             return TRUE;
           }else
           {
-            unet_neighbourhood[i].NeighborLastID = mac_packet.Sequence_Number;
+            unet_neighbourhood[i].NeighborLastID = MAC_RX_SEQUENCE_NUMBER();
             unet_neighbourhood[i].IDTimeout      = LAST_ID_SYSTEM_TIMER_TIMEOUT;
             return FALSE;
           }
@@ -261,6 +341,64 @@ INT8U VerifyPacketReplicated(void)
 
 
 
+// Decodifica o cabealho NWK do frame recebido, completo ou comprimido (NWK_COMPRESSED),
+// nos campos de mac_frame lidos pelas macros NWK_RX_*
+INT8U NWK_HeaderParse(void)
+{
+    INT8U *header = mac_frame->MAC_Payload;
+    INT8U  size   = 0;
+    
+    if (mac_frame->Payload_Size < NWK_COMPRESSED_OVERHEAD)
+    {
+      return ROUTE_FRAME_ERROR;
+    }
+    
+    if ((header[1] & NWK_COMPRESSED) == NWK_COMPRESSED)
+    {
+      size = NWK_COMPRESSED_HEADER_SIZE(header[1], header[2]);
+      if (mac_frame->Payload_Size < size)
+      {
+        return ROUTE_FRAME_ERROR;
+      }
+      
+      mac_frame->Nwk_Life    = header[2];
+      header += NWK_COMPRESSED_OVERHEAD;
+      
+      // Pacote no sentido do coordenador
+      if ((mac_frame->MAC_Payload[1] & NWK_DIRECTION) == NWK_DIRECTION)
+      {
+        mac_frame->Nwk_Destiny = 0x0000;
+      }else
+      {
+        mac_frame->Nwk_Destiny = (INT16U)(header[0] | (header[1] << 8));
+        header += 2;
+      }
+      
+      // Primeiro salto: a fonte  o n que transmitiu o frame
+      if (mac_frame->Nwk_Life == 0)
+      {
+        mac_frame->Nwk_Source = MAC_RX_SRC_ADDR_16B();
+      }else
+      {
+        mac_frame->Nwk_Source = (INT16U)(header[0] | (header[1] << 8));
+      }
+    }else
+    {
+      if (mac_frame->Payload_Size < NWK_OVERHEAD)
+      {
+        return ROUTE_FRAME_ERROR;
+      }
+      
+      size = NWK_OVERHEAD;
+      mac_frame->Nwk_Destiny = (INT16U)(header[2] | (header[3] << 8));
+      mac_frame->Nwk_Source  = (INT16U)(header[4] | (header[5] << 8));
+      mac_frame->Nwk_Life    = header[6];
+    }
+    
+    mac_frame->Nwk_Header_Size = size;
+    return OK;
+}
+
 void VerifyNeighbourhoodLastIDTimeout(void)
 {
     INT8U i = 0;
@@ -482,6 +620,7 @@ void HandleNewNeighborPing(void)
 #if (defined CHECK_DUPLICATE_MAC) && (CHECK_DUPLICATE_MAC == 1)              
               if(++foundme == 2){ // MAC duplicado ?
                  macAddr = (INT16U)(macAddr + RadioRand()); //pequena mudana no MAC address
+                 NWK_HeaderTemplates();
                  foundme = 0; 
               }
 #endif              
@@ -508,153 +647,371 @@ void HandleNewNeighborPing(void)
 
 
 
+// Escreve o cabealho NWK em mac_tx_fifo a partir de FrameIndex e retorna o ndice do payload.
+// Com NWK_HEADER_COMPRESSION o cabealho  comprimido (NWK_COMPRESSED) sempre que
+// o receptor pode inferir os campos omitidos
+static INT8U NWK_RouteHeader(INT8U FrameIndex, INT8U r_parameter, INT16U destiny, INT16U source, INT8U packet_life)
+{
+#if (NWK_HEADER_COMPRESSION == 1)
+  INT8U down = (INT8U)((r_parameter & NWK_DIRECTION) == NWK_DIRECTION);
+  
+  if (((down == FALSE) || (destiny == 0x0000)) && ((packet_life != 0) || (source == macAddr)))
+  {
+    mac_tx_fifo[FrameIndex++] = ROUTE_PACKET;
+    mac_tx_fifo[FrameIndex++] = (INT8U)(r_parameter | NWK_COMPRESSED);
+    mac_tx_fifo[FrameIndex++] = packet_life;
+    
+    // No sentido do coordenador o destino final  o coordenador
+    if (down == FALSE)
+    {
+      mac_tx_fifo[FrameIndex++] = (INT8U)(destiny & 0xFF);
+      mac_tx_fifo[FrameIndex++] = (INT8U)(destiny >> 8);
+    }
+    
+    // No primeiro salto a fonte  o endereo MAC fonte do frame
+    if (packet_life != 0)
+    {
+      mac_tx_fifo[FrameIndex++] = (INT8U)(source & 0xFF);
+      mac_tx_fifo[FrameIndex++] = (INT8U)(source >> 8);
+    }
+    return FrameIndex;
+  }
+#endif
+  
+  // Tipo de pacote de dados
+  mac_tx_fifo[FrameIndex++] = ROUTE_PACKET;
+  
+  // Adiciona os parametros de roteamento
+  // Sentido de transmisso
+  // Verificao se  o destino do pacote
+  // outros
+  mac_tx_fifo[FrameIndex++] = r_parameter;
+  
+  // Endereo de rede do destino final e do n fonte
+  mac_tx_fifo[FrameIndex++] = (INT8U)(destiny & 0xFF);
+  mac_tx_fifo[FrameIndex++] = (INT8U)(destiny >> 8);
+  mac_tx_fifo[FrameIndex++] = (INT8U)(source & 0xFF);
+  mac_tx_fifo[FrameIndex++] = (INT8U)(source >> 8);
+  
+  // Adiciona o tempo de vida do pacote
+  // ou seja, numero de saltos
+  mac_tx_fifo[FrameIndex++] = packet_life;
+  
+  return FrameIndex;
+}
+
 // Monta pacote de comando NWK
 // o payload do pacote ser copiado do vetor NWKPayload
 void NWK_Command(INT16U Address, INT8U r_parameter, INT8U payload_size, INT8U packet_life, INT16U destiny)
 {
   INT8U i = 0;
   INT8U FrameIndex = 0;
-  INT8U HeaderSize = 0;
-  INT8U PayloadSize = 0;
   INT8U tmp = 0;
                             
   // Inicia montagem do pacote NWK Command
   // Inicia montagem do pacote Data p/ roteamento
   
-  // Indicao de Beacon no Frame Control
-  PHYSetLongRAMAddr(2, 0x61);
-  HeaderSize++;
-  
-  // Indicao de Dest e Source Address de 16b, no Frame Control
-  PHYSetLongRAMAddr(3, 0x88);
-  HeaderSize++;
- 
+  // Cabealho pr-montado: frame control, PAN ID e endereo fonte
+  // No precisa PANId da fonte pq o pacote  intrapan
+  for (i = 0; i < NWK_MAC_HEADER_SIZE; i++)
+  {
+    mac_tx_fifo[2 + i] = nwk_data_header[i];
+  }
   
   // Sequence Number
   UserEnterCritical();
   tmp = SequenceNumber;
   UserExitCritical();
   
-  PHYSetLongRAMAddr(4, tmp);  
-  
-  HeaderSize++;
-  
-  // PanId do coordenador que gera o data packet
-  PHYSetLongRAMAddr(5, (INT8U)(macPANId & 0xFF));
-  PHYSetLongRAMAddr(6, (INT8U)(macPANId >> 8));
+  mac_tx_fifo[NWK_TX_SEQUENCE] = tmp;  
   
   // Endereo de destino do data packet
-  PHYSetLongRAMAddr(7, (INT8U)(Address & 0xFF));
-  PHYSetLongRAMAddr(8, (INT8U)(Address >> 8));
-  
-  // No precisa PANId da fonte pq
-  // o pacote  intrapan
-      
-  // Endereo fonte do data packet
-  PHYSetLongRAMAddr(9, (INT8U)(macAddr & 0xFF));
-  PHYSetLongRAMAddr(10, (INT8U)(macAddr >> 8));
-  HeaderSize += 6;
-  FrameIndex = 11;
-  
-  // Tipo de pacote de dados
-  PHYSetLongRAMAddr(FrameIndex, ROUTE_PACKET);
-  FrameIndex++;
-  PayloadSize++;
+  mac_tx_fifo[NWK_TX_DESTINATION]   = (INT8U)(Address & 0xFF);
+  mac_tx_fifo[NWK_TX_DESTINATION+1] = (INT8U)(Address >> 8);
+  FrameIndex = 2 + NWK_MAC_HEADER_SIZE;
   
-  // Adiciona os parametros de roteamento
-  // Sentido de transmisso
-  // Verificao se  o destino do pacote
-  // outros
-  PHYSetLongRAMAddr(FrameIndex, r_parameter);
-  FrameIndex++;
-  PayloadSize++;  
-                        
-  // Adiciona endereo de rede (localizao GPS)  
   if (packet_life == 0)
   {
-    // Endereo mac do destino final
-	PHYSetLongRAMAddr(FrameIndex++, (INT8U)(destiny & 0xFF));
-	PHYSetLongRAMAddr(FrameIndex++, (INT8U)(destiny >> 8));
+    // Endereo de rede do destino final, o n fonte  este n
+    FrameIndex = NWK_RouteHeader(FrameIndex, r_parameter, destiny, macAddr, 0);
     
-    // Endereo mac do n fonte
-	PHYSetLongRAMAddr(FrameIndex++, (INT8U)(macAddr & 0xFF));
-	PHYSetLongRAMAddr(FrameIndex++, (INT8U)(macAddr >> 8));
+    for(i=0;i<payload_size;i++)
+    {
+      mac_tx_fifo[FrameIndex++] = NWKPayload[i];
+    }  
+    
+    // A mensagem do pool de envio segue com este frame
+    nwk_tx_send    = NWKPayloadSend;
+    NWKPayloadSend = 0;
+    
+      /* keep stats */
+      IncUNET_NodeStat_apptxed();
+        
   }else
   {
+    // Um payload agregado continua agregado
+    r_parameter = (INT8U)(r_parameter | (NWK_RX_PARAMETER() & NWK_AGGREGATE));
+    
     // Copia os endereos de rede de destino e fonte
-        
-    // Copia os endereos de rede (endereo do n de destino final)
-    tmp = (INT8U)(nwk_packet.NWK_Destiny & 0xFF);
-    PHYSetLongRAMAddr(FrameIndex++, (INT8U)(tmp));
-    tmp = (INT8U)(nwk_packet.NWK_Destiny >> 8);
-    PHYSetLongRAMAddr(FrameIndex++, (INT8U)(tmp));
+    FrameIndex = NWK_RouteHeader(FrameIndex, r_parameter, NWK_RX_DESTINY(), NWK_RX_SOURCE(), packet_life);
     
-    // Copia os endereos de rede (endereo do n fonte)
-    tmp = (INT8U)(nwk_packet.NWK_Source & 0xFF);
-    PHYSetLongRAMAddr(FrameIndex++, (INT8U)(tmp));
-    tmp = (INT8U)(nwk_packet.NWK_Source >> 8);
-    PHYSetLongRAMAddr(FrameIndex++, (INT8U)(tmp));
+    // Copia somente o payload da mensagem do pacote anterior
+    for(i=0;i<payload_size;i++)
+    {
+      mac_tx_fifo[FrameIndex++] = NWK_RX_PAYLOAD[i];
+    }    
+  }
+
+  // Tamanho do MAC header (ignorado no modo no seguro) e do MAC header + Payload.
+  // Transmitido com pedido de ACK (MAC_TX_ACK) pela tarefa UNET_TX, ver NWK_TxSubmit
+  MAC_TxFrame(NWK_MAC_HEADER_SIZE, (INT8U)(FrameIndex - 2));
+}
+
+
+/* Uso de MAC_TX_REQUEST.Arg pelas requisies de roteamento */
+#define NWK_TX_BLACKLIST        (INT16U)0x00FF    // vizinhos que falharam (DownRoute)
+#define NWK_TX_CONTROL          (INT16U)0x1000    // manuteno de rotas: classe MAC_TX_CLASS_CONTROL
+#define NWK_TX_WAKE             (INT16U)0x2000    // UNET_TX liga o rdio para a transmisso (ContikiMAC)
+#define NWK_TX_NEIGHBOR         (INT16U)0x4000    // Node  o ndice do vizinho na tabela
+#define NWK_TX_FORWARD          (INT16U)0x8000    // pacote repassado: conta routdrop se falhar
+
+// Liga o rdio, se estiver dormindo, para uma transmisso. Chamada pela tarefa UNET_TX
+// antes de transmitir uma requisio com Wake: a espera pela estabilizao do rdio no
+// fica na deciso de roteamento, com as guardas da tarefa de rede
+void NWK_TxRadioWake(void)
+{
+#if ((CONTIKI_MAC_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))
+  if (!GetRadioStatus()){
+	SetRadioStatus(1);
+	RADIO_WAKE_STATUS_OLD = RADIO_WAKE_STATUS;
+	// Se o rdio estiver desligado, liga o radio
+	if( RADIO_WAKE_STATUS == RADIO_SLEEPING){
+	  // Liga o rdio e espera tempo de estabilizao
+	  WakeupRadio();
+	  DelayTask(2);
+	}
+  }
+#endif
+}
+
+static void NWK_TxRadioSleep(INT16U Arg)
+{
+#if ((CONTIKI_MAC_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))
+  if ((Arg & NWK_TX_WAKE) == NWK_TX_WAKE)
+  {
+    SetRadioStatus(0);
+	// Se no estado anterior o radio estava desligado, desliga o radio agora
+	if( RADIO_WAKE_STATUS_OLD == RADIO_SLEEPING) SleepRadio();
   }
+#else
+  (void)Arg;
+#endif
+}
+
+// Coloca na fila de transmisso o frame montado por NWK_Command, com pedido de ACK
+// e as retransmisses da poltica (MAC_TX_ROUTE, ...). Os pacotes repassados seguem na
+// classe MAC_TX_CLASS_ROUTE, a manuteno de rotas na MAC_TX_CLASS_CONTROL e as
+// mensagens da aplicao deste n na MAC_TX_CLASS_APP.
+// O resultado  entregue ao callback pela tarefa UNET_TX
+static INT8U NWK_TxSubmit(INT8U Node, INT8U Policy, INT16U Arg, MAC_TX_CALLBACK Callback)
+{
+  INT8U tx_class = MAC_TX_CLASS_APP;
+  INT8U send = nwk_tx_send;
+  MAC_TX_REQUEST *request;
   
-  PayloadSize +=4;
+  nwk_tx_send = 0;
   
-  // Adiciona o tempo de vida do pacote
-  // ou seja, numero de saltos
-  PHYSetLongRAMAddr(FrameIndex++, packet_life);
-  PayloadSize++;
+  if ((Arg & NWK_TX_FORWARD) == NWK_TX_FORWARD)
+  {
+    tx_class = MAC_TX_CLASS_ROUTE;
+  }else if ((Arg & NWK_TX_CONTROL) == NWK_TX_CONTROL)
+  {
+    tx_class = MAC_TX_CLASS_CONTROL;
+  }
   
-  if (packet_life == 0)
+  request = MAC_TxRequest(MAC_TX_ACK, Policy, tx_class, Callback);
+  if (request == NULL)
   {
-    for(i=0;i<payload_size;i++)
+    return TX_QUEUE_FULL;
+  }
+  
+  request->Node   = Node;
+  request->Arg    = Arg;
+  request->Wake   = (INT8U)(((Arg & NWK_TX_WAKE) == NWK_TX_WAKE) ? TRUE : FALSE);
+  request->Send   = send;
+  MAC_TxSubmit(request);
+  
+  // Increments Packet Sequence ID
+  // Used to identify replicated packets
+  UserEnterCritical();
+  if (++SequenceNumber == 0) SequenceNumber = 1;
+  UserExitCritical();
+  
+  return OK;
+}
+
+// Fim de uma transmisso de roteamento (tarefa UNET_TX, com NWK_LOCK_NEIGHBOR e NWK_LOCK_TX)
+static void NWK_TxDone(MAC_TX_REQUEST *request, INT8U status)
+{
+  if (status == OK)
+  {
+    if ((request->Arg & NWK_TX_NEIGHBOR) == NWK_TX_NEIGHBOR)
     {
-      PHYSetLongRAMAddr(FrameIndex++, NWKPayload[i]);
-      PayloadSize++;
-    }  
-    
-      /* keep stats */
-      IncUNET_NodeStat_apptxed();
-        
+      // Informa atividade do n
+      NeighborTable = (NEIGHBOR_TABLE_T)(NeighborTable | (NEIGHBOR_TABLE_T)(0x01 << request->Node));
+      unet_neighbourhood[request->Node].NeighborStatus.bits.Symmetric = TRUE;
+    }
   }else
   {
-    // Copia o payload do pacote anterior
-    for(i=0;i<payload_size;i++)
+    if ((request->Arg & NWK_TX_FORWARD) == NWK_TX_FORWARD)
     {
-      // Copia somente o payload da mensagem
-      // Cabealho MAC + Rede           = 11 bytes
-      // Endereos de Rede  			= 4 bytes
-      // Tempo de vida do pacote        =  1 byte
-      // Total                          = 16 bytes
-      tmp = nwk_packet.NWK_Payload[i];
-      PHYSetLongRAMAddr(FrameIndex++, (INT8U)(tmp));
-      PayloadSize++;
-    }    
+      UNET_FwdDrop(NWK_DROP_TX_FAILED);
+    }
   }
+  
+  if (request->Send != 0)
+  {
+    NWK_SendDone(request->Send, status);
+  }
+  
+  NWK_TxRadioSleep(request->Arg);
+}
+
 
-  // Informao do tamanho do MAC header em bytes
-  // No modo no seguro  ignorado
-  PHYSetLongRAMAddr(0x000,HeaderSize);
+// Entrega  aplicao a mensagem APP do pacote em roteamento, ou uma a uma as mensagens
+// de um frame agregado. Chamada pela tarefa de rede com NWK_LOCK_ROUTE, que  liberada
+// durante a entrega: UNET_APP copia cada mensagem para a caixa de mensagens da aplicao
+// e retorna, e o pacote continua sendo da tarefa de rede
+static void NWK_AppDeliver(void)
+{
+  INT8U *record;
+  INT8U  left;
+  INT8U  size;
+  
+  NWK_Unlock(NWK_LOCK_ROUTE);
+  
+  left = NWK_RX_PAYLOAD_SIZE();
+  
+  if ((NWK_RX_PARAMETER() & NWK_AGGREGATE) != NWK_AGGREGATE)
+  {
+    UNET_APP(NWK_RX_PAYLOAD, left, NWK_RX_SOURCE(), NWK_RX_TIMESTAMP());
+  }else
+  {
+    record = NWK_RX_PAYLOAD;
+    while (left >= NWK_AGGR_RECORD_HEADER)
+    {
+      size = record[0];
+      if ((INT8U)(left - NWK_AGGR_RECORD_HEADER) < size)
+      {
+        // Registro truncado
+        break;
+      }
+      
+      UNET_APP(&record[NWK_AGGR_RECORD_HEADER], size, (INT16U)(record[1] | (record[2] << 8)), NWK_RX_TIMESTAMP());
+      
+      record = &record[NWK_AGGR_RECORD_HEADER + size];
+      left   = (INT8U)(left - (NWK_AGGR_RECORD_HEADER + size));
+    }
+  }
   
-  // Informao do tamanho em bytes do MAC header + Payload
-  PHYSetLongRAMAddr(0x001,(INT8U)(HeaderSize+PayloadSize));
+  NWK_Lock(NWK_LOCK_ROUTE);
+}
+
+#if ((NWK_AGGREGATION_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))
+static INT8U NWK_Aggregate(INT8U RouteInit, INT8U NWKPayloadSize);
+#endif
 
-  // transmit packet with ACK requested
-  // Para solicitar ACK, bit2 = 1
-  mac_tasks_pending.bits.PacketPendingAck = 1;
-  PHYSetShortRAMAddr(WRITE_TXNMTRIG,0b00000101);
+
+#if (USE_REACTIVE_UP_ROUTE == 1)
+// Aprende a rota up para source pelo vizinho que transmitiu o pacote em roteamento,
+// a hops saltos (1: o prprio vizinho). Chamada com NWK_LOCK_UP_ROUTE
+static void NWK_UpRouteLearn(INT16U source, INT8U hops)
+{
+	INT8U i = 0;
+	INT8U match_count = 0;
+
+	// ********************************************************************************
+	// Guarda a informao de rota do n que passou por este roteador no sentido para o roteador (down)
+	// Verifica se ja existe este endereo na tabela
+	for(i=0;i<ROUTING_UP_TABLE_SIZE;i++)
+	{
+	  match_count = 0;
+
+	  // match count = 8 para manter compatibilidade
+	  // Procura se o n fonte do pacote j est na up routing table
+	  if (source == unet_routing_up_table[i].DestinyAddr) match_count = 8;
+
+	  if (match_count == 8)
+	  {
+		// Para o lao "for" se encontrar o endereo na lista de vizinhos
+		// E faz com que a maquina de estados repasse o pacote
+		// ao seu destino
+		break;
+	  }
+	}
+
+	// Se no est na tabela
+	if (match_count != 8)
+	{
+		// Procura posio vazia
+		for(i=0;i<ROUTING_UP_TABLE_SIZE;i++)
+		{
+		  if (unet_routing_up_table[i].Addr_16b == 0xFFFE)
+		  {
+			match_count = 8;
+			break;
+		  }
+		}
+
+	}
+
+	// Se existe posio na tabela ou estiver atualizando a posio
+	if (match_count == 8)
+	{
+	  unet_routing_up_table[i].Addr_16b = NWK_RX_MAC_SOURCE();
+	  unet_routing_up_table[i].Destination = (INT8U)((hops == 1) ? TRUE : FALSE);
+	  // Copia o endereo do n de origem do pacote para a lista de rotas up disponveis
+	  unet_routing_up_table[i].DestinyAddr = source;
+	  unet_routing_up_table[i].hops 	   = hops;
+	  unet_routing_up_table[i].activity	   = TRUE;
+	}
 }
 
+// Um frame agregado (NWK_AGGREGATE) tem como fonte o n que agregou: as rotas up
+// para os ns cujas mensagens ele carrega so aprendidas pelas fontes dos registros
+static void NWK_UpRouteLearnRecords(void)
+{
+	INT8U *record = NWK_RX_PAYLOAD;
+	INT8U  left   = NWK_RX_PAYLOAD_SIZE();
+	INT16U source;
+
+	while (left >= NWK_AGGR_RECORD_HEADER)
+	{
+	  if ((INT8U)(left - NWK_AGGR_RECORD_HEADER) < record[0])
+	  {
+		// Registro truncado
+		break;
+	  }
+
+	  source = (INT16U)(record[1] | (record[2] << 8));
+	  if (source != NWK_RX_SOURCE())
+	  {
+		// A mensagem de um n atrs do vizinho percorreu no mximo os saltos do frame
+		NWK_UpRouteLearn(source, (INT8U)((source == NWK_RX_MAC_SOURCE()) ? 1 : (NWK_RX_PACKET_LIFE() + 1)));
+	  }
+
+	  left   = (INT8U)(left - (NWK_AGGR_RECORD_HEADER + record[0]));
+	  record = &record[NWK_AGGR_RECORD_HEADER + record[0]];
+	}
+}
+#endif
 
 INT8U HandleRoutePacket(void)
 {
   INT8U i = 0;
   INT8U match_count = 0;
-  INT8U semaphore_return = 0;
-  INT8U attempts = 0;
   INT8U state = 0;  
   INT8U nwk_state ; /* Varivel utilizada na mquina de estados de roteamento */
-#if (CONTIKI_MAC_ENABLE == 1)    
-    INT16U start_time, stop_time;
-#endif  
   
   // Verifica se o destino existe na tabela de vizinhos   
   // Inicia mquina de estados para decodificar pacote e realizar roteamento
@@ -667,7 +1024,7 @@ INT8U HandleRoutePacket(void)
       case start_route:
         // Verifica o tempo de vida do pacote
         // Se maior que nwkMaxDepth saltos, descarta o pacote
-        if ((INT8U)(nwk_packet.NWK_Packet_Life+1) > nwkMaxDepth)
+        if ((INT8U)(NWK_RX_PACKET_LIFE()+1) > nwkMaxDepth)
         {
           nwk_state = end_route;
           state = PACKET_LIFE_ERROR;          
@@ -676,58 +1033,11 @@ INT8U HandleRoutePacket(void)
 
           #if (USE_REACTIVE_UP_ROUTE == 1)
         	// Se for mensagem DOWN, entra aqui, independente de ser destino ou no
-        	if ((nwk_packet.NWK_Parameter&NWK_DIRECTION) == NOT_DEST_DOWN){
-				// ********************************************************************************
-				// Guarda a informao de rota do n que passou por este roteador no sentido para o roteador (down)
-				// Verifica se ja existe este endereo na tabela
-				for(i=0;i<ROUTING_UP_TABLE_SIZE;i++)
+        	if ((NWK_RX_PARAMETER()&NWK_DIRECTION) == NOT_DEST_DOWN){
+				NWK_UpRouteLearn(NWK_RX_SOURCE(), (INT8U)(NWK_RX_PACKET_LIFE() + 1));
+				if ((NWK_RX_PARAMETER() & NWK_AGGREGATE) == NWK_AGGREGATE)
 				{
-				  match_count = 0;
-
-				  // match count = 8 para manter compatibilidade
-				  // Procura se o n fonte do pacote j est na up routing table
-				  if (nwk_packet.NWK_Source == unet_routing_up_table[i].DestinyAddr) match_count = 8;
-
-				  if (match_count == 8)
-				  {
-					// Para o lao "for" se encontrar o endereo na lista de vizinhos
-					// E faz com que a maquina de estados repasse o pacote
-					// ao seu destino
-					break;
-				  }
-				}
-
-				// Se no est na tabela
-				if (match_count != 8)
-				{
-					// Procura posio vazia
-					for(i=0;i<ROUTING_UP_TABLE_SIZE;i++)
-					{
-					  if (unet_routing_up_table[i].Addr_16b == 0xFFFE)
-					  {
-						match_count = 8;
-						break;
-					  }
-					}
-
-				}
-
-				// Se existe posio na tabela ou estiver atualizando a posio
-				if (match_count == 8)
-				{
-				  unet_routing_up_table[i].Addr_16b = mac_packet.SrcAddr_16b;
-				  if (nwk_packet.NWK_Packet_Life == 0)
-				  {
-					unet_routing_up_table[i].Destination = TRUE;
-				  }else
-				  {
-					unet_routing_up_table[i].Destination = FALSE;
-				  }
-				  // Copia o endereo do n de origem do pacote para a lista de rotas up disponveis
-				  unet_routing_up_table[i].DestinyAddr = nwk_packet.NWK_Source;
-				  unet_routing_up_table[i].hops 	   = nwk_packet.NWK_Packet_Life + 1;
-				  unet_routing_up_table[i].activity	   = TRUE;
-
+				  NWK_UpRouteLearnRecords();
 				}
         	}
           #endif
@@ -737,7 +1047,7 @@ INT8U HandleRoutePacket(void)
           // Informa atividade do n
           for(i=0;i<NEIGHBOURHOOD_SIZE;i++) 
           {            
-            if (mac_packet.SrcAddr_16b == unet_neighbourhood[i].Addr_16b)
+            if (NWK_RX_MAC_SOURCE() == unet_neighbourhood[i].Addr_16b)
             {
                 NeighborTable = (NEIGHBOR_TABLE_T)(NeighborTable | (NEIGHBOR_TABLE_T)(0x01 << i));
                 unet_neighbourhood[i].NeighborStatus.bits.Symmetric = TRUE;
@@ -746,10 +1056,10 @@ INT8U HandleRoutePacket(void)
           }
           
           // Verifica se o n  o destino do pacote
-          if(nwk_packet.NWK_Packet_Type == BROADCAST_PACKET || nwk_packet.NWK_Parameter&NWK_BROADCAST){
+          if(NWK_RX_PACKET_TYPE() == BROADCAST_PACKET || NWK_RX_PARAMETER()&NWK_BROADCAST){
             nwk_state = broadcast;
           }else{
-            if ((nwk_packet.NWK_Parameter&NWK_DEST) == NWK_DEST)
+            if ((NWK_RX_PARAMETER()&NWK_DEST) == NWK_DEST)
             {
               nwk_state = call_app_layer;
             } else
@@ -762,7 +1072,7 @@ INT8U HandleRoutePacket(void)
         break;
       case broadcast:
           // repassa pacote
-          UpBroadcastRoute((INT8U)(mac_packet.Payload_Size - NWK_OVERHEAD));
+          UpBroadcastRoute(NWK_RX_PAYLOAD_SIZE());
           // depois passa uma cpia para a camada de aplicao
           nwk_state = call_app_layer;
       break;
@@ -775,7 +1085,7 @@ INT8U HandleRoutePacket(void)
 
           if (unet_neighbourhood[i].NeighborStatus.bits.Symmetric == TRUE)
           {          
-              if (nwk_packet.NWK_Destiny == unet_neighbourhood[i].Addr_16b){
+              if (NWK_RX_DESTINY() == unet_neighbourhood[i].Addr_16b){
             	  match_count = 8;
             	  break;
               }
@@ -786,12 +1096,11 @@ INT8U HandleRoutePacket(void)
         {
           // Encontrou o destino na lista de vizinhos
           match_count = i;
-          attempts = 0;
           nwk_state = send_dest_packet;
         }else
         {
           // Continua o processo de roteamento
-          if ((nwk_packet.NWK_Parameter&NWK_DIRECTION) == NOT_DEST_UP)
+          if ((NWK_RX_PARAMETER()&NWK_DIRECTION) == NOT_DEST_UP)
           {
             nwk_state = route_up;
           }else
@@ -823,119 +1132,34 @@ INT8U HandleRoutePacket(void)
         break;
                 
       case send_dest_packet:
-        // Envia o pacote para o seu destino
-        attempts = 0;
-#if ((CONTIKI_MAC_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))
-    	SetRadioStatus(1);
-	    RADIO_WAKE_STATUS_OLD = RADIO_WAKE_STATUS;
-	    // Se o rdio estiver desligado, liga o radio
-	    if( RADIO_WAKE_STATUS == RADIO_SLEEPING){
-		  // Liga o rdio e espera tempo de estabilizao
-		  WakeupRadio();
-		  DelayTask(2);
-	    }
-#endif
-#if (CONTIKI_MAC_ENABLE == 1)
-        start_time = OSGetTickCount();
-        stop_time = 0;
-#endif
-        
-        // Tenta rotear o pacote NWK_TX_RETRIES vezes
-#if (CONTIKI_MAC_ENABLE == 1)
-        // Tenta entregar o pacote em pelo menos duas janelas
-        while (stop_time < ((CONTIKI_MAC_WINDOW*2)+10))
-#else
-        while (attempts < NWK_TX_RETRIES)
-#endif
-        {        	
-#if (CONTIKI_MAC_ENABLE != 1)          
-          if (attempts < (NWK_TX_RETRIES-1)){
-#endif
-        	if ((nwk_packet.NWK_Parameter&NWK_DIRECTION) == NWK_DIRECTION){
-        		NWK_Command(unet_neighbourhood[match_count].Addr_16b, DEST_DOWN, (INT8U)(mac_packet.Payload_Size - NWK_OVERHEAD),(INT8U)(nwk_packet.NWK_Packet_Life+1),0);
-        	}else{
-        		NWK_Command(unet_neighbourhood[match_count].Addr_16b, DEST_UP, (INT8U)(mac_packet.Payload_Size - NWK_OVERHEAD),(INT8U)(nwk_packet.NWK_Packet_Life+1),0);
-        	}
-            semaphore_return = OSSemPend(RF_TX_Event,(INT16U)(TX_TIMEOUT+RadioRand()));
-            
-            if (semaphore_return == OK)
-            {
-              if (macACK == TRUE) 
-              {
-                unet_neighbourhood[match_count].NeighborStatus.bits.Symmetric = TRUE;
-                
-                nwk_state = end_route;
-                state = OK;
-                // Sai do lao while
-                break;
-              }else 
-              {
-                attempts++;
-                // Espera tempo de bursting error
-#if (CONTIKI_MAC_ENABLE != 1) 
-                //DelayTask((INT16U)(RadioRand()*30));
-                DelayTask((INT16U)(RadioRand()+30));
-#endif
-              }
-            } else
-            {              
-              // Radio provavelmente travou, efetuar o reset
-              attempts++;
-
-              //  Disable receiving packets off air
-              PHYSetShortRAMAddr(WRITE_BBREG1,0x04);              
-              
-              MRF24J40Reset();
-
-              //  Enable receiving packets off air
-              PHYSetShortRAMAddr(WRITE_BBREG1,0x00);    
-            }
-#if (CONTIKI_MAC_ENABLE != 1)            
-			}else
-			{
-				// Se estourou o nmero de tentativas, desiste de rotear por este n
-				nwk_state = end_route;
-				state = ROUTE_ATTEMPTS_ERROR;
-				break;
-			}
-#endif          
-#if (CONTIKI_MAC_ENABLE == 1)
-    		// Descobre o tempo total do processo
-    		stop_time = OSGetTickCount();
-
-    		if (stop_time > start_time)
-    		{
-    			stop_time = stop_time - start_time;
-    		}else
-    		{
-    			stop_time = stop_time + (TICK_COUNT_OVERFLOW - start_time);
-			}
-#endif          
-        }
-        
-#if (CONTIKI_MAC_ENABLE == 1)        
-        if (stop_time >= (CONTIKI_MAC_WINDOW+5)){
+        #if ((NWK_AGGREGATION_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))
+        // Mensagem para o coordenador vizinho: espera no buffer de agregao
+        if ((NWK_RX_PARAMETER()&NWK_DIRECTION) == NWK_DIRECTION)
+        {
+          state = NWK_Aggregate(IN_PROGRESS_ROUTE, 0);
+          if (state == OK)
+          {
             nwk_state = end_route;
-            state = ROUTE_ATTEMPTS_ERROR;
+            break;
+          }
         }
-#endif        
-        
-        // Increments Packet Sequence ID
-        // Used to identify replicated packets
-        UserEnterCritical();
-        if (++SequenceNumber == 0) SequenceNumber = 1;
-        UserExitCritical();        
+        #endif
         
-#if ((CONTIKI_MAC_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))		        
-        SetRadioStatus(0);
-		// Se no estado anterior o radio estava desligado, desliga o radio agora
-		if( RADIO_WAKE_STATUS_OLD == RADIO_SLEEPING) SleepRadio();
-#endif        
+        // Envia o pacote para o seu destino
+    	if ((NWK_RX_PARAMETER()&NWK_DIRECTION) == NWK_DIRECTION){
+    		NWK_Command(unet_neighbourhood[match_count].Addr_16b, DEST_DOWN, NWK_RX_PAYLOAD_SIZE(),(INT8U)(NWK_RX_PACKET_LIFE()+1),0);
+    	}else{
+    		NWK_Command(unet_neighbourhood[match_count].Addr_16b, DEST_UP, NWK_RX_PAYLOAD_SIZE(),(INT8U)(NWK_RX_PACKET_LIFE()+1),0);
+    	}
+    	
+        // Tenta entregar o pacote NWK_TX_RETRIES-1 vezes (ContikiMAC: em pelo menos duas janelas)
+        state = NWK_TxSubmit(match_count, MAC_TX_DELIVER, (INT16U)(NWK_TX_NEIGHBOR | NWK_TX_FORWARD | NWK_TX_WAKE), NWK_TxDone);
+        nwk_state = end_route;
         break;
         
       case call_app_layer:
         // Acorda a tarefa de aplicao e termina o processo de roteamento
-        UNET_APP();
+        NWK_AppDeliver();
         nwk_state = end_route;
         state = OK;
         break;
@@ -954,43 +1178,16 @@ INT8U HandleRoutePacket(void)
 }
 
 
-// Realiza o roteamento no sentido do PAN Coordinator "NearBase"
-INT8U DownRoute(INT8U RouteInit, INT8U NWKPayloadSize)
+// Seleciona o vizinho de menor profundidade (e maior RSSI nesta profundidade)
+// fora da black list, dando preferncia aos vizinhos simtricos.
+// Retorna a profundidade do n selecionado ou 255 se no houver n
+static INT8U DownRouteSelect(INT16U BlackList, INT8U *selected)
 {
-
   INT8U   i = 0;
   INT8U   selected_node = 0;
-  INT8U   attempts = 0;
-  INT8U   semaphore_return = 0;
   INT8U   MinorDepth = 255;
   INT8U   MaxRSSI = 0;
-  INT16U  BlackList = 0;
-#if (CONTIKI_MAC_ENABLE == 1)
-  INT16U start_time, stop_time;
-#endif
-  
-  
-  if (NWKPayloadSize > MAX_APP_PAYLOAD_SIZE){   
-       return PAYLOAD_OVERFLOW;
-  }
   
-  if (thisNodeDepth >= ROUTE_TO_BASESTATION_LOST){
-      return NO_ROUTE_AVAILABLE;
-  }
-
-  // Se est enviando uma mensagem no sentido do coordenador
-  // no precisa de mensagem de manuteno de rota up
-  UserEnterCritical();
-  ReactiveUpCnt = 0;
-  UserExitCritical();
-
-  // Encontra a menor profundidade na tabela de vizinhos
-  TryAnotherNodeDown:
-   
-    MinorDepth = 255;
-    MaxRSSI = 0;
-    selected_node = 0;
-    
     // Varrendo a tabela de vizinhos em busca do n simtrico de menor profundidade
     for(i=0;i<NEIGHBOURHOOD_SIZE;i++)
     {
@@ -1073,197 +1270,341 @@ INT8U DownRoute(INT8U RouteInit, INT8U NWKPayloadSize)
       }
     }
     
-    // Se selecionou um n para tentativa de roteamento
+    *selected = selected_node;
+    return MinorDepth;
+}
+
+// Fim de uma transmisso de DownRoute (tarefa UNET_TX, com NWK_LOCK_NEIGHBOR e NWK_LOCK_TX).
+// Se estourou o nmero de tentativas, desiste de rotear por este n
+// e reenvia o mesmo frame para o prximo n de menor profundidade
+static void DownRouteDone(MAC_TX_REQUEST *request, INT8U status)
+{
+  INT8U selected_node = 0;
+  INT8U MinorDepth = 255;
+  
+  if (status != OK)
+  {
+    request->Arg = (INT16U)(request->Arg | (1 << request->Node));
+    MinorDepth = DownRouteSelect((INT16U)(request->Arg & NWK_TX_BLACKLIST), &selected_node);
+    
     if (MinorDepth != 255)
-    {      
-      attempts = 0;
-      
-#if ((CONTIKI_MAC_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))
-      	if (!GetRadioStatus()){
-			SetRadioStatus(1);
-			RADIO_WAKE_STATUS_OLD = RADIO_WAKE_STATUS;
-			// Se o rdio estiver desligado, liga o radio
-			if( RADIO_WAKE_STATUS == RADIO_SLEEPING){
-			  // Liga o rdio e espera tempo de estabilizao
-			  WakeupRadio();
-			  DelayTask(2);
-			}
-      	}
-#endif
-#if (CONTIKI_MAC_ENABLE == 1)
-        start_time = OSGetTickCount();
-        stop_time = 0;
-#endif
-        
-        // Tenta rotear o pacote NWK_TX_RETRIES vezes
-#if (CONTIKI_MAC_ENABLE == 1)
-        while (stop_time < (CONTIKI_MAC_WINDOW+5))
-#else
-        while (attempts < NWK_TX_RETRIES)
-#endif
-        {        	
-#if (CONTIKI_MAC_ENABLE != 1)          
-          if (attempts < (NWK_TX_RETRIES-1)){
-#endif
-          // Envia pacote a ser roteado
-          if (RouteInit != START_ROUTE)
-          {
-            if (MinorDepth == 0)              
-              NWK_Command(unet_neighbourhood[selected_node].Addr_16b, DEST_DOWN, (INT8U)(mac_packet.Payload_Size - NWK_OVERHEAD),(INT8U)(nwk_packet.NWK_Packet_Life+1),0);
-            else
-              NWK_Command(unet_neighbourhood[selected_node].Addr_16b, NOT_DEST_DOWN, (INT8U)(mac_packet.Payload_Size - NWK_OVERHEAD),(INT8U)(nwk_packet.NWK_Packet_Life+1),0);
-          }else
-          {
-            if (MinorDepth == 0)
-              NWK_Command(unet_neighbourhood[selected_node].Addr_16b, DEST_DOWN, NWKPayloadSize,0,0);
-            else
-              NWK_Command(unet_neighbourhood[selected_node].Addr_16b, NOT_DEST_DOWN, NWKPayloadSize,0,0);
-          }
-          // Espera confirmao de recepo
-          semaphore_return = OSSemPend(RF_TX_Event,(INT16U)(TX_TIMEOUT+RadioRand()));
-          
-          // Se foi recebido, ok
-          if (semaphore_return == OK)
-          {
-            if (macACK == TRUE) 
-            {
-              i = OK;
-              
-              // Informa atividade do n
-              NeighborTable = (NEIGHBOR_TABLE_T)(NeighborTable | (NEIGHBOR_TABLE_T)(0x01 << selected_node));
-              unet_neighbourhood[selected_node].NeighborStatus.bits.Symmetric = TRUE;
-              
-              // Sai do lao while
-              break;
-            }else 
-            {
-              attempts++;
-              // Espera tempo de bursting error
-#if (CONTIKI_MAC_ENABLE != 1) 
-                //DelayTask((INT16U)(RadioRand()*30));
-              DelayTask((INT16U)(RadioRand()+30));
+    {
+      request->Fifo[NWK_TX_DESTINATION]   = (INT8U)(unet_neighbourhood[selected_node].Addr_16b & 0xFF);
+      request->Fifo[NWK_TX_DESTINATION+1] = (INT8U)(unet_neighbourhood[selected_node].Addr_16b >> 8);
+      request->Fifo[NWK_TX_PARAMETER]     = (INT8U)((request->Fifo[NWK_TX_PARAMETER] & (NWK_AGGREGATE | NWK_COMPRESSED)) |
+                                                    ((MinorDepth == 0) ? DEST_DOWN : NOT_DEST_DOWN));
+      request->Node                       = selected_node;
+      MAC_TxRetry(request);
+      return;
+    }
+  }
+  
+  NWK_TxDone(request, status);
+}
+
+// Realiza o roteamento no sentido do PAN Coordinator "NearBase".
+// Arg: NWK_TX_CONTROL para as mensagens de manuteno de rotas, que no so agregadas
+static INT8U NWK_DownRoute(INT8U RouteInit, INT8U NWKPayloadSize, INT16U Arg)
+{
+
+  INT8U   selected_node = 0;
+  INT8U   MinorDepth = 255;
+  INT8U   parameter = 0;
+  INT16U  arg = (INT16U)(Arg | NWK_TX_NEIGHBOR | NWK_TX_WAKE);
+  
+  
+  if (NWKPayloadSize > MAX_APP_PAYLOAD_SIZE){   
+       return PAYLOAD_OVERFLOW;
+  }
+  
+  if (thisNodeDepth >= ROUTE_TO_BASESTATION_LOST){
+      return NO_ROUTE_AVAILABLE;
+  }
+
+  // Se est enviando uma mensagem no sentido do coordenador
+  // no precisa de mensagem de manuteno de rota up
+  UserEnterCritical();
+  ReactiveUpCnt = 0;
+  UserExitCritical();
+
+#if ((NWK_AGGREGATION_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))
+  // Mensagem para o coordenador: espera no buffer de agregao
+  if (((Arg & NWK_TX_CONTROL) == 0) && (NWK_Aggregate(RouteInit, NWKPayloadSize) == OK))
+  {
+    return OK;
+  }
 #endif
-            }
-          } else
-          {
-              // Radio provavelmente travou, efetuar o reset
-              attempts++;
 
-              //  Disable receiving packets off air
-              PHYSetShortRAMAddr(WRITE_BBREG1,0x04);              
-              
-              MRF24J40Reset();
+  // Encontra a menor profundidade na tabela de vizinhos
+  MinorDepth = DownRouteSelect(0, &selected_node);
+    
+  // Se no selecionou um n para tentativa de roteamento
+  if (MinorDepth == 255)
+  {
+    return NO_ROUTE_AVAILABLE;
+  }
+  
+  parameter = (MinorDepth == 0) ? DEST_DOWN : NOT_DEST_DOWN;
+  
+  // Envia pacote a ser roteado
+  if (RouteInit != START_ROUTE)
+  {
+    NWK_Command(unet_neighbourhood[selected_node].Addr_16b, parameter, NWK_RX_PAYLOAD_SIZE(),(INT8U)(NWK_RX_PACKET_LIFE()+1),0);
+    arg |= NWK_TX_FORWARD;
+  }else
+  {
+    NWK_Command(unet_neighbourhood[selected_node].Addr_16b, parameter, NWKPayloadSize,0,0);
+  }
+  
+  // Tenta rotear o pacote NWK_TX_RETRIES-1 vezes por n (ContikiMAC: durante uma janela),
+  // os demais ns so tentados em DownRouteDone
+  return NWK_TxSubmit(selected_node, MAC_TX_ROUTE, arg, DownRouteDone);
+}
 
-              //  Enable receiving packets off air
-              PHYSetShortRAMAddr(WRITE_BBREG1,0x00);
-          }
-#if (CONTIKI_MAC_ENABLE != 1)            
-          }else
-          {
-            // Se estourou o nmero de tentativas, desiste de rotear por este n
-            i = ROUTE_NODE_ERROR;
-            BlackList = (INT16U)(BlackList | (1 << selected_node));
-            goto TryAnotherNodeDown;            
-          }
-#endif 
-#if (CONTIKI_MAC_ENABLE == 1)
-    		// Descobre o tempo total do processo
-    		stop_time = OSGetTickCount();
-
-    		if (stop_time > start_time)
-    		{
-    			stop_time = stop_time - start_time;
-    		}else
-    		{
-    			stop_time = stop_time + (TICK_COUNT_OVERFLOW - start_time);
-			}
-#endif    		
-        }
-#if (CONTIKI_MAC_ENABLE == 1)        
-		if (stop_time >= (CONTIKI_MAC_WINDOW+5)){
-			// Se estourou o nmero de tentativas, desiste de rotear por este n
-			i = ROUTE_NODE_ERROR;
-			BlackList = (INT16U)(BlackList | (1 << selected_node));
-			goto TryAnotherNodeDown;
-		}
-#endif        
-    }else
+INT8U DownRoute(INT8U RouteInit, INT8U NWKPayloadSize)
+{
+  return NWK_DownRoute(RouteInit, NWKPayloadSize, 0);
+}
+
+#if ((NWK_AGGREGATION_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))
+/* Agregao das mensagens para o coordenador: as mensagens APP deste n e as
+   repassadas dos filhos esperam at NWK_AGGREGATION_HOLD ticks e seguem juntas em
+   um frame NWK_AGGREGATE. Acessado somente com a guarda NWK_LOCK_TX */
+typedef struct _NWK_AGGREGATION
+{
+  INT8U     Data[MAX_APP_PAYLOAD_SIZE];     // registros (NWK_AGGR_RECORD_HEADER + mensagem APP)
+  INT8U     Size;
+  INT8U     Packets;                        // pacotes agregados
+  INT8U     Forwarded;                      // pacotes agregados repassados de outros ns
+  INT8U     Life;                           // saltos j percorridos pelas mensagens repassadas
+  INT8U     Send;                           // mensagens do pool de envio agregadas (NWK_SEND_MASK)
+  ostick_t  Start;                          // instante do primeiro pacote
+} NWK_AGGREGATION;
+
+static NWK_AGGREGATION nwk_aggregation;
+
+// Monta em mac_tx_fifo o frame com as mensagens agregadas, para o coordenador
+static void NWK_AggregationFrame(INT16U Address, INT8U r_parameter)
+{
+  INT8U i = 0;
+  INT8U FrameIndex = 0;
+  
+  for (i = 0; i < NWK_MAC_HEADER_SIZE; i++)
+  {
+    mac_tx_fifo[2 + i] = nwk_data_header[i];
+  }
+  
+  UserEnterCritical();
+  mac_tx_fifo[NWK_TX_SEQUENCE] = SequenceNumber;
+  UserExitCritical();
+  
+  mac_tx_fifo[NWK_TX_DESTINATION]   = (INT8U)(Address & 0xFF);
+  mac_tx_fifo[NWK_TX_DESTINATION+1] = (INT8U)(Address >> 8);
+  FrameIndex = 2 + NWK_MAC_HEADER_SIZE;
+  
+  // Para o coordenador, com este n como fonte
+  FrameIndex = NWK_RouteHeader(FrameIndex, (INT8U)(r_parameter | NWK_AGGREGATE), 0x0000, macAddr, nwk_aggregation.Life);
+  
+  for (i = 0; i < nwk_aggregation.Size; i++)
+  {
+    mac_tx_fifo[FrameIndex++] = nwk_aggregation.Data[i];
+  }
+  nwk_tx_send = nwk_aggregation.Send;
+  
+  MAC_TxFrame(NWK_MAC_HEADER_SIZE, (INT8U)(FrameIndex - 2));
+}
+
+// Envia as mensagens agregadas pela rota down. Se a fila de transmisso estiver
+// cheia as mensagens continuam agregadas; sem rota elas so descartadas
+static INT8U NWK_AggregationFlush(void)
+{
+  INT8U   selected_node = 0;
+  INT8U   MinorDepth = 255;
+  INT8U   state = NO_ROUTE_AVAILABLE;
+  INT16U  arg = NWK_TX_NEIGHBOR | NWK_TX_WAKE;
+  
+  if (nwk_aggregation.Packets == 0)
+  {
+    return OK;
+  }
+  
+  if (thisNodeDepth < ROUTE_TO_BASESTATION_LOST)
+  {
+    MinorDepth = DownRouteSelect(0, &selected_node);
+  }
+  
+  if (MinorDepth != 255)
+  {
+    NWK_AggregationFrame(unet_neighbourhood[selected_node].Addr_16b, (MinorDepth == 0) ? DEST_DOWN : NOT_DEST_DOWN);
+    if (nwk_aggregation.Life != 0)
+    {
+      arg |= NWK_TX_FORWARD;
+    }
+    state = NWK_TxSubmit(selected_node, MAC_TX_ROUTE, arg, DownRouteDone);
+    if (state == TX_QUEUE_FULL)
     {
-      i = NO_ROUTE_AVAILABLE;
+      return state;
     }
+  }
+  
+  if (state != OK)
+  {
+    // Somente os pacotes repassados contam como descartes do repasse
+    for (; nwk_aggregation.Forwarded > 0; nwk_aggregation.Forwarded--)
+    {
+      UNET_FwdDrop(NWK_DROP_NO_ROUTE);
+    }
+    if (nwk_aggregation.Send != 0)
+    {
+      NWK_SendDone(nwk_aggregation.Send, state);
+    }
+  }
+  
+  nwk_aggregation.Size      = 0;
+  nwk_aggregation.Packets   = 0;
+  nwk_aggregation.Forwarded = 0;
+  nwk_aggregation.Life      = 0;
+  nwk_aggregation.Send      = 0;
+  return state;
+}
 
-    // Increments Packet Sequence ID
-    // Used to identify replicated packets
-    UserEnterCritical();
-    if (++SequenceNumber == 0) SequenceNumber = 1;
-    UserExitCritical();
-    
-#if ((CONTIKI_MAC_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))		        
-    SetRadioStatus(0);
-	// Se no estado anterior o radio estava desligado, desliga o radio agora
-	if( RADIO_WAKE_STATUS_OLD == RADIO_SLEEPING) SleepRadio();
-#endif    
-    
-    return i;
+// Coloca no buffer de agregao a mensagem da aplicao (START_ROUTE, em NWKPayload)
+// ou o pacote recebido para o coordenador. Retorna OK se o pacote foi agregado;
+// caso contrrio o pacote deve seguir sozinho
+static INT8U NWK_Aggregate(INT8U RouteInit, INT8U NWKPayloadSize)
+{
+  INT8U  i;
+  INT8U  size;
+  INT8U  total;
+  INT8U  life;
+  INT8U  record = TRUE;           // FALSE: o payload j  uma lista de registros
+  INT16U source;
+  volatile INT8U *data;
+  
+  if (RouteInit == START_ROUTE)
+  {
+    data   = NWKPayload;
+    size   = NWKPayloadSize;
+    source = macAddr;
+    life   = 0;
+  }else
+  {
+    if (NWK_RX_DESTINY() != 0x0000)
+    {
+      return ROUTE_NODE_ERROR;
+    }
+    data   = NWK_RX_PAYLOAD;
+    size   = NWK_RX_PAYLOAD_SIZE();
+    source = NWK_RX_SOURCE();
+    life   = (INT8U)(NWK_RX_PACKET_LIFE() + 1);
+    if ((NWK_RX_PARAMETER() & NWK_AGGREGATE) == NWK_AGGREGATE)
+    {
+      record = FALSE;
+    }
+  }
+  
+  total = size;
+  if (record == TRUE)
+  {
+    total = (INT8U)(size + NWK_AGGR_RECORD_HEADER);
+  }
+  if ((size > MAX_APP_PAYLOAD_SIZE) || (total > MAX_APP_PAYLOAD_SIZE))
+  {
+    return PAYLOAD_OVERFLOW;
+  }
+  
+  // No cabe com as mensagens j agregadas: envia as anteriores
+  if ((INT8U)(nwk_aggregation.Size + total) > MAX_APP_PAYLOAD_SIZE)
+  {
+    if (NWK_AggregationFlush() == TX_QUEUE_FULL)
+    {
+      return TX_QUEUE_FULL;
+    }
+  }
+  
+  if (record == TRUE)
+  {
+    nwk_aggregation.Data[nwk_aggregation.Size++] = size;
+    nwk_aggregation.Data[nwk_aggregation.Size++] = (INT8U)(source & 0xFF);
+    nwk_aggregation.Data[nwk_aggregation.Size++] = (INT8U)(source >> 8);
+  }
+  for (i = 0; i < size; i++)
+  {
+    nwk_aggregation.Data[nwk_aggregation.Size++] = data[i];
+  }
+  
+  if (life > nwk_aggregation.Life)
+  {
+    nwk_aggregation.Life = life;
+  }
+  
+  if (RouteInit == START_ROUTE)
+  {
+    IncUNET_NodeStat_apptxed();
+    nwk_aggregation.Send = (INT8U)(nwk_aggregation.Send | NWKPayloadSend);
+    NWKPayloadSend = 0;
+  }else
+  {
+    nwk_aggregation.Forwarded++;
+  }
+  
+  if (nwk_aggregation.Packets++ == 0)
+  {
+    // Acorda a tarefa de rede, que envia as mensagens ao fim do tempo de espera
+    nwk_aggregation.Start = OSGetTickCount();
+    OSSemPost(MAC_Event);
+  }
+  
+  // No cabe outra mensagem: envia j
+  if ((INT8U)(MAX_APP_PAYLOAD_SIZE - nwk_aggregation.Size) < (NWK_AGGR_RECORD_HEADER + APP_HEADER_SIZE))
+  {
+    (void)NWK_AggregationFlush();
+  }
+  
+  return OK;
+}
+
+// Chamada pela tarefa de rede com NWK_LOCK_NEIGHBOR e NWK_LOCK_TX: envia as mensagens agregadas
+// h NWK_AGGREGATION_HOLD ticks. Retorna os ticks at o prximo envio (0: nada agregado)
+ostick_t NWK_AggregationPoll(void)
+{
+  ostick_t elapsed;
+  
+  if (nwk_aggregation.Packets == 0)
+  {
+    return 0;
+  }
+  
+  elapsed = UNET_TicksSince(nwk_aggregation.Start);
+  if (elapsed < NWK_AGGREGATION_HOLD)
+  {
+    return (ostick_t)(NWK_AGGREGATION_HOLD - elapsed);
+  }
+  
+  if (NWK_AggregationFlush() == TX_QUEUE_FULL)
+  {
+    // Tenta de novo no prximo tick
+    return 1;
+  }
+  return 0;
 }
+#endif
 
 // Envia mensagens para todos os ns com maior profundidade a 1 salto de distncia
 INT8U UpSimpleRoute(INT8U NWKPayloadSize)
 {
   INT8U i = 0;
-  INT8U attempts = 0;
-  INT8U semaphore_return = 0;
     
   // Varrendo a tabela de vizinhos em busca de ns com maior profundidade
   for(i=0;i<NEIGHBOURHOOD_SIZE;i++)
   {
     if(unet_neighbourhood[i].NeighborDepth == (thisNodeDepth + 1))
     {
-      attempts = 0;
+      // Envia pacote a ser roteado
+      NWK_Command(unet_neighbourhood[i].Addr_16b, DEST_UP, NWKPayloadSize,0,unet_neighbourhood[i].Addr_16b);
       
-      // Tenta rotear o pacote NWK_TX_RETRIES vezes
-      while (attempts <= NWK_TX_RETRIES)
-      {
-          // Envia pacote a ser roteado
-          NWK_Command(unet_neighbourhood[i].Addr_16b, DEST_UP, NWKPayloadSize,0,unet_neighbourhood[i].Addr_16b);
-          // Espera confirmao de recepo
-          semaphore_return = OSSemPend(RF_TX_Event,(INT16U)(TX_TIMEOUT+RadioRand()));
-          
-          // Se foi recebido, ok
-          if (semaphore_return == OK)
-          {
-            if (macACK == TRUE) 
-            {
-              i = OK;
-              unet_neighbourhood[i].NeighborStatus.bits.Symmetric = TRUE;
-              // Sai do lao while
-              break;
-            }else 
-            {
-              attempts++;
-              // Espera tempo de bursting error
-              //DelayTask((INT16U)(RadioRand()*30));
-              DelayTask((INT16U)(RadioRand()+30));
-            }
-          } else
-          {
-              // Radio provavelmente travou, efetuar o reset
-              attempts++;
-
-              //  Disable receiving packets off air
-              PHYSetShortRAMAddr(WRITE_BBREG1,0x04);              
-              
-              MRF24J40Reset();
-
-              //  Enable receiving packets off air
-              PHYSetShortRAMAddr(WRITE_BBREG1,0x00);
-          }
-      }
-      // Increments Packet Sequence ID
-      // Used to identify replicated packets
-      UserEnterCritical();
-      if (++SequenceNumber == 0) SequenceNumber = 1;
-      UserExitCritical();
+      // Tenta rotear o pacote NWK_TX_RETRIES+1 vezes
+      (void)NWK_TxSubmit(i, MAC_TX_NEIGHBOURS, NWK_TX_NEIGHBOR, NWK_TxDone);
     }
     
     return i;
@@ -1278,8 +1619,6 @@ INT8U UpSimpleRoute(INT8U NWKPayloadSize)
 INT8U UpBroadcastRoute(INT8U NWKPayloadSize)
 {
   INT8U i = 0;
-  INT8U attempts = 0;
-  INT8U semaphore_return = 0;
   INT8U ret = ROUTE_ATTEMPTS_ERROR;
   
     
@@ -1289,51 +1628,11 @@ INT8U UpBroadcastRoute(INT8U NWKPayloadSize)
   
     if(unet_neighbourhood[i].NeighborDepth == (thisNodeDepth + 1))
     {
-      attempts = 0;
+      // Envia pacote a ser roteado
+      NWK_Command(unet_neighbourhood[i].Addr_16b, NWK_BROADCAST, NWKPayloadSize,0,0xFFFF);
       
-      // Tenta rotear o pacote NWK_TX_RETRIES vezes
-      while (attempts <= NWK_TX_RETRIES)
-      {
-          // Envia pacote a ser roteado
-          NWK_Command(unet_neighbourhood[i].Addr_16b, NWK_BROADCAST, NWKPayloadSize,0,0xFFFF);
-          
-          // Espera confirmao de recepo
-          semaphore_return = OSSemPend(RF_TX_Event,(INT16U)(TX_TIMEOUT+RadioRand()));
-          
-          // Se foi recebido, ok
-          if (semaphore_return == OK)
-          {
-            if (macACK == TRUE) 
-            {
-              ret = OK; 
-              unet_neighbourhood[i].NeighborStatus.bits.Symmetric = TRUE;
-              break;  // Sai do lao while
-            }else 
-            {
-              attempts++;
-              // Espera tempo de bursting error
-              //DelayTask((INT16U)(RadioRand()*30));
-              DelayTask((INT16U)(RadioRand()+30));
-            }
-          } else
-          {
-              // Radio provavelmente travou, efetuar o reset
-              attempts++;
-
-              //  Disable receiving packets off air
-              PHYSetShortRAMAddr(WRITE_BBREG1,0x04);              
-              
-              MRF24J40Reset();
-
-              //  Enable receiving packets off air
-              PHYSetShortRAMAddr(WRITE_BBREG1,0x00);
-          }
-      }
-      // Increments Packet Sequence ID
-      // Used to identify replicated packets
-      UserEnterCritical();
-      if (++SequenceNumber == 0) SequenceNumber = 1;
-      UserExitCritical();
+      // Tenta rotear o pacote NWK_TX_RETRIES+1 vezes
+      ret = NWK_TxSubmit(i, MAC_TX_NEIGHBOURS, NWK_TX_NEIGHBOR, NWK_TxDone);
     }
     
     return ret;
@@ -1348,14 +1647,8 @@ INT8U UpBroadcastRoute(INT8U NWKPayloadSize)
   {
     INT8U i = 0;
     INT8U j = 0;
-    INT8U attempts = 0;
     INT8U match_count = 0;
-    INT8U semaphore_return = 0;
-#if (CONTIKI_MAC_ENABLE == 1)    
-    INT16U start_time, stop_time;
-    volatile int counter1 = 0;
-    volatile int counter2 = 0;
-#endif
+    INT8U parameter = 0;
 
     if (RouteInit == IN_PROGRESS_ROUTE) 
     {
@@ -1364,7 +1657,7 @@ INT8U UpBroadcastRoute(INT8U NWKPayloadSize)
         match_count = 0;
 
         // Se achar o destino na tabela de rotas up
-        if (nwk_packet.NWK_Destiny == unet_routing_up_table[i].DestinyAddr) match_count = 8;
+        if (NWK_RX_DESTINY() == unet_routing_up_table[i].DestinyAddr) match_count = 8;
         
         if (match_count == 8) 
         {
@@ -1395,134 +1688,26 @@ INT8U UpBroadcastRoute(INT8U NWKPayloadSize)
     
     if (match_count == 8) 
     {
-        attempts = 0;
-        
-#if ((CONTIKI_MAC_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))
-    	SetRadioStatus(1);
-	    RADIO_WAKE_STATUS_OLD = RADIO_WAKE_STATUS;
-	    // Se o rdio estiver desligado, liga o radio
-	    if( RADIO_WAKE_STATUS == RADIO_SLEEPING){
-		  // Liga o rdio e espera tempo de estabilizao
-		  WakeupRadio();
-		  DelayTask(2);
-	    }
-#endif
-#if (CONTIKI_MAC_ENABLE == 1)
-        start_time = OSGetTickCount();
-        stop_time = 0;
-        counter1 = 0;
-        counter2 = 0;
-#endif
+        // Analisa se  o destino do pacote
+        if (unet_routing_up_table[i].Destination == TRUE)
+          parameter = DEST_UP;
+        else
+          parameter = NOT_DEST_UP;
         
-        // Tenta rotear o pacote NWK_TX_RETRIES vezes
-#if (CONTIKI_MAC_ENABLE == 1)
-        while (stop_time < ((CONTIKI_MAC_WINDOW+5)*2))
-#else
-        while (attempts < NWK_TX_RETRIES)
-#endif
-        {        	
-#if (CONTIKI_MAC_ENABLE != 1)          
-          if (attempts < (NWK_TX_RETRIES-1)){
-#endif
-            // Envia pacote a ser roteado
-            
-            // Analisa se  o destino do pacote
-            // Envia pacote a ser roteado
-            if (RouteInit == IN_PROGRESS_ROUTE)
-            {
-              if (unet_routing_up_table[i].Destination == TRUE)
-                NWK_Command(unet_routing_up_table[i].Addr_16b, DEST_UP, (INT8U)(mac_packet.Payload_Size - NWK_OVERHEAD),(INT8U)(nwk_packet.NWK_Packet_Life+1), 0);
-              else
-                NWK_Command(unet_routing_up_table[i].Addr_16b, NOT_DEST_UP, (INT8U)(mac_packet.Payload_Size - NWK_OVERHEAD),(INT8U)(nwk_packet.NWK_Packet_Life+1), 0);
-            }else
-            {
-              if (unet_routing_up_table[i].Destination == TRUE)
-                NWK_Command(unet_routing_up_table[i].Addr_16b, DEST_UP, NWKPayloadSize,0, destiny);
-              else
-                NWK_Command(unet_routing_up_table[i].Addr_16b, NOT_DEST_UP, NWKPayloadSize,0, destiny);
-            }
-            // Espera confirmao de recepo
-            semaphore_return = OSSemPend(RF_TX_Event,(INT16U)(TX_TIMEOUT+RadioRand()));
-
-            // Se foi recebido, ok
-            if (semaphore_return == OK)
-            {
-              if (macACK == TRUE) 
-              {
-                i = OK;
-                // Sai do lao while
-                break;
-              }else 
-              {
-                attempts++;
-#if (CONTIKI_MAC_ENABLE == 1)                
-                counter1++;
-#endif
-                // Espera tempo de bursting error
-#if (CONTIKI_MAC_ENABLE != 1) 
-                //DelayTask((INT16U)(RadioRand()*30));
-                DelayTask((INT16U)(RadioRand()+30));
-#endif
-              }
-            } else
-            {
-              // Radio provavelmente travou, efetuar o reset
-              attempts++;
-#if (CONTIKI_MAC_ENABLE == 1)              
-              counter2++;
-#endif
-
-              //  Disable receiving packets off air
-              PHYSetShortRAMAddr(WRITE_BBREG1,0x04);              
-              
-              MRF24J40Reset();
-
-              //  Enable receiving packets off air
-              PHYSetShortRAMAddr(WRITE_BBREG1,0x00);
-            }
-#if (CONTIKI_MAC_ENABLE != 1)            
-          }else
-          {
-            // Se estourou o nmero de tentativas, desiste de rotear por este n
-            j = ROUTE_NODE_ERROR;
-            break;
-          }
-#endif          
-#if (CONTIKI_MAC_ENABLE == 1)
-    		// Descobre o tempo total do processo
-    		stop_time = OSGetTickCount();
-
-    		if (stop_time >= start_time)
-    		{
-    			stop_time = stop_time - start_time;
-    		}else
-    		{
-    			stop_time = stop_time + (TICK_COUNT_OVERFLOW - start_time);
-			}
-#endif          
+        // Envia pacote a ser roteado
+        if (RouteInit == IN_PROGRESS_ROUTE)
+        {
+          NWK_Command(unet_routing_up_table[i].Addr_16b, parameter, NWK_RX_PAYLOAD_SIZE(),(INT8U)(NWK_RX_PACKET_LIFE()+1), 0);
+          j = NWK_TxSubmit(i, MAC_TX_DELIVER, (INT16U)(NWK_TX_FORWARD | NWK_TX_WAKE), NWK_TxDone);
+        }else
+        {
+          NWK_Command(unet_routing_up_table[i].Addr_16b, parameter, NWKPayloadSize,0, destiny);
+          j = NWK_TxSubmit(i, MAC_TX_DELIVER, NWK_TX_WAKE, NWK_TxDone);
         }
-        
-#if (CONTIKI_MAC_ENABLE == 1)        
-        if (stop_time >= (CONTIKI_MAC_WINDOW+5)) j = ROUTE_NODE_ERROR;
-        counter1 = 0;
-        counter2 = 0;
-#endif
-        
-        // Increments Packet Sequence ID
-        // Used to identify replicated packets
-        UserEnterCritical();
-        if (++SequenceNumber == 0) SequenceNumber = 1;
-        UserExitCritical();      
     }else
     {
       j = NO_ROUTE_AVAILABLE;
     }
-
-#if ((CONTIKI_MAC_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))		        
-    SetRadioStatus(0);
-	// Se no estado anterior o radio estava desligado, desliga o radio agora
-	if( RADIO_WAKE_STATUS_OLD == RADIO_SLEEPING) SleepRadio();
-#endif    
     
     return j;
   }
@@ -1531,8 +1716,6 @@ INT8U UpBroadcastRoute(INT8U NWKPayloadSize)
 INT8U OneHopRoute(INT8U NWKPayloadSize, INT16U destiny){
 
     INT8U       i = 0;
-    INT8U       attempts = 0;  
-    INT8U       semaphore_return = 0;
     INT8U       selected_node = 0;
     INT8U       match_count = 0;       
         
@@ -1563,65 +1746,11 @@ INT8U OneHopRoute(INT8U NWKPayloadSize, INT16U destiny){
     
       if (!match_count)   return NO_ROUTE_AVAILABLE;
     
-      // Tenta transmitir o pacote NWK_TX_RETRIES vezes
-      while (attempts < NWK_TX_RETRIES)
-      {
-        if (attempts < (NWK_TX_RETRIES-1))
-        {
-          // Envia pacote  
-          NWK_Command(unet_neighbourhood[selected_node].Addr_16b, DEST_UP, NWKPayloadSize,0, destiny);
-
-          // Espera confirmao de recepo
-          semaphore_return = OSSemPend(RF_TX_Event,(INT16U)(TX_TIMEOUT+RadioRand()));
-          
-          // Se foi recebido, ok
-          if (semaphore_return == OK)
-          {
-            if (macACK == TRUE) 
-            {
-              i = OK;
-              
-              // Informa atividade do n
-              NeighborTable = (NEIGHBOR_TABLE_T)(NeighborTable | (NEIGHBOR_TABLE_T)(0x01 << selected_node));                
-              unet_neighbourhood[i].NeighborStatus.bits.Symmetric = TRUE;
-              // Sai do lao while
-              break;
-            }else 
-            {
-              attempts++;
-              // Espera tempo de bursting error
-              //DelayTask((INT16U)(RadioRand()*30));
-              DelayTask((INT16U)(RadioRand()+30));
-            }
-          } else
-          {
-            // Radio provavelmente travou, efetuar o reset
-            attempts++;
-
-            //  Disable receiving packets off air
-            PHYSetShortRAMAddr(WRITE_BBREG1,0x04);              
-            
-            MRF24J40Reset();
-
-            //  Enable receiving packets off air
-            PHYSetShortRAMAddr(WRITE_BBREG1,0x00);
-          }
-        }else
-        {
-          i = NO_ROUTE_AVAILABLE;
-          break;
-        }
-      }                
-
+      // Envia pacote  
+      NWK_Command(unet_neighbourhood[selected_node].Addr_16b, DEST_UP, NWKPayloadSize,0, destiny);
       
-    // Increments Packet Sequence ID
-    // Used to identify replicated packets
-    UserEnterCritical();
-    if (++SequenceNumber == 0) SequenceNumber = 1;
-    UserExitCritical();      
-    
-    return i;
-  
+      // Tenta transmitir o pacote NWK_TX_RETRIES-1 vezes
+      return NWK_TxSubmit(selected_node, MAC_TX_ONE_HOP, NWK_TX_NEIGHBOR, NWK_TxDone);
 }
 
 #if (USE_REACTIVE_UP_ROUTE == 1)
@@ -1633,7 +1762,7 @@ INT8U ReactiveUpMessage(void)
   // No executa nada na camada de aplicao
   NWKPayload[j++] = 0xFF;
 
-  status = DownRoute(START_ROUTE,(INT8U)(j));
+  status = NWK_DownRoute(START_ROUTE,(INT8U)(j),NWK_TX_CONTROL);
 
   return status;
 }
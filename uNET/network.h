@@ -50,11 +50,29 @@ Copyright (c) <2009-2013> <Universidade Federal de Santa Maria>
 #define NO_ROUTE_AVAILABLE   (INT8U)0x09
 #define PAYLOAD_OVERFLOW     (INT8U)0x10
 
+// Event registration errors
+#define NWK_EVENT_TABLE_FULL (INT8U)0x11
+
+// Poltica da fila de repasse cheia (NWK_FWD_DROP_POLICY)
+#define NWK_FWD_DROP_TAIL    0                      // descarta o pacote que chegou
+#define NWK_FWD_DROP_OLDEST  1                      // descarta o pacote mais antigo da fila
+
+// Motivos de descarte de um pacote a repassar (UNET_FWD_STAT)
+#define NWK_DROP_QUEUE_TAIL   (INT8U)0              // fila de repasse cheia, pacote novo
+#define NWK_DROP_QUEUE_OLDEST (INT8U)1              // fila de repasse cheia, pacote mais antigo
+#define NWK_DROP_LIFE         (INT8U)2              // limite de saltos (PACKET_LIFE_ERROR)
+#define NWK_DROP_NO_ROUTE     (INT8U)3              // sem rota ou erro de formato
+#define NWK_DROP_TX_QUEUE     (INT8U)4              // fila de transmisso cheia (TX_QUEUE_FULL)
+#define NWK_DROP_TX_FAILED    (INT8U)5              // sem ACK do prximo salto
+#define NWK_DROP_REASONS      (INT8U)6
+
 
 // Routing algorithms
 #define NWK_DEST             (INT8U)0b0001
 #define NWK_DIRECTION        (INT8U)0b0010
 #define NWK_BROADCAST        (INT8U)0b1000
+#define NWK_AGGREGATE        (INT8U)0b0100    // payload is a list of APP messages
+#define NWK_COMPRESSED       (INT8U)0x40      // compressed NWK header
 
 
 #define DEST_UP              (INT8U)0b0001
@@ -70,6 +88,14 @@ Copyright (c) <2009-2013> <Universidade Federal de Santa Maria>
 #define START_ROUTE          (INT8U)0x00
 #define IN_PROGRESS_ROUTE    (INT8U)0x01
 
+// MAC header of the network frames: frame control, sequence number,
+// PAN id, destination and source short addresses
+#define NWK_MAC_HEADER_SIZE     (INT8U)9
+// Offsets of the NWK_Command fields in the TX normal FIFO image (mac_tx_fifo)
+#define NWK_TX_SEQUENCE         (INT8U)4
+#define NWK_TX_DESTINATION      (INT8U)7
+#define NWK_TX_PARAMETER        (INT8U)12
+
 // Maximum size of the neighbourhood table
 #define NEIGHBOURHOOD_SIZE      (INT8U)8
 typedef INT16U                  NEIGHBOR_TABLE_T;
@@ -109,21 +135,50 @@ typedef INT16U                  NEIGHBOR_TABLE_T;
 /* Overhead of NWK layer in bytes */
 #define NWK_OVERHEAD            (INT8U)7
 
-typedef union _NWK_TASKS_PENDING
+/* Compressed NWK header (NWK_COMPRESSED): packet type, parameter and packet life,
+   then the destiny only when the packet goes up (down it is the coordinator) and
+   the source only when the packet was forwarded (on the first hop it is the MAC source) */
+#define NWK_COMPRESSED_OVERHEAD (INT8U)3
+#define NWK_COMPRESSED_HEADER_SIZE(parameter,life)  (INT8U)(NWK_COMPRESSED_OVERHEAD + \
+                                  ((((parameter) & NWK_DIRECTION) == NWK_DIRECTION) ? 0 : 2) + \
+                                  (((life) == 0) ? 0 : 2))
+
+/* Aggregated payload (NWK_AGGREGATE): records of the APP message size,
+   the NWK source of the message (2 bytes) and the APP message */
+#define NWK_AGGR_RECORD_HEADER  (INT8U)3
+
+/* Eventos da tarefa de rede (bits de nwk_tasks_pending).
+   Cada evento tem um tratador registrado com NWK_EventRegister: a tarefa de rede
+   l e limpa de uma vez os eventos registrados (uma nica seo crtica por
+   iterao) e chama os tratadores na ordem de registro.
+   Tarefas sinalizam com NWK_EventSignal; interrupes (BRTOS_TimerHook) fazem
+   nwk_tasks_pending |= evento e OSSemPost(MAC_Event) */
+#define NWK_EVENT_DATA_PING         (INT16U)0x0001      // BRTOS_TimerHook, NWK_PingDone
+#define NWK_EVENT_VERIFY_NEIGHBOURHOOD (INT16U)0x0002   // BRTOS_TimerHook
+#define NWK_EVENT_NEW_NEIGHBOR_PING (INT16U)0x0004      // UNET_MAC
+#define NWK_EVENT_RADIO_RESET       (INT16U)0x0008      // BRTOS_TimerHook
+#define NWK_EVENT_ROUTE             (INT16U)0x0010      // UNET_MAC
+#define NWK_EVENT_REACTIVE_UP       (INT16U)0x0020      // BRTOS_TimerHook
+#define NWK_EVENT_VERIFY_UP_ROUTE   (INT16U)0x0040      // BRTOS_TimerHook
+#define NWK_EVENT_SEND              (INT16U)0x0100      // UNET_Send, UNET_TX
+
+/* Estado, no  evento (sem tratador): pings de vizinhana sendo retransmitidos */
+#define NWK_RETRY_BROADCAST         (INT16U)0x0080
+
+/* Eventos livres para novos tipos de trabalho, n = 0..6 */
+#define NWK_EVENT_USER(n)           (INT16U)(0x0200 << (n))
+
+#ifndef NWK_EVENT_HANDLERS
+#define NWK_EVENT_HANDLERS          12
+#endif
+
+typedef void (*NWK_EVENT_HANDLER)(void);
+
+typedef struct _NWK_EVENT_ENTRY
 {
-    INT8U Val;
-    struct _nwk_bits
-    {
-        INT8U DataPingPending             :1;
-        INT8U VerifyNeighbourhoodTable    :1;
-        INT8U NewNeighborPing             :1;
-        INT8U RadioReset                  :1;
-        INT8U RoutePending                :1;
-        INT8U ReactiveUpMessagePending    :1;
-        INT8U VerifyReactiveUpTable       :1;
-        INT8U RetryBroadcast			  :1;
-    } bits;
-} NWK_TASKS_PENDING;
+    INT16U              Event;
+    NWK_EVENT_HANDLER   Handler;
+} NWK_EVENT_ENTRY;
 
 
 typedef union _dword
@@ -187,21 +242,70 @@ typedef struct _UNET_ROUTING_UP_TABLE
 void NeighborPing(void);
 void HandleNewNeighborPing(void);
 INT8U HandleRoutePacket(void);
+#if ((NWK_AGGREGATION_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))
+ostick_t NWK_AggregationPoll(void);
+#endif
 void VerifyNeighbourhood(void);
 void VerifyNeighbourhoodLastIDTimeout(void);
 INT8U VerifyPacketReplicated(void);
+INT8U NWK_HeaderParse(void);
 void UpdateDepth(void);
 void NWK_Command(INT16U Address, INT8U r_parameter, INT8U payload_size, INT8U packet_life, INT16U destiny);
 
 void VerifyNewAddress(void);
+void NWK_HeaderTemplates(void);
 
 void IncDepthWatchdog(void);
 INT16U GetDepthWatchdog(void);
 void ClearDepthWatchdog(void);
 
+/* Guardas da camada de rede (NWK_Lock / NWK_Unlock)
+   NWK_LOCK_PACKET:   buffer de pacote compartilhado (NWKPayload). Os pacotes recebidos
+                      (mac_frame, nwk_frame) so guardados pelas suas referncias e as
+                      mensagens entregues s aplicaes so cpias (UNET_AppReceive)
+   NWK_LOCK_NEIGHBOR: tabela de vizinhos (unet_neighbourhood, NeighborTable,
+                      unet_neighbor_ping), profundidade e pai do n
+   NWK_LOCK_UP_ROUTE: tabela de rotas up (unet_routing_up_table)
+   NWK_LOCK_TX:       TX FIFO (mac_tx_fifo, fila de transmisso, buffer de agregao)
+                      e as sequncias de acesso ao rdio das tarefas (carga da TX
+                      normal FIFO e disparo, reset). Um nico acesso SPI, como
+                      SetTxPower, no precisa da guarda
+   Ordem de aquisio: PACKET, NEIGHBOR, UP_ROUTE, TX; a liberao  na ordem inversa.
+   NWK_Lock adquire de uma vez todas as guardas da seo, nesta ordem: uma seo
+   nunca chama NWK_Lock com guardas j adquiridas, assim no h deadlock.
+   acquireRadio/releaseRadio adquirem todas as guardas (NWK_LOCK_ALL) */
+#define NWK_LOCK_PACKET           (INT8U)0x01
+#define NWK_LOCK_NEIGHBOR         (INT8U)0x02
+#define NWK_LOCK_UP_ROUTE         (INT8U)0x04
+#define NWK_LOCK_TX               (INT8U)0x08
+#define NWK_LOCK_ALL              (INT8U)0x0F
+
+// Guardas de uma mensagem montada em NWKPayload e enviada ao coordenador (DownRoute, OneHopRoute)
+#define NWK_LOCK_DOWN_ROUTE       (INT8U)(NWK_LOCK_PACKET | NWK_LOCK_NEIGHBOR | NWK_LOCK_TX)
+
+// Guardas do roteamento de um pacote recebido (HandleRoutePacket), liberadas durante
+// a entrega  aplicao
+#define NWK_LOCK_ROUTE            (INT8U)(NWK_LOCK_NEIGHBOR | NWK_LOCK_UP_ROUTE | NWK_LOCK_TX)
+
+void NWK_Lock(INT8U locks);
+void NWK_Unlock(INT8U locks);
 void acquireRadio(void);
 void releaseRadio(void);
-void init_radio_resource(INT8U priority);
+void init_radio_resource(void);
+void NWK_TxRadioWake(void);
+
+/* Mensagens do pool de envio (um bit por entrada de UNET_Send) */
+#define NWK_SEND_MASK(i)          (INT8U)(1 << (i))
+
+// Mensagem do pool de envio montada em NWKPayload (com NWK_LOCK_PACKET): passa para a
+// requisio de transmisso (MAC_TX_REQUEST.Send) ou para o buffer de agregao que a leva
+extern INT8U NWKPayloadSend;
+
+// Fim das mensagens do pool de envio: status OK ou o erro de roteamento/transmisso
+void NWK_SendDone(INT8U Send, INT8U status);
+
+INT8U NWK_EventRegister(INT16U event, NWK_EVENT_HANDLER handler);
+void  NWK_EventSignal(INT16U event);
 
 INT8U DownRoute(INT8U RouteInit, INT8U AppPayloadSize);
 INT8U UpRoute(INT8U RouteInit, INT8U AppPayloadSize);
@@ -264,7 +368,7 @@ extern  volatile INT16U 			 ReactiveUpCnt;
 extern  volatile INT8U				 ReactiveUpTimeCnt;
 #endif
 
-extern  volatile NWK_TASKS_PENDING   nwk_tasks_pending;
+extern  volatile INT16U              nwk_tasks_pending;
 
 
 #endif
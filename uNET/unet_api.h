@@ -40,31 +40,119 @@ Copyright (c) <2009-2013> <Universidade Federal de Santa Maria>
 /* Message code returns */ 
 #define SEND_OK              (INT8U)0x00
 #define SEND_ERROR           (INT8U)0x01
+#define SEND_POOL_FULL       (INT8U)0x14      // no free entry in the send pool
+#define SEND_PENDING         (INT8U)0x15      // message not sent yet
+#define SEND_HANDLE_ERROR    (INT8U)0x16      // handle not held by the application
+#define APP_NO_MAILBOX       (INT8U)0x17      // application without a receive mailbox (SIGNAL_APPx)
 
 /* Functions used to send data in the network */
 INT8U NetSimpledata(INT8U direction, INT8U destino, INT8U *p_data);
 void  NetSimpleMeasure(INT8U direction, INT8U MeasureType, INT16U Value16, INT32U Value32);
 
+/* Application messages sent through the send pool (UNET_SEND_POOL_SIZE entries).
+   UNET_Send copies the message from the caller's buffer and returns at once, without
+   the network guards: the network task routes it and the result is polled with
+   UNET_SendStatus or waited on with UNET_SendWait. Reading the result releases the
+   handle; without a handle (NULL) the entry is released when the message is sent.
+   Result: OK, NO_ROUTE_AVAILABLE or the transmission error (TX_NO_ACK_ERROR, ...) */
+typedef INT8U UNET_SEND_HANDLE;
+
+#define UNET_SEND_NONE       (UNET_SEND_HANDLE)0xFF
+
+/* Routes of UNET_Send */
+#define UNET_SEND_TO_BASE    (INT8U)0         // to the coordinator (DownRoute), Destiny is not used
+#define UNET_SEND_UP         (INT8U)1         // to the node Destiny (ReactiveUpRoute)
+#define UNET_SEND_ONE_HOP    (INT8U)2         // to the neighbor Destiny (OneHopRoute)
+
+INT8U UNET_Send(INT8U Route, INT16U Destiny, const INT8U *Data, INT8U Size, UNET_SEND_HANDLE *Handle);
+INT8U UNET_SendStatus(UNET_SEND_HANDLE Handle);
+INT8U UNET_SendWait(UNET_SEND_HANDLE Handle, ostick_t Timeout);
+void  UNET_SendRelease(UNET_SEND_HANDLE Handle);
+
+/* Received application messages. UNET_APP copies each message into the mailbox of
+   its application (APP_01, ..., APP_255; APPx_MAILBOX_SIZE messages) and signals
+   SIGNAL_APPx; a message that finds the mailbox full is dropped and counted.
+   UNET_AppReceive waits up to Timeout ticks (0: no timeout) for the oldest message
+   and copies it to msg, read with APP_RX_*(msg): the application never holds a
+   received packet or a network guard.
+   Result: OK, TIMEOUT or APP_NO_MAILBOX */
+INT8U UNET_AppReceive(INT8U App, UNET_APP_MSG *msg, ostick_t Timeout);
+
+typedef struct _UNET_APP_STAT
+{
+  INT32U Delivered;                               // messages put in the mailbox
+  INT32U Dropped;                                 // messages dropped: mailbox full or message too long
+  INT8U  DepthMax;                                // messages in the mailbox at most
+} UNET_APP_STAT;
+
+const UNET_APP_STAT *GetUNET_AppStatistics(INT8U App);   // NULL: application without a mailbox
+
 /* Functions used to receive and decode data from the network */
-void  Decode_General_Profile(void);
-void  Decode_Lighting_Profile(void);
-void  Decode_SmartEnergy_Profile(void);
-INT8U Decode_Data_Profile(void);
+void  Decode_General_Profile(const UNET_APP_MSG *msg);
+void  Decode_Lighting_Profile(const UNET_APP_MSG *msg);
+void  Decode_SmartEnergy_Profile(const UNET_APP_MSG *msg);
+INT8U Decode_Data_Profile(const UNET_APP_MSG *msg);
 
 INT8U* GetUNET_Statistics(INT8U* tamanho);
 
+/* Transmission statistics, kept by the RF event task */
+#define UNET_TX_LATENCY_BUCKETS   (INT8U)8
+#define UNET_TX_LATENCY_MIN_US    (INT16U)256     // upper bound of the first latency bucket
+#define UNET_TX_RETRY_BUCKETS     (INT8U)4
+
+typedef struct _UNET_TX_STAT
+{
+  INT32U AirtimeUs;                               // air time of the transmitted frames, retries included
+  INT16U AirtimeRate;                             // air time per second in 0.1 %, average of the last 8 s
+  INT32U Latency[UNET_TX_LATENCY_BUCKETS];        // TX trigger to RF_TXIF: < 256 us, < 512 us, ..., >= 16.4 ms
+  INT32U Retries[UNET_TX_RETRY_BUCKETS];          // hardware retries of each frame (TXSR bits 7-6): 0, 1, 2, 3
+} UNET_TX_STAT;
+
+const UNET_TX_STAT *GetUNET_TxStatistics(void);
+
+/* Received packet pool (RX_PACKET_POOL_SIZE entries) */
+typedef struct _UNET_RX_POOL_STAT
+{
+  INT32U Exhausted;                               // frames that waited for a free packet in UNET_MAC
+  INT8U  InUse;                                   // packets held by the MAC or the forwarding queue
+  INT8U  InUseMax;
+} UNET_RX_POOL_STAT;
+
+const UNET_RX_POOL_STAT *GetUNET_RxPoolStatistics(void);
+
+/* Forwarding queue (NWK_FWD_QUEUE_SIZE entries) */
+typedef struct _UNET_FWD_STAT
+{
+  INT32U Queued;                                  // packets put in the forwarding queue
+  INT32U Dropped[NWK_DROP_REASONS];               // packets not forwarded: NWK_DROP_QUEUE_TAIL, ...
+  INT8U  DepthMax;                                // packets in the queue at most
+} UNET_FWD_STAT;
+
+const UNET_FWD_STAT *GetUNET_FwdStatistics(void);
+
+/* Packet to be forwarded dropped for reason (NWK_DROP_QUEUE_TAIL, ...), also counted in routdrop */
+void UNET_FwdDrop(INT8U reason);
+
+/* References to a received packet: the frame stays in its RX buffer slot
+   until the last reference is released */
+void UNET_RxPacketRetain(MAC_FRAME_VIEW *packet);
+void UNET_RxPacketRelease(MAC_FRAME_VIEW *packet);
+
+/* Ticks elapsed since a tick count (e.g. APP_RX_TIMESTAMP(msg)) */
+ostick_t UNET_TicksSince(ostick_t tick);
+
 /* External functions */
 extern void UNET_Init(void);
-extern void UNET_APP(void);
+extern void UNET_APP(const INT8U *Payload, INT8U Size, INT16U Source, ostick_t Timestamp);
 
 /* UNET tasks */
 extern void UNET_RF_Event(void *param);
 extern void UNET_MAC(void *param);
 extern void UNET_NWK(void *param);
+extern void UNET_TX(void *param);
 
 /* External Variables */
-extern        OS_QUEUE     RFBuffer;
-extern        BRTOS_Queue  *RF;
+extern        RF_RX_RING   RFBuffer;
 extern        BRTOS_Sem    *RF_Event;
 extern        BRTOS_Sem    *RF_RX_Event;
 extern        BRTOS_Sem    *RF_TX_Event;
@@ -88,9 +176,10 @@ extern BRTOS_Sem    *(SIGNAL_APP4);
 extern BRTOS_Sem    *(SIGNAL_APP255);
 #endif 
 
-/* payload vector - max. bytes = MAX_APP_PAYLOAD_SIZE */
+/* payload vector - max. bytes = MAX_APP_PAYLOAD_SIZE, used by the network task (UNET_Send) */
 extern  volatile INT8U     NWKPayload[MAX_APP_PAYLOAD_SIZE];
 
 void IncUNET_NodeStat_apptxed(void);
+void IncUNET_NodeStat_routdrop(void);
 
 #endif
@@ -121,4 +121,8 @@ enum destinos
 #define REACTIVE_POWER           (INT8U)0x87
 #define POWER_FACTOR             (INT8U)0x88
 
+// Smart Energy multiple metering encodings (SE_COMPACT_ENCODING)
+#define MULTIPLE_KEYFRAME        (INT8U)0x89
+#define MULTIPLE_DELTA           (INT8U)0x8A
+
 #endif
@@ -43,16 +43,82 @@ Copyright (c) <2009-2013> <Universidade Federal de Santa Maria>
 *
 ******************************************************************/  
 
-OS_QUEUE      RFBuffer;
-BRTOS_Queue  *RF;
+RF_RX_RING    RFBuffer;
 BRTOS_Sem    *RF_Event;
 BRTOS_Sem    *RF_RX_Event;
 BRTOS_Sem    *RF_TX_Event;
 BRTOS_Sem    *MAC_Event;
 
+/* ndices do buffer de RX em [0, 2*RFBufferSize) (RFBufferNext) */
+#if ((2*RFBufferSize) > 255)
+#error "RFBufferSize: at most 127 frames (INT8U ring indices)"
+#endif
+
+/* Controle de fluxo da recepo (RFBufferFlowControl) */
+#if ((RX_ACK_LOW_WATERMARK) < 0) || ((RX_ACK_LOW_WATERMARK) >= (RX_ACK_HIGH_WATERMARK)) || ((RX_ACK_HIGH_WATERMARK) > RFBufferSize)
+#error "RX_ACK_LOW_WATERMARK < RX_ACK_HIGH_WATERMARK <= RFBufferSize is required"
+#endif
+
+/* Pool de pacotes recebidos: cada pacote mantm o seu slot do RFBuffer
+   reservado enquanto tiver referncias (MAC, fila de repasse) */
+static MAC_FRAME_VIEW     RxPacket[RX_PACKET_POOL_SIZE];
+static UNET_RX_POOL_STAT  RxPoolStat;
+static volatile INT8U     RxPacketWaiting = FALSE;
+static BRTOS_Sem         *RX_PacketFree;
+
+/* Fila de repasse: pacotes a rotear, UNET_MAC coloca, a tarefa de rede retira.
+   NWK_FwdTx indica os pacotes que sero retransmitidos (no so s para este n):
+   eles esperam, em ordem, enquanto a fila de transmisso estiver cheia */
+static MAC_FRAME_VIEW    *NWK_FwdQueue[NWK_FWD_QUEUE_SIZE];
+static INT8U              NWK_FwdTx[NWK_FWD_QUEUE_SIZE];
+static INT8U              NWK_FwdIn    = 0;
+static INT8U              NWK_FwdOut   = 0;
+static volatile INT8U     NWK_FwdCount = 0;
+static volatile INT8U     NWK_FwdWaitTx = FALSE;
+static UNET_FWD_STAT      NWK_FwdStat;
+
+/* Pool de envio: mensagens da aplicao copiadas por UNET_Send, roteadas em ordem pela
+   tarefa de rede (NWK_EVENT_SEND). A entrada  liberada quando a aplicao l o resultado
+   (UNET_SendStatus, UNET_SendWait) ou, sem handle, no fim da transmisso */
+#if (UNET_SEND_POOL_SIZE > 8)
+#error "UNET_SEND_POOL_SIZE: at most 8 entries (NWK_SEND_MASK)"
+#endif
+
+#define UNET_SEND_FREE            (INT8U)0
+#define UNET_SEND_QUEUED          (INT8U)1      // espera a tarefa de rede
+#define UNET_SEND_ROUTED          (INT8U)2      // na fila de transmisso ou no buffer de agregao
+#define UNET_SEND_DONE            (INT8U)3      // Status  o resultado
+
+typedef struct _UNET_SEND_ENTRY
+{
+  INT8U       Data[MAX_APP_PAYLOAD_SIZE];
+  INT8U       Size;
+  INT8U       Route;                            // UNET_SEND_TO_BASE, UNET_SEND_UP, UNET_SEND_ONE_HOP
+  INT16U      Destiny;
+  INT8U       State;
+  INT8U       Status;
+  INT8U       Owned;                            // TRUE: a aplicao tem o handle
+  INT8U       Waiting;                          // TRUE: a aplicao espera em UNET_SendWait
+  BRTOS_Sem  *Done;
+} UNET_SEND_ENTRY;
+
+static UNET_SEND_ENTRY    UNET_SendPool[UNET_SEND_POOL_SIZE];
+static INT8U              UNET_SendQueue[UNET_SEND_POOL_SIZE];
+static INT8U              UNET_SendIn    = 0;
+static INT8U              UNET_SendOut   = 0;
+static volatile INT8U     UNET_SendCount = 0;
+static volatile INT8U     NWK_SendWaitTx = FALSE;
+
+/* Tratadores dos eventos da tarefa de rede */
+static NWK_EVENT_ENTRY  NWK_Events[NWK_EVENT_HANDLERS];
+static INT8U            NWK_EventCount = 0;
+static INT16U           NWK_EventMask  = 0;
+static void NWK_EventInit(void);
+
 BRTOS_TH	TH_RADIO;
 BRTOS_TH	TH_MAC;
 BRTOS_TH	TH_NETWORK;
+BRTOS_TH	TH_TX;
 
 #if ((CONTIKI_MAC_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))
 BRTOS_TH	TH_CONTIKIMAC;
@@ -76,6 +142,58 @@ BRTOS_Sem    *(SIGNAL_APP4);
 BRTOS_Sem    *(SIGNAL_APP255);   // reservada para bootloader
 #endif 
 
+/* Caixas de mensagens das aplicaes, indexadas pelo id da aplicao (APP_01, ...).
+   Somente a tarefa de rede coloca (UNET_APP) e somente a tarefa da aplicao retira
+   (UNET_AppReceive): a mensagem  copiada fora da seo crtica e os ndices so
+   atualizados dentro dela */
+#define UNET_APPS                 (INT8U)(APP_255 + 1)
+
+typedef struct _UNET_APP_MAILBOX
+{
+  UNET_APP_MSG     *Msg;
+  INT8U             Size;
+  INT8U             In;
+  INT8U             Out;
+  volatile INT8U    Count;
+  BRTOS_Sem        *Signal;
+  UNET_APP_STAT     Stat;
+} UNET_APP_MAILBOX;
+
+static UNET_APP_MAILBOX   UNET_AppMailbox[UNET_APPS];
+
+#ifdef SIGNAL_APP1
+#ifndef APP1_MAILBOX_SIZE
+#error "SIGNAL_APP1 requires APP1_MAILBOX_SIZE"
+#endif
+static UNET_APP_MSG       UNET_App1Msg[APP1_MAILBOX_SIZE];
+#endif
+#ifdef SIGNAL_APP2
+#ifndef APP2_MAILBOX_SIZE
+#error "SIGNAL_APP2 requires APP2_MAILBOX_SIZE"
+#endif
+static UNET_APP_MSG       UNET_App2Msg[APP2_MAILBOX_SIZE];
+#endif
+#ifdef SIGNAL_APP3
+#ifndef APP3_MAILBOX_SIZE
+#error "SIGNAL_APP3 requires APP3_MAILBOX_SIZE"
+#endif
+static UNET_APP_MSG       UNET_App3Msg[APP3_MAILBOX_SIZE];
+#endif
+#ifdef SIGNAL_APP4
+#ifndef APP4_MAILBOX_SIZE
+#error "SIGNAL_APP4 requires APP4_MAILBOX_SIZE"
+#endif
+static UNET_APP_MSG       UNET_App4Msg[APP4_MAILBOX_SIZE];
+#endif
+#ifdef SIGNAL_APP255
+#ifndef APP255_MAILBOX_SIZE
+#error "SIGNAL_APP255 requires APP255_MAILBOX_SIZE"
+#endif
+static UNET_APP_MSG       UNET_App255Msg[APP255_MAILBOX_SIZE];
+#endif
+
+static void UNET_AppMailboxInit(INT8U App, UNET_APP_MSG *Msg, INT8U Size, BRTOS_Sem *Signal);
+
 #if PROCESSOR == COLDFIRE_V1
 #pragma warn_implicitconv off
 #endif
@@ -93,7 +211,7 @@ static struct{
   INT16U routed;     // routed packets
   INT16U apptxed;    // apptxed packets
   INT16U dropped;    // packets dropped by hops limit, route not available
-  INT16U overbuf;    // packets dropped by RX buffer overflow
+  INT16U overbuf;    // packets dropped by RX buffer overflow or refused under backpressure
   INT16U routdrop;   // packets dropped by routing buffer overflow
   INT16U rxedbytes;  // rxed bytes
   INT16U txedbytes;  // txed bytes
@@ -101,7 +219,53 @@ static struct{
   INT16U txbps;       // tx throughput
   INT16U radioresets;  // radio reset
   INT16U hellos;       // hellos rxed
-}UNET_NodeStat = {0,0,0,0,0,0,0,0,0,0,0,0,0,0};  // 28 bytes
+  INT16U filtpan;      // frames of other PANs dropped before the RX buffer
+  INT16U filtaddr;     // unicasts to other nodes dropped before the RX buffer
+  INT16U bpevents;     // auto-ACK disabled by the RX buffer high watermark
+  INT16U bptime;       // time with auto-ACK disabled, in ms
+  INT16U drain1;       // UNET_MAC wakeups that decoded 1 frame
+  INT16U drain2;       // ... 2 or 3 frames
+  INT16U drain4;       // ... 4 to 7 frames
+  INT16U drain8;       // ... 8 frames or more
+  INT16U routdelay;    // max. ticks from the RX interrupt to the end of HandleRoutePacket
+}UNET_NodeStat = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};  // 46 bytes
+
+/* UNET transmission statistics: latency and hardware retries of each frame, air time */
+static UNET_TX_STAT UNET_TxStat;
+static INT32U       UNET_TxAirtimeSec;        // air time in the current second, in us
+static INT16U       UNET_TxTrigger;           // RADIO_TIMESTAMP_US() of the last TX trigger
+static ostick_t     UNET_TxTriggerTick;       // tick count of the last TX trigger
+
+// Relgio em microssegundos do incio da transmisso at o RF_TXIF. Com o timer
+// do tick da placa (RADIO_TIMER_COUNT, BoardConfig.h) soma a contagem dentro do tick
+// atual ao tick count; sem ele a resoluo  a do tick
+#ifndef RADIO_TIMESTAMP_US
+#ifdef RADIO_TIMER_COUNT
+// O timer  decrescente e recarrega a cada tick: se a contagem subiu entre as duas
+// leituras, o tick mudou no meio da leitura e ela  refeita
+static INT16U UNET_TimerTimestampUs(void)
+{
+  INT32U   before;
+  INT32U   count;
+  ostick_t tick;
+  
+  do
+  {
+    before = RADIO_TIMER_COUNT();
+    tick   = OSGetTickCount();
+    count  = RADIO_TIMER_COUNT();
+  } while (count > before);
+  
+  return (INT16U)((tick * (1000000 / configTICK_RATE_HZ)) + ((RADIO_TIMER_RELOAD - 1 - count) / RADIO_TIMER_PER_US));
+}
+#define RADIO_TIMESTAMP_US()  UNET_TimerTimestampUs()
+#else
+#define RADIO_TIMESTAMP_US()  (INT16U)(OSGetTickCount() * (1000000 / configTICK_RATE_HZ))
+#endif
+#endif
+
+// Tempo no ar de um frame de length bytes (MAC header + payload), com FCS e PHY header, a 250 kbps
+#define UNET_TX_AIRTIME_US(length)   ((INT32U)((length) + 2 + 6) * 32)
 
 
 static void ClearUNET_NodeStat(void)
@@ -115,6 +279,15 @@ static void ClearUNET_NodeStat(void)
   UNET_NodeStat.routdrop = 0;
   UNET_NodeStat.radioresets = 0;
   UNET_NodeStat.hellos = 0;
+  UNET_NodeStat.filtpan = 0;
+  UNET_NodeStat.filtaddr = 0;
+  UNET_NodeStat.bpevents = 0;
+  UNET_NodeStat.bptime = 0;
+  UNET_NodeStat.drain1 = 0;
+  UNET_NodeStat.drain2 = 0;
+  UNET_NodeStat.drain4 = 0;
+  UNET_NodeStat.drain8 = 0;
+  UNET_NodeStat.routdelay = 0;
 }
 
 #if (DEVICE_TYPE == ROUTER)
@@ -128,23 +301,77 @@ void IncUNET_NodeStat_apptxed(void){
   CHECK_NODESTAT(UNET_NodeStat.apptxed)
 }
 
+void IncUNET_NodeStat_routdrop(void){
+  UNET_NodeStat.routdrop++;
+  CHECK_NODESTAT(UNET_NodeStat.routdrop)
+}
+
+void UNET_FwdDrop(INT8U reason){
+  UserEnterCritical();
+  NWK_FwdStat.Dropped[reason]++;
+  UserExitCritical();
+  IncUNET_NodeStat_routdrop();
+}
+
+// Fim de uma transmisso (RF_TXIF): tentativas feitas pelo rdio, tempo no ar e,
+// se o frame foi disparado pela tarefa UNET_TX, tempo desde o disparo
+static void UNET_TxStatUpdate(INT8U retries, INT8U length, INT8U triggered)
+{
+  INT8U  bucket = 0;
+  INT16U bound  = UNET_TX_LATENCY_MIN_US;
+  INT16U elapsed;
+  INT32U airtime;
+  
+  if (triggered == TRUE)
+  {
+    elapsed = (INT16U)(RADIO_TIMESTAMP_US() - UNET_TxTrigger);
+    
+    // O tick count d a volta em TICK_COUNT_OVERFLOW, no em 2^16 us: uma volta
+    // entre o disparo e o RF_TXIF invalida a amostra. O tick count  lido antes
+    // do relgio no disparo e depois dele aqui
+    if (OSGetTickCount() >= UNET_TxTriggerTick)
+    {
+      while ((bucket < (UNET_TX_LATENCY_BUCKETS - 1)) && (elapsed >= bound))
+      {
+        bound <<= 1;
+        bucket++;
+      }
+      UNET_TxStat.Latency[bucket]++;
+    }
+  }
+  
+  UNET_TxStat.Retries[retries]++;
+  
+  airtime = (INT32U)(retries + 1) * UNET_TX_AIRTIME_US(length);
+  UserEnterCritical();
+  UNET_TxStat.AirtimeUs += airtime;
+  UNET_TxAirtimeSec     += airtime;
+  UserExitCritical();
+}
+
 
 /* Function to start all UNET Tasks */
 void UNET_Init(void)
 {  
+  INT8U i;
+  
   ////////////////////////////////////////////////////
   //     Initialize IEEE 802.15.4 radio mutex     ////
   ////////////////////////////////////////////////////  
-  init_radio_resource(UNET_Mutex_Priority);
+  init_radio_resource();
   
   
   ////////////////////////////////////////////////
   //     Initialize OS Network Services     //////
   ////////////////////////////////////////////////  
-  if ((INT8U)OSQueueCreate(&RFBuffer,RFBufferSize,&RF) != ALLOC_EVENT_OK)
-  {
-    while(1){};              
-  }
+  RFBuffer.In   = 0;
+  RFBuffer.Next = 0;
+  RFBuffer.Out  = 0;
+  
+  // Os ponteiros de pacote nunca so nulos: antes do primeiro frame
+  // apontam para um pacote livre do pool
+  mac_frame = &RxPacket[0];
+  nwk_frame = &RxPacket[0];
 
   /* UNET signals */
   if ((INT8U)OSSemCreate(0,&RF_RX_Event) != ALLOC_EVENT_OK)
@@ -161,6 +388,26 @@ void UNET_Init(void)
   {
     while(1){};
   } 
+  
+  if ((INT8U)OSSemCreate(0,&RX_PacketFree) != ALLOC_EVENT_OK)
+  {
+    while(1){};
+  } 
+  
+  for (i = 0; i < UNET_SEND_POOL_SIZE; i++)
+  {
+    UNET_SendPool[i].State = UNET_SEND_FREE;
+    if ((INT8U)OSSemCreate(0,&(UNET_SendPool[i].Done)) != ALLOC_EVENT_OK)
+    {
+      while(1){};
+    }
+  }
+  
+  /* Network task events */
+  NWK_EventInit();
+  
+  /* TX queue */
+  MAC_TxInit();
    
   
   #ifdef SIGNAL_APP1
@@ -168,30 +415,35 @@ void UNET_Init(void)
     {
       while(1){};
     } 
+    UNET_AppMailboxInit(APP_01, UNET_App1Msg, APP1_MAILBOX_SIZE, SIGNAL_APP1);
   #endif
   #ifdef SIGNAL_APP2
     if ((INT8U)OSSemCreate(0,&(SIGNAL_APP2)) != ALLOC_EVENT_OK)
     {
       while(1){};
     } 
+    UNET_AppMailboxInit(APP_02, UNET_App2Msg, APP2_MAILBOX_SIZE, SIGNAL_APP2);
   #endif 
   #ifdef SIGNAL_APP3
     if ((INT8U)OSSemCreate(0,&(SIGNAL_APP3)) != ALLOC_EVENT_OK)
     {
       while(1){};
     } 
+    UNET_AppMailboxInit(APP_03, UNET_App3Msg, APP3_MAILBOX_SIZE, SIGNAL_APP3);
   #endif 
   #ifdef SIGNAL_APP4
     if ((INT8U)OSSemCreate(0,&(SIGNAL_APP4)) != ALLOC_EVENT_OK)
     {
       while(1){};
     } 
+    UNET_AppMailboxInit(APP_04, UNET_App4Msg, APP4_MAILBOX_SIZE, SIGNAL_APP4);
   #endif 
   #ifdef SIGNAL_APP255
     if ((INT8U)OSSemCreate(0,&(SIGNAL_APP255)) != ALLOC_EVENT_OK)
     {
       while(1){};
     } 
+    UNET_AppMailboxInit(APP_255, UNET_App255Msg, APP255_MAILBOX_SIZE, SIGNAL_APP255);
   #endif    
 
      
@@ -214,6 +466,11 @@ void UNET_Init(void)
      while(1){};
   }
   
+  if(InstallTask(&UNET_TX,"UNET TX Handler",UNET_TX_StackSize,TX_HandlerPriority, NULL, &TH_TX) != OK)
+  {
+     while(1){};
+  }
+  
 #if ((CONTIKI_MAC_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))
   if(InstallTask(&Contiki_Task,"UNET NWK Handler",ContikiMAC_StackSize,ContikiMACPriority, NULL, &TH_NETWORK) != OK)
   {
@@ -258,7 +515,7 @@ BRTOS_TIMER reative_up_table_timer;
 TIMER_CNT neighbourhood_callback(void)
 {
 	// Avisa que deve verificar a tabela de vizinhana
-	nwk_tasks_pending.bits.VerifyNeighbourhoodTable = 1;
+	nwk_tasks_pending |= NWK_EVENT_VERIFY_NEIGHBOURHOOD;
 
 	// Acorda a tarefa de rede
 	OSSemPost(MAC_Event);
@@ -281,11 +538,11 @@ TIMER_CNT ping_callback(void)
     	stop_ping_time = 0;
 #endif
     	// Avisa que h um ping pendente
-		nwk_tasks_pending.bits.DataPingPending = 1;
+		nwk_tasks_pending |= NWK_EVENT_DATA_PING;
 
 		// Transmite PING_RETRIES pings
 		ping_retries = 0;
-		nwk_tasks_pending.bits.RetryBroadcast = 1;
+		nwk_tasks_pending |= NWK_RETRY_BROADCAST;
 
 		// Acorda a tarefa de rede
 		OSSemPost(MAC_Event);
@@ -306,7 +563,7 @@ TIMER_CNT reative_up_maintenance_callback(void)
 	if (mac_tasks_pending.bits.AssociationInProgress != 1)
 	{
 		// Avisa que h mensagem de manuteno de rede up pendente
-		nwk_tasks_pending.bits.ReactiveUpMessagePending = 1;
+		nwk_tasks_pending |= NWK_EVENT_REACTIVE_UP;
 
 		// Acorda a tarefa de rede
 		OSSemPost(MAC_Event);
@@ -318,7 +575,7 @@ TIMER_CNT reative_up_maintenance_callback(void)
 TIMER_CNT reative_up_table_callback(void)
 {
 	// Avisa que deve verificar a tabela de vizinhana
-	nwk_tasks_pending.bits.VerifyReactiveUpTable = 1;
+	nwk_tasks_pending |= NWK_EVENT_VERIFY_UP_ROUTE;
 
 	// Acorda a tarefa de rede
 	OSSemPost(MAC_Event);
@@ -372,11 +629,11 @@ void BRTOS_TimerHook(void)
             	stop_ping_time = 0;
 #endif
             	// Avisa que h um ping pendente
-				nwk_tasks_pending.bits.DataPingPending = 1;
+				nwk_tasks_pending |= NWK_EVENT_DATA_PING;
 
 				// Transmite PING_RETRIES pings
 				ping_retries = 0;
-				nwk_tasks_pending.bits.RetryBroadcast = 1;
+				nwk_tasks_pending |= NWK_RETRY_BROADCAST;
 
 				// Acorda a tarefa de rede
 				OSSemPost(MAC_Event);
@@ -390,7 +647,7 @@ void BRTOS_TimerHook(void)
             NeighbourhoodCnt = 0;
 
             // Avisa que deve verificar a tabela de vizinhana
-            nwk_tasks_pending.bits.VerifyNeighbourhoodTable = 1;
+            nwk_tasks_pending |= NWK_EVENT_VERIFY_NEIGHBOURHOOD;
             
             // Acorda a tarefa de rede
             OSSemPost(MAC_Event);
@@ -412,7 +669,7 @@ void BRTOS_TimerHook(void)
             if (mac_tasks_pending.bits.AssociationInProgress != 1)
             {
 				// Avisa que h mensagem de manuteno de rede up pendente
-				nwk_tasks_pending.bits.ReactiveUpMessagePending = 1;
+				nwk_tasks_pending |= NWK_EVENT_REACTIVE_UP;
 
 				// Acorda a tarefa de rede
 				OSSemPost(MAC_Event);
@@ -426,7 +683,7 @@ void BRTOS_TimerHook(void)
         	ReactiveUpTableCnt = 0;
 
             // Avisa que deve verificar a tabela de vizinhana
-            nwk_tasks_pending.bits.VerifyReactiveUpTable = 1;
+            nwk_tasks_pending |= NWK_EVENT_VERIFY_UP_ROUTE;
 
             // Acorda a tarefa de rede
             OSSemPost(MAC_Event);
@@ -448,7 +705,7 @@ void BRTOS_TimerHook(void)
       RadioWatchdog = 0;
       
       // Avisa que o radio pode estar travado
-      nwk_tasks_pending.bits.RadioReset = 1;      
+      nwk_tasks_pending |= NWK_EVENT_RADIO_RESET;
         
       // Acorda a tarefa de rede
       if (mac_tasks_pending.bits.isAssociated == 1)
@@ -467,6 +724,8 @@ void BRTOS_TimerHook(void)
        UNET_NodeStat.txbps = (UNET_NodeStat.txbps*7 + (UNET_NodeStat.txedbytes*8))>>3;
        UNET_NodeStat.rxedbytes = 0;
        UNET_NodeStat.txedbytes = 0;
+       UNET_TxStat.AirtimeRate = (INT16U)((UNET_TxStat.AirtimeRate*7 + UNET_TxAirtimeSec/1000)>>3);
+       UNET_TxAirtimeSec = 0;
     } 
     
 #endif
@@ -474,58 +733,476 @@ void BRTOS_TimerHook(void)
 }
 
 /* UNET Application Handler */
-void UNET_APP(void)
-{   
-    /* Retira todos os cabealhos e se houver algo a mais, 
-    so outros atributos */
-    if (mac_packet.Payload_Size < NWK_APP_HEADER_SIZE){ 
-        app_packet.APP_Command_Size = 0;
-    }else{
-        app_packet.APP_Command_Size = mac_packet.Payload_Size - (NWK_APP_HEADER_SIZE);
+// Copia a mensagem para a caixa de mensagens da aplicao (APP header: id da aplicao)
+// e acorda a tarefa que a executa. Chamada pela tarefa de rede, sem guardas da rede:
+// o pacote recebido no  retido pela aplicao
+void UNET_APP(const INT8U *Payload, INT8U Size, INT16U Source, ostick_t Timestamp)
+{
+    UNET_APP_MAILBOX *box;
+    UNET_APP_MSG *msg;
+    INT8U i;
+    
+    if ((Size == 0) || (Payload[0] >= UNET_APPS))
+    {
+      return;
     }
     
-    // Acorda a tarefa que esta executando a aplicao
-    switch(app_packet.APP_Identify)
-    {    
-      case APP_01:
-        #ifdef SIGNAL_APP1
-          OSSemPost(SIGNAL_APP1);
-        #endif
-        break; 
-      case APP_02:
-        #ifdef SIGNAL_APP2      
-          OSSemPost(SIGNAL_APP2);
-        #endif
+    box = &UNET_AppMailbox[Payload[0]];
+    if (box->Msg == NULL)
+    {
+      return;
+    }
+    
+    if ((box->Count >= box->Size) || (Size > MAX_APP_PAYLOAD_SIZE))
+    {
+      box->Stat.Dropped++;
+      return;
+    }
+    
+    msg = &box->Msg[box->In];
+    for (i = 0; i < Size; i++)
+    {
+      msg->Payload[i] = Payload[i];
+    }
+    msg->Size      = Size;
+    msg->Source    = Source;
+    msg->Timestamp = Timestamp;
+    
+    UserEnterCritical();
+    box->In = (INT8U)((box->In + 1) % box->Size);
+    box->Count++;
+    if (box->Count > box->Stat.DepthMax)
+    {
+      box->Stat.DepthMax = box->Count;
+    }
+    UserExitCritical();
+    
+    box->Stat.Delivered++;
+    OSSemPost(box->Signal);
+}
+
+static void UNET_AppMailboxInit(INT8U App, UNET_APP_MSG *Msg, INT8U Size, BRTOS_Sem *Signal)
+{
+    UNET_AppMailbox[App].Msg    = Msg;
+    UNET_AppMailbox[App].Size   = Size;
+    UNET_AppMailbox[App].Signal = Signal;
+}
+
+// Espera at Timeout ticks (0: sem timeout) pela mensagem mais antiga da caixa
+// da aplicao e a copia para msg, liberando a entrada
+INT8U UNET_AppReceive(INT8U App, UNET_APP_MSG *msg, ostick_t Timeout)
+{
+    UNET_APP_MAILBOX *box;
+    UNET_APP_MSG *head;
+    INT8U status;
+    INT8U i;
+    
+    if ((App >= UNET_APPS) || (UNET_AppMailbox[App].Msg == NULL) || (msg == NULL))
+    {
+      return APP_NO_MAILBOX;
+    }
+    
+    box = &UNET_AppMailbox[App];
+    status = OSSemPend(box->Signal, Timeout);
+    if (status != OK)
+    {
+      return status;
+    }
+    
+    head = &box->Msg[box->Out];
+    for (i = 0; i < head->Size; i++)
+    {
+      msg->Payload[i] = head->Payload[i];
+    }
+    msg->Size      = head->Size;
+    msg->Source    = head->Source;
+    msg->Timestamp = head->Timestamp;
+    
+    UserEnterCritical();
+    box->Out = (INT8U)((box->Out + 1) % box->Size);
+    box->Count--;
+    UserExitCritical();
+    
+    return OK;
+}
+
+const UNET_APP_STAT *GetUNET_AppStatistics(INT8U App){
+    if ((App >= UNET_APPS) || (UNET_AppMailbox[App].Msg == NULL))
+    {
+      return NULL;
+    }
+    return &UNET_AppMailbox[App].Stat;
+}
+
+
+
+/* UNET Network Handler */
+// Fim do envio de um ping de vizinhana (tarefa UNET_TX, com NWK_LOCK_NEIGHBOR e NWK_LOCK_TX).
+// Enquanto RetryBroadcast estiver ativo, pede um novo ping  tarefa de rede
+static void NWK_PingDone(MAC_TX_REQUEST *request, INT8U status)
+{
+    (void)request;
+    (void)status;
+    
+    UserEnterCritical();
+    //if (status == TX_RADIO_ERROR) nwk_tasks_pending |= NWK_EVENT_RADIO_RESET;
+    nwk_tasks_pending &= (INT16U)~NWK_EVENT_RADIO_RESET;
+    UserExitCritical();
+    
+    if(nwk_tasks_pending & NWK_RETRY_BROADCAST)
+    {    		
+#if (CONTIKI_MAC_ENABLE == 1)
+    	// Descobre o tempo total do processo
+    	stop_ping_time = UNET_TicksSince(start_ping_time);
+
+    	if (stop_ping_time < 132)
+#else
+    	if (ping_retries < PING_RETRIES)
+#endif
+		{				
+			// Avisa que h um ping pendente e acorda a tarefa de rede
+			NWK_EventSignal(NWK_EVENT_DATA_PING);
+		}else
+		{
+#if ((CONTIKI_MAC_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))		        
+			SetRadioStatus(0);
+			// Se no estado anterior o radio estava desligado, desliga o radio agora
+	        if( RADIO_WAKE_STATUS_OLD == RADIO_SLEEPING) SleepRadio();
+#endif
+			
+			UserEnterCritical();
+			nwk_tasks_pending &= (INT16U)~NWK_RETRY_BROADCAST;
+			UserExitCritical();
+		}
+    }
+}
+
+/* Tratadores dos eventos da tarefa de rede */
+
+// Roteamento dos pacotes recebidos, na ordem da fila de repasse.
+// A deciso de roteamento termina ao colocar o frame na fila de transmisso; a
+// concluso (ACK, retransmisses, backoff, outra rota)  feita pelos callbacks da
+// tarefa UNET_TX. Um pacote a repassar sem requisio de transmisso livre fica na
+// fila, e a tarefa UNET_TX retoma o roteamento (NWK_EVENT_ROUTE) ao liberar uma
+static void NWK_RouteEvent(void)
+{
+    MAC_FRAME_VIEW *packet;
+    INT8U tx_free;
+    INT8U i, j, k;
+    INT8U state;
+    ostick_t delay;
+    
+    for (;;)
+    {
+      // Sinalizado antes da verificao: uma requisio liberada depois dela retoma o roteamento
+      NWK_FwdWaitTx = TRUE;
+      tx_free = MAC_TxFree(MAC_TX_CLASS_ROUTE);
+      
+      // Sem requisio livre os pacotes a repassar esperam, em ordem; com
+      // NWK_FWD_LOCAL_BYPASS os pacotes para este n que esto atrs deles so roteados antes
+      packet = NULL;
+      UserEnterCritical();
+      i = NWK_FwdOut;
+      for (k = 0; k < NWK_FwdCount; k++)
+      {
+        if ((tx_free == TRUE) || (NWK_FwdTx[i] == FALSE))
+        {
+          packet = NWK_FwdQueue[i];
+          break;
+        }
+        #if (NWK_FWD_LOCAL_BYPASS == 0)
         break;
-      case APP_03:
-        #ifdef SIGNAL_APP3      
-          OSSemPost(SIGNAL_APP3);
         #endif
-        break; 
-      case APP_04:
-        #ifdef SIGNAL_APP4      
-          OSSemPost(SIGNAL_APP4);
-        #endif
-        break; 
-      case APP_255:
-        #ifdef SIGNAL_APP255
-          OSSemPost(SIGNAL_APP255);
-        #endif
-        break;                     
+        i = (INT8U)((i + 1) % NWK_FWD_QUEUE_SIZE);
+      }
+      if (packet != NULL)
+      {
+        // Retira o pacote, os anteriores avanam uma posio
+        while (i != NWK_FwdOut)
+        {
+          j = (INT8U)((i + NWK_FWD_QUEUE_SIZE - 1) % NWK_FWD_QUEUE_SIZE);
+          NWK_FwdQueue[i] = NWK_FwdQueue[j];
+          NWK_FwdTx[i]    = NWK_FwdTx[j];
+          i = j;
+        }
+        NWK_FwdOut = (INT8U)((NWK_FwdOut + 1) % NWK_FWD_QUEUE_SIZE);
+        NWK_FwdCount--;
+        NWK_FwdWaitTx = FALSE;
+      }else
+      {
+        // Fila vazia: nenhum pacote espera a tarefa UNET_TX
+        NWK_FwdWaitTx = (INT8U)((NWK_FwdCount != 0) ? TRUE : FALSE);
+      }
+      UserExitCritical();
+      
+      if (packet == NULL)
+      {
+        break;
+      }
+      
+      /* route and keep stats: OK = queued for UNET_TX,
+         a later transmission failure is counted in routdrop by the TX callback */
+      NWK_Lock(NWK_LOCK_ROUTE);
+      nwk_frame = packet;
+      state = HandleRoutePacket();
+      if(state == OK){      
+        UNET_NodeStat.routed++;
+        CHECK_NODESTAT(UNET_NodeStat.routed);
+      }else
+      if (state == PACKET_LIFE_ERROR){
+        UNET_FwdDrop(NWK_DROP_LIFE);
+      }else
+      if (state == TX_QUEUE_FULL){
+        UNET_FwdDrop(NWK_DROP_TX_QUEUE);
+      }else{
+        UNET_FwdDrop(NWK_DROP_NO_ROUTE);
+      }
+      
+      // Atraso do pacote neste n (fila de repasse + roteamento)
+      delay = UNET_TicksSince(NWK_RX_TIMESTAMP());
+      if (delay > UNET_NodeStat.routdelay)
+      {
+        UNET_NodeStat.routdelay = (INT16U)delay;
+      }
+      NWK_Unlock(NWK_LOCK_ROUTE);
+      
+      // Referncia da fila de repasse
+      UNET_RxPacketRelease(packet);
+    }
+}
+
+// Roteamento das mensagens da aplicao (UNET_Send), na ordem do pool de envio.
+// A mensagem  copiada para NWKPayload e segue com o frame (ou com o buffer de agregao);
+// o resultado  dado por NWK_SendDone no fim da transmisso. Sem requisio de transmisso
+// livre a mensagem fica no pool, e a tarefa UNET_TX retoma o envio (NWK_EVENT_SEND)
+static void NWK_SendEvent(void)
+{
+    UNET_SEND_ENTRY *send;
+    INT8U entry;
+    INT8U locks;
+    INT8U routed;
+    INT8U i;
+    INT8U state;
+    
+    for (;;)
+    {
+      // Sinalizado antes da verificao: uma requisio liberada depois dela retoma o envio
+      NWK_SendWaitTx = TRUE;
+      if (UNET_SendCount == 0)
+      {
+        NWK_SendWaitTx = FALSE;
+        break;
+      }
+      
+      if (MAC_TxFree(MAC_TX_CLASS_APP) == FALSE)
+      {
+        break;
+      }
+      
+      entry = UNET_SendQueue[UNET_SendOut];
+      send  = &UNET_SendPool[entry];
+      
+      // A rota up usa a tabela de rotas up
+      locks = (INT8U)((send->Route == UNET_SEND_UP) ? NWK_LOCK_ALL : NWK_LOCK_DOWN_ROUTE);
+      NWK_Lock(locks);
+      
+      for (i = 0; i < send->Size; i++)
+      {
+        NWKPayload[i] = send->Data[i];
+      }
+      NWKPayloadSend = NWK_SEND_MASK(entry);
+      
+      switch(send->Route)
+      {
+        case UNET_SEND_UP:
+          #if (USE_REACTIVE_UP_ROUTE == 1)
+          state = ReactiveUpRoute(START_ROUTE, send->Size, send->Destiny);
+          #else
+          state = NO_ROUTE_AVAILABLE;
+          #endif
+          break;
+        case UNET_SEND_ONE_HOP:
+          state = OneHopRoute(send->Size, send->Destiny);
+          break;
+        default:
+          state = DownRoute(START_ROUTE, send->Size);
+          break;
+      }
+      
+      // A mensagem seguiu com uma requisio de transmisso ou com o buffer de agregao
+      routed = (INT8U)(((NWKPayloadSend == 0) && (state == OK)) ? TRUE : FALSE);
+      NWKPayloadSend = 0;
+      
+      if (state != TX_QUEUE_FULL)
+      {
+        // Retirada antes da liberao da guarda NWK_LOCK_TX: o fim da
+        // transmisso (NWK_SendDone) pode liberar a entrada
+        UserEnterCritical();
+        UNET_SendOut = (INT8U)((UNET_SendOut + 1) % UNET_SEND_POOL_SIZE);
+        UNET_SendCount--;
+        if (routed == TRUE)
+        {
+          send->State = UNET_SEND_ROUTED;
+        }
+        UserExitCritical();
+      }
       
-      default:
+      NWK_Unlock(locks);
+      
+      if (state == TX_QUEUE_FULL)
+      {
         break;
+      }
+      
+      if (routed == FALSE)
+      {
+        NWK_SendDone(NWK_SEND_MASK(entry), state);
+      }
     }
+}
+
+// Analisa novo ping de vizinho
+static void NWK_NewNeighborPingEvent(void)
+{
+    NWK_Lock(NWK_LOCK_NEIGHBOR);
+    HandleNewNeighborPing();
+    NWK_Unlock(NWK_LOCK_NEIGHBOR);
+}
+
+// Monta e transmite pacote com ping para vizinhana
+static void NWK_DataPingEvent(void)
+{
+    MAC_TX_REQUEST *request;
+    
+    debug_tx_count4++;
+    
+    NWK_Lock(NWK_LOCK_NEIGHBOR | NWK_LOCK_TX);
+    NeighborPing();
+    ping_retries++;
     
+    // O resultado do envio e as retransmisses do ping so tratados em NWK_PingDone
+    request = MAC_TxRequest(MAC_TX_NO_ACK,MAC_TX_SINGLE,MAC_TX_CLASS_CONTROL,NWK_PingDone);
+    if (request != NULL)
+    {
+      // O rdio  ligado pela tarefa UNET_TX (ContikiMAC), desligado em NWK_PingDone
+      request->Wake = TRUE;
+      MAC_TxSubmit(request);
+    }else
+    {
+      NWK_PingDone(NULL,TX_QUEUE_FULL);
+    }
+    NWK_Unlock(NWK_LOCK_NEIGHBOR | NWK_LOCK_TX);
 }
 
+#if (USE_REACTIVE_UP_ROUTE == 1)
+// Monta e transmite pacote de manuteno da rede up
+static void NWK_ReactiveUpEvent(void)
+{
+    NWK_Lock(NWK_LOCK_PACKET | NWK_LOCK_NEIGHBOR | NWK_LOCK_TX);
+    ReactiveUpMessage();
+    NWK_Unlock(NWK_LOCK_PACKET | NWK_LOCK_NEIGHBOR | NWK_LOCK_TX);
+}
 
+// Verifica a tabela de rotas up
+static void NWK_VerifyUpRouteEvent(void)
+{
+    NWK_Lock(NWK_LOCK_UP_ROUTE);
+    VerifyUpRouteTable();
+    NWK_Unlock(NWK_LOCK_UP_ROUTE);
+}
+#endif
+
+// Verifica a tabela de vizinhos
+static void NWK_VerifyNeighbourhoodEvent(void)
+{
+    NWK_Lock(NWK_LOCK_NEIGHBOR);
+    VerifyNeighbourhood();
+    NWK_Unlock(NWK_LOCK_NEIGHBOR);
+}
+
+// Reset de Radio
+static void NWK_RadioResetEvent(void)
+{
+    NWK_Lock(NWK_LOCK_TX);
+    
+    //  Disable receiving packets off air
+    PHYSetShortRAMAddr(WRITE_BBREG1,0x04);
+    
+    // Limpa o buffer de recepo
+    RFBufferClean();
+    
+    MRF24J40Reset();
+    
+    //  Enable receiving packets off air
+    PHYSetShortRAMAddr(WRITE_BBREG1,0x00);         
+    
+    NWK_Unlock(NWK_LOCK_TX);
+    
+    // Statistics
+    UNET_NodeStat.radioresets++;
+    CHECK_NODESTAT(UNET_NodeStat.radioresets);
+}
+
+
+/* Registra o tratador de um evento da tarefa de rede (um bit de nwk_tasks_pending).
+   Os tratadores so chamados pela tarefa de rede, na ordem de registro */
+INT8U NWK_EventRegister(INT16U event, NWK_EVENT_HANDLER handler)
+{
+    INT8U status = OK;
+    
+    UserEnterCritical();
+    if (NWK_EventCount < NWK_EVENT_HANDLERS)
+    {
+      NWK_Events[NWK_EventCount].Event   = event;
+      NWK_Events[NWK_EventCount].Handler = handler;
+      NWK_EventCount++;
+      NWK_EventMask |= event;
+    }else
+    {
+      status = NWK_EVENT_TABLE_FULL;
+    }
+    UserExitCritical();
+    
+    return status;
+}
+
+// Sinaliza um evento e acorda a tarefa de rede (somente em tarefas)
+void NWK_EventSignal(INT16U event)
+{
+    UserEnterCritical();
+    nwk_tasks_pending |= event;
+    UserExitCritical();
+    
+    OSSemPost(MAC_Event);
+}
+
+// Eventos da pilha, na ordem de tratamento
+static void NWK_EventInit(void)
+{
+    NWK_EventCount = 0;
+    NWK_EventMask  = 0;
+    
+    if ((NWK_EventRegister(NWK_EVENT_ROUTE, NWK_RouteEvent) != OK) ||
+        (NWK_EventRegister(NWK_EVENT_SEND, NWK_SendEvent) != OK) ||
+        (NWK_EventRegister(NWK_EVENT_NEW_NEIGHBOR_PING, NWK_NewNeighborPingEvent) != OK) ||
+        (NWK_EventRegister(NWK_EVENT_DATA_PING, NWK_DataPingEvent) != OK) ||
+#if (USE_REACTIVE_UP_ROUTE == 1)
+        (NWK_EventRegister(NWK_EVENT_REACTIVE_UP, NWK_ReactiveUpEvent) != OK) ||
+        (NWK_EventRegister(NWK_EVENT_VERIFY_UP_ROUTE, NWK_VerifyUpRouteEvent) != OK) ||
+#endif
+        (NWK_EventRegister(NWK_EVENT_VERIFY_NEIGHBOURHOOD, NWK_VerifyNeighbourhoodEvent) != OK) ||
+        (NWK_EventRegister(NWK_EVENT_RADIO_RESET, NWK_RadioResetEvent) != OK))
+    {
+      while(1){};
+    }
+}
 
-/* UNET Network Handler */
 void UNET_NWK(void *param)
 {
    // task setup
    INT8U i        = 0;
+   ostick_t aggregation_wait = 0;       // 0: sem timeout
+   INT16U events  = 0;
    
    (void)param;
    
@@ -546,7 +1223,7 @@ void UNET_NWK(void *param)
    // Inicializa flags de estado da rede
    UserEnterCritical();
    mac_tasks_pending.Val = 0; 
-   nwk_tasks_pending.Val = 0;
+   nwk_tasks_pending = 0;
    UserExitCritical();
    
    NeighborPingTimeV = NEIGHBOR_PING_TIME + RadioRand() * 75;
@@ -561,6 +1238,7 @@ void UNET_NWK(void *param)
    }     
    
    #if (DEVICE_TYPE == PAN_COORDINATOR)
+   NWK_HeaderTemplates();
    UserEnterCritical();
     mac_tasks_pending.bits.isAssociated = 1;
    UserExitCritical();
@@ -576,6 +1254,7 @@ void UNET_NWK(void *param)
 
 	  	  // Grava os endereos mac e panid no radio
           PHYSetDeviceAddress(macPANId,macAddr);
+          NWK_HeaderTemplates();
 
           UserEnterCritical();
             RouterCapacity = 1;
@@ -595,6 +1274,7 @@ void UNET_NWK(void *param)
         macPANId = (INT16U)(macPANIdentificator & 0xFFFF); 
         
         PHYSetDeviceAddress(macPANId,macAddr);
+        NWK_HeaderTemplates();
                
         UserEnterCritical();
           RouterCapacity = 1;     /* bug corrigido: 01-09-2014 */
@@ -659,220 +1339,424 @@ void UNET_NWK(void *param)
    // task main loop
    for (;;)
    {
-      // Espera por um evento da camada MAC sem timeout
-      OSSemPend(MAC_Event,0);
-      
-      acquireRadio();
+      // Espera por um evento da camada MAC, sem timeout
+      // (ou at o envio das mensagens agregadas)
+      OSSemPend(MAC_Event,aggregation_wait);
       
+      // L e limpa de uma vez os eventos com tratador registrado
       UserEnterCritical();
-      // Verifica solicitao de roteamento de pacote
-      if (nwk_tasks_pending.bits.RoutePending == 1)          // set in UNET_MAC
-      {
-    	  UserExitCritical();
-    	  /* route and keep stats */
-          if(HandleRoutePacket() == OK){      
-            UNET_NodeStat.routed++;
-            CHECK_NODESTAT(UNET_NodeStat.routed);
-          }else{
-            UNET_NodeStat.routdrop++;
-            CHECK_NODESTAT(UNET_NodeStat.routdrop);
-          }
-          UserEnterCritical();
-            nwk_tasks_pending.bits.RoutePending = 0;
-          UserExitCritical();
-      }else
-      {
-    	  UserExitCritical();
-      }
+      events = nwk_tasks_pending & NWK_EventMask;
+      nwk_tasks_pending &= (INT16U)~events;
+      UserExitCritical();
       
-      // Analisa novo ping de vizinho
-      UserEnterCritical();
-      if (nwk_tasks_pending.bits.NewNeighborPing == 1)      // set in UNET_MAC
+      // Trata os eventos na ordem de registro.
+      // Cada tratador adquire somente as guardas que usa (NWK_Lock)
+      for (i = 0; (events != 0) && (i < NWK_EventCount); i++)
       {
-          UserExitCritical();
-          
-      	  HandleNewNeighborPing();
-      	  
-      	  UserEnterCritical();
-          nwk_tasks_pending.bits.NewNeighborPing = 0;
-          UserExitCritical();
-      }else
-  		{
-  			  UserExitCritical();
-  		}
-           
-      // Monta e transmite pacote com ping para vizinhana
-#if (CONTIKI_MAC_ENABLE == 1)
-next_ping:      
-#endif
-	  UserEnterCritical();
-      if (nwk_tasks_pending.bits.DataPingPending == 1)  // set in BRTOS_TimerHook
-      {
-          UserExitCritical();
-           
-          debug_tx_count4++;
-          
-#if ((CONTIKI_MAC_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))
-          if (!GetRadioStatus()){
-        	  SetRadioStatus(1);
-			  RADIO_WAKE_STATUS_OLD = RADIO_WAKE_STATUS;
-			  // Se o rdio estiver desligado, liga o radio
-			  if( RADIO_WAKE_STATUS == RADIO_SLEEPING){
-				  // Liga o rdio e espera tempo de estabilizao
-				  WakeupRadio();
-				  DelayTask(2);
-			  }
-          }
+        if (events & NWK_Events[i].Event)
+        {
+          events &= (INT16U)~NWK_Events[i].Event;
+          NWK_Events[i].Handler();
+        }
+      }
+
+#if ((NWK_AGGREGATION_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))
+      NWK_Lock(NWK_LOCK_NEIGHBOR | NWK_LOCK_TX);
+      aggregation_wait = NWK_AggregationPoll();
+      NWK_Unlock(NWK_LOCK_NEIGHBOR | NWK_LOCK_TX);
 #endif
-          
-          NeighborPing();
-		  ping_retries++;
+   }
+}
 
-          if (OSSemPend(RF_TX_Event,PING_TIME) == TIMEOUT)
-          {
-        	  UserEnterCritical();
-        	  //nwk_tasks_pending.bits.RadioReset = 1;
-        	  nwk_tasks_pending.bits.RadioReset = 0;
-        	  UserExitCritical();
-          }else
-          {
-        	  nwk_tasks_pending.bits.RadioReset = 0;
-          }
-          
-          UserEnterCritical();
-          nwk_tasks_pending.bits.DataPingPending = 0;
-          UserExitCritical();
 
-    	if(nwk_tasks_pending.bits.RetryBroadcast == 1)
-        {    		
-#if (CONTIKI_MAC_ENABLE == 1)
-    		// Descobre o tempo total do processo
-    		stop_ping_time = OSGetTickCount();
-
-    		if (stop_ping_time > start_ping_time)
-    		{
-    			stop_ping_time = stop_ping_time - start_ping_time;
-    		}else
-    		{
-    			stop_ping_time = stop_ping_time + (TICK_COUNT_OVERFLOW - start_ping_time);
-			}
+/* Numero de frames entre dois indices do buffer de recepo.
+   Os indices andam em [0, 2*RFBufferSize), assim buffer cheio (In - Out == RFBufferSize)
+   e buffer vazio (In == Out) so distinguidos sem contador compartilhado */
+static INT8U RFBufferDistance(INT8U from, INT8U to)
+{
+    INT16S entries = (INT16S)to - (INT16S)from;
+    if (entries < 0)
+    {
+      entries += 2*RFBufferSize;
+    }
+    return (INT8U)entries;
+}
 
-    		if (stop_ping_time < 132)
-			{
-				// Avisa que h um ping pendente
-    			UserEnterCritical();
-				nwk_tasks_pending.bits.DataPingPending = 1;
-				UserExitCritical();
-				
-				goto next_ping;
-#else
-	    	if (ping_retries < PING_RETRIES)
-			{				
-				// Avisa que h um ping pendente
-    			UserEnterCritical();
-				nwk_tasks_pending.bits.DataPingPending = 1;
-				UserExitCritical();
-				
-				// Acorda a tarefa de rede
-				OSSemPost(MAC_Event);
-#endif
-			}else
-			{
-#if ((CONTIKI_MAC_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))		        
-				SetRadioStatus(0);
-				// Se no estado anterior o radio estava desligado, desliga o radio agora
-		        if( RADIO_WAKE_STATUS_OLD == RADIO_SLEEPING) SleepRadio();
-#endif
-				
-				UserEnterCritical();
-				nwk_tasks_pending.bits.RetryBroadcast = 0;
-				UserExitCritical();
-			}
+// Frames no buffer: ainda no decodificados e reservados por pacotes
+#define RFBufferEntries()     RFBufferDistance(RFBuffer.Out, RFBuffer.In)
+
+// Frames ainda no decodificados pelo UNET_MAC
+#define RFBufferPending()     RFBufferDistance(RFBuffer.Next, RFBuffer.In)
+
+static INT8U RFBufferNext(INT8U index)
+{
+    index++;
+    if (index >= 2*RFBufferSize)
+    {
+      index = 0;
+    }
+    return index;
+}
+
+#define RFBufferIndex(index)  (INT8U)(((index) < RFBufferSize) ? (index) : ((index) - RFBufferSize))
+#define RFBufferSlot(index)   (&RFBuffer.Slot[RFBufferIndex(index)])
+
+/* Avana Out sobre os slots j liberados pelos pacotes. Chamada em seo crtica */
+static void RFBufferReclaim(void)
+{
+    while ((RFBuffer.Out != RFBuffer.Next) && (RFBufferSlot(RFBuffer.Out)->Held == 0))
+    {
+      RFBuffer.Out = RFBufferNext(RFBuffer.Out);
+    }
+}
+
+/* Controle de fluxo da recepo: o UNET_RF_Event desabilita o ACK automatico
+   quando o buffer chega a RX_ACK_HIGH_WATERMARK frames e o habilita de novo
+   quando a tarefa que libera um pacote (UNET_MAC ou tarefa de rede) v o
+   buffer descer a RX_ACK_LOW_WATERMARK frames e lhe pede (RFBackpressureRelease).
+   S o UNET_RF_Event muda RFBackpressure e o ACK automatico: as duas transies
+   no se intercalam.
+   RX_ACK_LOW_WATERMARK < RX_ACK_HIGH_WATERMARK <= RFBufferSize */
+
+static volatile INT8U  RFBackpressure        = 0;
+static volatile INT8U  RFBackpressureRelease = 0;
+static ostick_t        RFBackpressureStart   = 0;
+
+static void RFBufferFlowControl(void)
+{
+    INT8U release = FALSE;
+    
+    UserEnterCritical();
+    if ((RFBackpressure == 1) && (RFBackpressureRelease == 0) && (RFBufferEntries() <= RX_ACK_LOW_WATERMARK))
+    {
+      RFBackpressureRelease = 1;
+      release = TRUE;
+    }
+    UserExitCritical();
+    
+    if (release == TRUE)
+    {
+      OSSemPost(RF_Event);
+    }
+}
+
+/* Limpa o buffer de recepo. Chamada com NWK_LOCK_TX.
+   Descarta os frames ainda no decodificados; os slots reservados por
+   pacotes so liberados quando os pacotes forem liberados */
+void RFBufferClean(void)
+{
+    UserEnterCritical();
+    RFBuffer.Next = RFBuffer.In;
+    RFBufferReclaim();
+    UserExitCritical();
+    
+    RFBufferFlowControl();
+}
+
+/* Pool de pacotes recebidos */
+
+// Reserva um pacote livre, com a referncia do UNET_MAC. No bloqueia:
+// sem pacote livre retorna NULL
+static MAC_FRAME_VIEW *UNET_RxPacketAlloc(void)
+{
+    MAC_FRAME_VIEW *packet = NULL;
+    INT8U i;
+    
+    UserEnterCritical();
+    for (i = 0; i < RX_PACKET_POOL_SIZE; i++)
+    {
+      if (RxPacket[i].Refs == 0)
+      {
+        packet = &RxPacket[i];
+        packet->Refs = 1;
+        RxPoolStat.InUse++;
+        if (RxPoolStat.InUse > RxPoolStat.InUseMax)
+        {
+          RxPoolStat.InUseMax = RxPoolStat.InUse;
         }
-      }else
+        break;
+      }
+    }
+    UserExitCritical();
+    
+    return packet;
+}
+
+// Espera um pacote livre (UNET_MAC, sem guardas adquiridas)
+static void UNET_RxPacketWait(void)
+{
+    INT8U exhausted = FALSE;
+    
+    for (;;)
+    {
+      UserEnterCritical();
+      if (RxPoolStat.InUse < RX_PACKET_POOL_SIZE)
       {
-    	  UserExitCritical();
+        UserExitCritical();
+        break;
       }
+      RxPacketWaiting = TRUE;
+      UserExitCritical();
       
-#if (USE_REACTIVE_UP_ROUTE == 1)
-      // Monta e transmite pacote de manuteno da rede up
-	  UserEnterCritical();
-      if (nwk_tasks_pending.bits.ReactiveUpMessagePending == 1)  // set in BRTOS_TimerHook
+      if (exhausted == FALSE)
       {
-          UserExitCritical();
+        exhausted = TRUE;
+        RxPoolStat.Exhausted++;
+      }
+      (void)OSSemPend(RX_PacketFree,0);
+    }
+}
 
-          ReactiveUpMessage();
+// Nova referncia a um pacote (somente de quem j tem uma referncia)
+void UNET_RxPacketRetain(MAC_FRAME_VIEW *packet)
+{
+    UserEnterCritical();
+    packet->Refs++;
+    UserExitCritical();
+}
 
-          UserEnterCritical();
-          nwk_tasks_pending.bits.ReactiveUpMessagePending = 0;
-          UserExitCritical();
-      }else
+// Libera uma referncia ao pacote. Na ltima, o slot do frame  liberado
+// e o UNET_MAC, se estiver esperando um pacote,  acordado
+void UNET_RxPacketRelease(MAC_FRAME_VIEW *packet)
+{
+    INT8U freed = FALSE;
+    INT8U wakeup = FALSE;
+    
+    UserEnterCritical();
+    if (packet->Refs > 0)
+    {
+      packet->Refs--;
+      if (packet->Refs == 0)
       {
-    	  UserExitCritical();
+        RFBuffer.Slot[packet->Slot].Held = 0;
+        RFBufferReclaim();
+        RxPoolStat.InUse--;
+        freed = TRUE;
+        if (RxPacketWaiting == TRUE)
+        {
+          RxPacketWaiting = FALSE;
+          wakeup = TRUE;
+        }
       }
+    }
+    UserExitCritical();
+    
+    if (freed == TRUE)
+    {
+      /* O buffer desceu  marca inferior ? */
+      RFBufferFlowControl();
+    }
+    
+    if (wakeup == TRUE)
+    {
+      OSSemPost(RX_PacketFree);
+    }
+}
 
-      // Verifica a tabela de rotas up
-      UserEnterCritical();
-      if (nwk_tasks_pending.bits.VerifyReactiveUpTable == 1)   // set in BRTOS_TimerHook
+const UNET_RX_POOL_STAT *GetUNET_RxPoolStatistics(void){
+    return &RxPoolStat;
+}
+
+const UNET_FWD_STAT *GetUNET_FwdStatistics(void){
+    return &NWK_FwdStat;
+}
+
+// Copia a mensagem para uma entrada livre do pool de envio e acorda a tarefa de rede.
+// No adquire as guardas da rede: tarefas diferentes montam e enviam mensagens ao mesmo tempo
+INT8U UNET_Send(INT8U Route, INT16U Destiny, const INT8U *Data, INT8U Size, UNET_SEND_HANDLE *Handle)
+{
+    UNET_SEND_ENTRY *send = NULL;
+    INT8U entry = UNET_SEND_NONE;
+    INT8U i;
+    
+    if (Handle != NULL)
+    {
+      *Handle = UNET_SEND_NONE;
+    }
+    
+    if ((Data == NULL) || (Size == 0) || (Size > MAX_APP_PAYLOAD_SIZE))
+    {
+      return PAYLOAD_OVERFLOW;
+    }
+    
+#if (USE_REACTIVE_UP_ROUTE == 0)
+    if (Route == UNET_SEND_UP)
+    {
+      return NO_ROUTE_AVAILABLE;
+    }
+#endif
+    
+    UserEnterCritical();
+    for (i = 0; i < UNET_SEND_POOL_SIZE; i++)
+    {
+      if (UNET_SendPool[i].State == UNET_SEND_FREE)
       {
-          UserExitCritical();
-          VerifyUpRouteTable();
-          UserEnterCritical();
-      	  nwk_tasks_pending.bits.VerifyReactiveUpTable = 0;
-      	  UserExitCritical();
-      }else
+        UNET_SendPool[i].State = UNET_SEND_QUEUED;
+        entry = i;
+        break;
+      }
+    }
+    UserExitCritical();
+    
+    if (entry == UNET_SEND_NONE)
+    {
+      return SEND_POOL_FULL;
+    }
+    
+    send = &UNET_SendPool[entry];
+    for (i = 0; i < Size; i++)
+    {
+      send->Data[i] = Data[i];
+    }
+    send->Size    = Size;
+    send->Route   = Route;
+    send->Destiny = Destiny;
+    send->Status  = SEND_PENDING;
+    send->Owned   = (INT8U)((Handle != NULL) ? TRUE : FALSE);
+    send->Waiting = FALSE;
+    
+    UserEnterCritical();
+    UNET_SendQueue[UNET_SendIn] = entry;
+    UNET_SendIn = (INT8U)((UNET_SendIn + 1) % UNET_SEND_POOL_SIZE);
+    UNET_SendCount++;
+    UserExitCritical();
+    
+    if (Handle != NULL)
+    {
+      *Handle = entry;
+    }
+    
+    NWK_EventSignal(NWK_EVENT_SEND);
+    
+    return OK;
+}
+
+// Resultado de uma mensagem concluda: a entrada  liberada
+static INT8U UNET_SendResult(UNET_SEND_ENTRY *send)
+{
+    INT8U status;
+    
+    UserEnterCritical();
+    status = send->Status;
+    send->Owned = FALSE;
+    send->State = UNET_SEND_FREE;
+    UserExitCritical();
+    
+    return status;
+}
+
+#define UNET_SEND_VALID(h)    (((h) < UNET_SEND_POOL_SIZE) && (UNET_SendPool[(h)].Owned == TRUE))
+
+// SEND_PENDING enquanto a mensagem no foi concluda; depois o seu resultado
+INT8U UNET_SendStatus(UNET_SEND_HANDLE Handle)
+{
+    if (!UNET_SEND_VALID(Handle))
+    {
+      return SEND_HANDLE_ERROR;
+    }
+    
+    if (UNET_SendPool[Handle].State != UNET_SEND_DONE)
+    {
+      return SEND_PENDING;
+    }
+    
+    return UNET_SendResult(&UNET_SendPool[Handle]);
+}
+
+// Espera at Timeout ticks (0: sem timeout) pelo resultado da mensagem.
+// Retorna SEND_PENDING no timeout, e o handle continua vlido
+INT8U UNET_SendWait(UNET_SEND_HANDLE Handle, ostick_t Timeout)
+{
+    UNET_SEND_ENTRY *send;
+    INT8U wait;
+    
+    if (!UNET_SEND_VALID(Handle))
+    {
+      return SEND_HANDLE_ERROR;
+    }
+    
+    send = &UNET_SendPool[Handle];
+    
+    UserEnterCritical();
+    wait = (INT8U)((send->State != UNET_SEND_DONE) ? TRUE : FALSE);
+    send->Waiting = wait;
+    UserExitCritical();
+    
+    if (wait == TRUE)
+    {
+      if (OSSemPend(send->Done, Timeout) != OK)
       {
+        UserEnterCritical();
+        wait = send->Waiting;
+        send->Waiting = FALSE;
         UserExitCritical();
+        
+        if (wait == TRUE)
+        {
+          return SEND_PENDING;
+        }
+        
+        // Concluda depois do timeout: consome o sinal de NWK_SendDone
+        (void)OSSemPend(send->Done, 0);
       }
-#endif
+    }
+    
+    return UNET_SendResult(send);
+}
+
+// Descarta o handle: uma mensagem ainda no concluda  enviada e a entrada 
+// liberada no fim da transmisso
+void UNET_SendRelease(UNET_SEND_HANDLE Handle)
+{
+    if (!UNET_SEND_VALID(Handle))
+    {
+      return;
+    }
+    
+    UserEnterCritical();
+    UNET_SendPool[Handle].Owned = FALSE;
+    if (UNET_SendPool[Handle].State == UNET_SEND_DONE)
+    {
+      UNET_SendPool[Handle].State = UNET_SEND_FREE;
+    }
+    UserExitCritical();
+}
 
-      // Verifica a tabela de vizinhos
+// Fim das mensagens do pool de envio (tarefa de rede ou callbacks da tarefa UNET_TX)
+void NWK_SendDone(INT8U Send, INT8U status)
+{
+    UNET_SEND_ENTRY *send;
+    INT8U wake;
+    INT8U i;
+    
+    for (i = 0; i < UNET_SEND_POOL_SIZE; i++)
+    {
+      if ((Send & NWK_SEND_MASK(i)) == 0)
+      {
+        continue;
+      }
+      
+      send = &UNET_SendPool[i];
+      wake = FALSE;
+      
       UserEnterCritical();
-      if (nwk_tasks_pending.bits.VerifyNeighbourhoodTable == 1)   // set in BRTOS_TimerHook
+      if (send->Owned == TRUE)
       {
-          UserExitCritical();
-          VerifyNeighbourhood();
-          UserEnterCritical();
-      	  nwk_tasks_pending.bits.VerifyNeighbourhoodTable = 0;
-      	  UserExitCritical();
+        send->Status  = status;
+        send->State   = UNET_SEND_DONE;
+        wake          = send->Waiting;
+        send->Waiting = FALSE;
       }else
       {
-        UserExitCritical();     
+        send->State   = UNET_SEND_FREE;
       }
+      UserExitCritical();
       
-      // Reset de Radio
-      UserEnterCritical();
-      if (nwk_tasks_pending.bits.RadioReset == 1)   // set in BRTOS_TimerHook & UNET_NWK
+      if (wake == TRUE)
       {
-          nwk_tasks_pending.bits.RadioReset = 0;
-          UserExitCritical();          
-          
-          //  Disable receiving packets off air
-          PHYSetShortRAMAddr(WRITE_BBREG1,0x04);
-          
-          // Limpa o buffer de recepo
-          (void)OSCleanQueue(RF);
-          
-          MRF24J40Reset();
-
-          //  Enable receiving packets off air
-          PHYSetShortRAMAddr(WRITE_BBREG1,0x00);         
-          
-          // Statistics
-          UNET_NodeStat.radioresets++;
-          CHECK_NODESTAT(UNET_NodeStat.radioresets);
-      }           
-
-      releaseRadio();      
-   }
-}
-
-
-static void RFBufferClean(void)
-{
-    (void)OSCleanQueue(RF);
-    mac_packet.Dst_PAN_Ident = 0xFFFE;
-    mac_packet.DstAddr_16b   = 0xFFFE;            
+        OSSemPost(send->Done);
+      }
+    }
 }
 
 #if ((INCLUDE_PRINT == 1) && (DEVICE_TYPE == PAN_COORDINATOR))
@@ -880,344 +1764,125 @@ static void RFBufferClean(void)
 #include "utils.h"
 #endif
 
+/* Distribuio de frames decodificados por ativao do UNET_MAC */
+static void RFDrainStat(INT8U frames)
+{
+    if (frames >= 8)
+    {
+      UNET_NodeStat.drain8++;
+      CHECK_NODESTAT(UNET_NodeStat.drain8);
+    }else
+    if (frames >= 4)
+    {
+      UNET_NodeStat.drain4++;
+      CHECK_NODESTAT(UNET_NodeStat.drain4);
+    }else
+    if (frames >= 2)
+    {
+      UNET_NodeStat.drain2++;
+      CHECK_NODESTAT(UNET_NodeStat.drain2);
+    }else
+    if (frames == 1)
+    {
+      UNET_NodeStat.drain1++;
+      CHECK_NODESTAT(UNET_NodeStat.drain1);
+    }
+}
+
 // UNET MAC Handler
+// Decodifica em uma nica aquisio das guardas todos os frames do buffer de RX,
+// at RX_DRAIN_MAX frames, cada um em um pacote do pool. Os pacotes a rotear vo
+// para a fila de repasse e o lote continua; o lote termina no frame que deixa
+// trabalho para a tarefa de rede sobre a tabela de vizinhos (ping de vizinhana,
+// associao), que s roda depois de liberadas as guardas, ou quando o pool se esgota.
+// A tabela de rotas up no  usada: ReactiveUpMessage e as aplicaes seguem com ela
 void UNET_MAC(void *param)
 {
    /* task setup */
-   INT8U packet_size = 0;
    INT8U data1 = 0;
-   INT8U data2 = 0;
    INT8U i = 0;
    INT8U index = 0;
    INT8U beacon = 0;
-   INT8U packet_state = 0;
-   INT8U packet_error = 0;
-   INT16U CRCValue = 0;
+   INT8U frames = 0;
+   INT8U handoff = FALSE;
+   MAC_FRAME_VIEW *packet = NULL;   // pacote com a referncia do UNET_MAC
+   MAC_FRAME_VIEW *drop;            // pacote descartado pela fila de repasse cheia
 
 #if ((INCLUDE_PRINT == 1) && (DEVICE_TYPE == PAN_COORDINATOR))
    char buffer[8];
 #endif
 
    (void)param;
-   packet_state = start_packet;
    BeaconCnt = 0; 
    
    for (;;) 
    {
       OSSemPend (RF_RX_Event,0);
-            
-      acquireRadio();
       
-      // Retira da fila o tamanho do pacote
-      (void)OSRQueue(&RFBuffer,&packet_size);
-      
-      packet_state = start_packet;
-      packet_error = 0;
-      
-      if (packet_size > 128)
+      // O pacote do ltimo frame do lote anterior ficou com o UNET_MAC at aqui
+      // (a associao l mac_frame depois de acordada)
+      if (packet != NULL)
       {
-        RFBufferClean();
-        packet_error++;
-        packet_state = end_packet;
+        UNET_RxPacketRelease(packet);
+        packet = NULL;
       }
       
-      // Retira do pacote o frame control
-      (void)OSRQueue(&RFBuffer,&data1);
-      (void)OSRQueue(&RFBuffer,&data2);
-      mac_frame_control.Val = (INT16U)((data1 << 8)  | data2);
-
-      // Retira do pacote o sequence number
-      (void)OSRQueue(&RFBuffer,(INT8U *)&mac_packet.Sequence_Number);
-      packet_size -= 3;
+      // Pool esgotado: os pacotes esto na fila de repasse ou em roteamento.
+      // Os frames esperam no buffer de RX (controle de fluxo do rdio)
+      UNET_RxPacketWait();
+            
+      // Tabela de vizinhos (VerifyPacketReplicated) e TX FIFO
+      // (respostas MAC e controle de fluxo do rdio)
+      NWK_Lock(NWK_LOCK_NEIGHBOR | NWK_LOCK_TX);
       
-      if (packet_size > 128)
-      {
-        RFBufferClean();
-        packet_error++;
-        packet_state = end_packet;
-      }            
+      frames  = 0;
+      handoff = FALSE;
       
-      // Inicia mquina de estados para decodificar pacote
-      while(packet_state != end_packet)
-      {  
-        switch(packet_state)
-        {
-          case start_packet:
-            switch(mac_frame_control.bits.DstAddrMode)
-            {
-              case 0:
-                packet_state = dest_00;
-                break;
-              case 1:
-                packet_state = dest_01;
-                break;
-              case 2:
-                packet_state = dest_10;
-                packet_size -= 4;
-                if (packet_size > 128)
-                {
-                  RFBufferClean();
-                  packet_error++;
-                  packet_state = end_packet;
-                }                
-                break;
-              case 3:
-                packet_state = dest_11;
-                packet_size -= 10;
-                if (packet_size > 128)
-                {
-                  RFBufferClean();
-                  packet_error++;
-                  packet_state = end_packet;
-                }                
-                break;
-              default:
-                RFBufferClean();
-                packet_error++;
-                packet_state = end_packet;              
-                break;
-            }
-          break;
-          
-          case dest_00:
-             mac_packet.DstAddr_16b   = 0xFFFE;
-             mac_packet.Dst_PAN_Ident = 0xFFFE;
-             for(i=8;i>0;i--)
-             {
-                mac_packet.DstAddr_64b[i-1] = 0;
-             }           
-             packet_state = intra_pan; 
-             break;
-          case dest_01:
-             for(i=0;i<packet_size;i++)
-             {
-                (void)OSRQueue(&RFBuffer,&data1);    
-             }
-             packet_state = end_packet;
-             break;
-          case dest_10:
-             (void)OSRQueue(&RFBuffer,&data1);
-             (void)OSRQueue(&RFBuffer,&data2);
-             mac_packet.Dst_PAN_Ident = (INT16U)((data2 << 8) | data1);
-             (void)OSRQueue(&RFBuffer,&data1);
-             (void)OSRQueue(&RFBuffer,&data2);
-             mac_packet.DstAddr_16b = (INT16U)((data2 << 8) | data1);
-             packet_state = intra_pan;
-             break;
-          case dest_11:
-             (void)OSRQueue(&RFBuffer,&data1);
-             (void)OSRQueue(&RFBuffer,&data2);
-             mac_packet.Dst_PAN_Ident = (INT16U)((data2 << 8) | data1);
-             for(i=8;i>0;i--)
-             {
-                (void)OSRQueue(&RFBuffer,(INT8U *)&mac_packet.DstAddr_64b[i-1]);
-             }
-             packet_state = intra_pan;        
-             break;                                 
-          case intra_pan:
-             if(mac_frame_control.bits.IntraPAN)
-             {
-                switch(mac_frame_control.bits.SrcAddrMode)
-                {
-                  case 0:
-                    packet_state = source_100;
-                    break;
-                  case 1:
-                    packet_state = source_101;
-                    break;
-                  case 2:
-                    packet_state = source_110;                
-                    break;
-                  case 3:
-                    packet_state = source_111;
-                    break;
-                  default:
-                    RFBufferClean();
-                    packet_error++;
-                    packet_state = end_packet;              
-                    break;                    
-                }
-                
-             }else
-             {
-                switch(mac_frame_control.bits.SrcAddrMode)
-                {
-                  case 0:
-                    packet_state = source_000;
-                    break;
-                  case 1:
-                    packet_state = source_001;
-                    break;
-                  case 2:
-                    packet_state = source_010;                
-                    break;
-                  case 3:
-                    packet_state = source_011;
-                    break;
-                  default:
-                    RFBufferClean();
-                    packet_error++;
-                    packet_state = end_packet;              
-                    break;                                                                          
-                }           
-             }
-            break;
-          case source_000:
-            mac_packet.SrcAddr_16b   = 0xFFFE;
-            mac_packet.Src_PAN_Ident = 0xFFFE;
-            for(i=8;i>0;i--)
-            {
-               mac_packet.SrcAddr_64b[i-1] = 0;
-            }
-            packet_state = payload;
-            break;
-          case source_001:
-            for(i=0;i<packet_size;i++)
-            {
-               (void)OSRQueue(&RFBuffer,&data1);
-            }
-            packet_state = end_packet;
-            break;
-          case source_010:
-            (void)OSRQueue(&RFBuffer,&data1);
-            (void)OSRQueue(&RFBuffer,&data2);
-            mac_packet.Src_PAN_Ident = (INT16U)((data2 << 8) | data1);
-            (void)OSRQueue(&RFBuffer,&data1);
-            (void)OSRQueue(&RFBuffer,&data2);
-            mac_packet.SrcAddr_16b = (INT16U)((data2 << 8) | data1);
-            packet_size -= 4;
-            if (packet_size > 128)
-            {
-              RFBufferClean();
-              packet_error++;
-              packet_state = end_packet;
-            }
-            packet_state = payload;
-            break;
-          case source_011:
-            (void)OSRQueue(&RFBuffer,&data1);
-            (void)OSRQueue(&RFBuffer,&data2);
-            mac_packet.Src_PAN_Ident = (INT16U)((data2 << 8) | data1);
-            for(i=8;i>0;i--)
-            {
-               (void)OSRQueue(&RFBuffer,(INT8U *)&mac_packet.SrcAddr_64b[i-1]);
-            }        
-            packet_size -= 10;
-            if (packet_size > 128)
-            {
-              RFBufferClean();
-              packet_error++;
-              packet_state = end_packet;
-            }            
-            packet_state = payload;
-            break;
-          case source_100:
-            mac_packet.SrcAddr_16b   = 0xFFFE;
-            mac_packet.Src_PAN_Ident = 0xFFFE;
-            for(i=8;i>0;i--)
-            {
-               mac_packet.SrcAddr_64b[i-1] = 0;
-            }
-            packet_state = payload;         
-            break;
-          case source_101:
-            for(i=0;i<packet_size;i++)
-            {
-               (void)OSRQueue(&RFBuffer,&data1);
-            }
-            packet_state = end_packet;        
-            break;
-          case source_110:
-            mac_packet.Src_PAN_Ident = 0xFFFE;
-            (void)OSRQueue(&RFBuffer,&data1);
-            (void)OSRQueue(&RFBuffer,&data2);
-            mac_packet.SrcAddr_16b = (INT16U)((data2 << 8) | data1);
-            packet_size -= 2;
-            if (packet_size > 128)
-            {
-              RFBufferClean();
-              packet_error++;
-              packet_state = end_packet;
-            }            
-            packet_state = payload;
-            break;
-          case source_111:
-            mac_packet.Src_PAN_Ident = 0xFFFE;
-            for(i=8;i>0;i--)
-            {
-               (void)OSRQueue(&RFBuffer,(INT8U *)&mac_packet.SrcAddr_64b[i-1]);
-            }
-            packet_size -= 8;
-            if (packet_size > 128)
-            {
-              RFBufferClean();
-              packet_error++;
-              packet_state = end_packet;
-            }            
-            packet_state = payload;
-            break;
-          case payload:
-            mac_packet.Payload_Size = 0;
-            if (packet_size > 123) 
-            {
-              RFBufferClean();
-              packet_error++;
-              packet_state = end_packet;
-            }
-            for(i=0;i<(packet_size-2);i++)
-            {
-               (void)OSRQueue(&RFBuffer,(INT8U *)&mac_packet.MAC_Payload[i]);
-               mac_packet.Payload_Size++;
-            }
-            packet_size = (INT8U)(packet_size - mac_packet.Payload_Size);
-            if (packet_size > 128)
-            {
-              RFBufferClean();
-              packet_error++;
-              packet_state = end_packet;
-            }             
-            packet_state = CRC;         
-            break;
-          case CRC:
-            (void)OSRQueue(&RFBuffer,&data1);
-            (void)OSRQueue(&RFBuffer,&data2);
-            mac_packet.Frame_CRC = (INT16U)((data2 << 8) | data1);
-            packet_size -= 2;
-            
-            // Salva CRC Computado
-            (void)OSRQueue(&RFBuffer,&data1);
-            (void)OSRQueue(&RFBuffer,&data2);
-            CRCValue = (INT16U)((data1 << 8) | data2);
-            
-            // Salva o RSSI (Receiver Signal Strength Indicator)
-            (void)OSRQueue(&RFBuffer,(INT8U *)&mac_packet.Frame_RSSI);
-             // Salva o LQI (Link Quality Indicator)
-            (void)OSRQueue(&RFBuffer,(INT8U*)(&mac_packet.Frame_LQI));
-            
-            packet_state = end_packet;
-            break;
-          default:
-            RFBufferClean();
-            packet_error++;
-            packet_state = end_packet;
-            break;                    
-        }
+      do
+      {
+      // Libera o pacote do frame anterior, se ningum mais o referencia
+      if (packet != NULL)
+      {
+        UNET_RxPacketRelease(packet);
+        packet = NULL;
       }
       
+      // O buffer pode ter sido limpo depois do sinal (reset do rdio)
+      if (RFBufferPending() == 0)
+      {
+        break;
+      }
       
-      packet_state = start_packet;
+      packet = UNET_RxPacketAlloc();
+      if (packet == NULL)
+      {
+        // O sinal do frame fica pendente: o prximo lote espera um pacote livre
+        break;
+      }
       
-            
-      /* Tem espao para o prximo pacote ? */
-      if(RFBuffer.OSQEntries + 133  <= RFBufferSize){
-        PHYSetAutoACK(1);        
+      // Cada frame publicado no buffer sinalizou RF_RX_Event antes de
+      // ser visto aqui: consome o sinal dos frames seguintes do lote (no bloqueia)
+      if (frames > 0)
+      {
+        (void)OSSemPend (RF_RX_Event,0);
       }
+      frames++;
+      
+      // O cabealho  decodificado diretamente no slot, que fica reservado
+      // enquanto o pacote tiver referncias. Uma nica atualizao de indice por frame
+      UserEnterCritical();
+      packet->Slot = RFBufferIndex(RFBuffer.Next);
+      RFBuffer.Slot[packet->Slot].Held = 1;
+      RFBuffer.Next = RFBufferNext(RFBuffer.Next);
+      UserExitCritical();
       
+      mac_frame = packet;
+      data1 = MAC_FrameParse(&RFBuffer.Slot[packet->Slot]);
       
       // Reset do contador de Watchdog do Radio
       RadioWatchdog = 0;
       
-      if ((mac_packet.Frame_CRC != CRCValue) || (packet_error != 0)){         
+      if (data1 != TRUE){         
           UNET_NodeStat.dropped++;
           CHECK_NODESTAT(UNET_NodeStat.dropped);
       }else 
@@ -1227,25 +1892,25 @@ void UNET_MAC(void *param)
           {
             // Testa o PANId
             data1 = 0;
-            if((mac_packet.Dst_PAN_Ident == macPANId) || (mac_packet.Dst_PAN_Ident == 0xFFFF))
+            if((MAC_RX_DST_PAN_IDENT() == macPANId) || (MAC_RX_DST_PAN_IDENT() == 0xFFFF))
             {  
                 // Testa o endereo
                 switch(mac_frame_control.bits.DstAddrMode)
                 {
                   case 0b10:
                     // Testa endereo de 16 bits
-                    if(mac_packet.DstAddr_16b != macAddr)
+                    if(MAC_RX_DST_ADDR_16B() != macAddr)
                       data1 = 0xFF;
                     
                     // Verifica se  broadcast
-                    if(mac_packet.DstAddr_16b == 0xFFFF)
+                    if(MAC_RX_DST_ADDR_16B() == 0xFFFF)
                       data1 = 0;            
                     break;
                   case 0b11:
                     // Testa endereo de 64 bits
                     for(i=0;i<8;i++)
                     {
-                      if(mac_packet.DstAddr_64b[i] != mac64Address[i])
+                      if(MAC_RX_DST_ADDR_64B(i) != mac64Address[i])
                       {
                         data1++;
                       }
@@ -1254,7 +1919,7 @@ void UNET_MAC(void *param)
                   default:
                     UNET_NodeStat.dropped++;
                     CHECK_NODESTAT(UNET_NodeStat.dropped);
-                    (void)OSCleanQueue(RF);
+                    RFBufferClean();
                     break;
                 }
             }else
@@ -1287,49 +1952,79 @@ void UNET_MAC(void *param)
                     #endif                      
                     
                     // Analisa tipo de data frame
-                    switch(mac_packet.MAC_Payload[0])
+                    switch(mac_frame->MAC_Payload[0])
                     {
                       case DATA_PING:
                         // pacote de ping de vizinhana
 						#if ((INCLUDE_PRINT == 1) && (DEVICE_TYPE == PAN_COORDINATOR))
                     	PRINT_PING_INFO();
 						#endif
-                        unet_neighbor_ping.Addr_16b            = mac_packet.SrcAddr_16b;
-                        unet_neighbor_ping.NeighborRSSI        = mac_packet.Frame_RSSI;
-                        unet_neighbor_ping.NeighborLQI         = mac_packet.Frame_LQI;
-                        unet_neighbor_ping.NeighborDepth       = mac_packet.MAC_Payload[1];
+                        unet_neighbor_ping.Addr_16b            = MAC_RX_SRC_ADDR_16B();
+                        unet_neighbor_ping.NeighborRSSI        = mac_frame->Frame_RSSI;
+                        unet_neighbor_ping.NeighborLQI         = mac_frame->Frame_LQI;
+                        unet_neighbor_ping.NeighborDepth       = mac_frame->MAC_Payload[1];
                         index = 2;
                         
                         // Copy neighbourhood of this neighbor
                         unet_neighbor_ping.NeighborsNumber = 0;
-                        for(i=0;i<((mac_packet.Payload_Size - index)/3);i++)
+                        for(i=0;i<((mac_frame->Payload_Size - index)/3);i++)
                         {
                           if(i>=NEIGHBOURHOOD_SIZE) break; 
-                          unet_neighbor_ping.Neighbors[i] = (INT16U)((mac_packet.MAC_Payload[(index+(i*3))] << 8) | mac_packet.MAC_Payload[(index+1+(i*3))]);
-                          unet_neighbor_ping.NeighborsRSSI[i] = mac_packet.MAC_Payload[(index+2+(i*3))];
+                          unet_neighbor_ping.Neighbors[i] = (INT16U)((mac_frame->MAC_Payload[(index+(i*3))] << 8) | mac_frame->MAC_Payload[(index+1+(i*3))]);
+                          unet_neighbor_ping.NeighborsRSSI[i] = mac_frame->MAC_Payload[(index+2+(i*3))];
                           unet_neighbor_ping.NeighborsNumber++;
                         }
                         
-                        // Acorda tarefa de rede
-                        UserEnterCritical();
-                          nwk_tasks_pending.bits.NewNeighborPing = 1;
-                        UserExitCritical();
-                        
                         UNET_NodeStat.hellos++;
                         CHECK_NODESTAT(UNET_NodeStat.hellos);
                         
-                        OSSemPost(MAC_Event);
+                        // Acorda tarefa de rede
+                        handoff = TRUE;
+                        NWK_EventSignal(NWK_EVENT_NEW_NEIGHBOR_PING);
                         break;
 
                       case ROUTE_PACKET:
-                        if (VerifyPacketReplicated() == OK)
+                        // Cabealho NWK completo ou comprimido
+                        if ((NWK_HeaderParse() == OK) && (VerifyPacketReplicated() == OK))
                         {
-                          // Armazena no buffer de roteamento e acorda tarefa de rede
+                          // Passa a referncia do pacote para a fila de repasse e acorda a
+                          // tarefa de rede. Com a fila cheia descarta o pacote novo ou o mais antigo
+                          drop = NULL;
                           UserEnterCritical();
-                            nwk_tasks_pending.bits.RoutePending = 1;
+                          if (NWK_FwdCount == NWK_FWD_QUEUE_SIZE)
+                          {
+                            #if (NWK_FWD_DROP_POLICY == NWK_FWD_DROP_OLDEST)
+                            drop = NWK_FwdQueue[NWK_FwdOut];
+                            NWK_FwdOut = (INT8U)((NWK_FwdOut + 1) % NWK_FWD_QUEUE_SIZE);
+                            NWK_FwdCount--;
+                            #else
+                            drop = packet;
+                            #endif
+                          }
+                          if (drop != packet)
+                          {
+                            NWK_FwdQueue[NWK_FwdIn] = packet;
+                            NWK_FwdTx[NWK_FwdIn]    = (INT8U)(((mac_frame->MAC_Payload[1] & (NWK_DEST | NWK_BROADCAST)) != NWK_DEST) ? TRUE : FALSE);
+                            NWK_FwdIn = (INT8U)((NWK_FwdIn + 1) % NWK_FWD_QUEUE_SIZE);
+                            NWK_FwdCount++;
+                            NWK_FwdStat.Queued++;
+                            if (NWK_FwdCount > NWK_FwdStat.DepthMax)
+                            {
+                              NWK_FwdStat.DepthMax = NWK_FwdCount;
+                            }
+                          }
                           UserExitCritical();
                           
-                          OSSemPost(MAC_Event);
+                          if (drop != NULL)
+                          {
+                            UNET_FwdDrop((drop == packet) ? NWK_DROP_QUEUE_TAIL : NWK_DROP_QUEUE_OLDEST);
+                            UNET_RxPacketRelease(drop);
+                          }
+                          if (drop != packet)
+                          {
+                            NWK_EventSignal(NWK_EVENT_ROUTE);
+                          }
+                          packet = NULL;
                         }
                         break;
                       
@@ -1364,7 +2059,7 @@ void UNET_MAC(void *param)
                         // Verifica se este beacon j no est alocado
                         for(i=0;i<BeaconLimit;i++)
                         {
-                          if (unet_beacon[i].Addr_16b == mac_packet.SrcAddr_16b)
+                          if (unet_beacon[i].Addr_16b == MAC_RX_SRC_ADDR_16B())
                           {
                             // utiliza a mesma varivel para informar
                             // que o beacon deste PANId j est alocado
@@ -1376,11 +2071,11 @@ void UNET_MAC(void *param)
                         // Se o beacon da rede UNET ainda no foi alocado, Aloca
                         if (beacon == TRUE)
                         { 
-                          unet_beacon[BeaconCnt].PAN_Ident         = mac_packet.Src_PAN_Ident;
-                          unet_beacon[BeaconCnt].Addr_16b          = mac_packet.SrcAddr_16b;
-                          unet_beacon[BeaconCnt].Beacon_RSSI       = mac_packet.Frame_RSSI;
+                          unet_beacon[BeaconCnt].PAN_Ident         = MAC_RX_SRC_PAN_IDENT();
+                          unet_beacon[BeaconCnt].Addr_16b          = MAC_RX_SRC_ADDR_16B();
+                          unet_beacon[BeaconCnt].Beacon_RSSI       = mac_frame->Frame_RSSI;
                           // Verificar formato do Beacon Frame
-                          unet_beacon[BeaconCnt].DeviceDepth       = mac_packet.MAC_Payload[6];
+                          unet_beacon[BeaconCnt].DeviceDepth       = mac_frame->MAC_Payload[6];
                           unet_beacon[BeaconCnt].AssociationStatus = 0;
                           BeaconCnt++;
                         }
@@ -1395,7 +2090,7 @@ void UNET_MAC(void *param)
               data1 = 0;
               for(i=0;i<8;i++)
               {
-                  if(mac_packet.DstAddr_64b[i] != mac64Address[i])
+                  if(MAC_RX_DST_ADDR_64B(i) != mac64Address[i])
                   {
                     data1 = 0xFF;
                     break;
@@ -1410,29 +2105,198 @@ void UNET_MAC(void *param)
                   if(mac_frame_control.bits.FrameType != MACFrame)
                   {
                       // Tratar MAC frames da associao
+                      handoff = TRUE;
                       OSSemPost(MAC_Event);
                   }
               }
             }
           }
       }
+      } while ((handoff == FALSE) && (frames < RX_DRAIN_MAX));
+      
+      RFDrainStat(frames);
       
-      releaseRadio();
+      NWK_Unlock(NWK_LOCK_NEIGHBOR | NWK_LOCK_TX);
+   }
+}
+
+#ifndef MRF24J40_HAS_BURST
+/* Driver do rdio sem acesso em rajada  long RAM (MRF24J40_HAS_BURST):
+   a rajada  feita com um acesso SPI por byte */
+static void PHYGetLongRAMBurst(INT16U address, INT8U *data, INT8U size)
+{
+  INT8U i;
+  
+  for (i = 0; i < size; i++)
+  {
+    data[i] = PHYGetLongRAMAddr((INT16U)(address + i));
+  }
+}
+
+static void PHYSetLongRAMBurst(INT16U address, const INT8U *data, INT8U size)
+{
+  INT8U i;
+  
+  for (i = 0; i < size; i++)
+  {
+    PHYSetLongRAMAddr((INT16U)(address + i), data[i]);
+  }
+}
+#endif
+
+/* Task to transmit the frames of the TX queue */
+// A guarda NWK_LOCK_TX s fica adquirida para carregar a TX normal FIFO e, com
+// NWK_LOCK_NEIGHBOR (callbacks de rota e de ping), para tratar o resultado:
+// durante a transmisso (e a espera pelo ACK) UNET_MAC continua decodificando frames
+void UNET_TX(void *param)
+{
+   MAC_TX_REQUEST *request;
+   INT8U status;
+   INT16U events;
+   
+   (void)param;
+   
+   for (;;)
+   {
+      request = MAC_TxNext();
+      
+#if ((CONTIKI_MAC_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))
+      // Liga o rdio para a primeira transmisso da requisio, sem as guardas
+      if (request->Wake == TRUE)
+      {
+        request->Wake = FALSE;
+        NWK_TxRadioWake();
+      }
+#endif
+      
+      NWK_Lock(NWK_LOCK_TX);
+      
+      UserEnterCritical();
+      mac_tasks_pending.bits.PacketPendingAck = 1;
+      UserExitCritical();
+      
+      // Escrita do frame na TX normal FIFO em uma nica transao SPI
+      PHYSetLongRAMBurst((INT16U)0x000, request->Fifo, (INT8U)(2 + request->Fifo[1]));
+      UNET_TxTriggerTick = OSGetTickCount();
+      UNET_TxTrigger     = RADIO_TIMESTAMP_US();
+      PHYSetShortRAMAddr(WRITE_TXNMTRIG, request->Trigger);
+      
+      NWK_Unlock(NWK_LOCK_TX);
+      
+      // Espera o RF_TXIF (ACK recebido ou falha)
+      if (OSSemPend(RF_TX_Event,(INT16U)(TX_TIMEOUT+RadioRand())) == OK)
+      {
+        status = (macACK == TRUE) ? OK : TX_NO_ACK_ERROR;
+      }else
+      {
+        status = TX_RADIO_ERROR;
+      }
+      
+      NWK_Lock(NWK_LOCK_NEIGHBOR | NWK_LOCK_TX);
+      
+      if (status == TX_RADIO_ERROR)
+      {
+        UserEnterCritical();
+        mac_tasks_pending.bits.PacketPendingAck = 0;
+        UserExitCritical();
+        
+        // Radio provavelmente travou, efetuar o reset
+        if (request->Trigger == MAC_TX_ACK)
+        {
+          //  Disable receiving packets off air
+          PHYSetShortRAMAddr(WRITE_BBREG1,0x04);              
+          
+          MRF24J40Reset();
+          
+          //  Enable receiving packets off air
+          PHYSetShortRAMAddr(WRITE_BBREG1,0x00);
+        }
+      }
+      
+      MAC_TxDone(request, status);
+      
+      NWK_Unlock(NWK_LOCK_NEIGHBOR | NWK_LOCK_TX);
+      
+      // Requisio liberada: a cabea da fila de repasse e as mensagens
+      // do pool de envio podem ser transmitidas
+      events = 0;
+      if (NWK_FwdWaitTx == TRUE)
+      {
+        NWK_FwdWaitTx = FALSE;
+        events |= NWK_EVENT_ROUTE;
+      }
+      if (NWK_SendWaitTx == TRUE)
+      {
+        NWK_SendWaitTx = FALSE;
+        events |= NWK_EVENT_SEND;
+      }
+      if (events != 0)
+      {
+        NWK_EventSignal(events);
+      }
    }
 }
 
 /* Task to handle radio Rx and Tx events */
+// Cabealho lido antes de reservar o slot: FC(2) + SN(1) + PAN(2) + endereo de destino de 16 bits(2)
+#define RX_FILTER_HEADER_SIZE   (INT8U)7
+
+#define RX_FILTER_PASS          (INT8U)0
+#define RX_FILTER_PAN           (INT8U)1
+#define RX_FILTER_ADDR          (INT8U)2
+#define RX_FILTER_BUSY          (INT8U)3
+
+#if (RX_ADDRESS_FILTER == 1)
+
+// Filtro de endereo aplicado no RX FIFO, antes do buffer de RX.
+// S descarta frames de dados e de comando com destino de 16 bits quando
+// associado; beacons, broadcasts e os demais modos passam e so tratados pelo UNET_MAC
+static INT8U RFAddressFilter(const INT8U *header, INT8U size)
+{
+  MAC_FRAME_CONTROL fc;
+  INT16U            value;
+  
+  if ((mac_tasks_pending.bits.isAssociated != 1) || (size < RX_FILTER_HEADER_SIZE))
+  {
+    return RX_FILTER_PASS;
+  }
+  
+  fc.Val = (INT16U)((header[0] << 8) | header[1]);
+  if (((fc.bits.FrameType != DataFrame) && (fc.bits.FrameType != MACFrame)) || (fc.bits.DstAddrMode != 0b10))
+  {
+    return RX_FILTER_PASS;
+  }
+  
+  // Testa o PANId
+  value = (INT16U)(header[3] | (header[4] << 8));
+  if ((value != macPANId) && (value != 0xFFFF))
+  {
+    return RX_FILTER_PAN;
+  }
+  
+  // Testa o endereo de 16 bits (broadcast passa)
+  value = (INT16U)(header[5] | (header[6] << 8));
+  if ((value != macAddr) && (value != 0xFFFF))
+  {
+    return RX_FILTER_ADDR;
+  }
+  
+  return RX_FILTER_PASS;
+}
+#endif
+
 void UNET_RF_Event(void *param)
 {
   /* task setup */
   volatile MRF24J40_IFREG flags;
-  INT16U         size = 0;
   INT8U          i;
-  INT8U          RSSI_VAL;
-  INT8U          LQI_VAL;
-  INT8U          ReceivedByte=0;  
-  INT16U         j=0;
-  INT16U         CRCValue = 0;
+  RF_RX_SLOT    *slot;
+  static INT8U   header[RX_FILTER_HEADER_SIZE];
+  INT8U         *frame;
+  INT8U          hsize;
+  INT8U          full;
+  INT8U          filter;
+  ostick_t       timestamp;
 
   (void)param;
   //////////////////////////////////////////////
@@ -1453,6 +2317,17 @@ void UNET_RF_Event(void *param)
       // Stop Task to wait RF Event
       OSSemPend (RF_Event,0);
       
+      // Fim da contrapresso pedido por RFBufferFlowControl: habilita o ACK
+      // automatico antes de desligar RFBackpressure, um frame recebido neste
+      // intervalo  guardado sem ACK e o vizinho o retransmite
+      if (RFBackpressureRelease == 1)
+      {
+        RFBackpressureRelease = 0;
+        PHYSetAutoACK(1);
+        RFBackpressure = 0;
+        UNET_NodeStat.bptime += (INT16U)UNET_TicksSince(RFBackpressureStart);
+      }
+      
       // read the interrupt status register to see what caused the interrupt        
       flags.Val=PHYGetShortRAMAddr(READ_ISRSTS);
            
@@ -1464,6 +2339,10 @@ void UNET_RF_Event(void *param)
         debug_tx_count1++;
         //read out the results of the transmission
         results.Val = PHYGetShortRAMAddr(READ_TXSR);
+        
+        // the number of retries is located in bits 7-6 of TXSR
+        i=PHYGetLongRAMAddr(0x001);
+        UNET_TxStatUpdate((INT8U)(results.Val >> 6), i, (INT8U)mac_tasks_pending.bits.PacketPendingAck);
                 
         if(results.bits.b0 == 1)
         {
@@ -1482,8 +2361,6 @@ void UNET_RF_Event(void *param)
           UNET_NodeStat.txed++;
           CHECK_NODESTAT(UNET_NodeStat.txed);
           
-          i=PHYGetLongRAMAddr(0x001);
-          
           if(UNET_NodeStat.txedbytes<0xFFFF){
              UNET_NodeStat.txedbytes +=i;
           }
@@ -1502,6 +2379,9 @@ void UNET_RF_Event(void *param)
             
       if(flags.bits.RF_RXIF)
       {                      
+         // Instante de recepo, antes das transaes SPI
+         timestamp = OSGetTickCount();
+         
 #if ((CONTIKI_MAC_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))
     	  SetRadioStatus(1);
 #endif
@@ -1514,10 +2394,41 @@ void UNET_RF_Event(void *param)
          //first byte of the receive buffer is the packet length                
          i=PHYGetLongRAMAddr(0x300);          
          
-         // Verifica se aceitar o pacote ir gerar buffer underrun
-         size = RFBuffer.OSQEntries + i + 4;
+         // Frames PHY tem no maximo 127 bytes
+         if (i > 127) i = 127;
          
-         if(RFBufferSize > size)
+         // Le primeiro o cabealho, no slot livre ou, com o buffer cheio,
+         // em um buffer  parte (o slot em In pode ser o slot em uso pelo UNET_MAC)
+         full   = (RFBufferEntries() >= RFBufferSize) ? TRUE : FALSE;
+         slot   = RFBufferSlot(RFBuffer.In);
+         frame  = (full == TRUE) ? header : slot->Frame;
+         hsize  = (i < RX_FILTER_HEADER_SIZE) ? i : RX_FILTER_HEADER_SIZE;
+         PHYGetLongRAMBurst((INT16U)0x301, frame, hsize);
+#if (RX_ADDRESS_FILTER == 1)
+         filter = RFAddressFilter(frame, hsize);
+#else
+         filter = RX_FILTER_PASS;
+#endif
+         
+         // Com o ACK automatico desabilitado o rdio no confirmou os frames que
+         // pediram ACK: no so guardados, pois o vizinho vai retransmiti-los
+         if ((filter == RX_FILTER_PASS) && (RFBackpressure == 1) && (hsize > 0) && (frame[0] & MAC_ACK))
+         {
+            filter = RX_FILTER_BUSY;
+         }
+         
+         if (filter == RX_FILTER_PAN)
+         {
+            UNET_NodeStat.filtpan++;
+            CHECK_NODESTAT(UNET_NodeStat.filtpan);
+         }else
+         if (filter == RX_FILTER_ADDR)
+         {
+            UNET_NodeStat.filtaddr++;
+            CHECK_NODESTAT(UNET_NodeStat.filtaddr);
+         }else
+         // Verifica se h slot livre para o pacote
+         if((filter == RX_FILTER_PASS) && (full == FALSE))
          {            
              // Incrementa o numero de pacotes recebidos
              UNET_NodeStat.rxed++;
@@ -1526,32 +2437,27 @@ void UNET_RF_Event(void *param)
              if(UNET_NodeStat.rxedbytes<0xFFFF){
                 UNET_NodeStat.rxedbytes +=i;
              }
-                
-             for(j=0;j<=i;j++)
-             {
-                //read out the rest of the buffer
-                ReceivedByte = PHYGetLongRAMAddr((INT16U)0x300 + j);    
-                OSWQueue(&RFBuffer,ReceivedByte);
-                if ((j > 0) && (j <= i-2))
-                {
-                  CRC_Update(ReceivedByte);
-                }
-             }
              
-             CRCValue = CRC_Get();       
-             
-             // Guarda o CRC computado
-             OSWQueue(&RFBuffer,(INT8U)(CRCValue >> 8));
-             OSWQueue(&RFBuffer,(INT8U)(CRCValue & 0xFF));
-
-             // LQI  --> 0x300+i+(INT16U)1
-             // RSSI --> 0x300+i+(INT16U)2
-             LQI_VAL  = PHYGetLongRAMAddr(0x300+i+(INT16U)1);
-             RSSI_VAL = PHYGetLongRAMAddr(0x300+i+(INT16U)2);
+             slot = RFBufferSlot(RFBuffer.In);
+             slot->Length = i;
+                
+             // Le o frame, o FCS, o LQI e o RSSI em uma unica transacao SPI
+             // RX FIFO: 0x301 .. 0x300+i   --> frame + FCS
+             //          0x300+i+1          --> LQI
+             //          0x300+i+2          --> RSSI
+             // (o cabealho j est no slot)
+             PHYGetLongRAMBurst((INT16U)(0x301 + hsize), &slot->Frame[hsize], (INT8U)(i + 2 - hsize));
+
+             // Guarda o CRC computado (frame sem o FCS), o LQI, o RSSI e o instante de recepo
+             slot->CRC       = (i > 2) ? CRC_Compute(slot->Frame, (INT8U)(i - 2)) : 0;
+             slot->LQI       = slot->Frame[i];
+             slot->RSSI      = slot->Frame[i+1];
+             slot->Timestamp = timestamp;
              
-             // Guarda no final da fila o valor do RSSI
-             OSWQueue(&RFBuffer,RSSI_VAL);
-             OSWQueue(&RFBuffer,LQI_VAL);
+             // Publica o frame: uma nica atualizao de indice por frame
+             UserEnterCritical();
+             RFBuffer.In = RFBufferNext(RFBuffer.In);
+             UserExitCritical();
              
 #if ((CONTIKI_MAC_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))
              SetRadioStatus(0);
@@ -1559,14 +2465,19 @@ void UNET_RF_Event(void *param)
              
              OSSemPost(RF_RX_Event);
              
-             /* No tem espao para o prximo pacote ? */
-             if(RFBuffer.OSQEntries + 133  > RFBufferSize){
+             /* O buffer chegou  marca superior ? */
+             if((RFBackpressure == 0) && (RFBufferEntries() >= RX_ACK_HIGH_WATERMARK)){
                 /* Desabilita ACK automatico */
-                PHYSetAutoACK(0);                
+                PHYSetAutoACK(0);
+                RFBackpressure      = 1;
+                RFBackpressureStart = OSGetTickCount();
+                UNET_NodeStat.bpevents++;
+                CHECK_NODESTAT(UNET_NodeStat.bpevents);
              }              
              
          }else{
             // Incrementa o numero de pacotes descartados por overflow de buffer de RX
+            // ou recusados sem ACK
             UNET_NodeStat.overbuf++;
             CHECK_NODESTAT(UNET_NodeStat.overbuf);
          }
@@ -1591,6 +2502,18 @@ void UNET_RF_Event(void *param)
   }
 }
 
+/* Ticks elapsed since a tick count. The tick count wraps at TICK_COUNT_OVERFLOW */
+ostick_t UNET_TicksSince(ostick_t tick)
+{
+    ostick_t now = OSGetTickCount();
+    
+    if (now >= tick)
+    {
+      return (ostick_t)(now - tick);
+    }
+    return (ostick_t)(now + (TICK_COUNT_OVERFLOW - tick));
+}
+
 /* Return a pointer to "UNET_NodeStat" struct */
 INT8U* GetUNET_Statistics(INT8U* tamanho){
     if(tamanho == NULL) return NULL;
@@ -1599,6 +2522,11 @@ INT8U* GetUNET_Statistics(INT8U* tamanho){
     return (INT8U*)&UNET_NodeStat;
 }
 
+/* Return a pointer to the transmission statistics */
+const UNET_TX_STAT *GetUNET_TxStatistics(void){
+    return &UNET_TxStat;
+}
+
 
 #if ((CONTIKI_MAC_ENABLE == 1) && (DEVICE_TYPE != PAN_COORDINATOR))
 void Contiki_Task(void *param){
@@ -1621,7 +2549,7 @@ void Contiki_Task(void *param){
 		
 #if 1
 		if (!GetRadioStatus()){
-			acquireRadio();
+			NWK_Lock(NWK_LOCK_TX);
 			
 			WakeupRadio();
 			//aguarda o tempo para estabilizar o oscilador apos acordar o radio
@@ -1631,7 +2559,7 @@ void Contiki_Task(void *param){
 				DelayTask(1);
 			}			
 			SleepRadio();
-			releaseRadio();
+			NWK_Unlock(NWK_LOCK_TX);
 		}
 #endif
 		